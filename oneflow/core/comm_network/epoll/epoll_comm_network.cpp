@@ -16,6 +16,7 @@ limitations under the License.
 #ifdef __linux__
 
 #include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
+#include "oneflow/core/comm_network/epoll/io_uring_socket_helper.h"
 #include "glog/logging.h"
 #include "oneflow/core/control/ctrl_client.h"
 #include "oneflow/core/control/global_process_ctx.h"
@@ -29,6 +30,9 @@ namespace oneflow {
 namespace {
 
 static const int32_t kInvlidPort = 0;
+static const int64_t kControlConnIdx = 0;
+static const int64_t kDefaultNumDataConns = 4;
+static const int64_t kDefaultStripeBytes = 1 << 20;
 
 sockaddr_in GetSockAddr(const std::string& addr, uint16_t port) {
   sockaddr_in sa;
@@ -39,7 +43,7 @@ sockaddr_in GetSockAddr(const std::string& addr, uint16_t port) {
   return sa;
 }
 
-int SockListen(int listen_sockfd, int32_t* listen_port, int32_t total_machine_num) {
+int SockListen(int listen_sockfd, int32_t* listen_port, int32_t backlog) {
   // System designated available port if listen_port == kInvlidPort, otherwise, the configured port
   // is used.
   sockaddr_in sa = GetSockAddr("0.0.0.0", *listen_port);
@@ -59,7 +63,7 @@ int SockListen(int listen_sockfd, int32_t* listen_port, int32_t total_machine_nu
     }
   }
   if (bind_result == 0) {
-    PCHECK(listen(listen_sockfd, total_machine_num) == 0);
+    PCHECK(listen(listen_sockfd, backlog) == 0);
     LOG(INFO) << "CommNet:Epoll listening on "
               << "0.0.0.0:" + std::to_string(*listen_port);
   } else {
@@ -82,6 +86,17 @@ uint16_t PullPort(int64_t machine_id) {
   return port;
 }
 
+bool UseIOUring() {
+  if (!ParseBooleanFromEnv("ONEFLOW_COMM_NET_EPOLL_USE_IO_URING", false)) { return false; }
+#ifdef WITH_LIBURING
+  if (IOUringPoller::IsAvailable()) { return true; }
+  LOG(WARNING) << "CommNet:Epoll falls back to epoll because io_uring is unavailable";
+#else
+  LOG(WARNING) << "CommNet:Epoll falls back to epoll because OneFlow is built without liburing";
+#endif  // WITH_LIBURING
+  return false;
+}
+
 }  // namespace
 
 EpollCommNet::~EpollCommNet() {
@@ -89,8 +104,17 @@ EpollCommNet::~EpollCommNet() {
     VLOG(1) << "CommNet Thread " << i << " finish";
     pollers_[i]->Stop();
   }
+#ifdef WITH_LIBURING
+  for (size_t i = 0; i < io_uring_pollers_.size(); ++i) {
+    VLOG(1) << "CommNet IOUring Thread " << i << " finish";
+    io_uring_pollers_[i]->Stop();
+  }
+#endif  // WITH_LIBURING
   OF_ENV_BARRIER();
   for (IOEventPoller* poller : pollers_) { delete poller; }
+#ifdef WITH_LIBURING
+  for (IOUringPoller* poller : io_uring_pollers_) { delete poller; }
+#endif  // WITH_LIBURING
   for (auto& pair : sockfd2helper_) { delete pair.second; }
 }
 
@@ -112,7 +136,41 @@ void EpollCommNet::SendTransportMsg(int64_t dst_machine_id, const TransportMsg&
 }
 
 void EpollCommNet::SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg) {
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  if (msg.msg_type == SocketMsgType::kRequestRead) {
+    SendRequestReadMsg(dst_machine_id, msg);
+  } else {
+    GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  }
+}
+
+void EpollCommNet::SendRequestReadMsg(int64_t dst_machine_id, const SocketMsg& msg) {
+  auto src_mem_desc = static_cast<const SocketMemDesc*>(msg.request_read_msg.src_token);
+  const int64_t byte_size = src_mem_desc->byte_size;
+  const int64_t num_chunks =
+      std::max<int64_t>(RoundUp(byte_size, stripe_bytes_) / stripe_bytes_, 1);
+  // Consecutive reads continue the rotation, so small reads are spread over the data connections
+  // as well.
+  const uint64_t first_data_conn = next_data_conn_.fetch_add(num_chunks, std::memory_order_relaxed);
+  FOR_RANGE(int64_t, chunk_idx, 0, num_chunks) {
+    SocketMsg chunk_msg = msg;
+    chunk_msg.request_read_msg.offset = chunk_idx * stripe_bytes_;
+    chunk_msg.request_read_msg.byte_size =
+        std::min(stripe_bytes_, byte_size - chunk_msg.request_read_msg.offset);
+    chunk_msg.request_read_msg.num_chunks = num_chunks;
+    GetDataSocketHelper(dst_machine_id, (first_data_conn + chunk_idx) % num_data_conns_)
+        ->AsyncWrite(chunk_msg);
+  }
+}
+
+void EpollCommNet::ReadChunkDone(void* read_id, int64_t num_chunks) {
+  if (num_chunks > 1) {
+    std::unique_lock<std::mutex> lck(read_id2num_done_chunks_mtx_);
+    int64_t& num_done_chunks = read_id2num_done_chunks_[read_id];
+    num_done_chunks += 1;
+    if (num_done_chunks < num_chunks) { return; }
+    read_id2num_done_chunks_.erase(read_id);
+  }
+  ReadDone(read_id);
 }
 
 SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
@@ -123,23 +181,45 @@ SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
 }
 
 EpollCommNet::EpollCommNet() : CommNetIf() {
-  pollers_.resize(Singleton<ResourceDesc, ForSession>::Get()->CommNetWorkerNum(), nullptr);
-  for (size_t i = 0; i < pollers_.size(); ++i) { pollers_[i] = new IOEventPoller; }
+  num_data_conns_ =
+      ParseIntegerFromEnv("ONEFLOW_COMM_NET_EPOLL_NUM_DATA_CONNECTIONS", kDefaultNumDataConns);
+  CHECK_GT(num_data_conns_, 0);
+  stripe_bytes_ = ParseIntegerFromEnv("ONEFLOW_COMM_NET_EPOLL_STRIPE_BYTES", kDefaultStripeBytes);
+  CHECK_GT(stripe_bytes_, 0);
+  next_data_conn_ = 0;
+  const size_t num_pollers = Singleton<ResourceDesc, ForSession>::Get()->CommNetWorkerNum();
+  if (UseIOUring()) {
+#ifdef WITH_LIBURING
+    LOG(INFO) << "CommNet:Epoll uses io_uring";
+    FOR_RANGE(size_t, i, 0, num_pollers) { io_uring_pollers_.emplace_back(new IOUringPoller); }
+#endif  // WITH_LIBURING
+  } else {
+    FOR_RANGE(size_t, i, 0, num_pollers) { pollers_.emplace_back(new IOEventPoller); }
+  }
   InitSockets();
   for (IOEventPoller* poller : pollers_) { poller->Start(); }
+#ifdef WITH_LIBURING
+  for (IOUringPoller* poller : io_uring_pollers_) { poller->Start(); }
+#endif  // WITH_LIBURING
 }
 
 void EpollCommNet::InitSockets() {
   int64_t this_machine_id = GlobalProcessCtx::Rank();
   auto this_machine = Singleton<ResourceDesc, ForSession>::Get()->machine(this_machine_id);
   int64_t total_machine_num = Singleton<ResourceDesc, ForSession>::Get()->process_ranks().size();
-  machine_id2sockfd_.assign(total_machine_num, -1);
+  const int64_t num_conns = 1 + num_data_conns_;
+  machine_id2sockfds_.assign(total_machine_num, std::vector<int>(num_conns, -1));
   sockfd2helper_.clear();
   size_t poller_idx = 0;
-  auto NewSocketHelper = [&](int sockfd) {
-    IOEventPoller* poller = pollers_[poller_idx];
-    poller_idx = (poller_idx + 1) % pollers_.size();
-    return new SocketHelper(sockfd, poller);
+  auto NewSocketHelper = [&](int sockfd) -> SocketHelper* {
+    const size_t cur_poller_idx = poller_idx;
+    poller_idx = (poller_idx + 1) % std::max(pollers_.size(), io_uring_pollers_.size());
+#ifdef WITH_LIBURING
+    if (!io_uring_pollers_.empty()) {
+      return new IOUringSocketHelper(sockfd, io_uring_pollers_[cur_poller_idx]);
+    }
+#endif  // WITH_LIBURING
+    return new EpollSocketHelper(sockfd, pollers_[cur_poller_idx]);
   };
 
   // listen
@@ -152,12 +232,13 @@ void EpollCommNet::InitSockets() {
       this_listen_port = Singleton<EnvDesc>::Get()->data_port();
     }
   }
-  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num), 0);
+  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num * num_conns), 0);
   CHECK_NE(this_listen_port, 0);
   PushPort(this_machine_id, this_listen_port);
   int32_t src_machine_count = 0;
 
-  // connect
+  // connect, every connection starts with the rank of the connecting machine and the index of
+  // the connection, so the peer can accept them in any order
   for (int64_t peer_id : peer_machine_id()) {
     if (peer_id < this_machine_id) {
       ++src_machine_count;
@@ -166,42 +247,56 @@ void EpollCommNet::InitSockets() {
     uint16_t peer_port = PullPort(peer_id);
     auto peer_machine = Singleton<ResourceDesc, ForSession>::Get()->machine(peer_id);
     sockaddr_in peer_sockaddr = GetSockAddr(peer_machine.addr(), peer_port);
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    const int val = 1;
-    PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
-    PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
-           == 0);
-    ssize_t n = write(sockfd, &this_machine_id, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
-    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    machine_id2sockfd_[peer_id] = sockfd;
+    FOR_RANGE(int64_t, conn_idx, 0, num_conns) {
+      int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+      const int val = 1;
+      PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
+      PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
+             == 0);
+      const int64_t handshake[2] = {this_machine_id, conn_idx};
+      ssize_t n = write(sockfd, handshake, sizeof(handshake));
+      PCHECK(n == sizeof(handshake));
+      CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
+      machine_id2sockfds_[peer_id][conn_idx] = sockfd;
+    }
   }
 
   // accept
-  HashSet<int64_t> processed_ranks;
-  FOR_RANGE(int32_t, idx, 0, src_machine_count) {
+  FOR_RANGE(int32_t, idx, 0, src_machine_count * num_conns) {
     sockaddr_in peer_sockaddr;
     socklen_t len = sizeof(peer_sockaddr);
     int sockfd = accept(listen_sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), &len);
     PCHECK(sockfd != -1);
-    int64_t peer_rank;
-    ssize_t n = read(sockfd, &peer_rank, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
+    int64_t handshake[2];
+    ssize_t n = read(sockfd, handshake, sizeof(handshake));
+    PCHECK(n == sizeof(handshake));
+    const int64_t peer_rank = handshake[0];
+    const int64_t conn_idx = handshake[1];
+    CHECK_LT(conn_idx, num_conns)
+        << "ONEFLOW_COMM_NET_EPOLL_NUM_DATA_CONNECTIONS differs between machines";
+    CHECK_EQ(machine_id2sockfds_.at(peer_rank).at(conn_idx), -1);
     CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    CHECK(processed_ranks.emplace(peer_rank).second);
-    machine_id2sockfd_[peer_rank] = sockfd;
+    machine_id2sockfds_[peer_rank][conn_idx] = sockfd;
   }
   PCHECK(close(listen_sockfd) == 0);
   ClearPort(this_machine_id);
 
   // useful log
   FOR_RANGE(int64_t, machine_id, 0, total_machine_num) {
-    VLOG(2) << "machine " << machine_id << " sockfd " << machine_id2sockfd_[machine_id];
+    FOR_RANGE(int64_t, conn_idx, 0, num_conns) {
+      VLOG(2) << "machine " << machine_id << " connection " << conn_idx << " sockfd "
+              << machine_id2sockfds_[machine_id][conn_idx];
+    }
   }
 }
 
 SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id) {
-  int sockfd = machine_id2sockfd_.at(machine_id);
+  int sockfd = machine_id2sockfds_.at(machine_id).at(kControlConnIdx);
+  return sockfd2helper_.at(sockfd);
+}
+
+SocketHelper* EpollCommNet::GetDataSocketHelper(int64_t machine_id, int64_t data_conn_idx) {
+  int sockfd = machine_id2sockfds_.at(machine_id).at(kControlConnIdx + 1 + data_conn_idx);
   return sockfd2helper_.at(sockfd);
 }
 
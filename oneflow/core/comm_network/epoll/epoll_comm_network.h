@@ -24,6 +24,8 @@ limitations under the License.
 
 namespace oneflow {
 
+class IOUringPoller;
+
 class EpollCommNet final : public CommNetIf<SocketMemDesc> {
  public:
   OF_DISALLOW_COPY_AND_MOVE(EpollCommNet);
@@ -32,6 +34,7 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   void SendActorMsg(int64_t dst_machine_id, const ActorMsg& msg) override;
   void SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg);
   void SendTransportMsg(int64_t dst_machine_id, const TransportMsg& msg);
+  void ReadChunkDone(void* read_id, int64_t num_chunks);
 
  private:
   SocketMemDesc* NewMemDesc(void* ptr, size_t byte_size) override;
@@ -39,12 +42,24 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   friend class Singleton<EpollCommNet>;
   EpollCommNet();
   void InitSockets();
+  // Connection 0 to every peer carries the control messages, the data connections 1 to
+  // num_data_conns_ carry the chunks of read request bodies.
   SocketHelper* GetSocketHelper(int64_t machine_id);
+  SocketHelper* GetDataSocketHelper(int64_t machine_id, int64_t data_conn_idx);
+  void SendRequestReadMsg(int64_t dst_machine_id, const SocketMsg& msg);
   void DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) override;
 
+  int64_t num_data_conns_;
+  int64_t stripe_bytes_;
+  std::atomic<uint64_t> next_data_conn_;
+  // Only one kind of poller is used, io_uring_pollers_ if ONEFLOW_COMM_NET_EPOLL_USE_IO_URING is
+  // set and io_uring is available, otherwise pollers_.
   std::vector<IOEventPoller*> pollers_;
-  std::vector<int> machine_id2sockfd_;
+  std::vector<IOUringPoller*> io_uring_pollers_;
+  std::vector<std::vector<int>> machine_id2sockfds_;
   HashMap<int, SocketHelper*> sockfd2helper_;
+  std::mutex read_id2num_done_chunks_mtx_;
+  HashMap<void*, int64_t> read_id2num_done_chunks_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,157 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#if defined(__linux__) && defined(WITH_LIBURING)
+
+#include "oneflow/core/comm_network/epoll/io_uring_poller.h"
+#include "oneflow/core/comm_network/epoll/io_uring_socket_helper.h"
+#include <sys/eventfd.h>
+
+namespace oneflow {
+
+namespace {
+
+constexpr uint32_t kMinRingQueueDepth = 64;
+
+}  // namespace
+
+IOUringPoller::IOUringPoller() : ring_{}, wakeup_event_num_(0), stop_requested_(false) {
+  stopped_ = false;
+  wakeup_fd_ = eventfd(0, EFD_CLOEXEC);
+  PCHECK(wakeup_fd_ != -1);
+  wakeup_op_.on_complete = [this](int32_t res) { OnWakeup(res); };
+}
+
+IOUringPoller::~IOUringPoller() {
+  io_uring_queue_exit(&ring_);
+  for (int sockfd : sockfds_) { PCHECK(close(sockfd) == 0); }
+  PCHECK(close(wakeup_fd_) == 0);
+}
+
+bool IOUringPoller::IsAvailable() {
+  struct io_uring ring {};
+  if (io_uring_queue_init(1, &ring, 0) == 0) {
+    io_uring_queue_exit(&ring);
+    return true;
+  } else {
+    return false;
+  }
+}
+
+void IOUringPoller::AddSocketHelper(IOUringSocketHelper* helper) {
+  int opt = fcntl(helper->sockfd(), F_GETFD);
+  PCHECK(opt != -1);
+  PCHECK(fcntl(helper->sockfd(), F_SETFD, opt | FD_CLOEXEC) == 0);
+  helpers_.emplace_back(helper);
+  sockfds_.emplace_back(helper->sockfd());
+}
+
+void IOUringPoller::Start() {
+  // Every socket has at most one receive and one send in flight, plus the wakeup read.
+  const uint32_t num_inflight = helpers_.size() * 2 + 1;
+  const int ret = io_uring_queue_init(std::max(num_inflight, kMinRingQueueDepth), &ring_, 0);
+  CHECK_EQ(ret, 0) << "io_uring_queue_init failed: " << strerror(-ret);
+  std::vector<struct iovec> recv_buffers(helpers_.size());
+  FOR_RANGE(size_t, i, 0, helpers_.size()) {
+    recv_buffers.at(i).iov_base = helpers_.at(i)->mut_recv_buffer();
+    recv_buffers.at(i).iov_len = helpers_.at(i)->recv_buffer_size();
+  }
+  const int register_ret =
+      io_uring_register_buffers(&ring_, recv_buffers.data(), recv_buffers.size());
+  if (register_ret == 0) {
+    FOR_RANGE(size_t, i, 0, helpers_.size()) { helpers_.at(i)->set_recv_buffer_index(i); }
+  } else {
+    // Registration fails e.g. when the buffers exceed RLIMIT_MEMLOCK, which only costs the
+    // page pinning on every receive.
+    LOG(WARNING) << "CommNet:Epoll io_uring_register_buffers failed: " << strerror(-register_ret);
+  }
+  thread_ = std::thread(&IOUringPoller::PollLoop, this);
+}
+
+void IOUringPoller::Stop() {
+  stop_requested_.store(true);
+  uint64_t event_num = 1;
+  PCHECK(write(wakeup_fd_, &event_num, 8) == 8);
+  thread_.join();
+}
+
+void IOUringPoller::NotifyWritePending(IOUringSocketHelper* helper) {
+  bool need_wakeup = false;
+  {
+    std::unique_lock<std::mutex> lck(write_pending_helpers_mtx_);
+    need_wakeup = write_pending_helpers_.empty();
+    write_pending_helpers_.emplace_back(helper);
+  }
+  if (need_wakeup) {
+    uint64_t event_num = 1;
+    PCHECK(write(wakeup_fd_, &event_num, 8) == 8);
+  }
+}
+
+io_uring_sqe* IOUringPoller::GetSqe() {
+  io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr) {
+    const int ret = io_uring_submit(&ring_);
+    CHECK_GE(ret, 0) << "io_uring_submit failed: " << strerror(-ret);
+    sqe = io_uring_get_sqe(&ring_);
+  }
+  return CHECK_NOTNULL(sqe);
+}
+
+void IOUringPoller::PollLoop() {
+  for (IOUringSocketHelper* helper : helpers_) { helper->StartRecv(); }
+  SubmitWakeupRead();
+  while (!stopped_) {
+    const int ret = io_uring_submit_and_wait(&ring_, 1);
+    if (ret < 0) {
+      CHECK_EQ(ret, -EINTR) << "io_uring_submit_and_wait failed: " << strerror(-ret);
+      continue;
+    }
+    struct io_uring_cqe* cqe = nullptr;
+    unsigned head = 0;
+    unsigned num_cqes = 0;
+    io_uring_for_each_cqe(&ring_, head, cqe) {
+      static_cast<IOUringOp*>(io_uring_cqe_get_data(cqe))->on_complete(cqe->res);
+      num_cqes += 1;
+    }
+    io_uring_cq_advance(&ring_, num_cqes);
+  }
+}
+
+void IOUringPoller::SubmitWakeupRead() {
+  io_uring_sqe* sqe = GetSqe();
+  io_uring_prep_read(sqe, wakeup_fd_, &wakeup_event_num_, 8, 0);
+  io_uring_sqe_set_data(sqe, &wakeup_op_);
+}
+
+void IOUringPoller::OnWakeup(int32_t res) {
+  CHECK_EQ(res, 8) << "wakeup read failed: " << strerror(-res);
+  std::vector<IOUringSocketHelper*> helpers;
+  {
+    std::unique_lock<std::mutex> lck(write_pending_helpers_mtx_);
+    helpers.swap(write_pending_helpers_);
+  }
+  for (IOUringSocketHelper* helper : helpers) { helper->StartWrite(); }
+  if (stop_requested_.load()) {
+    VLOG(1) << "Break IOUring Loop";
+    stopped_ = true;
+  } else {
+    SubmitWakeupRead();
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // __linux__ && WITH_LIBURING
@@ -0,0 +1,80 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_EPOLL_IO_URING_POLLER_H_
+#define ONEFLOW_CORE_COMM_NETWORK_EPOLL_IO_URING_POLLER_H_
+
+#include "oneflow/core/comm_network/epoll/socket_message.h"
+
+#if defined(__linux__) && defined(WITH_LIBURING)
+
+#include <liburing.h>
+
+namespace oneflow {
+
+class IOUringSocketHelper;
+
+// A request submitted to the ring, the address of the IOUringOp is the user data of its
+// completion.
+struct IOUringOp {
+  std::function<void(int32_t res)> on_complete;
+};
+
+// Completion based counterpart of IOEventPoller. One thread submits the requests of its sockets
+// and runs their completion handlers, the receive buffers of the sockets are registered with
+// the ring when it starts.
+class IOUringPoller final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(IOUringPoller);
+  IOUringPoller();
+  ~IOUringPoller();
+
+  static bool IsAvailable();
+
+  // Must be called before Start, the poller closes the socket when it is destroyed.
+  void AddSocketHelper(IOUringSocketHelper* helper);
+
+  void Start();
+  void Stop();
+
+  // Called from any thread when the helper has messages to write.
+  void NotifyWritePending(IOUringSocketHelper* helper);
+
+  // Only called on the poller thread.
+  io_uring_sqe* GetSqe();
+
+ private:
+  void PollLoop();
+  void SubmitWakeupRead();
+  void OnWakeup(int32_t res);
+
+  io_uring ring_;
+  std::vector<IOUringSocketHelper*> helpers_;
+  std::vector<int> sockfds_;
+  int wakeup_fd_;
+  uint64_t wakeup_event_num_;
+  IOUringOp wakeup_op_;
+  std::atomic<bool> stop_requested_;
+  bool stopped_;
+  std::mutex write_pending_helpers_mtx_;
+  std::vector<IOUringSocketHelper*> write_pending_helpers_;
+  std::thread thread_;
+};
+
+}  // namespace oneflow
+
+#endif  // __linux__ && WITH_LIBURING
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_EPOLL_IO_URING_POLLER_H_
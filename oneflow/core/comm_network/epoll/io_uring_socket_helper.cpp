@@ -0,0 +1,185 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#if defined(__linux__) && defined(WITH_LIBURING)
+
+#include "oneflow/core/comm_network/epoll/io_uring_socket_helper.h"
+#include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
+#include "oneflow/core/lazy/actor/actor_message_bus.h"
+#include "oneflow/core/transport/transport.h"
+
+#include <netinet/tcp.h>
+
+namespace oneflow {
+
+namespace {
+
+constexpr size_t kRecvBufferBytes = 64 * 1024;
+constexpr size_t kMaxRecvBytes = 1 << 30;
+
+}  // namespace
+
+IOUringSocketHelper::~IOUringSocketHelper() {
+  VLOG(1) << "CommNet:Epoll sockfd " << sockfd_ << " wrote " << write_queue_.num_written_msgs()
+          << " messages with " << num_send_requests_ << " io_uring send requests and used "
+          << num_recv_requests_ << " io_uring receive requests";
+}
+
+IOUringSocketHelper::IOUringSocketHelper(int sockfd, IOUringPoller* poller) {
+  sockfd_ = sockfd;
+  poller_ = poller;
+  recv_op_.on_complete = [this](int32_t res) { OnRecvDone(res); };
+  recv_buffer_.resize(kRecvBufferBytes);
+  recv_buffer_index_ = -1;
+  is_recv_into_body_ = false;
+  cur_msg_received_ = 0;
+  is_in_msg_body_ = false;
+  body_ptr_ = nullptr;
+  body_remaining_ = 0;
+  send_op_.on_complete = [this](int32_t res) { OnSendDone(res); };
+  is_sending_ = false;
+  num_recv_requests_ = 0;
+  num_send_requests_ = 0;
+  poller->AddSocketHelper(this);
+}
+
+void IOUringSocketHelper::AsyncWrite(const SocketMsg& msg) {
+  if (write_queue_.Push(msg)) { poller_->NotifyWritePending(this); }
+}
+
+void IOUringSocketHelper::StartRecv() {
+  io_uring_sqe* sqe = poller_->GetSqe();
+  // Bodies which do not fit into the receive buffer are received in place to save the copy.
+  is_recv_into_body_ = is_in_msg_body_ && body_remaining_ >= recv_buffer_.size();
+  if (is_recv_into_body_) {
+    io_uring_prep_recv(sqe, sockfd_, body_ptr_, std::min(body_remaining_, kMaxRecvBytes), 0);
+  } else if (recv_buffer_index_ >= 0) {
+    io_uring_prep_read_fixed(sqe, sockfd_, recv_buffer_.data(), recv_buffer_.size(), 0,
+                             recv_buffer_index_);
+  } else {
+    io_uring_prep_recv(sqe, sockfd_, recv_buffer_.data(), recv_buffer_.size(), 0);
+  }
+  io_uring_sqe_set_data(sqe, &recv_op_);
+  num_recv_requests_ += 1;
+}
+
+void IOUringSocketHelper::StartWrite() {
+  if (is_sending_) { return; }
+  if (write_queue_.BatchDone() && !write_queue_.NextBatch()) { return; }
+  std::memset(&send_msghdr_, 0, sizeof(send_msghdr_));
+  send_msghdr_.msg_iov = const_cast<struct iovec*>(write_queue_.BatchIovecs());
+  send_msghdr_.msg_iovlen = write_queue_.BatchIovecNum();
+  io_uring_sqe* sqe = poller_->GetSqe();
+  io_uring_prep_sendmsg(sqe, sockfd_, &send_msghdr_, 0);
+  io_uring_sqe_set_data(sqe, &send_op_);
+  is_sending_ = true;
+  num_send_requests_ += 1;
+}
+
+void IOUringSocketHelper::OnRecvDone(int32_t res) {
+  if (res == -EINTR || res == -EAGAIN) {
+    StartRecv();
+    return;
+  }
+  CHECK_GE(res, 0) << "fd " << sockfd_ << " receive failed: " << strerror(-res);
+  if (res == 0) { LOG(FATAL) << "fd " << sockfd_ << " closed by peer"; }
+  const int val = 1;
+  PCHECK(setsockopt(sockfd_, IPPROTO_TCP, TCP_QUICKACK, (char*)&val, sizeof(int)) == 0);
+  if (is_recv_into_body_) {
+    body_ptr_ += res;
+    body_remaining_ -= res;
+    if (body_remaining_ == 0) { OnMsgBodyDone(); }
+  } else {
+    ConsumeRecvBuffer(recv_buffer_.data(), res);
+  }
+  StartRecv();
+}
+
+void IOUringSocketHelper::OnSendDone(int32_t res) {
+  if (res == -EINTR || res == -EAGAIN) {
+    res = 0;
+  } else {
+    CHECK_GE(res, 0) << "fd " << sockfd_ << " send failed: " << strerror(-res);
+  }
+  write_queue_.ConsumeBatch(res);
+  is_sending_ = false;
+  StartWrite();
+}
+
+void IOUringSocketHelper::ConsumeRecvBuffer(const char* data, size_t size) {
+  while (size > 0) {
+    if (is_in_msg_body_) {
+      const size_t n = std::min(size, body_remaining_);
+      std::memcpy(body_ptr_, data, n);
+      body_ptr_ += n;
+      body_remaining_ -= n;
+      data += n;
+      size -= n;
+      if (body_remaining_ == 0) { OnMsgBodyDone(); }
+    } else {
+      const size_t n = std::min(size, sizeof(cur_msg_) - cur_msg_received_);
+      std::memcpy(reinterpret_cast<char*>(&cur_msg_) + cur_msg_received_, data, n);
+      cur_msg_received_ += n;
+      data += n;
+      size -= n;
+      if (cur_msg_received_ == sizeof(cur_msg_)) {
+        cur_msg_received_ = 0;
+        OnMsgHeadDone();
+      }
+    }
+  }
+}
+
+void IOUringSocketHelper::OnMsgHeadDone() {
+  switch (cur_msg_.msg_type) {
+    case SocketMsgType::kRequestWrite: {
+      SocketMsg msg_to_send;
+      msg_to_send.msg_type = SocketMsgType::kRequestRead;
+      msg_to_send.request_read_msg.src_token = cur_msg_.request_write_msg.src_token;
+      msg_to_send.request_read_msg.dst_token = cur_msg_.request_write_msg.dst_token;
+      msg_to_send.request_read_msg.read_id = cur_msg_.request_write_msg.read_id;
+      Singleton<EpollCommNet>::Get()->SendSocketMsg(cur_msg_.request_write_msg.dst_machine_id,
+                                                    msg_to_send);
+      break;
+    }
+    case SocketMsgType::kRequestRead: {
+      auto mem_desc = static_cast<const SocketMemDesc*>(cur_msg_.request_read_msg.dst_token);
+      body_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr) + cur_msg_.request_read_msg.offset;
+      body_remaining_ = cur_msg_.request_read_msg.byte_size;
+      is_in_msg_body_ = true;
+      if (body_remaining_ == 0) { OnMsgBodyDone(); }
+      break;
+    }
+    case SocketMsgType::kActor: {
+      Singleton<ActorMsgBus>::Get()->SendMsgWithoutCommNet(cur_msg_.actor_msg);
+      break;
+    }
+    case SocketMsgType::kTransport: {
+      Singleton<Transport>::Get()->EnqueueTransportMsg(cur_msg_.transport_msg);
+      break;
+    }
+    default: UNIMPLEMENTED();
+  }
+}
+
+void IOUringSocketHelper::OnMsgBodyDone() {
+  is_in_msg_body_ = false;
+  Singleton<EpollCommNet>::Get()->ReadChunkDone(cur_msg_.request_read_msg.read_id,
+                                                cur_msg_.request_read_msg.num_chunks);
+}
+
+}  // namespace oneflow
+
+#endif  // __linux__ && WITH_LIBURING
@@ -0,0 +1,82 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_EPOLL_IO_URING_SOCKET_HELPER_H_
+#define ONEFLOW_CORE_COMM_NETWORK_EPOLL_IO_URING_SOCKET_HELPER_H_
+
+#include "oneflow/core/comm_network/epoll/io_uring_poller.h"
+#include "oneflow/core/comm_network/epoll/socket_helper.h"
+
+#if defined(__linux__) && defined(WITH_LIBURING)
+
+namespace oneflow {
+
+// Speaks the same protocol as SocketReadHelper and SocketWriteHelper, but with at most one
+// receive and one send request in flight instead of non-blocking read and write loops. Received
+// bytes land in a registered buffer holding many message headers at a time, only large bodies
+// are received directly into their destination.
+class IOUringSocketHelper final : public SocketHelper {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(IOUringSocketHelper);
+  IOUringSocketHelper() = delete;
+  ~IOUringSocketHelper() override;
+
+  IOUringSocketHelper(int sockfd, IOUringPoller* poller);
+
+  void AsyncWrite(const SocketMsg& msg) override;
+
+  int sockfd() const { return sockfd_; }
+  char* mut_recv_buffer() { return recv_buffer_.data(); }
+  size_t recv_buffer_size() const { return recv_buffer_.size(); }
+  void set_recv_buffer_index(int recv_buffer_index) { recv_buffer_index_ = recv_buffer_index; }
+
+  // Only called on the poller thread.
+  void StartRecv();
+  void StartWrite();
+
+ private:
+  void OnRecvDone(int32_t res);
+  void OnSendDone(int32_t res);
+  void ConsumeRecvBuffer(const char* data, size_t size);
+  void OnMsgHeadDone();
+  void OnMsgBodyDone();
+
+  int sockfd_;
+  IOUringPoller* poller_;
+
+  IOUringOp recv_op_;
+  std::vector<char> recv_buffer_;
+  int recv_buffer_index_;
+  bool is_recv_into_body_;
+  SocketMsg cur_msg_;
+  size_t cur_msg_received_;
+  bool is_in_msg_body_;
+  char* body_ptr_;
+  size_t body_remaining_;
+
+  IOUringOp send_op_;
+  SocketWriteQueue write_queue_;
+  struct msghdr send_msghdr_;
+  bool is_sending_;
+
+  int64_t num_recv_requests_;
+  int64_t num_send_requests_;
+};
+
+}  // namespace oneflow
+
+#endif  // __linux__ && WITH_LIBURING
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_EPOLL_IO_URING_SOCKET_HELPER_H_
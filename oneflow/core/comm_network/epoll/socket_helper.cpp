@@ -19,7 +19,7 @@ limitations under the License.
 
 namespace oneflow {
 
-SocketHelper::SocketHelper(int sockfd, IOEventPoller* poller) {
+EpollSocketHelper::EpollSocketHelper(int sockfd, IOEventPoller* poller) {
   read_helper_ = new SocketReadHelper(sockfd);
   write_helper_ = new SocketWriteHelper(sockfd, poller);
   poller->AddFd(
@@ -27,12 +27,12 @@ SocketHelper::SocketHelper(int sockfd, IOEventPoller* poller) {
       [this]() { write_helper_->NotifyMeSocketWriteable(); });
 }
 
-SocketHelper::~SocketHelper() {
+EpollSocketHelper::~EpollSocketHelper() {
   delete read_helper_;
   delete write_helper_;
 }
 
-void SocketHelper::AsyncWrite(const SocketMsg& msg) { write_helper_->AsyncWrite(msg); }
+void EpollSocketHelper::AsyncWrite(const SocketMsg& msg) { write_helper_->AsyncWrite(msg); }
 
 }  // namespace oneflow
 
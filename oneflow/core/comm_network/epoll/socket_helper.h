@@ -24,15 +24,25 @@ limitations under the License.
 
 namespace oneflow {
 
-class SocketHelper final {
+// One connection to a peer. The I/O engine behind it is chosen when the comm net starts.
+class SocketHelper {
  public:
   OF_DISALLOW_COPY_AND_MOVE(SocketHelper);
-  SocketHelper() = delete;
-  ~SocketHelper();
+  SocketHelper() = default;
+  virtual ~SocketHelper() = default;
 
-  SocketHelper(int sockfd, IOEventPoller* poller);
+  virtual void AsyncWrite(const SocketMsg& msg) = 0;
+};
+
+class EpollSocketHelper final : public SocketHelper {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(EpollSocketHelper);
+  EpollSocketHelper() = delete;
+  ~EpollSocketHelper() override;
+
+  EpollSocketHelper(int sockfd, IOEventPoller* poller);
 
-  void AsyncWrite(const SocketMsg& msg);
+  void AsyncWrite(const SocketMsg& msg) override;
 
  private:
   SocketReadHelper* read_helper_;
@@ -54,10 +54,15 @@ struct RequestWriteMsg {
   void* read_id;
 };
 
+// A read may be split into several chunks sent over different data connections, each chunk
+// carries the bytes [offset, offset + byte_size) of the memory behind src_token and dst_token.
 struct RequestReadMsg {
   void* src_token;
   void* dst_token;
   void* read_id;
+  int64_t offset;
+  int64_t byte_size;
+  int64_t num_chunks;
 };
 
 struct SocketMsg {
@@ -22,7 +22,29 @@ limitations under the License.
 
 namespace oneflow {
 
-SocketWriteHelper::~SocketWriteHelper() {
+namespace {
+
+// Messages are written in batches with one writev, a batch is closed once it holds this many
+// bytes, kMaxWriteBatchMsgs messages or kMaxWriteBatchIovecs buffers.
+constexpr size_t kDefaultWriteBatchBytes = 64 * 1024;
+constexpr size_t kMaxWriteBatchMsgs = 256;
+constexpr size_t kMaxWriteBatchIovecs = 512;
+
+}  // namespace
+
+SocketWriteQueue::SocketWriteQueue() {
+  cur_msg_queue_ = new std::queue<SocketMsg>;
+  pending_msg_queue_ = new std::queue<SocketMsg>;
+  batch_msgs_.reserve(kMaxWriteBatchMsgs);
+  batch_iovecs_.reserve(kMaxWriteBatchIovecs);
+  cur_iovec_idx_ = 0;
+  max_batch_bytes_ =
+      ParseIntegerFromEnv("ONEFLOW_COMM_NET_EPOLL_WRITE_BATCH_BYTES", kDefaultWriteBatchBytes);
+  CHECK_GT(max_batch_bytes_, 0);
+  num_written_msgs_ = 0;
+}
+
+SocketWriteQueue::~SocketWriteQueue() {
   delete cur_msg_queue_;
   cur_msg_queue_ = nullptr;
   {
@@ -32,25 +54,80 @@ SocketWriteHelper::~SocketWriteHelper() {
   }
 }
 
+bool SocketWriteQueue::Push(const SocketMsg& msg) {
+  std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
+  bool was_empty = pending_msg_queue_->empty();
+  pending_msg_queue_->push(msg);
+  return was_empty;
+}
+
+bool SocketWriteQueue::NextBatch() {
+  num_written_msgs_ += batch_msgs_.size();
+  batch_msgs_.clear();
+  batch_iovecs_.clear();
+  cur_iovec_idx_ = 0;
+  size_t batch_bytes = 0;
+  while (batch_bytes < max_batch_bytes_ && batch_msgs_.size() < kMaxWriteBatchMsgs
+         && batch_iovecs_.size() + 2 <= kMaxWriteBatchIovecs) {
+    if (cur_msg_queue_->empty()) {
+      {
+        std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
+        std::swap(cur_msg_queue_, pending_msg_queue_);
+      }
+      if (cur_msg_queue_->empty()) { break; }
+    }
+    batch_msgs_.emplace_back(cur_msg_queue_->front());
+    cur_msg_queue_->pop();
+    const SocketMsg& msg = batch_msgs_.back();
+    AppendToBatch(&msg, sizeof(msg));
+    batch_bytes += sizeof(msg);
+    // The body of a read request follows its header directly in the stream.
+    if (msg.msg_type == SocketMsgType::kRequestRead) {
+      auto src_mem_desc = static_cast<const SocketMemDesc*>(msg.request_read_msg.src_token);
+      const char* body_ptr = static_cast<const char*>(src_mem_desc->mem_ptr);
+      AppendToBatch(body_ptr + msg.request_read_msg.offset, msg.request_read_msg.byte_size);
+      batch_bytes += msg.request_read_msg.byte_size;
+    }
+  }
+  return !batch_iovecs_.empty();
+}
+
+void SocketWriteQueue::ConsumeBatch(size_t n) {
+  while (cur_iovec_idx_ < batch_iovecs_.size() && n >= batch_iovecs_.at(cur_iovec_idx_).iov_len) {
+    n -= batch_iovecs_.at(cur_iovec_idx_).iov_len;
+    cur_iovec_idx_ += 1;
+  }
+  if (n > 0) {
+    struct iovec* iov = &batch_iovecs_.at(cur_iovec_idx_);
+    iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+    iov->iov_len -= n;
+  }
+}
+
+void SocketWriteQueue::AppendToBatch(const void* ptr, size_t size) {
+  if (size == 0) { return; }
+  struct iovec iov;
+  iov.iov_base = const_cast<void*>(ptr);
+  iov.iov_len = size;
+  batch_iovecs_.emplace_back(iov);
+}
+
+SocketWriteHelper::~SocketWriteHelper() {
+  VLOG(1) << "CommNet:Epoll sockfd " << sockfd_ << " wrote " << write_queue_.num_written_msgs()
+          << " messages with " << num_write_syscalls_ << " write syscalls";
+}
+
 SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller) {
   sockfd_ = sockfd;
   queue_not_empty_fd_ = eventfd(0, 0);
   PCHECK(queue_not_empty_fd_ != -1);
   poller->AddFdWithOnlyReadHandler(queue_not_empty_fd_,
                                    std::bind(&SocketWriteHelper::ProcessQueueNotEmptyEvent, this));
-  cur_msg_queue_ = new std::queue<SocketMsg>;
-  pending_msg_queue_ = new std::queue<SocketMsg>;
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-  write_ptr_ = nullptr;
-  write_size_ = 0;
+  num_write_syscalls_ = 0;
 }
 
 void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
-  pending_msg_queue_mtx_.lock();
-  bool need_send_event = pending_msg_queue_->empty();
-  pending_msg_queue_->push(msg);
-  pending_msg_queue_mtx_.unlock();
-  if (need_send_event) { SendQueueNotEmptyEvent(); }
+  if (write_queue_.Push(msg)) { SendQueueNotEmptyEvent(); }
 }
 
 void SocketWriteHelper::NotifyMeSocketWriteable() { WriteUntilMsgQueueEmptyOrSocketNotWriteable(); }
@@ -67,41 +144,17 @@ void SocketWriteHelper::ProcessQueueNotEmptyEvent() {
 }
 
 void SocketWriteHelper::WriteUntilMsgQueueEmptyOrSocketNotWriteable() {
-  while ((this->*cur_write_handle_)()) {}
-}
-
-bool SocketWriteHelper::InitMsgWriteHandle() {
-  if (cur_msg_queue_->empty()) {
-    {
-      std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
-      std::swap(cur_msg_queue_, pending_msg_queue_);
-    }
-    if (cur_msg_queue_->empty()) { return false; }
+  while (true) {
+    if (write_queue_.BatchDone() && !write_queue_.NextBatch()) { return; }
+    if (!DoCurWrite()) { return; }
   }
-  cur_msg_ = cur_msg_queue_->front();
-  cur_msg_queue_->pop();
-  write_ptr_ = reinterpret_cast<const char*>(&cur_msg_);
-  write_size_ = sizeof(cur_msg_);
-  cur_write_handle_ = &SocketWriteHelper::MsgHeadWriteHandle;
-  return true;
-}
-
-bool SocketWriteHelper::MsgHeadWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgHeadDone);
-}
-
-bool SocketWriteHelper::MsgBodyWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgBodyDone);
 }
 
-bool SocketWriteHelper::DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)()) {
-  ssize_t n = write(sockfd_, write_ptr_, write_size_);
-  if (n == write_size_) {
-    (this->*set_cur_write_done)();
-    return true;
-  } else if (n >= 0) {
-    write_ptr_ += n;
-    write_size_ -= n;
+bool SocketWriteHelper::DoCurWrite() {
+  ssize_t n = writev(sockfd_, write_queue_.BatchIovecs(), write_queue_.BatchIovecNum());
+  num_write_syscalls_ += 1;
+  if (n >= 0) {
+    write_queue_.ConsumeBatch(n);
     return true;
   } else {
     CHECK_EQ(n, -1);
@@ -110,40 +163,6 @@ bool SocketWriteHelper::DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)
   }
 }
 
-void SocketWriteHelper::SetStatusWhenMsgHeadDone() {
-  switch (cur_msg_.msg_type) {
-#define MAKE_ENTRY(x, y) \
-  case SocketMsgType::k##x: return SetStatusWhen##x##MsgHeadDone();
-    OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
-    default: UNIMPLEMENTED();
-  }
-}
-
-void SocketWriteHelper::SetStatusWhenMsgBodyDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestWriteMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestReadMsgHeadDone() {
-  const void* src_token = cur_msg_.request_read_msg.src_token;
-  auto src_mem_desc = static_cast<const SocketMemDesc*>(src_token);
-  write_ptr_ = reinterpret_cast<const char*>(src_mem_desc->mem_ptr);
-  write_size_ = src_mem_desc->byte_size;
-  cur_write_handle_ = &SocketWriteHelper::MsgBodyWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenActorMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenTransportMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
 }  // namespace oneflow
 
 #endif  // __linux__
@@ -21,8 +21,49 @@ limitations under the License.
 
 #ifdef OF_PLATFORM_POSIX
 
+#include <sys/uio.h>
+
 namespace oneflow {
 
+// Messages waiting to be written to one socket. They are taken in batches laid out as the iovecs
+// of one vectored write, a batch is closed once it holds the configured number of bytes or too
+// many messages. Push may be called from any thread, the other methods only from the writer.
+class SocketWriteQueue final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(SocketWriteQueue);
+  SocketWriteQueue();
+  ~SocketWriteQueue();
+
+  // Returns true if the queue was empty before, in which case the writer has to be woken up.
+  bool Push(const SocketMsg& msg);
+
+  // Starts the next batch, returns false if there is nothing to write.
+  bool NextBatch();
+  bool BatchDone() const { return cur_iovec_idx_ == batch_iovecs_.size(); }
+  const struct iovec* BatchIovecs() const { return batch_iovecs_.data() + cur_iovec_idx_; }
+  size_t BatchIovecNum() const { return batch_iovecs_.size() - cur_iovec_idx_; }
+  // Marks the first n bytes of the remaining batch as written.
+  void ConsumeBatch(size_t n);
+
+  int64_t num_written_msgs() const { return num_written_msgs_; }
+
+ private:
+  void AppendToBatch(const void* ptr, size_t size);
+
+  std::queue<SocketMsg>* cur_msg_queue_;
+
+  std::mutex pending_msg_queue_mtx_;
+  std::queue<SocketMsg>* pending_msg_queue_;
+
+  // Headers are referenced by batch_iovecs_, so batch_msgs_ is reserved up front and never
+  // reallocates.
+  std::vector<SocketMsg> batch_msgs_;
+  std::vector<struct iovec> batch_iovecs_;
+  size_t cur_iovec_idx_;
+  size_t max_batch_bytes_;
+  int64_t num_written_msgs_;
+};
+
 class SocketWriteHelper final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(SocketWriteHelper);
@@ -40,30 +81,12 @@ class SocketWriteHelper final {
   void ProcessQueueNotEmptyEvent();
 
   void WriteUntilMsgQueueEmptyOrSocketNotWriteable();
-  bool InitMsgWriteHandle();
-  bool MsgHeadWriteHandle();
-  bool MsgBodyWriteHandle();
-
-  bool DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)());
-  void SetStatusWhenMsgHeadDone();
-  void SetStatusWhenMsgBodyDone();
-
-#define MAKE_ENTRY(x, y) void SetStatusWhen##x##MsgHeadDone();
-  OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
+  bool DoCurWrite();
 
   int sockfd_;
   int queue_not_empty_fd_;
-
-  std::queue<SocketMsg>* cur_msg_queue_;
-
-  std::mutex pending_msg_queue_mtx_;
-  std::queue<SocketMsg>* pending_msg_queue_;
-
-  SocketMsg cur_msg_;
-  bool (SocketWriteHelper::*cur_write_handle_)();
-  const char* write_ptr_;
-  size_t write_size_;
+  SocketWriteQueue write_queue_;
+  int64_t num_write_syscalls_;
 };
 
 }  // namespace oneflow
@@ -34,6 +34,8 @@ class Buffer final {
   BufferStatus Pull(T* item);
   BufferStatus TryReceive(T* item);
   void Close();
+  // Items already queued beyond a lowered max_len stay, only further Push calls wait.
+  void SetMaxLen(size_t max_len);
 
  private:
   std::queue<T> queue_;
@@ -82,6 +84,13 @@ void Buffer<T>::Close() {
   cond_.notify_all();
 }
 
+template<typename T>
+void Buffer<T>::SetMaxLen(size_t max_len) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  max_len_ = max_len;
+  cond_.notify_all();
+}
+
 }  // namespace oneflow
 
 #endif  // ONEFLOW_CORE_COMMON_BUFFER_H_
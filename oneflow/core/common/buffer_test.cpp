@@ -0,0 +1,70 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "gtest/gtest.h"
+#include "oneflow/core/common/buffer.h"
+
+namespace oneflow {
+
+TEST(Buffer, raised_max_len_wakes_blocked_push) {
+  Buffer<int> buffer(1);
+  ASSERT_EQ(buffer.Push(0), kBufferStatusSuccess);
+  std::atomic<bool> is_pushed(false);
+  std::thread pusher([&]() {
+    ASSERT_EQ(buffer.Push(1), kBufferStatusSuccess);
+    is_pushed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_FALSE(is_pushed);
+  buffer.SetMaxLen(2);
+  pusher.join();
+  ASSERT_TRUE(is_pushed);
+  int item = -1;
+  ASSERT_EQ(buffer.TryReceive(&item), kBufferStatusSuccess);
+  ASSERT_EQ(item, 0);
+  ASSERT_EQ(buffer.TryReceive(&item), kBufferStatusSuccess);
+  ASSERT_EQ(item, 1);
+  ASSERT_EQ(buffer.TryReceive(&item), kBufferStatusEmpty);
+}
+
+TEST(Buffer, lowered_max_len_keeps_queued_items) {
+  Buffer<int> buffer(4);
+  for (int i = 0; i < 4; ++i) { ASSERT_EQ(buffer.Push(i), kBufferStatusSuccess); }
+  buffer.SetMaxLen(1);
+  std::atomic<bool> is_pushed(false);
+  std::thread pusher([&]() {
+    ASSERT_EQ(buffer.Push(4), kBufferStatusSuccess);
+    is_pushed = true;
+  });
+  // Push waits until fewer items than the new max_len are queued.
+  int item = -1;
+  for (int i = 0; i < 4; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_FALSE(is_pushed);
+    ASSERT_EQ(buffer.Pull(&item), kBufferStatusSuccess);
+    ASSERT_EQ(item, i);
+  }
+  pusher.join();
+  ASSERT_TRUE(is_pushed);
+  ASSERT_EQ(buffer.Pull(&item), kBufferStatusSuccess);
+  ASSERT_EQ(item, 4);
+  buffer.Close();
+  ASSERT_EQ(buffer.Push(5), kBufferStatusErrorClosed);
+}
+
+}  // namespace oneflow
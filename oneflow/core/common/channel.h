@@ -31,6 +31,9 @@ class Channel final {
 
   template<typename U>
   ChannelStatus Send(U&& item);
+  // Enqueues all items under one lock and wakes up a receiver at most once.
+  template<typename InputIt>
+  ChannelStatus SendMany(InputIt first, InputIt last);
   ChannelStatus Receive(T* item);
   ChannelStatus ReceiveMany(std::queue<T>* items);
   void Close();
@@ -56,6 +59,21 @@ ChannelStatus Channel<T>::Send(U&& item) {
   return kChannelStatusSuccess;
 }
 
+template<typename T>
+template<typename InputIt>
+ChannelStatus Channel<T>::SendMany(InputIt first, InputIt last) {
+  if (first == last) { return kChannelStatusSuccess; }
+  bool notify;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (is_closed_) { return kChannelStatusErrorClosed; }
+    notify = queue_.empty();
+    for (; first != last; ++first) { queue_.push(*first); }
+  }
+  if (notify) { cond_.notify_one(); }
+  return kChannelStatusSuccess;
+}
+
 template<typename T>
 ChannelStatus Channel<T>::Receive(T* item) {
   std::unique_lock<std::mutex> lock(mutex_);
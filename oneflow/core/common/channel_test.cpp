@@ -60,4 +60,21 @@ TEST(Channel, 30sender40receiver) {
   }
 }
 
+TEST(Channel, send_many) {
+  Channel<int> channel;
+  std::vector<int> items(100);
+  std::iota(items.begin(), items.end(), 0);
+  ASSERT_EQ(channel.SendMany(items.begin(), items.begin()), kChannelStatusSuccess);
+  ASSERT_EQ(channel.SendMany(items.begin(), items.end()), kChannelStatusSuccess);
+  std::queue<int> received;
+  ASSERT_EQ(channel.ReceiveMany(&received), kChannelStatusSuccess);
+  ASSERT_EQ(received.size(), items.size());
+  for (int i = 0; i < items.size(); ++i) {
+    ASSERT_EQ(received.front(), i);
+    received.pop();
+  }
+  channel.Close();
+  ASSERT_EQ(channel.SendMany(items.begin(), items.end()), kChannelStatusErrorClosed);
+}
+
 }  // namespace oneflow
@@ -0,0 +1,321 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_LOCK_FREE_CHANNEL_H_
+#define ONEFLOW_CORE_COMMON_LOCK_FREE_CHANNEL_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/channel.h"
+
+namespace oneflow {
+
+namespace detail {
+
+constexpr size_t kChannelCacheLineSize = 64;
+constexpr int32_t kChannelMinSpins = 16;
+constexpr int32_t kChannelMaxSpins = 4096;
+
+// Spins on the predicate for a while before blocking on a condition variable. The spin budget
+// adapts: it grows when spinning succeeded and shrinks when the waiter had to block anyway.
+// Notify only takes the mutex if somebody is blocked, so the fast path has no lock at all.
+class ChannelWaiter final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ChannelWaiter);
+  ChannelWaiter() : num_waiters_(0), spin_limit_(kChannelMinSpins) {}
+  ~ChannelWaiter() = default;
+
+  template<typename Predicate>
+  void Wait(const Predicate& ready) {
+    const int32_t spin_limit = spin_limit_.load(std::memory_order_relaxed);
+    for (int32_t i = 0; i < spin_limit; ++i) {
+      if (ready()) {
+        spin_limit_.store(std::min(spin_limit * 2, kChannelMaxSpins), std::memory_order_relaxed);
+        return;
+      }
+      std::this_thread::yield();
+    }
+    spin_limit_.store(std::max(spin_limit / 2, kChannelMinSpins), std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(mutex_);
+    num_waiters_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!ready()) { cond_.wait(lock); }
+    num_waiters_.fetch_sub(1);
+  }
+
+  // Must be called after the state change which may make a predicate true.
+  void Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_waiters_.load(std::memory_order_relaxed) == 0) { return; }
+    std::lock_guard<std::mutex> lock(mutex_);
+    cond_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::atomic<int32_t> num_waiters_;
+  std::atomic<int32_t> spin_limit_;
+};
+
+inline size_t RoundUpChannelCapacity(size_t capacity) {
+  CHECK_GT(capacity, 0);
+  size_t rounded = 1;
+  while (rounded < capacity) { rounded <<= 1; }
+  return rounded;
+}
+
+// Bounded ring with one producer and one consumer. Each side only writes its own index, so
+// the two indices are padded apart to keep them on separate cache lines.
+template<typename T>
+class SpscRing final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(SpscRing);
+  explicit SpscRing(size_t capacity)
+      : mask_(RoundUpChannelCapacity(capacity) - 1), slots_(new Slot[mask_ + 1]) {
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+  }
+  ~SpscRing() {
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    for (size_t i = head_.load(std::memory_order_relaxed); i != tail; ++i) {
+      slots_[i & mask_].Ptr()->~T();
+    }
+  }
+
+  template<typename U>
+  bool TryPush(U&& item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) { return false; }
+    new (slots_[tail & mask_].Ptr()) T(std::forward<U>(item));
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T* item) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) { return false; }
+    T* ptr = slots_[head & mask_].Ptr();
+    *item = std::move(*ptr);
+    ptr->~T();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+  bool Full() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire) > mask_;
+  }
+
+ private:
+  struct Slot {
+    T* Ptr() { return reinterpret_cast<T*>(&storage); }
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<size_t> head_;
+  char padding_[kChannelCacheLineSize];
+  std::atomic<size_t> tail_;
+};
+
+// Bounded ring with many producers and one consumer, after Dmitry Vyukov's bounded MPMC queue.
+// Every slot carries a sequence number telling whether it is free for the producer claiming
+// position pos (sequence == pos) or holds the item for the consumer (sequence == pos + 1).
+template<typename T>
+class MpscRing final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MpscRing);
+  explicit MpscRing(size_t capacity)
+      : mask_(RoundUpChannelCapacity(capacity) - 1), slots_(new Slot[mask_ + 1]), head_(0) {
+    for (size_t i = 0; i <= mask_; ++i) { slots_[i].sequence.store(i, std::memory_order_relaxed); }
+    tail_.store(0, std::memory_order_relaxed);
+  }
+  ~MpscRing() {
+    for (; !Empty(); ++head_) { slots_[head_ & mask_].Ptr()->~T(); }
+  }
+
+  template<typename U>
+  bool TryPush(U&& item) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true) {
+      slot = &slots_[pos & mask_];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    new (slot->Ptr()) T(std::forward<U>(item));
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only called by the consumer.
+  bool TryPop(T* item) {
+    Slot* slot = &slots_[head_ & mask_];
+    if (slot->sequence.load(std::memory_order_acquire) != head_ + 1) { return false; }
+    *item = std::move(*slot->Ptr());
+    slot->Ptr()->~T();
+    slot->sequence.store(head_ + mask_ + 1, std::memory_order_release);
+    head_ += 1;
+    return true;
+  }
+
+  // Only called by the consumer.
+  bool Empty() const {
+    return slots_[head_ & mask_].sequence.load(std::memory_order_acquire) != head_ + 1;
+  }
+
+  bool Full() const {
+    const size_t pos = tail_.load(std::memory_order_acquire);
+    return slots_[pos & mask_].sequence.load(std::memory_order_acquire) != pos;
+  }
+
+ private:
+  struct Slot {
+    T* Ptr() { return reinterpret_cast<T*>(&storage); }
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  size_t head_;
+  char padding_[kChannelCacheLineSize];
+  std::atomic<size_t> tail_;
+};
+
+// Bounded channel with the Send/Receive/ReceiveMany/Close semantics of Channel<T> on top of a
+// lock-free ring. Send waits while the ring is full. Items sent before Close are still delivered,
+// and a Send racing with Close either fails or is delivered, never lost: the receiver only reports
+// kChannelStatusErrorClosed once no Send is in flight and the ring is drained.
+template<typename T, typename Ring>
+class LockFreeChannel final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(LockFreeChannel);
+  explicit LockFreeChannel(size_t capacity)
+      : ring_(capacity), is_closed_(false), num_sending_(0) {}
+  ~LockFreeChannel() = default;
+
+  template<typename U>
+  ChannelStatus Send(U&& item) {
+    num_sending_.fetch_add(1);
+    ChannelStatus status = kChannelStatusSuccess;
+    while (true) {
+      if (is_closed_.load()) {
+        status = kChannelStatusErrorClosed;
+        break;
+      }
+      if (ring_.TryPush(std::forward<U>(item))) { break; }
+      not_full_.Wait([this]() { return !ring_.Full() || is_closed_.load(); });
+    }
+    num_sending_.fetch_sub(1);
+    not_empty_.Notify();
+    return status;
+  }
+
+  ChannelStatus Receive(T* item) {
+    while (!ring_.TryPop(item)) {
+      if (IsDrained()) { return kChannelStatusErrorClosed; }
+      not_empty_.Wait([this]() { return !ring_.Empty() || IsDrained(); });
+    }
+    not_full_.Notify();
+    return kChannelStatusSuccess;
+  }
+
+  ChannelStatus ReceiveMany(std::queue<T>* items) {
+    T item;
+    ChannelStatus status = Receive(&item);
+    if (status != kChannelStatusSuccess) { return status; }
+    items->push(std::move(item));
+    while (ring_.TryPop(&item)) { items->push(std::move(item)); }
+    not_full_.Notify();
+    return kChannelStatusSuccess;
+  }
+
+  void Close() {
+    is_closed_.store(true);
+    not_empty_.Notify();
+    not_full_.Notify();
+  }
+
+ private:
+  bool IsDrained() const {
+    return is_closed_.load() && num_sending_.load() == 0 && ring_.Empty();
+  }
+
+  Ring ring_;
+  std::atomic<bool> is_closed_;
+  std::atomic<int64_t> num_sending_;
+  ChannelWaiter not_empty_;
+  ChannelWaiter not_full_;
+};
+
+}  // namespace detail
+
+constexpr size_t kDefaultLockFreeChannelCapacity = 1024;
+
+// Only one thread may call Send and only one thread may call Receive/ReceiveMany.
+template<typename T>
+class SpscChannel final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(SpscChannel);
+  explicit SpscChannel(size_t capacity = kDefaultLockFreeChannelCapacity) : channel_(capacity) {}
+  ~SpscChannel() = default;
+
+  template<typename U>
+  ChannelStatus Send(U&& item) {
+    return channel_.Send(std::forward<U>(item));
+  }
+  ChannelStatus Receive(T* item) { return channel_.Receive(item); }
+  ChannelStatus ReceiveMany(std::queue<T>* items) { return channel_.ReceiveMany(items); }
+  void Close() { channel_.Close(); }
+
+ private:
+  detail::LockFreeChannel<T, detail::SpscRing<T>> channel_;
+};
+
+// Any thread may call Send, only one thread may call Receive/ReceiveMany.
+template<typename T>
+class MpscChannel final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MpscChannel);
+  explicit MpscChannel(size_t capacity = kDefaultLockFreeChannelCapacity) : channel_(capacity) {}
+  ~MpscChannel() = default;
+
+  template<typename U>
+  ChannelStatus Send(U&& item) {
+    return channel_.Send(std::forward<U>(item));
+  }
+  ChannelStatus Receive(T* item) { return channel_.Receive(item); }
+  ChannelStatus ReceiveMany(std::queue<T>* items) { return channel_.ReceiveMany(items); }
+  void Close() { channel_.Close(); }
+
+ private:
+  detail::LockFreeChannel<T, detail::MpscRing<T>> channel_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_LOCK_FREE_CHANNEL_H_
@@ -0,0 +1,155 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/common/lock_free_channel.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Every sender sends num_messages timestamps, the receiver records the latency of each of them.
+template<typename ChannelT>
+void RunBenchmark(const std::string& name, ChannelT* channel, int sender_num,
+                  int64_t num_messages) {
+  std::vector<int64_t> latencies;
+  latencies.reserve(sender_num * num_messages);
+  const int64_t start = NowNanos();
+  std::thread receiver([&]() {
+    int64_t sent_time = 0;
+    while (channel->Receive(&sent_time) == kChannelStatusSuccess) {
+      latencies.push_back(NowNanos() - sent_time);
+    }
+  });
+  std::vector<std::thread> senders;
+  for (int i = 0; i < sender_num; ++i) {
+    senders.emplace_back([&]() {
+      for (int64_t j = 0; j < num_messages; ++j) {
+        CHECK_EQ(channel->Send(NowNanos()), kChannelStatusSuccess);
+      }
+    });
+  }
+  for (std::thread& sender : senders) { sender.join(); }
+  channel->Close();
+  receiver.join();
+  const double seconds = (NowNanos() - start) * 1e-9;
+  ASSERT_EQ(latencies.size(), sender_num * num_messages);
+  std::sort(latencies.begin(), latencies.end());
+  LOG(INFO) << name << ", " << sender_num << " sender(s): "
+            << latencies.size() / seconds / 1e6 << " M msgs/s, p50 "
+            << latencies.at(latencies.size() / 2) / 1e3 << " us, p99 "
+            << latencies.at(latencies.size() * 99 / 100) / 1e3 << " us";
+}
+
+}  // namespace
+
+TEST(SpscChannel, in_order) {
+  SpscChannel<std::unique_ptr<int>> channel(16);
+  const int num_messages = 10000;
+  std::thread sender([&]() {
+    for (int i = 0; i < num_messages; ++i) {
+      ASSERT_EQ(channel.Send(std::unique_ptr<int>(new int(i))), kChannelStatusSuccess);
+    }
+    channel.Close();
+  });
+  int expected = 0;
+  std::queue<std::unique_ptr<int>> items;
+  while (channel.ReceiveMany(&items) == kChannelStatusSuccess) {
+    while (!items.empty()) {
+      ASSERT_EQ(*items.front(), expected);
+      items.pop();
+      expected += 1;
+    }
+  }
+  sender.join();
+  ASSERT_EQ(expected, num_messages);
+  ASSERT_EQ(channel.Send(std::unique_ptr<int>(new int(0))), kChannelStatusErrorClosed);
+}
+
+TEST(MpscChannel, 30sender) {
+  MpscChannel<int> channel(64);
+  const int sender_num = 30;
+  const int range_num = 2000;
+  std::vector<int> visit(range_num, 0);
+  std::thread receiver([&]() {
+    int num = -1;
+    while (channel.Receive(&num) == kChannelStatusSuccess) { ++visit.at(num); }
+  });
+  std::vector<std::thread> senders;
+  for (int i = 0; i < sender_num; ++i) {
+    senders.emplace_back([&]() {
+      for (int j = 0; j < range_num; ++j) { ASSERT_EQ(channel.Send(j), kChannelStatusSuccess); }
+    });
+  }
+  for (std::thread& sender : senders) { sender.join(); }
+  channel.Close();
+  receiver.join();
+  for (int i = 0; i < range_num; ++i) { ASSERT_EQ(visit.at(i), sender_num); }
+}
+
+TEST(MpscChannel, close_while_sending) {
+  MpscChannel<int> channel(4);
+  const int sender_num = 8;
+  std::atomic<int> num_sent(0);
+  std::vector<std::thread> senders;
+  for (int i = 0; i < sender_num; ++i) {
+    senders.emplace_back([&]() {
+      while (channel.Send(1) == kChannelStatusSuccess) { num_sent += 1; }
+    });
+  }
+  int num_received = 0;
+  int item = 0;
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(channel.Receive(&item), kChannelStatusSuccess);
+    num_received += item;
+  }
+  channel.Close();
+  while (channel.Receive(&item) == kChannelStatusSuccess) { num_received += item; }
+  for (std::thread& sender : senders) { sender.join(); }
+  ASSERT_EQ(num_received, num_sent.load());
+}
+
+// Throughput and latency of the channels, run with --gtest_also_run_disabled_tests.
+TEST(LockFreeChannel, DISABLED_benchmark) {
+  const int64_t num_messages = 200000;
+  {
+    Channel<int64_t> channel;
+    RunBenchmark("Channel", &channel, 1, num_messages);
+  }
+  {
+    SpscChannel<int64_t> channel;
+    RunBenchmark("SpscChannel", &channel, 1, num_messages);
+  }
+  {
+    Channel<int64_t> channel;
+    RunBenchmark("Channel", &channel, 4, num_messages / 4);
+  }
+  {
+    MpscChannel<int64_t> channel;
+    RunBenchmark("MpscChannel", &channel, 4, num_messages / 4);
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
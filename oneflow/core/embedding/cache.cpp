@@ -22,22 +22,33 @@ namespace oneflow {
 namespace embedding {
 
 std::unique_ptr<Cache> NewCache(const CacheOptions& options) {
-#ifdef WITH_CUDA
   CHECK_GT(options.key_size, 0);
   CHECK_GT(options.value_size, 0);
   CHECK_GT(options.capacity, 0);
-  if (options.policy == CacheOptions::Policy::kLRU) {
-    return NewLruCache(options);
-  } else if (options.policy == CacheOptions::Policy::kFull) {
-    return NewFullCache(options);
-  } else {
-    UNIMPLEMENTED();
-    return nullptr;
+  if (options.device_type == DeviceType::kCPU) {
+    if (options.policy == CacheOptions::Policy::kLRU) {
+      return NewCpuLruCache(options);
+    } else if (options.policy == CacheOptions::Policy::kFull) {
+      return NewCpuFullCache(options);
+    } else {
+      UNIMPLEMENTED();
+      return nullptr;
+    }
+  }
+#ifdef WITH_CUDA
+  if (options.device_type == DeviceType::kCUDA) {
+    if (options.policy == CacheOptions::Policy::kLRU) {
+      return NewLruCache(options);
+    } else if (options.policy == CacheOptions::Policy::kFull) {
+      return NewFullCache(options);
+    } else {
+      UNIMPLEMENTED();
+      return nullptr;
+    }
   }
-#else
+#endif  // WITH_CUDA
   UNIMPLEMENTED();
   return nullptr;
-#endif  // WITH_CUDA
 }
 
 }  // namespace embedding
@@ -20,6 +20,7 @@ limitations under the License.
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/ep/include/stream.h"
 #include "oneflow/core/common/data_type.h"
+#include "oneflow/core/common/device_type.h"
 
 namespace oneflow {
 
@@ -35,6 +36,13 @@ struct CacheOptions {
     kHost,
   };
   Policy policy = Policy::kLRU;
+  // The key value stores built by EmbeddingManager only support CUDA caches so far, kCPU caches are
+  // only available through NewCache.
+#ifdef WITH_CUDA
+  DeviceType device_type = DeviceType::kCUDA;
+#else
+  DeviceType device_type = DeviceType::kCPU;
+#endif  // WITH_CUDA
   MemoryKind value_memory_kind = MemoryKind::kDevice;
   uint64_t capacity{};
   uint32_t key_size{};
@@ -244,6 +244,201 @@ TEST(Cache, LruCache) {
 
 #endif  // WITH_CUDA
 
+void TestCpuCache(Cache* cache, uint32_t line_size) {
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+
+  std::unordered_set<int64_t> in_cache;
+  const size_t n_iter = 32;
+  const uint32_t n_keys = 1024;
+  std::vector<int64_t> keys(n_keys);
+  uint32_t n_missing = 0;
+  std::vector<int64_t> missing_keys(n_keys);
+  std::vector<uint32_t> missing_indices(n_keys);
+  std::vector<float> values(n_keys * line_size);
+  uint32_t n_evicted = 0;
+  std::vector<int64_t> evicted_keys(n_keys);
+  std::vector<float> evicted_values(n_keys * line_size);
+  std::vector<uint8_t> mask(n_keys);
+  std::vector<int64_t> random_keys(n_keys * 32);
+  std::iota(random_keys.begin(), random_keys.end(), 1);
+  std::random_device rd;
+  std::mt19937 g(rd());
+  for (size_t iter = 0; iter < n_iter; ++iter) {
+    std::shuffle(random_keys.begin(), random_keys.end(), g);
+    std::copy(random_keys.begin(), random_keys.begin() + n_keys, keys.begin());
+    std::unordered_set<int64_t> expect_missing_keys_set;
+    std::unordered_set<uint32_t> expect_missing_indices_set;
+    std::unordered_set<int64_t> keys_set;
+    for (size_t i = 0; i < n_keys; ++i) {
+      keys_set.emplace(keys[i]);
+      if (in_cache.count(keys[i]) == 0) {
+        expect_missing_keys_set.emplace(keys[i]);
+        expect_missing_indices_set.emplace(i);
+      }
+    }
+    // test
+    cache->Test(stream, n_keys, keys.data(), &n_missing, missing_keys.data(),
+                missing_indices.data());
+    ASSERT_EQ(n_missing, expect_missing_keys_set.size());
+    std::unordered_set<int64_t> test_missing_keys_set;
+    std::unordered_set<uint32_t> test_missing_indices_set;
+    for (size_t i = 0; i < n_missing; ++i) {
+      test_missing_keys_set.emplace(missing_keys[i]);
+      test_missing_indices_set.emplace(missing_indices[i]);
+      ASSERT_EQ(keys[missing_indices[i]], missing_keys[i]);
+    }
+    ASSERT_EQ(test_missing_keys_set, expect_missing_keys_set);
+    ASSERT_EQ(test_missing_indices_set, expect_missing_indices_set);
+
+    // get
+    if (cache->Policy() == CacheOptions::Policy::kFull) {
+      cache->Get(stream, n_keys, keys.data(), values.data(), mask.data());
+      for (size_t i = 0; i < n_keys; ++i) {
+        ASSERT_EQ(mask[i] == 0, expect_missing_keys_set.count(keys[i]) > 0);
+      }
+    }
+    cache->Get(stream, n_keys, keys.data(), values.data(), &n_missing, missing_keys.data(),
+               missing_indices.data());
+    ASSERT_EQ(n_missing, expect_missing_keys_set.size());
+    std::unordered_set<int64_t> get_missing_keys_set;
+    for (size_t i = 0; i < n_missing; ++i) {
+      get_missing_keys_set.emplace(missing_keys[i]);
+      ASSERT_EQ(keys[missing_indices[i]], missing_keys[i]);
+    }
+    ASSERT_EQ(get_missing_keys_set, expect_missing_keys_set);
+    for (size_t i = 0; i < n_keys; ++i) {
+      if (get_missing_keys_set.count(keys[i]) == 0) {
+        for (size_t j = 0; j < line_size; ++j) {
+          ASSERT_EQ(values[i * line_size + j], static_cast<float>(keys[i] * line_size + j))
+              << "iter " << iter << " i " << i << " j " << j;
+        }
+      }
+    }
+
+    // put
+    for (size_t i = 0; i < n_keys; ++i) {
+      for (size_t j = 0; j < line_size; ++j) {
+        values[i * line_size + j] = static_cast<float>(keys[i] * line_size + j);
+      }
+    }
+    cache->Put(stream, n_keys, keys.data(), values.data(), &n_evicted, evicted_keys.data(),
+               evicted_values.data());
+    for (size_t i = 0; i < n_evicted; ++i) {
+      ASSERT_TRUE(in_cache.count(evicted_keys[i]) > 0 || keys_set.count(evicted_keys[i]) > 0);
+      for (size_t j = 0; j < line_size; ++j) {
+        ASSERT_EQ(evicted_values[i * line_size + j],
+                  static_cast<float>(evicted_keys[i] * line_size + j));
+      }
+    }
+    for (size_t i = 0; i < n_keys; ++i) { in_cache.emplace(keys[i]); }
+    for (size_t i = 0; i < n_evicted; ++i) { in_cache.erase(evicted_keys[i]); }
+  }
+  const uint64_t dump_capacity = cache->DumpCapacity();
+  for (size_t start_key_index = 0; start_key_index < dump_capacity; start_key_index += n_keys) {
+    cache->Dump(stream, start_key_index, std::min(start_key_index + n_keys, dump_capacity),
+                &n_evicted, evicted_keys.data(), evicted_values.data());
+    for (size_t i = 0; i < n_evicted; ++i) {
+      ASSERT_TRUE(in_cache.count(evicted_keys[i]) > 0);
+      in_cache.erase(evicted_keys[i]);
+      for (size_t j = 0; j < line_size; ++j) {
+        ASSERT_EQ(evicted_values[i * line_size + j],
+                  static_cast<float>(evicted_keys[i] * line_size + j));
+      }
+    }
+  }
+  CHECK_EQ(in_cache.size(), 0);
+  device->DestroyStream(stream);
+}
+
+TEST(Cache, CpuFullCache) {
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kFull;
+  options.device_type = DeviceType::kCPU;
+  const uint32_t line_size = 128;
+  options.value_size = 512;
+  options.capacity = 65536;
+  options.key_size = 8;
+  options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  std::unique_ptr<Cache> cache(NewCache(options));
+  cache->ReserveQueryLength(65536);
+  TestCpuCache(cache.get(), line_size);
+}
+
+TEST(Cache, CpuLruCache) {
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kLRU;
+  options.device_type = DeviceType::kCPU;
+  const uint32_t line_size = 128;
+  options.value_size = 512;
+  options.capacity = 8192;
+  options.key_size = 8;
+  options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  std::unique_ptr<Cache> cache(NewCache(options));
+  cache->ReserveQueryLength(65536);
+  TestCpuCache(cache.get(), line_size);
+}
+
+TEST(Cache, CpuLruCacheSetOverflow) {
+  std::unique_ptr<ep::DeviceManagerRegistry> device_manager_registry(
+      new ep::DeviceManagerRegistry());
+  auto device = device_manager_registry->GetDevice(DeviceType::kCPU, 0);
+  ep::Stream* stream = device->CreateStream();
+  CacheOptions options{};
+  options.policy = CacheOptions::Policy::kLRU;
+  options.device_type = DeviceType::kCPU;
+  options.value_size = sizeof(float);
+  // A single set, so every key of a batch falls into the same set.
+  options.capacity = 16;
+  options.key_size = 8;
+  options.value_memory_kind = CacheOptions::MemoryKind::kHost;
+  std::unique_ptr<Cache> cache(NewCache(options));
+  ASSERT_EQ(cache->Capacity(), 16);
+  const uint32_t n_keys = 40;
+  cache->ReserveQueryLength(n_keys);
+  std::vector<int64_t> keys(n_keys);
+  std::vector<float> values(n_keys);
+  uint32_t n_evicted = 0;
+  std::vector<int64_t> evicted_keys(n_keys);
+  std::vector<float> evicted_values(n_keys);
+  // The value put for a key in a batch encodes the key and the batch.
+  std::unordered_map<int64_t, float> latest_values;
+  std::unordered_map<int64_t, float> store;
+  for (int64_t version = 0; version < 3; ++version) {
+    // The batches overlap, so some keys are updated while others are inserted.
+    for (uint32_t i = 0; i < n_keys; ++i) {
+      keys[i] = version * 12 + i;
+      values[i] = static_cast<float>(keys[i] * 100 + version);
+      latest_values[keys[i]] = values[i];
+    }
+    cache->Put(stream, n_keys, keys.data(), values.data(), &n_evicted, evicted_keys.data(),
+               evicted_values.data());
+    ASSERT_LE(n_evicted, n_keys);
+    for (uint32_t i = 0; i < n_evicted; ++i) { store[evicted_keys[i]] = evicted_values[i]; }
+    uint32_t n_dumped = 0;
+    std::vector<int64_t> cached_keys(cache->DumpCapacity());
+    std::vector<float> cached_values(cache->DumpCapacity());
+    cache->Dump(stream, 0, cache->DumpCapacity(), &n_dumped, cached_keys.data(),
+                cached_values.data());
+    ASSERT_EQ(n_dumped, 16);
+    // Every key put so far is either cached or was evicted with its latest value.
+    std::unordered_map<int64_t, float> cached;
+    for (uint32_t i = 0; i < n_dumped; ++i) { cached[cached_keys[i]] = cached_values[i]; }
+    for (const auto& pair : latest_values) {
+      auto it = cached.find(pair.first);
+      if (it != cached.end()) {
+        ASSERT_EQ(it->second, pair.second) << "key " << pair.first;
+      } else {
+        ASSERT_TRUE(store.count(pair.first) > 0) << "key " << pair.first;
+        ASSERT_EQ(store.at(pair.first), pair.second) << "key " << pair.first;
+      }
+    }
+  }
+  device->DestroyStream(stream);
+}
+
 }  // namespace
 
 }  // namespace embedding
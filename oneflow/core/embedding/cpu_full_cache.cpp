@@ -0,0 +1,280 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/full_cache.h"
+#include "oneflow/core/embedding/hash_functions.cuh"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+constexpr int64_t kParallelGrainKeys = 256;
+
+// Host counterpart of the ordinal encoder in full_cache.cu: an open addressing table with linear
+// probing which assigns every key a dense row id. The lowest bit of the key is moved into the
+// entry index so that 0 can be used as the empty marker of the key slot.
+template<typename Key, typename Index>
+class CpuOrdinalEncoder {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CpuOrdinalEncoder);
+  explicit CpuOrdinalEncoder(uint64_t capacity, float load_factor)
+      : capacity_(capacity), table_capacity_(capacity / load_factor) {
+    table_keys_.reset(new std::atomic<Key>[table_capacity_]);
+    table_indices_.reset(new std::atomic<Index>[table_capacity_]);
+    Clear();
+  }
+  ~CpuOrdinalEncoder() = default;
+
+  // Returns the row id plus one of key, or 0 if key is absent and insert is false.
+  template<bool insert>
+  Index Encode(Key key) {
+    const Key key_hi = (key | 0x1);
+    const Key key_lo = (key & 0x1);
+    const uint64_t start_idx = FullCacheHash()(key) % table_capacity_;
+    for (uint64_t count = 0; count < table_capacity_; ++count) {
+      const uint64_t idx = (start_idx + count) % table_capacity_;
+      Key entry_key = table_keys_[idx].load(std::memory_order_acquire);
+      if (entry_key == 0) {
+        if (!insert) { return 0; }
+        if (table_keys_[idx].compare_exchange_strong(entry_key, key_hi)) {
+          const Index index_plus_one = table_size_.fetch_add(1) + 1;
+          CHECK_LE(index_plus_one, capacity_) << "Full cache overflow";
+          table_indices_[idx].store((index_plus_one << 1U) | key_lo, std::memory_order_release);
+          return index_plus_one;
+        }
+      }
+      if (entry_key == key_hi) {
+        Index entry_index = table_indices_[idx].load(std::memory_order_acquire);
+        // The inserting thread publishes the index right after claiming the slot.
+        while (entry_index == 0) {
+          std::this_thread::yield();
+          entry_index = table_indices_[idx].load(std::memory_order_acquire);
+        }
+        if ((entry_index & 0x1) == key_lo) { return entry_index >> 1U; }
+      }
+    }
+    CHECK(!insert) << "Full cache overflow";
+    return 0;
+  }
+
+  bool DumpEntry(uint64_t idx, Key* key, Index* index_plus_one) const {
+    const Index entry_index = table_indices_[idx].load(std::memory_order_acquire);
+    if (entry_index == 0) { return false; }
+    *key = ((table_keys_[idx].load(std::memory_order_relaxed) ^ 0x1) | (entry_index & 0x1));
+    *index_plus_one = (entry_index >> 1U);
+    return true;
+  }
+
+  void Clear() {
+    table_size_.store(0);
+    for (uint64_t i = 0; i < table_capacity_; ++i) {
+      table_keys_[i].store(0, std::memory_order_relaxed);
+      table_indices_[i].store(0, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  uint64_t TableCapacity() const { return table_capacity_; }
+
+ private:
+  uint64_t capacity_;
+  uint64_t table_capacity_;
+  std::unique_ptr<std::atomic<Key>[]> table_keys_;
+  std::unique_ptr<std::atomic<Index>[]> table_indices_;
+  std::atomic<Index> table_size_;
+};
+
+template<typename Key, typename Index>
+class CpuFullCache : public Cache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CpuFullCache);
+  explicit CpuFullCache(const CacheOptions& options)
+      : encoder_(options.capacity, options.load_factor),
+        options_(options),
+        max_query_length_(0) {
+    values_.resize(options_.capacity * options_.value_size);
+  }
+  ~CpuFullCache() override = default;
+
+  uint64_t Capacity() const override { return options_.capacity; }
+  uint64_t DumpCapacity() const override { return encoder_.TableCapacity(); }
+  uint32_t KeySize() const override { return options_.key_size; }
+  uint32_t ValueSize() const override { return options_.value_size; }
+  DataType ValueType() const override { return options_.value_type; }
+  uint32_t MaxQueryLength() const override { return max_query_length_; }
+
+  void ReserveQueryLength(uint32_t query_length) override {
+    max_query_length_ = std::max(max_query_length_, query_length);
+  }
+
+  CacheOptions::Policy Policy() const override { return CacheOptions::Policy::kFull; }
+
+  void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
+            void* missing_keys, uint32_t* missing_indices) override {
+    Lookup<true>(stream, n_keys, static_cast<const Key*>(keys), nullptr, n_missing,
+                 static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values, uint32_t* n_missing,
+           void* missing_keys, uint32_t* missing_indices) override {
+    Lookup<false>(stream, n_keys, static_cast<const Key*>(keys), static_cast<char*>(values),
+                  n_missing, static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values,
+           uint8_t* mask) override;
+
+  void Put(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+           uint32_t* n_evicted, void* evicted_keys, void* evicted_values) override;
+
+  void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+            uint32_t* n_dumped, void* keys, void* values) override;
+
+  void Clear() override { encoder_.Clear(); }
+
+ private:
+  template<bool test_only>
+  void Lookup(ep::Stream* stream, uint32_t n_keys, const Key* keys, char* values,
+              uint32_t* n_missing, Key* missing_keys, uint32_t* missing_indices);
+
+  char* Row(Index index_plus_one) {
+    return values_.data() + (index_plus_one - 1) * options_.value_size;
+  }
+
+  CpuOrdinalEncoder<Key, Index> encoder_;
+  std::vector<char> values_;
+  CacheOptions options_;
+  uint32_t max_query_length_;
+};
+
+template<typename Key, typename Index>
+template<bool test_only>
+void CpuFullCache<Key, Index>::Lookup(ep::Stream* stream, uint32_t n_keys, const Key* keys,
+                                      char* values, uint32_t* n_missing, Key* missing_keys,
+                                      uint32_t* missing_indices) {
+  CHECK_LE(n_keys, max_query_length_);
+  const uint32_t value_size = options_.value_size;
+  std::atomic<uint32_t> missing_count(0);
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, n_keys,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const Index row = encoder_.template Encode<false>(keys[i]);
+          if (row == 0) {
+            const uint32_t missing_idx = missing_count.fetch_add(1, std::memory_order_relaxed);
+            missing_keys[missing_idx] = keys[i];
+            missing_indices[missing_idx] = i;
+          } else if (!test_only) {
+            std::memcpy(values + i * value_size, Row(row), value_size);
+          }
+        }
+      },
+      kParallelGrainKeys);
+  *n_missing = missing_count.load();
+}
+
+template<typename Key, typename Index>
+void CpuFullCache<Key, Index>::Get(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                                   void* values, uint8_t* mask) {
+  CHECK_LE(n_keys, max_query_length_);
+  const Key* keys_ptr = static_cast<const Key*>(keys);
+  char* values_ptr = static_cast<char*>(values);
+  const uint32_t value_size = options_.value_size;
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, n_keys,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const Index row = encoder_.template Encode<false>(keys_ptr[i]);
+          mask[i] = row > 0;
+          if (row > 0) { std::memcpy(values_ptr + i * value_size, Row(row), value_size); }
+        }
+      },
+      kParallelGrainKeys);
+}
+
+template<typename Key, typename Index>
+void CpuFullCache<Key, Index>::Put(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                                   const void* values, uint32_t* n_evicted, void* evicted_keys,
+                                   void* evicted_values) {
+  CHECK_LE(n_keys, max_query_length_);
+  // Full cache never evicts.
+  *n_evicted = 0;
+  const Key* keys_ptr = static_cast<const Key*>(keys);
+  const char* values_ptr = static_cast<const char*>(values);
+  const uint32_t value_size = options_.value_size;
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, n_keys,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const Index row = encoder_.template Encode<true>(keys_ptr[i]);
+          std::memcpy(Row(row), values_ptr + i * value_size, value_size);
+        }
+      },
+      kParallelGrainKeys);
+}
+
+template<typename Key, typename Index>
+void CpuFullCache<Key, Index>::Dump(ep::Stream* stream, uint64_t start_key_index,
+                                    uint64_t end_key_index, uint32_t* n_dumped, void* keys,
+                                    void* values) {
+  Key* keys_ptr = static_cast<Key*>(keys);
+  char* values_ptr = static_cast<char*>(values);
+  const uint32_t value_size = options_.value_size;
+  uint32_t count = 0;
+  for (uint64_t idx = start_key_index; idx < end_key_index; ++idx) {
+    Key key;
+    Index row;
+    if (!encoder_.DumpEntry(idx, &key, &row)) { continue; }
+    keys_ptr[count] = key;
+    std::memcpy(values_ptr + count * value_size, Row(row), value_size);
+    count += 1;
+  }
+  *n_dumped = count;
+}
+
+template<typename Index>
+std::unique_ptr<Cache> DispatchKeyType(const CacheOptions& options) {
+  if (options.key_size == sizeof(uint32_t)) {
+    return std::unique_ptr<Cache>(new CpuFullCache<uint32_t, Index>(options));
+  } else if (options.key_size == sizeof(uint64_t)) {
+    return std::unique_ptr<Cache>(new CpuFullCache<uint64_t, Index>(options));
+  } else {
+    UNIMPLEMENTED();
+    return nullptr;
+  }
+}
+
+std::unique_ptr<Cache> DispatchIndexType(const CacheOptions& options) {
+  const int64_t table_capacity = static_cast<double>(options.capacity) / options.load_factor;
+  if (table_capacity >= (1ULL << 31ULL)) {
+    return DispatchKeyType<uint64_t>(options);
+  } else {
+    return DispatchKeyType<uint32_t>(options);
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<Cache> NewCpuFullCache(const CacheOptions& options) {
+  return DispatchIndexType(options);
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
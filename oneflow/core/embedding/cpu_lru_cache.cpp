@@ -0,0 +1,282 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/lru_cache.h"
+#include "oneflow/core/embedding/hash_functions.cuh"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+// The cache is organized as n_set sets of kNumWays ways, every key can only live in the set
+// selected by its hash. Replacement inside a set uses the CLOCK algorithm, which approximates LRU
+// with one reference bit per way. Sets are protected by a fixed number of lock stripes so that
+// keys falling into different stripes are served concurrently.
+constexpr uint32_t kNumWays = 16;
+constexpr uint64_t kMaxNumLockStripes = 4096;
+constexpr int64_t kParallelGrainKeys = 256;
+
+enum WayState : uint8_t {
+  kEmpty = 0,
+  kValid = 1,
+  kReferenced = 2,
+};
+
+template<typename Key>
+class CpuLruCache : public Cache {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CpuLruCache);
+  explicit CpuLruCache(const CacheOptions& options)
+      : value_size_(options.value_size),
+        value_type_(options.value_type),
+        max_query_length_(0),
+        n_set_((options.capacity - 1 + kNumWays) / kNumWays),
+        num_lock_stripes_(std::min(n_set_, kMaxNumLockStripes)) {
+    CHECK_GT(n_set_, 0);
+    keys_.resize(n_set_ * kNumWays);
+    states_.resize(n_set_ * kNumWays);
+    hands_.resize(n_set_);
+    values_.resize(n_set_ * kNumWays * value_size_);
+    lock_stripes_.reset(new std::mutex[num_lock_stripes_]);
+    Clear();
+  }
+  ~CpuLruCache() override = default;
+
+  uint32_t KeySize() const override { return sizeof(Key); }
+  uint32_t ValueSize() const override { return value_size_; }
+  DataType ValueType() const override { return value_type_; }
+  uint64_t Capacity() const override { return n_set_ * kNumWays; }
+  uint32_t MaxQueryLength() const override { return max_query_length_; }
+
+  void ReserveQueryLength(uint32_t query_length) override {
+    if (query_length < max_query_length_) { return; }
+    pending_indices_.resize(query_length);
+    max_query_length_ = query_length;
+  }
+
+  CacheOptions::Policy Policy() const override { return CacheOptions::Policy::kLRU; }
+
+  void Test(ep::Stream* stream, uint32_t n_keys, const void* keys, uint32_t* n_missing,
+            void* missing_keys, uint32_t* missing_indices) override {
+    Lookup<true>(stream, n_keys, static_cast<const Key*>(keys), nullptr, n_missing,
+                 static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Get(ep::Stream* stream, uint32_t n_keys, const void* keys, void* values, uint32_t* n_missing,
+           void* missing_keys, uint32_t* missing_indices) override {
+    Lookup<false>(stream, n_keys, static_cast<const Key*>(keys), static_cast<char*>(values),
+                  n_missing, static_cast<Key*>(missing_keys), missing_indices);
+  }
+
+  void Put(ep::Stream* stream, uint32_t n_keys, const void* keys, const void* values,
+           uint32_t* n_evicted, void* evicted_keys, void* evicted_values) override;
+
+  void Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+            uint32_t* n_dumped, void* keys, void* values) override;
+
+  void Clear() override {
+    std::fill(states_.begin(), states_.end(), WayState::kEmpty);
+    std::fill(hands_.begin(), hands_.end(), 0);
+  }
+
+ private:
+  template<bool test_only>
+  void Lookup(ep::Stream* stream, uint32_t n_keys, const Key* keys, char* values,
+              uint32_t* n_missing, Key* missing_keys, uint32_t* missing_indices);
+
+  uint64_t SetId4Key(Key key) const { return LruCacheHash()(key) % n_set_; }
+
+  std::mutex* LockStripe4SetId(uint64_t set_id) const {
+    return &lock_stripes_[set_id % num_lock_stripes_];
+  }
+
+  int FindWay(uint64_t set_id, Key key) const {
+    const Key* set_keys = keys_.data() + set_id * kNumWays;
+    const uint8_t* set_states = states_.data() + set_id * kNumWays;
+    for (int way = 0; way < kNumWays; ++way) {
+      if (set_states[way] != WayState::kEmpty && set_keys[way] == key) { return way; }
+    }
+    return -1;
+  }
+
+  int FindWayOrEmptyWay(uint64_t set_id, Key key) const {
+    const int way = FindWay(set_id, key);
+    if (way >= 0) { return way; }
+    const uint8_t* set_states = states_.data() + set_id * kNumWays;
+    for (int empty_way = 0; empty_way < kNumWays; ++empty_way) {
+      if (set_states[empty_way] == WayState::kEmpty) { return empty_way; }
+    }
+    return -1;
+  }
+
+  void WriteWay(uint64_t set_id, int way, Key key, const char* value) {
+    keys_[set_id * kNumWays + way] = key;
+    states_[set_id * kNumWays + way] = WayState::kReferenced;
+    std::memcpy(Line(set_id, way), value, value_size_);
+  }
+
+  char* Line(uint64_t set_id, int way) {
+    return values_.data() + (set_id * kNumWays + way) * value_size_;
+  }
+
+  uint32_t value_size_;
+  DataType value_type_;
+  uint32_t max_query_length_;
+  uint64_t n_set_;
+  uint64_t num_lock_stripes_;
+  std::vector<Key> keys_;
+  std::vector<uint8_t> states_;
+  std::vector<uint8_t> hands_;
+  std::vector<char> values_;
+  std::vector<uint32_t> pending_indices_;
+  std::unique_ptr<std::mutex[]> lock_stripes_;
+};
+
+template<typename Key>
+template<bool test_only>
+void CpuLruCache<Key>::Lookup(ep::Stream* stream, uint32_t n_keys, const Key* keys, char* values,
+                              uint32_t* n_missing, Key* missing_keys,
+                              uint32_t* missing_indices) {
+  CHECK_LE(n_keys, max_query_length_);
+  std::atomic<uint32_t> missing_count(0);
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, n_keys,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const Key key = keys[i];
+          const uint64_t set_id = SetId4Key(key);
+          std::lock_guard<std::mutex> lock(*LockStripe4SetId(set_id));
+          const int way = FindWay(set_id, key);
+          if (way < 0) {
+            const uint32_t missing_idx = missing_count.fetch_add(1, std::memory_order_relaxed);
+            missing_keys[missing_idx] = key;
+            missing_indices[missing_idx] = i;
+          } else if (!test_only) {
+            std::memcpy(values + i * value_size_, Line(set_id, way), value_size_);
+            states_[set_id * kNumWays + way] = WayState::kReferenced;
+          }
+        }
+      },
+      kParallelGrainKeys);
+  *n_missing = missing_count.load();
+}
+
+template<typename Key>
+void CpuLruCache<Key>::Put(ep::Stream* stream, uint32_t n_keys, const void* keys,
+                           const void* values, uint32_t* n_evicted, void* evicted_keys,
+                           void* evicted_values) {
+  CHECK_LE(n_keys, max_query_length_);
+  const Key* keys_ptr = static_cast<const Key*>(keys);
+  const char* values_ptr = static_cast<const char*>(values);
+  Key* evicted_keys_ptr = static_cast<Key*>(evicted_keys);
+  char* evicted_values_ptr = static_cast<char*>(evicted_values);
+  ep::CpuStream* cpu_stream = stream->As<ep::CpuStream>();
+  // Like the CUDA implementation, keys already cached or fitting into a free way are written
+  // first, and only the remaining keys evict. When more keys of this batch fall into one set than
+  // it has ways, they evict each other. A key evicted this way has its update applied already, so
+  // it is returned with the value of this batch and no update is lost.
+  std::atomic<uint32_t> pending_count(0);
+  cpu_stream->ParallelFor(
+      0, n_keys,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const Key key = keys_ptr[i];
+          const uint64_t set_id = SetId4Key(key);
+          std::lock_guard<std::mutex> lock(*LockStripe4SetId(set_id));
+          const int way = FindWayOrEmptyWay(set_id, key);
+          if (way < 0) {
+            pending_indices_[pending_count.fetch_add(1, std::memory_order_relaxed)] = i;
+          } else {
+            WriteWay(set_id, way, key, values_ptr + i * value_size_);
+          }
+        }
+      },
+      kParallelGrainKeys);
+  std::atomic<uint32_t> evicted_count(0);
+  cpu_stream->ParallelFor(
+      0, pending_count.load(),
+      [&](int64_t begin, int64_t end) {
+        for (int64_t pending_idx = begin; pending_idx < end; ++pending_idx) {
+          const uint32_t i = pending_indices_[pending_idx];
+          const Key key = keys_ptr[i];
+          const uint64_t set_id = SetId4Key(key);
+          std::lock_guard<std::mutex> lock(*LockStripe4SetId(set_id));
+          // The key may have been inserted by a duplicate of it earlier in this pass.
+          int way = FindWay(set_id, key);
+          if (way < 0) {
+            // CLOCK: referenced ways get a second chance, the first unreferenced one is evicted.
+            const Key* set_keys = keys_.data() + set_id * kNumWays;
+            uint8_t* set_states = states_.data() + set_id * kNumWays;
+            uint8_t hand = hands_[set_id];
+            while (set_states[hand] == WayState::kReferenced) {
+              set_states[hand] = WayState::kValid;
+              hand = (hand + 1) % kNumWays;
+            }
+            way = hand;
+            hands_[set_id] = (hand + 1) % kNumWays;
+            const uint32_t evicted_idx = evicted_count.fetch_add(1, std::memory_order_relaxed);
+            evicted_keys_ptr[evicted_idx] = set_keys[way];
+            std::memcpy(evicted_values_ptr + evicted_idx * value_size_, Line(set_id, way),
+                        value_size_);
+          }
+          WriteWay(set_id, way, key, values_ptr + i * value_size_);
+        }
+      },
+      kParallelGrainKeys);
+  *n_evicted = evicted_count.load();
+}
+
+template<typename Key>
+void CpuLruCache<Key>::Dump(ep::Stream* stream, uint64_t start_key_index, uint64_t end_key_index,
+                            uint32_t* n_dumped, void* keys, void* values) {
+  Key* keys_ptr = static_cast<Key*>(keys);
+  char* values_ptr = static_cast<char*>(values);
+  uint32_t count = 0;
+  for (uint64_t index = start_key_index; index < end_key_index; ++index) {
+    const uint64_t set_id = index / kNumWays;
+    const int way = index % kNumWays;
+    std::lock_guard<std::mutex> lock(*LockStripe4SetId(set_id));
+    if (states_[index] == WayState::kEmpty) { continue; }
+    keys_ptr[count] = keys_[index];
+    std::memcpy(values_ptr + count * value_size_, Line(set_id, way), value_size_);
+    count += 1;
+  }
+  *n_dumped = count;
+}
+
+std::unique_ptr<Cache> DispatchKeyType(const CacheOptions& options) {
+  if (options.key_size == sizeof(uint32_t)) {
+    return std::unique_ptr<Cache>(new CpuLruCache<uint32_t>(options));
+  } else if (options.key_size == sizeof(uint64_t)) {
+    return std::unique_ptr<Cache>(new CpuLruCache<uint64_t>(options));
+  } else {
+    UNIMPLEMENTED();
+    return nullptr;
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<Cache> NewCpuLruCache(const CacheOptions& options) {
+  return DispatchKeyType(options);
+}
+
+}  // namespace embedding
+
+}  // namespace oneflow
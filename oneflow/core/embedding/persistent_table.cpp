@@ -60,7 +60,16 @@ constexpr char const* kKeysDirName = "keys";
 constexpr char const* kValuesDirName = "values";
 constexpr char const* kSnapshotsDirName = "snapshots";
 constexpr char const* kSnapshotListFileName = "LIST";
+constexpr char const* kSnapshotIndexFileName = "INDEX";
+constexpr char const* kTemporaryFileNameSuffix = ".tmp";
 constexpr size_t kParallelForStride = 256;
+constexpr uint32_t kDefaultCompactionIntervalMs = 10000;
+constexpr double kDefaultCompactionMaxLiveRatio = 0.5;
+constexpr uint32_t kCompactionBatchSize = 16384;
+constexpr uint32_t kNumIndexShards = 64;
+constexpr uint64_t kSnapshotIndexMagic = 0x5844494e5053464fULL;
+constexpr uint64_t kSnapshotIndexEmptyRowId = std::numeric_limits<uint64_t>::max();
+constexpr double kSnapshotIndexLoadFactor = 0.75;
 
 template<typename T>
 T* BytesOffset(T* ptr, size_t bytes) {
@@ -333,6 +342,92 @@ class Worker final {
   std::thread thread_;
 };
 
+using ValueFileTable = std::vector<std::shared_ptr<PosixFile>>;
+
+// The snapshot index file is an open addressing hash table with linear probing which maps keys to
+// row ids. It is queried in place through mmap, so that loading a snapshot does not need to
+// rebuild the whole index in memory.
+struct SnapshotIndexHeader {
+  uint64_t magic;
+  uint64_t key_size;
+  uint64_t capacity;
+  uint64_t num_keys;
+};
+
+template<typename Key>
+struct SnapshotIndexSlot {
+  Key key;
+  uint64_t row_id;
+};
+
+template<typename Key>
+uint64_t SnapshotIndexFileSize(uint64_t capacity) {
+  return sizeof(SnapshotIndexHeader) + capacity * sizeof(SnapshotIndexSlot<Key>);
+}
+
+template<typename Key>
+class MappedSnapshotIndex final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MappedSnapshotIndex);
+  ~MappedSnapshotIndex() = default;
+
+  // Returns nullptr if the file is truncated or its header does not match.
+  static std::unique_ptr<MappedSnapshotIndex<Key>> Open(const std::string& pathname) {
+    PosixFile file(pathname, O_RDONLY, 0644);
+    const size_t file_size = file.Size();
+    if (file_size < sizeof(SnapshotIndexHeader)) { return nullptr; }
+    std::unique_ptr<MappedSnapshotIndex<Key>> index(new MappedSnapshotIndex<Key>());
+    index->mapped_file_ = PosixMappedFile(std::move(file), file_size, PROT_READ);
+    index->header_ = static_cast<const SnapshotIndexHeader*>(index->mapped_file_.ptr());
+    const SnapshotIndexHeader& header = *index->header_;
+    if (header.magic != kSnapshotIndexMagic || header.key_size != sizeof(Key)
+        || header.capacity == 0 || header.num_keys >= header.capacity
+        || file_size != SnapshotIndexFileSize<Key>(header.capacity)) {
+      return nullptr;
+    }
+    index->slots_ = reinterpret_cast<const SnapshotIndexSlot<Key>*>(index->header_ + 1);
+    return index;
+  }
+
+  uint64_t NumKeys() const { return header_->num_keys; }
+
+  bool Find(Key key, uint64_t* row_id) const {
+    const uint64_t capacity = header_->capacity;
+    uint64_t idx = PersistentTableIndexHash()(key) % capacity;
+    for (uint64_t count = 0; count < capacity; ++count) {
+      const SnapshotIndexSlot<Key>& slot = slots_[idx];
+      if (slot.row_id == kSnapshotIndexEmptyRowId) { return false; }
+      if (slot.key == key) {
+        *row_id = slot.row_id;
+        return true;
+      }
+      idx = (idx + 1 == capacity) ? 0 : idx + 1;
+    }
+    return false;
+  }
+
+  template<typename Func>
+  void ForEach(const Func& func) const {
+    for (uint64_t idx = 0; idx < header_->capacity; ++idx) {
+      const SnapshotIndexSlot<Key>& slot = slots_[idx];
+      if (slot.row_id != kSnapshotIndexEmptyRowId) { func(slot.key, slot.row_id); }
+    }
+  }
+
+ private:
+  MappedSnapshotIndex() = default;
+
+  PosixMappedFile mapped_file_;
+  const SnapshotIndexHeader* header_;
+  const SnapshotIndexSlot<Key>* slots_;
+};
+
+template<typename Key>
+struct IndexShard {
+  std::mutex mutex;
+  robin_hood::unordered_flat_map<Key, uint64_t> row_id_mapping;
+};
+
 template<typename Key, typename Engine>
 class SnapshotIteratorImpl;
 
@@ -359,6 +454,7 @@ class PersistentTableImpl : public PersistentTable {
                     const std::function<void(Iterator* iter)>& Hook) override;
   void SaveSnapshot(const std::string& name) override;
   Iterator* ReadSnapshot(const std::string& name) override;
+  void GetStats(PersistentTableStats* stats) override;
 
  private:
   friend class SnapshotIteratorImpl<Key, Engine>;
@@ -367,9 +463,23 @@ class PersistentTableImpl : public PersistentTable {
   std::string IndexFilePath(const std::string& name, uint64_t chunk_id) const;
   std::string SnapshotDirPath(const std::string& name) const;
   std::string SnapshotListFilePath(const std::string& name) const;
+  std::string SnapshotIndexFilePath(const std::string& name) const;
   void LoadSnapshotImpl(const std::string& name);
+  bool LoadSnapshotIndex(const std::string& name);
   void SaveSnapshotImpl(const std::string& name);
+  void SaveSnapshotIndex(const std::string& name, uint64_t num_keys);
   void ParallelFor(size_t total, const ForRange<Engine>& for_range);
+  IndexShard<Key>& IndexShard4Key(Key key);
+  bool FindRowId(Key key, uint64_t* row_id);
+  template<typename Func>
+  void ForEachRow(const Func& func);
+  uint64_t NumKeys();
+  std::vector<std::unique_lock<std::mutex>> LockAllIndexShards();
+  void ResetChunkLiveCounts();
+  std::unordered_set<uint64_t> GetSnapshotChunks() const;
+  void CompactionLoop();
+  void Compact();
+  void CompactChunk(uint64_t chunk_id);
 
   std::string root_dir_;
   std::string keys_dir_;
@@ -385,16 +495,37 @@ class PersistentTableImpl : public PersistentTable {
 
   std::vector<std::unique_ptr<Worker<Engine>>> workers_;
 
-  std::vector<uint32_t> offsets_buffer_;
   AlignedBuffer blocks_buffer_;
 
+  // Writers (puts, snapshot loading and compaction) are serialized by mutex_ and additionally
+  // hold the lock of the index shard they modify, so a lookup only locks the shard of its key.
   std::recursive_mutex mutex_;
   uint64_t physical_table_size_;
-  robin_hood::unordered_flat_map<Key, uint64_t> row_id_mapping_;
-  std::vector<PosixFile> value_files_;
+  std::unique_ptr<IndexShard<Key>[]> index_shards_;
+  // Index of the loaded snapshot, mapped from disk. The index shards only hold the keys put after
+  // the snapshot was loaded, they take precedence over the snapshot index.
+  std::unique_ptr<MappedSnapshotIndex<Key>> snapshot_index_;
+  uint64_t num_shadowed_snapshot_keys_;
+  // Copy on write table of the value chunks, indexed by chunk id. Writers publish a new table with
+  // std::atomic_store, lookups take a reference with std::atomic_load, which also keeps the files
+  // of reclaimed chunks open until in-flight reads are done.
+  std::shared_ptr<const ValueFileTable> value_files_;
   PosixFile writable_key_file_;
   uint64_t writable_key_file_chunk_id_;
   PosixFileLockGuard lock_;
+
+  // Number of keys currently mapped into each value chunk. Updated keys are appended to the tail,
+  // so older chunks only lose live values over time and are rewritten by the compaction thread
+  // once they become sparse enough.
+  std::vector<uint64_t> chunk_live_counts_;
+  uint64_t num_reclaimed_chunks_;
+  uint64_t num_compacted_values_;
+  double compaction_max_live_ratio_;
+  uint32_t compaction_interval_ms_;
+  std::thread compaction_thread_;
+  std::mutex compaction_mutex_;
+  std::condition_variable compaction_cond_;
+  std::atomic<bool> compaction_shutdown_;
 };
 
 template<typename Key, typename Engine>
@@ -405,10 +536,19 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
       physical_block_size_(options.physical_block_size),
       logical_block_size_(GetLogicalBlockSize(options.physical_block_size, value_size_)),
       blocks_buffer_(options.physical_block_size),
-      writable_key_file_chunk_id_(-1) {
+      num_shadowed_snapshot_keys_(0),
+      writable_key_file_chunk_id_(-1),
+      num_reclaimed_chunks_(0),
+      num_compacted_values_(0),
+      compaction_shutdown_(false) {
   const uint64_t capacity_hint = ParseIntegerFromEnv(
       "ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_CAPACITY_HINT", options.capacity_hint);
-  if (capacity_hint > 0) { row_id_mapping_.reserve(capacity_hint); }
+  index_shards_.reset(new IndexShard<Key>[kNumIndexShards]);
+  if (capacity_hint > 0) {
+    for (uint32_t i = 0; i < kNumIndexShards; ++i) {
+      index_shards_[i].row_id_mapping.reserve(capacity_hint / kNumIndexShards + 1);
+    }
+  }
   PosixFile::RecursiveCreateDirectory(options.path, 0755);
   const std::string lock_filename = PosixFile::JoinPath(options.path, kLockFileName);
   const bool init = !PosixFile::FileExists(lock_filename);
@@ -439,23 +579,41 @@ PersistentTableImpl<Key, Engine>::PersistentTableImpl(const PersistentTableOptio
   }
   std::unordered_map<uint64_t, std::string> chunks;
   ListChunkFiles(values_dir_, kValueFileNamePrefix, &chunks);
+  std::shared_ptr<ValueFileTable> value_files(new ValueFileTable());
   for (auto& chunk : chunks) {
-    if (value_files_.size() <= chunk.first) { value_files_.resize(chunk.first + 1); }
-    CHECK_EQ(value_files_.at(chunk.first).fd(), -1);
-    PosixFile value_file(chunk.second, O_RDWR | O_DIRECT, 0644);
-    value_files_.at(chunk.first) = std::move(value_file);
-  }
-  if (!value_files_.empty()) {
-    physical_table_size_ = ((value_files_.size() - 1) * num_logical_blocks_per_chunk_
-                            + value_files_.back().Size() / logical_block_size_)
+    if (value_files->size() <= chunk.first) { value_files->resize(chunk.first + 1); }
+    CHECK(!value_files->at(chunk.first));
+    value_files->at(chunk.first).reset(new PosixFile(chunk.second, O_RDWR | O_DIRECT, 0644));
+  }
+  if (!value_files->empty()) {
+    CHECK(value_files->back());
+    physical_table_size_ = ((value_files->size() - 1) * num_logical_blocks_per_chunk_
+                            + value_files->back()->Size() / logical_block_size_)
                            * num_values_per_block_;
   } else {
     physical_table_size_ = 0;
   }
+  chunk_live_counts_.resize(value_files->size());
+  value_files_ = std::move(value_files);
+  compaction_max_live_ratio_ =
+      ParseFloatFromEnv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_COMPACTION_MAX_LIVE_RATIO",
+                        kDefaultCompactionMaxLiveRatio);
+  compaction_interval_ms_ =
+      ParseIntegerFromEnv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_COMPACTION_INTERVAL_MS",
+                          kDefaultCompactionIntervalMs);
+  if (ParseBooleanFromEnv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_ENABLE_COMPACTION", false)) {
+    compaction_thread_ = std::thread(&PersistentTableImpl<Key, Engine>::CompactionLoop, this);
+  }
 }
 
 template<typename Key, typename Engine>
 PersistentTableImpl<Key, Engine>::~PersistentTableImpl() {
+  {
+    std::lock_guard<std::mutex> lock(compaction_mutex_);
+    compaction_shutdown_ = true;
+  }
+  compaction_cond_.notify_all();
+  if (compaction_thread_.joinable()) { compaction_thread_.join(); }
   for (uint32_t tid = 0; tid < workers_.size(); ++tid) { workers_.at(tid)->Shutdown(); }
 }
 
@@ -467,24 +625,46 @@ uint32_t PersistentTableImpl<Key, Engine>::LogicalBlockSize() const {
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::GetBlocks(uint32_t num_keys, const void* keys, void* blocks,
                                                  uint32_t* offsets) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  // The table is loaded before the keys are looked up, so a chunk reclaimed by the compaction after
+  // the lookup of one of its rows is still open. A row put after the table was loaded may be in a
+  // chunk the table does not have yet; newer tables are loaded for such rows and kept until every
+  // read is done. If the chunk of a row has been reclaimed by the time a newer table is loaded, the
+  // row has been moved and its key is looked up again.
+  const std::shared_ptr<const ValueFileTable> value_files = std::atomic_load(&value_files_);
+  std::mutex newer_value_files_mutex;
+  std::vector<std::shared_ptr<const ValueFileTable>> newer_value_files;
+  const auto ValueFile4ChunkId = [&](uint64_t chunk_id) -> PosixFile* {
+    if (chunk_id < value_files->size() && value_files->at(chunk_id)) {
+      return value_files->at(chunk_id).get();
+    }
+    std::lock_guard<std::mutex> lock(newer_value_files_mutex);
+    if (newer_value_files.empty() || newer_value_files.back()->size() <= chunk_id
+        || !newer_value_files.back()->at(chunk_id)) {
+      newer_value_files.emplace_back(std::atomic_load(&value_files_));
+    }
+    CHECK_LT(chunk_id, newer_value_files.back()->size());
+    return newer_value_files.back()->at(chunk_id).get();
+  };
   ParallelFor(num_keys, [&](Engine* engine, size_t start, size_t end) {
     for (uint64_t i = start; i < end; ++i) {
       const Key key = static_cast<const Key*>(keys)[i];
-      auto it = row_id_mapping_.find(key);
-      if (it == row_id_mapping_.end()) {
+      uint64_t id = 0;
+      PosixFile* file = nullptr;
+      while (FindRowId(key, &id)) {
+        file = ValueFile4ChunkId(id / num_values_per_block_ / num_logical_blocks_per_chunk_);
+        if (file != nullptr) { break; }
+      }
+      if (file == nullptr) {
         offsets[i] = logical_block_size_;
       } else {
-        const uint64_t id = it->second;
         const uint64_t block_id = id / num_values_per_block_;
         const uint32_t id_in_block = id - block_id * num_values_per_block_;
         const uint32_t offset_in_block = id_in_block * value_size_;
         const uint64_t chunk_id = block_id / num_logical_blocks_per_chunk_;
         const uint64_t block_in_chunk = block_id - chunk_id * num_logical_blocks_per_chunk_;
         const uint64_t block_offset = block_in_chunk * logical_block_size_;
-        PosixFile& file = value_files_.at(chunk_id);
         offsets[i] = offset_in_block;
-        engine->AsyncPread(file.fd(), BytesOffset(blocks, i * logical_block_size_),
+        engine->AsyncPread(file->fd(), BytesOffset(blocks, i * logical_block_size_),
                            logical_block_size_, block_offset);
       }
     }
@@ -494,26 +674,26 @@ void PersistentTableImpl<Key, Engine>::GetBlocks(uint32_t num_keys, const void*
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::Get(uint32_t num_keys, const void* keys, void* values,
                                            uint32_t* n_missing, uint32_t* missing_indices) {
-  std::lock_guard<std::recursive_mutex> lock(mutex_);
-  offsets_buffer_.resize(num_keys);
+  std::vector<uint32_t> offsets(num_keys);
+  AlignedBuffer blocks_buffer(physical_block_size_);
   void* blocks_ptr = nullptr;
   if (value_size_ == logical_block_size_
       && reinterpret_cast<uintptr_t>(values) % physical_block_size_ == 0) {
     blocks_ptr = values;
   } else {
-    blocks_buffer_.Resize(num_keys * logical_block_size_);
-    blocks_ptr = blocks_buffer_.ptr();
+    blocks_buffer.Resize(num_keys * logical_block_size_);
+    blocks_ptr = blocks_buffer.ptr();
   }
-  GetBlocks(num_keys, keys, blocks_ptr, offsets_buffer_.data());
+  GetBlocks(num_keys, keys, blocks_ptr, offsets.data());
   uint32_t missing_count = 0;
   for (uint32_t i = 0; i < num_keys; ++i) {
-    if (offsets_buffer_.at(i) == logical_block_size_) {
+    if (offsets.at(i) == logical_block_size_) {
       missing_indices[missing_count] = i;
       missing_count += 1;
     } else {
-      if (value_size_ != logical_block_size_) {
+      if (blocks_ptr != values) {
         MemcpyOffset(values, i * value_size_, blocks_ptr,
-                     (i * logical_block_size_) + offsets_buffer_[i], value_size_);
+                     (i * logical_block_size_) + offsets[i], value_size_);
       }
     }
   }
@@ -532,20 +712,27 @@ void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void*
   const uint64_t start_block_id = start_index / num_values_per_block_;
   uint64_t written_blocks = 0;
   const uint64_t block_keys_size = num_values_per_block_ * sizeof(Key);
+  if (num_blocks > 0) {
+    const uint64_t end_chunk_id = (start_block_id + num_blocks - 1) / num_logical_blocks_per_chunk_;
+    if (value_files_->size() <= end_chunk_id) {
+      std::shared_ptr<ValueFileTable> value_files(new ValueFileTable(*value_files_));
+      while (value_files->size() <= end_chunk_id) {
+        value_files->emplace_back(
+            new PosixFile(ValueFilePath(value_files->size()), O_CREAT | O_RDWR | O_DIRECT, 0644));
+      }
+      std::atomic_store(&value_files_, std::shared_ptr<const ValueFileTable>(value_files));
+    }
+  }
   BlockingCounter bc(1);
   workers_.at(0)->Schedule([&](Engine*) {
     while (written_blocks < num_blocks) {
       const uint64_t batch_start_block_id = start_block_id + written_blocks;
       const uint64_t batch_chunk_id = batch_start_block_id / num_logical_blocks_per_chunk_;
-      if (batch_chunk_id == value_files_.size()) {
-        value_files_.emplace_back(ValueFilePath(batch_chunk_id), O_CREAT | O_RDWR | O_DIRECT, 0644);
-      } else {
-        CHECK_LE(batch_chunk_id, value_files_.size());
-      }
+      CHECK_LT(batch_chunk_id, value_files_->size());
       if ((!writable_key_file_.IsOpen()) || writable_key_file_chunk_id_ != batch_chunk_id) {
         writable_key_file_ = PosixFile(KeyFilePath(batch_chunk_id), O_CREAT | O_RDWR, 0644);
       }
-      PosixFile& value_file = value_files_.at(batch_chunk_id);
+      PosixFile& value_file = *value_files_->at(batch_chunk_id);
       const uint64_t block_id_in_chunk =
           batch_start_block_id - batch_chunk_id * num_logical_blocks_per_chunk_;
       const uint64_t blocks_to_write =
@@ -570,10 +757,31 @@ void PersistentTableImpl<Key, Engine>::PutBlocks(uint32_t num_keys, const void*
     }
     bc.Decrease();
   });
-  for (uint64_t i = 0; i < num_keys; ++i) {
-    row_id_mapping_[static_cast<const Key*>(keys)[i]] = start_index + i;
+  if (num_keys > 0) {
+    const uint64_t end_chunk_id = (start_index + num_keys - 1) / num_values_per_chunk_;
+    if (chunk_live_counts_.size() <= end_chunk_id) { chunk_live_counts_.resize(end_chunk_id + 1); }
   }
   bc.WaitForeverUntilCntEqualZero();
+  // New rows are published only after their values have been written.
+  for (uint64_t i = 0; i < num_keys; ++i) {
+    const Key key = static_cast<const Key*>(keys)[i];
+    const uint64_t row_id = start_index + i;
+    IndexShard<Key>& shard = IndexShard4Key(key);
+    std::lock_guard<std::mutex> shard_lock(shard.mutex);
+    auto it = shard.row_id_mapping.find(key);
+    if (it == shard.row_id_mapping.end()) {
+      uint64_t snapshot_row_id = 0;
+      if (snapshot_index_ && snapshot_index_->Find(key, &snapshot_row_id)) {
+        chunk_live_counts_[snapshot_row_id / num_values_per_chunk_] -= 1;
+        num_shadowed_snapshot_keys_ += 1;
+      }
+      shard.row_id_mapping.emplace(key, row_id);
+    } else {
+      chunk_live_counts_[it->second / num_values_per_chunk_] -= 1;
+      it->second = row_id;
+    }
+    chunk_live_counts_[row_id / num_values_per_chunk_] += 1;
+  }
 }
 
 template<typename Key, typename Engine>
@@ -626,12 +834,22 @@ std::string PersistentTableImpl<Key, Engine>::SnapshotListFilePath(const std::st
   return PosixFile::JoinPath(SnapshotDirPath(name), kSnapshotListFileName);
 }
 
+template<typename Key, typename Engine>
+std::string PersistentTableImpl<Key, Engine>::SnapshotIndexFilePath(const std::string& name) const {
+  return PosixFile::JoinPath(SnapshotDirPath(name), kSnapshotIndexFileName);
+}
+
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(const std::string& name) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   const std::string snapshot_base = SnapshotDirPath(name);
   const std::string snapshot_list = SnapshotListFilePath(name);
-  row_id_mapping_.clear();
+  std::vector<std::unique_lock<std::mutex>> shard_locks = LockAllIndexShards();
+  for (uint32_t i = 0; i < kNumIndexShards; ++i) { index_shards_[i].row_id_mapping.clear(); }
+  snapshot_index_.reset();
+  num_shadowed_snapshot_keys_ = 0;
+  ResetChunkLiveCounts();
+  if (LoadSnapshotIndex(name)) { return; }
   std::ifstream list_if(snapshot_list);
   std::string index_filename;
   while (std::getline(list_if, index_filename)) {
@@ -647,25 +865,70 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshotImpl(const std::string& name)
     const uint64_t* indices = static_cast<const uint64_t*>(mapped_index.ptr());
     const Key* keys = static_cast<const Key*>(mapped_key.ptr());
     const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
-    row_id_mapping_.reserve(row_id_mapping_.size() + n_entries);
     for (size_t i = 0; i < n_entries; ++i) {
-      CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
+      const Key key = keys[indices[i] - chunk_start_index];
+      CHECK(IndexShard4Key(key).row_id_mapping.emplace(key, indices[i]).second);
     }
+    CHECK_LT(chunk_id, chunk_live_counts_.size());
+    chunk_live_counts_[chunk_id] += n_entries;
   }
 }
 
+template<typename Key, typename Engine>
+bool PersistentTableImpl<Key, Engine>::LoadSnapshotIndex(const std::string& name) {
+  if (!ParseBooleanFromEnv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_SNAPSHOT_LOAD_MMAP_INDEX",
+                           true)) {
+    return false;
+  }
+  const std::string snapshot_index_path = SnapshotIndexFilePath(name);
+  if (!PosixFile::FileExists(snapshot_index_path)) { return false; }
+  std::unique_ptr<MappedSnapshotIndex<Key>> snapshot_index =
+      MappedSnapshotIndex<Key>::Open(snapshot_index_path);
+  // The per-chunk index files are the snapshot, a damaged INDEX is only a slower load.
+  if (!snapshot_index) {
+    LOG(WARNING) << "ignore broken snapshot index " << snapshot_index_path;
+    return false;
+  }
+  // The number of live values of each chunk is given by the size of its index file.
+  std::vector<uint64_t> chunk_live_counts(chunk_live_counts_.size());
+  std::ifstream list_if(SnapshotListFilePath(name));
+  std::string index_filename;
+  uint64_t num_keys = 0;
+  while (std::getline(list_if, index_filename)) {
+    const uint64_t chunk_id = GetChunkId(index_filename, kIndexFileNamePrefix);
+    PosixFile index_file(PosixFile::JoinPath(SnapshotDirPath(name), index_filename), O_RDONLY,
+                         0644);
+    CHECK_EQ(index_file.Size() % sizeof(uint64_t), 0);
+    CHECK_LT(chunk_id, chunk_live_counts.size());
+    chunk_live_counts[chunk_id] += index_file.Size() / sizeof(uint64_t);
+    num_keys += index_file.Size() / sizeof(uint64_t);
+  }
+  if (num_keys != snapshot_index->NumKeys()) {
+    LOG(WARNING) << "ignore snapshot index " << snapshot_index_path << " with "
+                 << snapshot_index->NumKeys() << " keys, the snapshot has " << num_keys;
+    return false;
+  }
+  snapshot_index_ = std::move(snapshot_index);
+  chunk_live_counts_ = std::move(chunk_live_counts);
+  return true;
+}
+
 template<typename Key, typename Engine>
 void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   PosixFile::RecursiveCreateDirectory(SnapshotDirPath(name), 0755);
   std::ofstream list_ofs(SnapshotListFilePath(name));
-  if (row_id_mapping_.empty()) { return; }
-  std::vector<PosixMappedFile> index_files(value_files_.size());
-  std::vector<uint64_t> counters(value_files_.size());
+  const uint64_t num_keys = NumKeys();
+  if (num_keys == 0) {
+    PosixFile::RecursiveDelete(SnapshotIndexFilePath(name));
+    return;
+  }
+  std::vector<PosixMappedFile> index_files(value_files_->size());
+  std::vector<uint64_t> counters(value_files_->size());
   const uint64_t max_index_file_size = num_values_per_chunk_ * sizeof(uint64_t);
-  for (const auto& pair : row_id_mapping_) {
-    const uint64_t chunk_id = pair.second / num_values_per_chunk_;
-    CHECK(chunk_id < value_files_.size());
+  ForEachRow([&](Key key, uint64_t row_id) {
+    const uint64_t chunk_id = row_id / num_values_per_chunk_;
+    CHECK(chunk_id < value_files_->size());
     if (index_files[chunk_id].ptr() == nullptr) {
       PosixFile snapshot_file(IndexFilePath(name, chunk_id), O_CREAT | O_RDWR, 0644);
       snapshot_file.Truncate(max_index_file_size);
@@ -675,10 +938,11 @@ void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name)
     uint64_t* indices = static_cast<uint64_t*>(index_files[chunk_id].ptr());
     uint64_t& count = counters[chunk_id];
     CHECK_LT(count, num_values_per_chunk_);
-    indices[count] = pair.second;
+    indices[count] = row_id;
     count += 1;
-  }
-  for (size_t i = 0; i < value_files_.size(); ++i) {
+  });
+  SaveSnapshotIndex(name, num_keys);
+  for (size_t i = 0; i < value_files_->size(); ++i) {
     const uint64_t count = counters[i];
     if (count > 0) {
       index_files[i].file().Truncate(count * sizeof(uint64_t));
@@ -689,6 +953,41 @@ void PersistentTableImpl<Key, Engine>::SaveSnapshotImpl(const std::string& name)
   }
 }
 
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::SaveSnapshotIndex(const std::string& name,
+                                                         uint64_t num_keys) {
+  const uint64_t capacity = static_cast<uint64_t>(num_keys / kSnapshotIndexLoadFactor) + 1;
+  const uint64_t file_size = SnapshotIndexFileSize<Key>(capacity);
+  const std::string snapshot_index_path = SnapshotIndexFilePath(name);
+  // The index of a loaded snapshot may still be mapped, so the new one is written to a temporary
+  // file and renamed over the old one.
+  const std::string tmp_path = snapshot_index_path + kTemporaryFileNameSuffix;
+  {
+    PosixFile file(tmp_path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    file.Truncate(file_size);
+    PosixMappedFile mapped_file(std::move(file), file_size, PROT_READ | PROT_WRITE);
+    SnapshotIndexHeader* header = static_cast<SnapshotIndexHeader*>(mapped_file.ptr());
+    SnapshotIndexSlot<Key>* slots = reinterpret_cast<SnapshotIndexSlot<Key>*>(header + 1);
+    for (uint64_t idx = 0; idx < capacity; ++idx) { slots[idx].row_id = kSnapshotIndexEmptyRowId; }
+    uint64_t count = 0;
+    ForEachRow([&](Key key, uint64_t row_id) {
+      uint64_t idx = PersistentTableIndexHash()(key) % capacity;
+      while (slots[idx].row_id != kSnapshotIndexEmptyRowId) {
+        idx = (idx + 1 == capacity) ? 0 : idx + 1;
+      }
+      slots[idx].key = key;
+      slots[idx].row_id = row_id;
+      count += 1;
+    });
+    CHECK_EQ(count, num_keys);
+    header->magic = kSnapshotIndexMagic;
+    header->key_size = sizeof(Key);
+    header->capacity = capacity;
+    header->num_keys = num_keys;
+  }
+  PCHECK(rename(tmp_path.c_str(), snapshot_index_path.c_str()) == 0);
+}
+
 template<typename Key, typename Engine>
 bool PersistentTableImpl<Key, Engine>::SnapshotExists(const std::string& name) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
@@ -711,7 +1010,11 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshot(
   }
   const std::string snapshot_base = SnapshotDirPath(name);
   const std::string snapshot_list = SnapshotListFilePath(name);
-  row_id_mapping_.clear();
+  std::vector<std::unique_lock<std::mutex>> shard_locks = LockAllIndexShards();
+  for (uint32_t i = 0; i < kNumIndexShards; ++i) { index_shards_[i].row_id_mapping.clear(); }
+  snapshot_index_.reset();
+  num_shadowed_snapshot_keys_ = 0;
+  ResetChunkLiveCounts();
   std::ifstream list_if(snapshot_list);
   std::string index_filename;
   while (std::getline(list_if, index_filename)) {
@@ -727,10 +1030,12 @@ void PersistentTableImpl<Key, Engine>::LoadSnapshot(
     const uint64_t* indices = static_cast<const uint64_t*>(mapped_index.ptr());
     const Key* keys = static_cast<const Key*>(mapped_key.ptr());
     const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
-    row_id_mapping_.reserve(row_id_mapping_.size() + n_entries);
     for (size_t i = 0; i < n_entries; ++i) {
-      CHECK(row_id_mapping_.emplace(keys[indices[i] - chunk_start_index], indices[i]).second);
+      const Key key = keys[indices[i] - chunk_start_index];
+      CHECK(IndexShard4Key(key).row_id_mapping.emplace(key, indices[i]).second);
     }
+    CHECK_LT(chunk_id, chunk_live_counts_.size());
+    chunk_live_counts_[chunk_id] += n_entries;
     if (Hook) {
       PosixFile value_file(ValueFilePath(chunk_id), O_RDONLY, 0644);
       PosixMappedFile mapped_value(std::move(value_file), value_file.Size(), PROT_READ, mmap_flags);
@@ -774,6 +1079,188 @@ void PersistentTableImpl<Key, Engine>::ParallelFor(size_t total,
   bc.WaitForeverUntilCntEqualZero();
 }
 
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::GetStats(PersistentTableStats* stats) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  *stats = PersistentTableStats();
+  stats->num_keys = NumKeys();
+  for (const auto& value_file : *value_files_) {
+    if (!value_file) { continue; }
+    stats->num_value_chunks += 1;
+    stats->num_value_slots += value_file->Size() / logical_block_size_ * num_values_per_block_;
+  }
+  stats->num_reclaimed_chunks = num_reclaimed_chunks_;
+  stats->num_compacted_values = num_compacted_values_;
+  if (stats->num_value_slots > 0) {
+    stats->dead_space_fraction =
+        1.0 - static_cast<double>(stats->num_keys) / static_cast<double>(stats->num_value_slots);
+  }
+}
+
+template<typename Key, typename Engine>
+IndexShard<Key>& PersistentTableImpl<Key, Engine>::IndexShard4Key(Key key) {
+  return index_shards_[PersistentTableIndexHash()(key) % kNumIndexShards];
+}
+
+template<typename Key, typename Engine>
+bool PersistentTableImpl<Key, Engine>::FindRowId(Key key, uint64_t* row_id) {
+  IndexShard<Key>& shard = IndexShard4Key(key);
+  std::lock_guard<std::mutex> shard_lock(shard.mutex);
+  auto it = shard.row_id_mapping.find(key);
+  if (it != shard.row_id_mapping.end()) {
+    *row_id = it->second;
+    return true;
+  }
+  return snapshot_index_ && snapshot_index_->Find(key, row_id);
+}
+
+template<typename Key, typename Engine>
+template<typename Func>
+void PersistentTableImpl<Key, Engine>::ForEachRow(const Func& func) {
+  for (uint32_t shard_id = 0; shard_id < kNumIndexShards; ++shard_id) {
+    for (const auto& pair : index_shards_[shard_id].row_id_mapping) {
+      func(pair.first, pair.second);
+    }
+  }
+  if (snapshot_index_) {
+    snapshot_index_->ForEach([&](Key key, uint64_t row_id) {
+      if (IndexShard4Key(key).row_id_mapping.count(key) == 0) { func(key, row_id); }
+    });
+  }
+}
+
+template<typename Key, typename Engine>
+uint64_t PersistentTableImpl<Key, Engine>::NumKeys() {
+  uint64_t num_keys = 0;
+  for (uint32_t i = 0; i < kNumIndexShards; ++i) {
+    std::lock_guard<std::mutex> shard_lock(index_shards_[i].mutex);
+    num_keys += index_shards_[i].row_id_mapping.size();
+  }
+  if (snapshot_index_) { num_keys += snapshot_index_->NumKeys() - num_shadowed_snapshot_keys_; }
+  return num_keys;
+}
+
+template<typename Key, typename Engine>
+std::vector<std::unique_lock<std::mutex>> PersistentTableImpl<Key, Engine>::LockAllIndexShards() {
+  std::vector<std::unique_lock<std::mutex>> shard_locks;
+  shard_locks.reserve(kNumIndexShards);
+  for (uint32_t i = 0; i < kNumIndexShards; ++i) {
+    shard_locks.emplace_back(index_shards_[i].mutex);
+  }
+  return shard_locks;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::ResetChunkLiveCounts() {
+  chunk_live_counts_.assign(value_files_->size(), 0);
+}
+
+template<typename Key, typename Engine>
+std::unordered_set<uint64_t> PersistentTableImpl<Key, Engine>::GetSnapshotChunks() const {
+  std::unordered_set<uint64_t> chunks;
+  if (!PosixFile::FileExists(snapshots_dir_)) { return chunks; }
+  DIR* dir = opendir(snapshots_dir_.c_str());
+  PCHECK(dir != nullptr);
+  struct dirent* ent = nullptr;
+  while ((ent = readdir(dir)) != nullptr) {
+    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) { continue; }
+    std::ifstream list_if(SnapshotListFilePath(ent->d_name));
+    std::string index_filename;
+    while (std::getline(list_if, index_filename)) {
+      chunks.insert(GetChunkId(index_filename, kIndexFileNamePrefix));
+    }
+  }
+  PCHECK(closedir(dir) == 0);
+  return chunks;
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::CompactionLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(compaction_mutex_);
+      compaction_cond_.wait_for(lock, std::chrono::milliseconds(compaction_interval_ms_),
+                                [&]() { return compaction_shutdown_.load(); });
+      if (compaction_shutdown_) { break; }
+    }
+    Compact();
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::Compact() {
+  std::vector<uint64_t> candidates;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (value_files_->empty()) { return; }
+    // Chunks referenced by a snapshot must stay intact, and the tail chunk is still being filled.
+    const std::unordered_set<uint64_t> snapshot_chunks = GetSnapshotChunks();
+    for (uint64_t chunk_id = 0; chunk_id + 1 < value_files_->size(); ++chunk_id) {
+      if (!value_files_->at(chunk_id)) { continue; }
+      if (snapshot_chunks.count(chunk_id) != 0) { continue; }
+      if (chunk_live_counts_[chunk_id] < compaction_max_live_ratio_ * num_values_per_chunk_) {
+        candidates.push_back(chunk_id);
+      }
+    }
+  }
+  for (const uint64_t chunk_id : candidates) {
+    if (compaction_shutdown_) { break; }
+    CompactChunk(chunk_id);
+  }
+}
+
+template<typename Key, typename Engine>
+void PersistentTableImpl<Key, Engine>::CompactChunk(uint64_t chunk_id) {
+  const uint64_t chunk_start_index = chunk_id * num_values_per_chunk_;
+  bool has_live_values = false;
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    has_live_values = chunk_live_counts_[chunk_id] > 0;
+  }
+  if (has_live_values) {
+    // The keys of a sealed chunk never change, live values are found by checking whether the
+    // mapping of each key still points into this chunk. The table lock is only held for one
+    // batch at a time so that lookups and updates are interleaved with the compaction.
+    PosixFile key_file(KeyFilePath(chunk_id), O_RDONLY, 0644);
+    const uint64_t num_chunk_keys = std::min<uint64_t>(key_file.Size() / sizeof(Key),
+                                                       num_values_per_chunk_);
+    PosixMappedFile mapped_key(std::move(key_file), key_file.Size(), PROT_READ);
+    const Key* chunk_keys = static_cast<const Key*>(mapped_key.ptr());
+    std::vector<Key> batch_keys;
+    std::vector<char> batch_values(kCompactionBatchSize * value_size_);
+    std::vector<uint32_t> missing_indices(kCompactionBatchSize);
+    uint64_t pos = 0;
+    while (pos < num_chunk_keys) {
+      if (compaction_shutdown_) { return; }
+      std::lock_guard<std::recursive_mutex> lock(mutex_);
+      if (chunk_live_counts_[chunk_id] == 0) { break; }
+      batch_keys.clear();
+      for (; pos < num_chunk_keys && batch_keys.size() < kCompactionBatchSize; ++pos) {
+        uint64_t row_id = 0;
+        if (FindRowId(chunk_keys[pos], &row_id) && row_id == chunk_start_index + pos) {
+          batch_keys.push_back(chunk_keys[pos]);
+        }
+      }
+      if (batch_keys.empty()) { continue; }
+      uint32_t n_missing = 0;
+      Get(batch_keys.size(), batch_keys.data(), batch_values.data(), &n_missing,
+          missing_indices.data());
+      CHECK_EQ(n_missing, 0);
+      Put(batch_keys.size(), batch_keys.data(), batch_values.data());
+      num_compacted_values_ += batch_keys.size();
+    }
+  }
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  // A snapshot may have been taken while the live values were being moved.
+  if (chunk_live_counts_[chunk_id] != 0 || GetSnapshotChunks().count(chunk_id) != 0) { return; }
+  std::shared_ptr<ValueFileTable> value_files(new ValueFileTable(*value_files_));
+  value_files->at(chunk_id).reset();
+  std::atomic_store(&value_files_, std::shared_ptr<const ValueFileTable>(value_files));
+  PosixFile::RecursiveDelete(ValueFilePath(chunk_id));
+  PosixFile::RecursiveDelete(KeyFilePath(chunk_id));
+  num_reclaimed_chunks_ += 1;
+}
+
 template<typename Key, typename Engine>
 class SnapshotIteratorImpl : public PersistentTable::Iterator {
  public:
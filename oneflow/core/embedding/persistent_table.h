@@ -31,6 +31,17 @@ struct PersistentTableOptions {
   uint64_t capacity_hint = 0;
 };
 
+struct PersistentTableStats {
+  uint64_t num_keys = 0;
+  uint64_t num_value_slots = 0;
+  uint64_t num_value_chunks = 0;
+  uint64_t num_reclaimed_chunks = 0;
+  uint64_t num_compacted_values = 0;
+  // Fraction of the value slots on disk which are not referenced by any key, including the
+  // slots left behind by updated keys and the padding of partially filled blocks.
+  double dead_space_fraction = 0;
+};
+
 class PersistentTable {
  public:
   OF_DISALLOW_COPY_AND_MOVE(PersistentTable);
@@ -61,6 +72,7 @@ class PersistentTable {
                             const std::function<void(Iterator* iter)>& Hook) = 0;
   virtual void SaveSnapshot(const std::string& name) = 0;
   virtual Iterator* ReadSnapshot(const std::string& name) = 0;
+  virtual void GetStats(PersistentTableStats* stats) = 0;
 };
 
 std::unique_ptr<PersistentTable> NewPersistentTable(const PersistentTableOptions& options);
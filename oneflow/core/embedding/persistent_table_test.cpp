@@ -0,0 +1,322 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/embedding/persistent_table.h"
+#include <gtest/gtest.h>
+#include <numeric>
+#include <chrono>
+#include <random>
+#include <thread>
+#include "oneflow/core/embedding/posix_file.h"
+
+namespace oneflow {
+
+namespace embedding {
+
+namespace {
+
+#ifdef __linux__
+
+constexpr uint32_t kValueLength = 1024;
+
+std::string CreateTempDirectory() {
+  const char* tmp_env = getenv("TMPDIR");
+  const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
+  std::string tpl = std::string(tmp_dir) + "/test_persistent_table_XXXXXX";
+  char* path = mkdtemp(const_cast<char*>(tpl.c_str()));
+  PCHECK(path != nullptr);
+  return std::string(path);
+}
+
+PersistentTableOptions GetTableOptions(const std::string& path) {
+  PersistentTableOptions options{};
+  options.path = path;
+  options.key_size = sizeof(uint64_t);
+  options.value_size = kValueLength * sizeof(float);
+  options.physical_block_size = 4096;
+  // 256 values per chunk
+  options.target_chunk_size_mb = 1;
+  return options;
+}
+
+float ValueOf(uint64_t key, uint32_t version, uint32_t i) {
+  return static_cast<float>(key * 1000 + version * 10 + i % 10);
+}
+
+void MakeValues(const std::vector<uint64_t>& keys, uint32_t version, std::vector<float>* values) {
+  values->resize(keys.size() * kValueLength);
+  for (size_t k = 0; k < keys.size(); ++k) {
+    for (uint32_t i = 0; i < kValueLength; ++i) {
+      values->at(k * kValueLength + i) = ValueOf(keys.at(k), version, i);
+    }
+  }
+}
+
+std::vector<uint64_t> KeyRange(uint64_t begin, uint64_t end) {
+  std::vector<uint64_t> keys(end - begin);
+  std::iota(keys.begin(), keys.end(), begin);
+  return keys;
+}
+
+void PutKeys(PersistentTable* table, const std::vector<uint64_t>& keys, uint32_t version) {
+  std::vector<float> values;
+  MakeValues(keys, version, &values);
+  table->Put(keys.size(), keys.data(), values.data());
+}
+
+// Checks that every key is found with the value of its version.
+void CheckKeys(PersistentTable* table, const std::vector<uint64_t>& keys,
+               const std::function<uint32_t(uint64_t)>& Version4Key) {
+  std::vector<float> values(keys.size() * kValueLength);
+  std::vector<uint32_t> missing_indices(keys.size());
+  uint32_t n_missing = 0;
+  table->Get(keys.size(), keys.data(), values.data(), &n_missing, missing_indices.data());
+  ASSERT_EQ(n_missing, 0);
+  for (size_t k = 0; k < keys.size(); ++k) {
+    const uint32_t version = Version4Key(keys.at(k));
+    for (uint32_t i = 0; i < kValueLength; ++i) {
+      ASSERT_EQ(values.at(k * kValueLength + i), ValueOf(keys.at(k), version, i));
+    }
+  }
+}
+
+// Checks that none of the keys are found.
+void CheckMissingKeys(PersistentTable* table, const std::vector<uint64_t>& keys) {
+  std::vector<float> values(keys.size() * kValueLength);
+  std::vector<uint32_t> missing_indices(keys.size());
+  uint32_t n_missing = 0;
+  table->Get(keys.size(), keys.data(), values.data(), &n_missing, missing_indices.data());
+  ASSERT_EQ(n_missing, keys.size());
+}
+
+std::string SnapshotIndexPath(const std::string& path, const std::string& name) {
+  return PosixFile::JoinPath(PosixFile::JoinPath(PosixFile::JoinPath(path, "snapshots"), name),
+                             "INDEX");
+}
+
+// Saves a snapshot of keys [0, 1024) with every third key updated, and changes the table after
+// the snapshot was taken.
+void SaveTestSnapshot(const std::string& path, const std::string& name) {
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(GetTableOptions(path));
+  PutKeys(table.get(), KeyRange(0, 1024), 0);
+  std::vector<uint64_t> updated_keys;
+  for (uint64_t key = 0; key < 1024; key += 3) { updated_keys.push_back(key); }
+  PutKeys(table.get(), updated_keys, 1);
+  table->SaveSnapshot(name);
+  ASSERT_TRUE(PosixFile::FileExists(SnapshotIndexPath(path, name)));
+  PutKeys(table.get(), KeyRange(512, 2048), 2);
+}
+
+uint32_t TestSnapshotVersion4Key(uint64_t key) { return key % 3 == 0 ? 1 : 0; }
+
+// Loads the snapshot saved by SaveTestSnapshot into a new table and checks it.
+void CheckTestSnapshot(const std::string& path, const std::string& name) {
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(GetTableOptions(path));
+  ASSERT_TRUE(table->SnapshotExists(name));
+  table->LoadSnapshot(name);
+  CheckKeys(table.get(), KeyRange(0, 1024), TestSnapshotVersion4Key);
+  CheckMissingKeys(table.get(), KeyRange(1024, 2048));
+  PersistentTableStats stats;
+  table->GetStats(&stats);
+  ASSERT_EQ(stats.num_keys, 1024);
+  // Keys put after the load take precedence over the snapshot.
+  PutKeys(table.get(), KeyRange(1000, 1100), 3);
+  const auto Version4Key = [](uint64_t key) {
+    return key >= 1000 ? 3 : TestSnapshotVersion4Key(key);
+  };
+  CheckKeys(table.get(), KeyRange(0, 1100), Version4Key);
+  table->GetStats(&stats);
+  ASSERT_EQ(stats.num_keys, 1100);
+  // A snapshot of the loaded table holds the keys of both indexes.
+  table->SaveSnapshot(name + "-next");
+  table.reset();
+  table = NewPersistentTable(GetTableOptions(path));
+  table->LoadSnapshot(name + "-next");
+  CheckKeys(table.get(), KeyRange(0, 1100), Version4Key);
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+#ifdef __linux__
+
+TEST(PersistentTable, ConcurrentGetPut) {
+  const std::string path = CreateTempDirectory();
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(GetTableOptions(path));
+  const uint64_t num_keys = 8192;
+  const uint64_t put_batch_size = 32;
+  const uint64_t read_ahead = 256;
+  // Keys below num_published_keys have been put. Every key is put once, so its value does not
+  // change while new chunks are added.
+  std::atomic<uint64_t> num_published_keys(0);
+  std::thread writer([&]() {
+    for (uint64_t begin = 0; begin < num_keys; begin += put_batch_size) {
+      PutKeys(table.get(), KeyRange(begin, begin + put_batch_size), 0);
+      num_published_keys = begin + put_batch_size;
+    }
+  });
+  std::vector<std::thread> readers;
+  std::atomic<uint64_t> num_checked_batches(0);
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&, t]() {
+      std::mt19937 gen(t);
+      while (true) {
+        const uint64_t published = num_published_keys;
+        // The batch ends past the published keys, so keys put while the batch is read may be found
+        // in a chunk added after the Get loaded the value file table.
+        const uint64_t end = std::min(published + read_ahead, num_keys);
+        const uint64_t begin = end - std::min<uint64_t>(end, read_ahead + gen() % 512);
+        const std::vector<uint64_t> keys = KeyRange(begin, end);
+        std::vector<float> values(keys.size() * kValueLength);
+        std::vector<uint32_t> missing_indices(keys.size());
+        uint32_t n_missing = 0;
+        table->Get(keys.size(), keys.data(), values.data(), &n_missing, missing_indices.data());
+        std::vector<bool> missing(keys.size());
+        for (uint32_t i = 0; i < n_missing; ++i) {
+          ASSERT_GE(keys.at(missing_indices.at(i)), published);
+          missing.at(missing_indices.at(i)) = true;
+        }
+        for (size_t k = 0; k < keys.size(); ++k) {
+          if (missing.at(k)) { continue; }
+          ASSERT_EQ(values.at(k * kValueLength), ValueOf(keys.at(k), 0, 0));
+        }
+        num_checked_batches += 1;
+        if (published == num_keys) { break; }
+      }
+    });
+  }
+  writer.join();
+  for (auto& reader : readers) { reader.join(); }
+  ASSERT_GT(num_checked_batches, 0);
+  CheckKeys(table.get(), KeyRange(0, num_keys), [](uint64_t) { return 0; });
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, GetStats) {
+  const std::string path = CreateTempDirectory();
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(GetTableOptions(path));
+  PersistentTableStats stats;
+  table->GetStats(&stats);
+  ASSERT_EQ(stats.num_keys, 0);
+  ASSERT_EQ(stats.num_value_slots, 0);
+  ASSERT_EQ(stats.num_value_chunks, 0);
+  ASSERT_EQ(stats.dead_space_fraction, 0);
+  PutKeys(table.get(), KeyRange(0, 512), 0);
+  PutKeys(table.get(), KeyRange(0, 128), 1);
+  table->GetStats(&stats);
+  ASSERT_EQ(stats.num_keys, 512);
+  ASSERT_EQ(stats.num_value_slots, 640);
+  ASSERT_EQ(stats.num_value_chunks, 3);
+  ASSERT_EQ(stats.num_reclaimed_chunks, 0);
+  ASSERT_EQ(stats.num_compacted_values, 0);
+  ASSERT_DOUBLE_EQ(stats.dead_space_fraction, 1.0 - 512.0 / 640.0);
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, Compaction) {
+  setenv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_ENABLE_COMPACTION", "1", 1);
+  setenv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_COMPACTION_INTERVAL_MS", "10", 1);
+  const std::string path = CreateTempDirectory();
+  std::unique_ptr<PersistentTable> table = NewPersistentTable(GetTableOptions(path));
+  unsetenv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_ENABLE_COMPACTION");
+  unsetenv("ONEFLOW_ONE_EMBEDDING_PERSISTENT_TABLE_COMPACTION_INTERVAL_MS");
+  const std::vector<uint64_t> keys = KeyRange(0, 1024);
+  const auto Version4Key = [](uint64_t key) -> uint32_t { return key % 4 == 0 ? 0 : 1; };
+  // Chunks 0 to 3 hold the first version of every key. Updating three of every four keys leaves
+  // a quarter of them live, chunks 4 to 6 hold the updates and chunk 6 is the tail.
+  PutKeys(table.get(), keys, 0);
+  std::vector<uint64_t> updated_keys;
+  for (const uint64_t key : keys) {
+    if (Version4Key(key) == 1) { updated_keys.push_back(key); }
+  }
+  PutKeys(table.get(), updated_keys, 1);
+  PersistentTableStats stats;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (true) {
+    table->GetStats(&stats);
+    if (stats.num_reclaimed_chunks >= 4) { break; }
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  CheckKeys(table.get(), keys, Version4Key);
+  table->GetStats(&stats);
+  ASSERT_EQ(stats.num_keys, keys.size());
+  ASSERT_EQ(stats.num_reclaimed_chunks, 4);
+  ASSERT_EQ(stats.num_compacted_values, keys.size() / 4);
+  ASSERT_EQ(stats.num_value_chunks, 4);
+  ASSERT_EQ(stats.num_value_slots, keys.size());
+  ASSERT_DOUBLE_EQ(stats.dead_space_fraction, 0);
+  // A snapshot taken after the compaction refers to the moved values.
+  table->SaveSnapshot("compacted");
+  table.reset();
+  table = NewPersistentTable(GetTableOptions(path));
+  table->LoadSnapshot("compacted");
+  CheckKeys(table.get(), keys, Version4Key);
+  table.reset();
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, SnapshotIndex) {
+  const std::string path = CreateTempDirectory();
+  SaveTestSnapshot(path, "snapshot");
+  CheckTestSnapshot(path, "snapshot");
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, TruncatedSnapshotIndex) {
+  const std::string path = CreateTempDirectory();
+  SaveTestSnapshot(path, "snapshot");
+  const std::string index_path = SnapshotIndexPath(path, "snapshot");
+  {
+    PosixFile index_file(index_path, O_RDWR, 0644);
+    index_file.Truncate(index_file.Size() / 2);
+  }
+  // The snapshot is rebuilt from the index files of its chunks.
+  CheckTestSnapshot(path, "snapshot");
+  {
+    PosixFile index_file(index_path, O_RDWR, 0644);
+    index_file.Truncate(8);
+  }
+  CheckTestSnapshot(path, "snapshot");
+  PosixFile::RecursiveDelete(path);
+}
+
+TEST(PersistentTable, CorruptSnapshotIndex) {
+  const std::string path = CreateTempDirectory();
+  SaveTestSnapshot(path, "snapshot");
+  const std::string index_path = SnapshotIndexPath(path, "snapshot");
+  // The header is the magic, the key size, the capacity and the number of keys.
+  const auto OverwriteHeaderField = [&](int field, uint64_t value) {
+    PosixFile index_file(index_path, O_RDWR, 0644);
+    PCHECK(pwrite(index_file.fd(), &value, sizeof(value), field * sizeof(uint64_t))
+           == sizeof(value));
+  };
+  OverwriteHeaderField(3, 1023);
+  CheckTestSnapshot(path, "snapshot");
+  OverwriteHeaderField(2, 1);
+  CheckTestSnapshot(path, "snapshot");
+  OverwriteHeaderField(0, 0);
+  CheckTestSnapshot(path, "snapshot");
+  PosixFile::RecursiveDelete(path);
+}
+
+#endif  // __linux__
+
+}  // namespace embedding
+
+}  // namespace oneflow
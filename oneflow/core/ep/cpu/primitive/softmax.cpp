@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/ep/include/primitive/softmax.h"
 #include "oneflow/core/ep/include/primitive/log_softmax.h"
 #include "oneflow/core/ep/cpu/primitive/type_seq.h"
+#include "oneflow/core/ep/cpu/primitive/softmax_util.h"
 #include "oneflow/core/ep/cpu/cpu_stream.h"
 #include "oneflow/core/ep/cpu/cpu_device.h"
 #include "oneflow/core/ep/common/primitive/util.h"
@@ -33,38 +34,126 @@ enum class Algorithm {
   kLogSoftmax,
 };
 
+template<typename T>
+void SoftmaxRowMaxAndSum(size_t cols, const T* row_x, T* row_max, T* row_sum) {
+  const size_t num_packed_cols = cols / softmax::kPackSize * softmax::kPackSize;
+  T lane_max[softmax::kPackSize];
+  T lane_sum[softmax::kPackSize];
+  for (size_t i = 0; i < softmax::kPackSize; ++i) {
+    lane_max[i] = std::numeric_limits<T>::lowest();
+    lane_sum[i] = 0;
+  }
+  // Online softmax: every lane keeps a running max and a sum rescaled to that max.
+  for (size_t j = 0; j < num_packed_cols; j += softmax::kPackSize) {
+    for (size_t i = 0; i < softmax::kPackSize; ++i) {
+      const T x = row_x[j + i];
+      const T new_max = std::max(lane_max[i], x);
+      lane_sum[i] = lane_sum[i] * softmax::Exp<T>::Compute(lane_max[i] - new_max)
+                    + softmax::Exp<T>::Compute(x - new_max);
+      lane_max[i] = new_max;
+    }
+  }
+  T max = std::numeric_limits<T>::lowest();
+  for (size_t i = 0; i < softmax::kPackSize; ++i) { max = std::max(max, lane_max[i]); }
+  for (size_t j = num_packed_cols; j < cols; ++j) { max = std::max(max, row_x[j]); }
+  T sum = 0;
+  for (size_t i = 0; i < softmax::kPackSize; ++i) {
+    sum += lane_sum[i] * softmax::Exp<T>::Compute(lane_max[i] - max);
+  }
+  for (size_t j = num_packed_cols; j < cols; ++j) {
+    sum += softmax::Exp<T>::Compute(row_x[j] - max);
+  }
+  *row_max = max;
+  *row_sum = sum;
+}
+
+template<typename T>
+T SoftmaxRowMax(size_t cols, const T* row_x) {
+  const size_t num_packed_cols = cols / softmax::kPackSize * softmax::kPackSize;
+  T lane_max[softmax::kPackSize];
+  for (size_t i = 0; i < softmax::kPackSize; ++i) {
+    lane_max[i] = std::numeric_limits<T>::lowest();
+  }
+  for (size_t j = 0; j < num_packed_cols; j += softmax::kPackSize) {
+    for (size_t i = 0; i < softmax::kPackSize; ++i) {
+      lane_max[i] = std::max(lane_max[i], row_x[j + i]);
+    }
+  }
+  T max = std::numeric_limits<T>::lowest();
+  for (size_t i = 0; i < softmax::kPackSize; ++i) { max = std::max(max, lane_max[i]); }
+  for (size_t j = num_packed_cols; j < cols; ++j) { max = std::max(max, row_x[j]); }
+  return max;
+}
+
+// Writes exp(x - row_max) to row_y when store_exp is true, and returns the sum of them.
+template<typename T, bool store_exp>
+T SoftmaxRowExpSum(size_t cols, const T* row_x, T row_max, T* row_y) {
+  const size_t num_packed_cols = cols / softmax::kPackSize * softmax::kPackSize;
+  T lane_sum[softmax::kPackSize];
+  for (size_t i = 0; i < softmax::kPackSize; ++i) { lane_sum[i] = 0; }
+  for (size_t j = 0; j < num_packed_cols; j += softmax::kPackSize) {
+    for (size_t i = 0; i < softmax::kPackSize; ++i) {
+      const T exp_x = softmax::Exp<T>::Compute(row_x[j + i] - row_max);
+      if (store_exp) { row_y[j + i] = exp_x; }
+      lane_sum[i] += exp_x;
+    }
+  }
+  T sum = 0;
+  for (size_t i = 0; i < softmax::kPackSize; ++i) { sum += lane_sum[i]; }
+  for (size_t j = num_packed_cols; j < cols; ++j) {
+    const T exp_x = softmax::Exp<T>::Compute(row_x[j] - row_max);
+    if (store_exp) { row_y[j] = exp_x; }
+    sum += exp_x;
+  }
+  return sum;
+}
+
 template<Algorithm algorithm, typename T>
-void SoftmaxCpu(size_t rows, size_t cols, const T* x, T* y) {
-  for (size_t i = 0; i < rows; ++i) {
-    size_t row_offset = i * cols;
-    const T* row_x = x + row_offset;
-    T* row_y = y + row_offset;
-    const T row_max = *std::max_element(row_x, row_x + cols);
-    T row_sum = 0;
-    for (size_t j = 0; j < cols; ++j) {
-      if (algorithm == Algorithm::kSoftmax) {
-        T exp_x = std::exp(row_x[j] - row_max);
-        row_sum += exp_x;
-        row_y[j] = exp_x;
-      } else if (algorithm == Algorithm::kLogSoftmax) {
-        row_y[j] = row_x[j] - row_max;
-        row_sum += std::exp(row_y[j]);
-      } else {
-        UNIMPLEMENTED();
+void SoftmaxRow(size_t cols, const T* row_x, T* row_y) {
+  if (cols >= softmax::kOnlineSoftmaxMinCols) {
+    T row_max;
+    T row_sum;
+    SoftmaxRowMaxAndSum<T>(cols, row_x, &row_max, &row_sum);
+    if (algorithm == Algorithm::kSoftmax) {
+      const T inv_row_sum = static_cast<T>(1) / row_sum;
+      for (size_t j = 0; j < cols; ++j) {
+        row_y[j] = softmax::Exp<T>::Compute(row_x[j] - row_max) * inv_row_sum;
       }
+    } else if (algorithm == Algorithm::kLogSoftmax) {
+      const T row_shift = row_max + std::log(row_sum);
+      for (size_t j = 0; j < cols; ++j) { row_y[j] = row_x[j] - row_shift; }
+    } else {
+      UNIMPLEMENTED();
     }
-    for (size_t j = 0; j < cols; ++j) {
-      if (algorithm == Algorithm::kSoftmax) {
-        row_y[j] /= row_sum;
-      } else if (algorithm == Algorithm::kLogSoftmax) {
-        row_y[j] -= std::log(row_sum);
-      } else {
-        UNIMPLEMENTED();
-      }
+  } else {
+    const T row_max = SoftmaxRowMax<T>(cols, row_x);
+    if (algorithm == Algorithm::kSoftmax) {
+      const T inv_row_sum =
+          static_cast<T>(1) / SoftmaxRowExpSum<T, true>(cols, row_x, row_max, row_y);
+      for (size_t j = 0; j < cols; ++j) { row_y[j] *= inv_row_sum; }
+    } else if (algorithm == Algorithm::kLogSoftmax) {
+      const T row_sum = SoftmaxRowExpSum<T, false>(cols, row_x, row_max, row_y);
+      const T row_shift = row_max + std::log(row_sum);
+      for (size_t j = 0; j < cols; ++j) { row_y[j] = row_x[j] - row_shift; }
+    } else {
+      UNIMPLEMENTED();
     }
   }
 }
 
+template<Algorithm algorithm, typename T>
+void SoftmaxCpu(Stream* stream, size_t rows, size_t cols, const T* x, T* y) {
+  stream->As<CpuStream>()->ParallelFor(
+      0, rows,
+      [cols, x, y](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const size_t row_offset = i * cols;
+          SoftmaxRow<algorithm, T>(cols, x + row_offset, y + row_offset);
+        }
+      },
+      softmax::GetRowGrainSize(cols));
+}
+
 template<typename SoftmaxBase, Algorithm algorithm, typename T>
 class SoftmaxImpl : public SoftmaxBase {
  public:
@@ -73,7 +162,8 @@ class SoftmaxImpl : public SoftmaxBase {
   ~SoftmaxImpl() override = default;
 
   void Launch(Stream* stream, size_t rows, size_t cols, const void* x, void* y) override {
-    SoftmaxCpu<algorithm, T>(rows, cols, reinterpret_cast<const T*>(x), reinterpret_cast<T*>(y));
+    SoftmaxCpu<algorithm, T>(stream, rows, cols, reinterpret_cast<const T*>(x),
+                             reinterpret_cast<T*>(y));
   }
 };
 
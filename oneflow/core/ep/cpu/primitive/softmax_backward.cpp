@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/ep/include/primitive/softmax_backward.h"
 #include "oneflow/core/ep/include/primitive/log_softmax_backward.h"
 #include "oneflow/core/ep/cpu/primitive/type_seq.h"
+#include "oneflow/core/ep/cpu/primitive/softmax_util.h"
 #include "oneflow/core/ep/cpu/cpu_stream.h"
 #include "oneflow/core/ep/cpu/cpu_device.h"
 #include "oneflow/core/ep/common/onednn.h"
@@ -34,32 +35,56 @@ enum class Algorithm {
 };
 
 template<Algorithm algorithm, typename T>
-void SoftmaxBackwardCpu(size_t rows, size_t cols, const T* y, const T* dy, T* dx) {
-  for (size_t i = 0; i < rows; ++i) {
-    size_t row_offset = i * cols;
-    const T* row_y = y + row_offset;
-    const T* row_dy = dy + row_offset;
-    T* row_dx = dx + row_offset;
-    T row_sum = 0;
-    for (size_t j = 0; j < cols; ++j) {
+void SoftmaxBackwardRow(size_t cols, const T* row_y, const T* row_dy, T* row_dx) {
+  const size_t num_packed_cols = cols / softmax::kPackSize * softmax::kPackSize;
+  T lane_sum[softmax::kPackSize];
+  for (size_t i = 0; i < softmax::kPackSize; ++i) { lane_sum[i] = 0; }
+  for (size_t j = 0; j < num_packed_cols; j += softmax::kPackSize) {
+    for (size_t i = 0; i < softmax::kPackSize; ++i) {
       if (algorithm == Algorithm::kSoftmax) {
-        row_sum += row_y[j] * row_dy[j];
+        lane_sum[i] += row_y[j + i] * row_dy[j + i];
       } else if (algorithm == Algorithm::kLogSoftmax) {
-        row_sum += row_dy[j];
+        lane_sum[i] += row_dy[j + i];
       } else {
         UNIMPLEMENTED();
       }
     }
-    for (size_t j = 0; j < cols; ++j) {
-      if (algorithm == Algorithm::kSoftmax) {
-        row_dx[j] = (row_dy[j] - row_sum) * row_y[j];
-      } else if (algorithm == Algorithm::kLogSoftmax) {
-        row_dx[j] = row_dy[j] - std::exp(row_y[j]) * row_sum;
-      } else {
-        UNIMPLEMENTED();
-      }
+  }
+  T row_sum = 0;
+  for (size_t i = 0; i < softmax::kPackSize; ++i) { row_sum += lane_sum[i]; }
+  for (size_t j = num_packed_cols; j < cols; ++j) {
+    if (algorithm == Algorithm::kSoftmax) {
+      row_sum += row_y[j] * row_dy[j];
+    } else if (algorithm == Algorithm::kLogSoftmax) {
+      row_sum += row_dy[j];
+    } else {
+      UNIMPLEMENTED();
     }
   }
+  for (size_t j = 0; j < cols; ++j) {
+    if (algorithm == Algorithm::kSoftmax) {
+      row_dx[j] = (row_dy[j] - row_sum) * row_y[j];
+    } else if (algorithm == Algorithm::kLogSoftmax) {
+      row_dx[j] = row_dy[j] - softmax::Exp<T>::Compute(row_y[j]) * row_sum;
+    } else {
+      UNIMPLEMENTED();
+    }
+  }
+}
+
+template<Algorithm algorithm, typename T>
+void SoftmaxBackwardCpu(Stream* stream, size_t rows, size_t cols, const T* y, const T* dy,
+                        T* dx) {
+  stream->As<CpuStream>()->ParallelFor(
+      0, rows,
+      [cols, y, dy, dx](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const size_t row_offset = i * cols;
+          SoftmaxBackwardRow<algorithm, T>(cols, y + row_offset, dy + row_offset,
+                                           dx + row_offset);
+        }
+      },
+      softmax::GetRowGrainSize(cols));
 }
 
 template<typename SoftmaxBackwardBase, Algorithm algorithm, typename T>
@@ -71,7 +96,7 @@ class SoftmaxBackwardImpl : public SoftmaxBackwardBase {
 
   void Launch(Stream* stream, size_t rows, size_t cols, const void* y, const void* dy,
               void* dx) override {
-    SoftmaxBackwardCpu<algorithm, T>(rows, cols, reinterpret_cast<const T*>(y),
+    SoftmaxBackwardCpu<algorithm, T>(stream, rows, cols, reinterpret_cast<const T*>(y),
                                      reinterpret_cast<const T*>(dy), reinterpret_cast<T*>(dx));
   }
 };
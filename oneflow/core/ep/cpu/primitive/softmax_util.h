@@ -0,0 +1,90 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_CPU_PRIMITIVE_SOFTMAX_UTIL_H_
+#define ONEFLOW_CORE_EP_CPU_PRIMITIVE_SOFTMAX_UTIL_H_
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace oneflow {
+
+namespace ep {
+namespace primitive {
+
+namespace softmax {
+
+// Rows are walked in packs of kPackSize columns and every lane of the pack keeps its own
+// partial result, so the inner loops carry no dependence between lanes and get vectorized.
+constexpr size_t kPackSize = 8;
+// Number of elements a single ParallelFor task should process at least.
+constexpr size_t kParallelGrainElems = 32768;
+// Rows at least this wide are computed with the online (single pass max and sum) algorithm,
+// which reads the row twice instead of three times.
+constexpr size_t kOnlineSoftmaxMinCols = 4096;
+
+inline size_t GetRowGrainSize(size_t cols) {
+  return std::max<size_t>(1, kParallelGrainElems / std::max<size_t>(cols, 1));
+}
+
+template<typename T>
+struct Exp {
+  static inline T Compute(T x) { return std::exp(x); }
+};
+
+// Polynomial approximation of exp for float (Cephes expf), written branch free so that it is
+// vectorized when inlined into a loop. Relative error is within 2 ulp on the clamped range.
+// Inputs below the range, -inf included, give 0 and NaN is passed through like std::exp, so
+// masked (-inf) columns and fully masked rows come out the same as with the scalar kernels.
+template<>
+struct Exp<float> {
+  static inline float Compute(float in) {
+    constexpr float kExpHi = 88.3762626647949f;
+    constexpr float kExpLo = -87.3365447504019f;
+    constexpr float kLog2e = 1.44269504088896341f;
+    constexpr float kLn2Hi = 0.693359375f;
+    constexpr float kLn2Lo = -2.12194440e-4f;
+    // std::max(kExpLo, in) rather than std::max(in, kExpLo) so that NaN is clamped as well.
+    const float x = std::min(std::max(kExpLo, in), kExpHi);
+    const float fx = x * kLog2e + 0.5f;
+    int32_t n = static_cast<int32_t>(fx);
+    n -= static_cast<int32_t>(static_cast<float>(n) > fx);
+    const float fn = static_cast<float>(n);
+    const float r = x - fn * kLn2Hi - fn * kLn2Lo;
+    float p = 1.9875691500E-4f;
+    p = p * r + 1.3981999507E-3f;
+    p = p * r + 8.3334519073E-3f;
+    p = p * r + 4.1665795894E-2f;
+    p = p * r + 1.6666665459E-1f;
+    p = p * r + 5.0000001201E-1f;
+    p = p * r * r + r + 1.0f;
+    const int32_t pow2n_bits = (n + 127) << 23;
+    float pow2n;
+    std::memcpy(&pow2n, &pow2n_bits, sizeof(float));
+    const float out = in < kExpLo ? 0.0f : p * pow2n;
+    return in != in ? in : out;
+  }
+};
+
+}  // namespace softmax
+
+}  // namespace primitive
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_CPU_PRIMITIVE_SOFTMAX_UTIL_H_
@@ -138,6 +138,18 @@ TEST_F(PrimitiveTest, TestSoftmaxBackward) {
   }
 }
 
+// Row lengths around the vectorized lanes, and enough rows to be split over several tasks.
+TEST_F(PrimitiveTest, TestSoftmaxBackwardRowsAndLanes) {
+  std::vector<int> num_rows = {1, 3, 1000};
+  std::vector<int> num_cols = {1, 7, 8, 9, 17, 4100};
+  for (int i = 0; i < num_rows.size(); ++i) {
+    for (int j = 0; j < num_cols.size(); ++j) {
+      TestSoftmaxBackward(&device_manager_registry_, available_device_types_, num_rows.at(i),
+                          num_cols.at(j));
+    }
+  }
+}
+
 }  // namespace test
 
 }  // namespace primitive
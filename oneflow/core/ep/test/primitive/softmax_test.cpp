@@ -20,6 +20,7 @@ limitations under the License.
 #include "oneflow/core/ep/include/primitive/softmax.h"
 #include "oneflow/core/ep/include/primitive/log_softmax.h"
 #include <unsupported/Eigen/CXX11/Tensor>
+#include <random>
 
 namespace oneflow {
 
@@ -107,11 +108,92 @@ void TestSoftmax(DeviceManagerRegistry* registry, const std::set<DeviceType>& de
   TestSoftmax<DataType::kFloat16, Eigen::half>(registry, device_types, num_rows, num_cols, false);
 }
 
+// Every third column of each row is masked with -inf, and so is all of row 0.
+void TestMaskedSoftmax(DeviceManagerRegistry* registry, const std::set<DeviceType>& device_types,
+                       int num_rows, int num_cols, bool log_softmax) {
+  const int elem_cnt = num_rows * num_cols;
+  const int data_size = elem_cnt * sizeof(float);
+  const float inf = std::numeric_limits<float>::infinity();
+  const auto IsMasked = [&](int row, int col) { return row == 0 || col % 3 == 0; };
+  std::vector<float> softmax_in(elem_cnt);
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-10, 10);
+  for (int i = 0; i < elem_cnt; ++i) {
+    softmax_in.at(i) = IsMasked(i / num_cols, i % num_cols) ? -inf : dist(gen);
+  }
+  std::vector<double> softmax_out(elem_cnt);
+  for (int row = 1; row < num_rows; ++row) {
+    const float* row_in = softmax_in.data() + row * num_cols;
+    const double max = *std::max_element(row_in, row_in + num_cols);
+    double sum = 0;
+    for (int col = 0; col < num_cols; ++col) { sum += std::exp(row_in[col] - max); }
+    for (int col = 0; col < num_cols; ++col) {
+      softmax_out.at(row * num_cols + col) = log_softmax ? row_in[col] - max - std::log(sum)
+                                                         : std::exp(row_in[col] - max) / sum;
+    }
+  }
+
+  for (const auto& device_type : device_types) {
+    auto device = registry->GetDevice(device_type, 0);
+    ep::test::PinnedMemoryGuard input(device.get(), data_size);
+    ep::test::PinnedMemoryGuard output(device.get(), data_size);
+    std::memcpy(input.ptr(), softmax_in.data(), data_size);
+    ep::test::DeviceMemoryGuard device_in(device.get(), data_size);
+    ep::test::DeviceMemoryGuard device_out(device.get(), data_size);
+    ep::test::StreamGuard stream(device.get());
+    std::unique_ptr<Memcpy> h2d = NewPrimitive<MemcpyFactory>(device_type, MemcpyKind::kHtoD);
+    ASSERT_TRUE(h2d.operator bool());
+    std::unique_ptr<Memcpy> d2h = NewPrimitive<MemcpyFactory>(device_type, MemcpyKind::kDtoH);
+    ASSERT_TRUE(d2h.operator bool());
+    h2d->Launch(stream.stream(), device_in.ptr(), input.ptr(), data_size);
+    if (log_softmax) {
+      std::unique_ptr<LogSoftmax> log_softmax =
+          NewPrimitive<LogSoftmaxFactory>(device_type, DataType::kFloat);
+      ASSERT_TRUE(log_softmax.operator bool());
+      log_softmax->Launch(stream.stream(), num_rows, num_cols, device_in.ptr(), device_out.ptr());
+    } else {
+      std::unique_ptr<Softmax> softmax =
+          NewPrimitive<SoftmaxFactory>(device_type, DataType::kFloat);
+      ASSERT_TRUE(softmax.operator bool());
+      softmax->Launch(stream.stream(), num_rows, num_cols, device_in.ptr(), device_out.ptr());
+    }
+    d2h->Launch(stream.stream(), output.ptr(), device_out.ptr(), data_size);
+    CHECK_JUST(stream.stream()->Sync());
+    const float* of_out = output.ptr<float>();
+    for (int i = 0; i < elem_cnt; ++i) {
+      const int row = i / num_cols;
+      if (row == 0) {
+        // Nothing is left to normalize over.
+        if (device_type == DeviceType::kCPU) { ASSERT_TRUE(std::isnan(of_out[i])) << i; }
+      } else if (IsMasked(row, i % num_cols)) {
+        if (log_softmax) {
+          ASSERT_EQ(of_out[i], -inf) << i;
+        } else {
+          ASSERT_EQ(of_out[i], 0) << i;
+        }
+      } else {
+        ASSERT_NEAR(of_out[i], softmax_out.at(i), 1e-4) << i;
+      }
+    }
+  }
+}
+
 }  // namespace
 
+TEST_F(PrimitiveTest, TestMaskedSoftmax) {
+  // Rows for the vectorized lanes and the tail, and for the online algorithm.
+  std::vector<int> num_cols = {7, 40, 4100};
+  for (int j = 0; j < num_cols.size(); ++j) {
+    for (bool log_softmax : {false, true}) {
+      TestMaskedSoftmax(&device_manager_registry_, available_device_types_, 5, num_cols.at(j),
+                        log_softmax);
+    }
+  }
+}
+
 TEST_F(PrimitiveTest, TestSoftmax) {
   std::vector<int> num_rows = {32, 33, 512, 511};
-  std::vector<int> num_cols = {15, 16, 32, 768, 1536};
+  std::vector<int> num_cols = {15, 16, 32, 768, 1536, 4100};
   for (int i = 0; i < num_rows.size(); ++i) {
     for (int j = 0; j < num_cols.size(); ++j) {
       TestSoftmax(&device_manager_registry_, available_device_types_, num_rows.at(i),
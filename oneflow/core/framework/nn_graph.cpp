@@ -28,6 +28,7 @@ limitations under the License.
 #include "oneflow/core/framework/tensor_name_scope.h"
 #include "oneflow/core/functional/functional.h"
 #include "oneflow/core/graph/op_graph.h"
+#include "oneflow/core/job/compiled_plan_cache.h"
 #include "oneflow/core/job/compiler.h"
 #include "oneflow/core/job/job_build_and_infer_ctx_mgr.h"
 #include "oneflow/core/job/job_desc.h"
@@ -37,6 +38,7 @@ limitations under the License.
 #include "oneflow/core/job/plan_util.h"
 #include "oneflow/core/job_rewriter/job_completer.h"
 #include "oneflow/core/persistence/tee_persistent_log_stream.h"
+#include "oneflow/core/thread/thread_manager.h"
 #include "oneflow/core/vm/virtual_machine.h"
 #include "oneflow/core/vm/vm_util.h"
 #include "oneflow/core/profiler/profiler.h"
@@ -284,39 +286,70 @@ Maybe<void> NNGraph::CompileAndInitRuntime() {
 
   if (GlobalProcessCtx::IsThisProcessMaster()) {
     double start = GetCurTime();
-    // TODO(chengcheng): new memory reused by chunk
-    Compiler().Compile(&job_, &plan_);
-    PlanUtil::GenMemBlockAndChunkWithVariableOpNames4Plan(&plan_, variable_op_names_);
-
-    VLOG(1) << "Graph name: " << name_ << " compile time: " << (GetCurTime() - start) / 1000000000.0
-            << " seconds.";
-    if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
-      TeePersistentLogStream::Create("job_" + name_ + "_plan")->Write(plan_);
-      PlanUtil::ToDotFile(plan_, "job_" + name_ + "_plan.dot");
+    std::unique_ptr<CompiledPlanCache> plan_cache;
+    if (CompiledPlanCache::IsEnabled()) {
+      plan_cache.reset(new CompiledPlanCache(CompiledPlanCache::CacheDir(), job_, job_id_,
+                                             variable_op_names_));
+    }
+    if (plan_cache && plan_cache->TryLoad(&plan_)) {
+      VLOG(1) << "Graph name: " << name_ << " load plan from cache time: "
+              << (GetCurTime() - start) / 1000000000.0 << " seconds.";
+    } else {
+      // TODO(chengcheng): new memory reused by chunk
+      Compiler().Compile(&job_, &plan_);
+      PlanUtil::GenMemBlockAndChunkWithVariableOpNames4Plan(&plan_, variable_op_names_);
+
+      VLOG(1) << "Graph name: " << name_
+              << " compile time: " << (GetCurTime() - start) / 1000000000.0 << " seconds.";
+      if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
+        TeePersistentLogStream::Create("job_" + name_ + "_plan")->Write(plan_);
+        PlanUtil::ToDotFile(plan_, "job_" + name_ + "_plan.dot");
+      }
+      PlanUtil::GenRegisterHint(&plan_);
+      // TODO(chengcheng): test collective boxing for multi-job.
+      PlanUtil::GenCollectiveBoxingPlan(&job_, &plan_);
+      // PlanUtil::SetForceInplaceMemBlock(&plan_); NOTE(chengcheng): only for ssp.
+      PlanUtil::DumpCtrlRegstInfoToPlan(&plan_);
+      if (plan_cache) { plan_cache->Save(plan_); }
     }
-    PlanUtil::GenRegisterHint(&plan_);
-    // TODO(chengcheng): test collective boxing for multi-job.
-    PlanUtil::GenCollectiveBoxingPlan(&job_, &plan_);
-    // PlanUtil::SetForceInplaceMemBlock(&plan_); NOTE(chengcheng): only for ssp.
-    PlanUtil::DumpCtrlRegstInfoToPlan(&plan_);
     PlanUtil::PlanMemoryLog(&plan_, name_);
     if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
       PlanUtil::GenLightPlan(&plan_, name_);
     }
   }
   if (GlobalProcessCtx::WorldSize() > 1) {
-    std::string plan_name = "plan:" + job_name();
+    const int64_t world_size = GlobalProcessCtx::WorldSize();
+    auto RankPlanName = [&](int64_t rank) {
+      return "plan:" + job_name() + ":" + std::to_string(rank);
+    };
     if (GlobalProcessCtx::IsThisProcessMaster()) {
-      // TODO(chengcheng): split plan for each rank.
-      Singleton<CtrlClient>::Get()->PushKV(plan_name, plan_);
+      // NOTE: Each rank only gets its own part of the plan, so neither the pushed bytes per rank
+      //     nor the memory held by each rank grow with the number of ranks.
+      double start = GetCurTime();
+      Plan master_plan;
+      MultiThreadLoop(world_size, [&](size_t rank) {
+        if (static_cast<int64_t>(rank) == GlobalProcessCtx::Rank()) {
+          PlanUtil::GenPlan4Rank(plan_, rank, &master_plan);
+        } else {
+          Plan rank_plan;
+          PlanUtil::GenPlan4Rank(plan_, rank, &rank_plan);
+          Singleton<CtrlClient>::Get()->PushKV(RankPlanName(rank), rank_plan);
+        }
+      });
+      plan_.Swap(&master_plan);
+      VLOG(1) << "Graph name: " << name_ << " split and push plan time: "
+              << (GetCurTime() - start) / 1000000000.0 << " seconds.";
     } else {
-      Singleton<CtrlClient>::Get()->PullKV(plan_name, &plan_);
+      Singleton<CtrlClient>::Get()->PullKV(RankPlanName(GlobalProcessCtx::Rank()), &plan_);
     }
     OF_SESSION_BARRIER();
     // NOTE(zwx): After barrier plan is synchronized between all ranks,
     //     then it can be cleared for saving mem.
     if (GlobalProcessCtx::IsThisProcessMaster()) {
-      Singleton<CtrlClient>::Get()->ClearKV(plan_name);
+      for (int64_t rank = 0; rank < world_size; ++rank) {
+        if (rank == GlobalProcessCtx::Rank()) { continue; }
+        Singleton<CtrlClient>::Get()->ClearKV(RankPlanName(rank));
+      }
     }
   }
   // NOTE(chengcheng): recovery op_attr
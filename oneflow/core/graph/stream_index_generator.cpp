@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/graph/stream_index_generator.h"
+#include "oneflow/core/job/compiled_plan_cache.pb.h"
 
 namespace oneflow {
 
@@ -49,4 +50,28 @@ StreamIndexGenerator::stream_index_t StreamIndexGenerator::GenerateNamedRoundRob
   return cur_stream_index;
 }
 
+void StreamIndexGenerator::DumpState(StreamIndexGeneratorState* state) {
+  std::unique_lock<std::mutex> lck(mtx_);
+  state->set_next_stream_index(next_stream_index_);
+  auto* name2rr_range = state->mutable_name2rr_range();
+  name2rr_range->clear();
+  for (const auto& pair : name2rr_range_) {
+    StreamIndexRoundRobinRange* range = &(*name2rr_range)[pair.first];
+    range->set_begin(pair.second.begin);
+    range->set_size(pair.second.size);
+    range->set_offset(pair.second.offset);
+  }
+}
+
+void StreamIndexGenerator::LoadState(const StreamIndexGeneratorState& state) {
+  std::unique_lock<std::mutex> lck(mtx_);
+  next_stream_index_ = state.next_stream_index();
+  name2rr_range_.clear();
+  for (const auto& pair : state.name2rr_range()) {
+    RoundRobinRange range(pair.second.begin(), pair.second.size());
+    range.offset = pair.second.offset();
+    name2rr_range_.emplace(pair.first, range);
+  }
+}
+
 }  // namespace oneflow
@@ -20,6 +20,8 @@ limitations under the License.
 
 namespace oneflow {
 
+class StreamIndexGeneratorState;
+
 class StreamIndexGenerator final {
  public:
   using stream_index_t = StreamId::stream_index_t;
@@ -32,6 +34,9 @@ class StreamIndexGenerator final {
   stream_index_t GenerateNamed(const std::string& name);
   stream_index_t GenerateNamedRoundRobin(const std::string& name, size_t size);
 
+  void DumpState(StreamIndexGeneratorState* state);
+  void LoadState(const StreamIndexGeneratorState& state);
+
  private:
   struct RoundRobinRange {
     RoundRobinRange(stream_index_t begin, size_t size) : begin(begin), size(size), offset(0) {}
@@ -0,0 +1,68 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/common/protobuf.h"
+#include "oneflow/core/graph/stream_index_generator.h"
+#include "oneflow/core/job/compiled_plan_cache.pb.h"
+
+namespace oneflow {
+
+namespace {
+
+std::vector<StreamIndexGenerator::stream_index_t> Generate(StreamIndexGenerator* generator) {
+  std::vector<StreamIndexGenerator::stream_index_t> stream_indices;
+  stream_indices.push_back(generator->GenerateAnonymous());
+  stream_indices.push_back(generator->GenerateNamed("named"));
+  stream_indices.push_back(generator->GenerateNamed("other_named"));
+  for (int i = 0; i < 5; ++i) {
+    stream_indices.push_back(generator->GenerateNamedRoundRobin("round_robin", 3));
+  }
+  return stream_indices;
+}
+
+}  // namespace
+
+TEST(StreamIndexGenerator, load_dumped_state) {
+  StreamIndexGenerator generator;
+  generator.GenerateAnonymous();
+  generator.GenerateNamed("named");
+  // Stops in the middle of the round robin range.
+  generator.GenerateNamedRoundRobin("round_robin", 3);
+  generator.GenerateNamedRoundRobin("round_robin", 3);
+  StreamIndexGeneratorState state;
+  generator.DumpState(&state);
+  ASSERT_EQ(state.next_stream_index(), 5);
+  ASSERT_EQ(state.name2rr_range().size(), 2);
+  ASSERT_EQ(state.name2rr_range().at("round_robin").begin(), 2);
+  ASSERT_EQ(state.name2rr_range().at("round_robin").size(), 3);
+  ASSERT_EQ(state.name2rr_range().at("round_robin").offset(), 2);
+  const std::vector<StreamIndexGenerator::stream_index_t> expected = Generate(&generator);
+  ASSERT_EQ(expected,
+            (std::vector<StreamIndexGenerator::stream_index_t>{5, 1, 6, 4, 2, 3, 4, 2}));
+
+  StreamIndexGenerator loaded;
+  loaded.GenerateNamed("discarded");
+  loaded.LoadState(state);
+  ASSERT_EQ(Generate(&loaded), expected);
+  // The state of a loaded generator is dumped as it was loaded.
+  StreamIndexGenerator reloaded;
+  reloaded.LoadState(state);
+  StreamIndexGeneratorState redumped;
+  reloaded.DumpState(&redumped);
+  ASSERT_TRUE(PbMd().Equals(redumped, state));
+}
+
+}  // namespace oneflow
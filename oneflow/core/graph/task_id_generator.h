@@ -30,6 +30,13 @@ class TaskIdGenerator final {
 
   TaskId Generate(const StreamId& stream_id);
 
+  const HashMap<StreamId, task_index_t>& stream_id2task_index_counter() const {
+    return stream_id2task_index_counter_;
+  }
+  HashMap<StreamId, task_index_t>* mut_stream_id2task_index_counter() {
+    return &stream_id2task_index_counter_;
+  }
+
  private:
   HashMap<StreamId, task_index_t> stream_id2task_index_counter_;
 };
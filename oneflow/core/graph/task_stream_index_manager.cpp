@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/graph/task_stream_index_manager.h"
 #include "oneflow/core/job/global_for.h"
 #include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/job/compiled_plan_cache.pb.h"
 
 namespace oneflow {
 
@@ -48,6 +49,22 @@ TaskStreamIndexManager::stream_index_t TaskStreamIndexManager::GetNamedTaskStrea
   return generator->GenerateNamed(name);
 }
 
+void TaskStreamIndexManager::DumpState(CompilerGlobalState* state) {
+  std::unique_lock<std::mutex> lck(mtx_);
+  auto* device2stream_index_generator = state->mutable_device2stream_index_generator();
+  device2stream_index_generator->clear();
+  for (const auto& pair : generators_) {
+    const int64_t device_key = EncodeStreamIdToInt64(StreamId(pair.first, 0));
+    pair.second->DumpState(&(*device2stream_index_generator)[device_key]);
+  }
+}
+
+void TaskStreamIndexManager::LoadState(const CompilerGlobalState& state) {
+  for (const auto& pair : state.device2stream_index_generator()) {
+    GetGenerator(DecodeStreamIdFromInt64(pair.first).device_id())->LoadState(pair.second);
+  }
+}
+
 void TaskStreamIndexGetterRegistry::Register(const key_t& key, const stream_index_getter& getter) {
   bool insert_success = stream_index_getter_map_.emplace(key, getter).second;
   if (!insert_success) {
@@ -21,6 +21,8 @@ limitations under the License.
 
 namespace oneflow {
 
+class CompilerGlobalState;
+
 class TaskStreamIndexManager final {
  public:
   using stream_index_t = StreamId::stream_index_t;
@@ -34,6 +36,9 @@ class TaskStreamIndexManager final {
   stream_index_t GetComputeTaskStreamIndex(const DeviceId& device_id);
   stream_index_t GetNamedTaskStreamIndex(const DeviceId& device_id, const std::string& name);
 
+  void DumpState(CompilerGlobalState* state);
+  void LoadState(const CompilerGlobalState& state);
+
  private:
   HashMap<DeviceId, std::unique_ptr<StreamIndexGenerator>> generators_;
   std::mutex mtx_;
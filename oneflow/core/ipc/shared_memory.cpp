@@ -37,8 +37,8 @@ namespace {
 #ifdef __linux__
 
 // return errno
-int ShmOpen(const std::string& shm_name, int* fd, bool create) {
-  SharedMemoryManager::get().AddShmName(shm_name);
+int ShmOpen(const std::string& shm_name, int* fd, bool create, bool managed = true) {
+  if (managed) { SharedMemoryManager::get().AddShmName(shm_name); }
   *fd = shm_open(("/" + shm_name).c_str(), (create ? O_CREAT : 0) | O_RDWR | O_EXCL,
                  S_IRUSR | S_IWUSR);
   return *fd == -1 ? errno : 0;
@@ -67,9 +67,14 @@ Maybe<void*> ShmSetUp(std::string* shm_name, size_t shm_size, bool create) {
 #ifdef __linux__
   int fd = 0;
   PCHECK_OR_RETURN(ShmOpen(shm_name, &fd, create));
-  PCHECK_OR_RETURN(posix_fallocate(fd, 0, shm_size)) << ReturnEmptyStr([&] { close(fd); });
+  // A segment that could not be set up is removed at once, e.g. when /dev/shm is full.
+  const auto CloseAndUnlink = [&] {
+    close(fd);
+    if (create) { shm_unlink(("/" + *shm_name).c_str()); }
+  };
+  PCHECK_OR_RETURN(posix_fallocate(fd, 0, shm_size)) << ReturnEmptyStr(CloseAndUnlink);
   void* ptr = nullptr;
-  PCHECK_OR_RETURN(ShmMap(fd, shm_size, &ptr)) << ReturnEmptyStr([&] { close(fd); });
+  PCHECK_OR_RETURN(ShmMap(fd, shm_size, &ptr)) << ReturnEmptyStr(CloseAndUnlink);
   close(fd);
   std::memset(ptr, 0, shm_size);
   return ptr;
@@ -78,10 +83,11 @@ Maybe<void*> ShmSetUp(std::string* shm_name, size_t shm_size, bool create) {
 #endif
 }
 
-Maybe<void*> ShmSetUp(const std::string& shm_name, size_t* shm_size, bool create) {
+Maybe<void*> ShmSetUp(const std::string& shm_name, size_t* shm_size, bool create,
+                      bool managed) {
 #ifdef __linux__
   int fd = 0;
-  PCHECK_OR_RETURN(ShmOpen(shm_name, &fd, create));
+  PCHECK_OR_RETURN(ShmOpen(shm_name, &fd, create, managed));
   struct stat st;  // NOLINT
   PCHECK_OR_RETURN(fstat(fd, &st)) << ReturnEmptyStr([&] { close(fd); });
   *shm_size = st.st_size;
@@ -178,7 +184,14 @@ Maybe<SharedMemory> SharedMemory::Open(size_t shm_size, bool create) {
 
 Maybe<SharedMemory> SharedMemory::Open(const std::string& shm_name, bool create) {
   size_t shm_size = 0;
-  char* ptr = static_cast<char*>(JUST(ShmSetUp(shm_name, &shm_size, create)));
+  char* ptr = static_cast<char*>(JUST(ShmSetUp(shm_name, &shm_size, create, /*managed=*/true)));
+  return std::shared_ptr<SharedMemory>(new SharedMemory(ptr, shm_name, shm_size));
+}
+
+Maybe<SharedMemory> SharedMemory::OpenUnmanaged(const std::string& shm_name) {
+  size_t shm_size = 0;
+  char* ptr = static_cast<char*>(
+      JUST(ShmSetUp(shm_name, &shm_size, /*create=*/false, /*managed=*/false)));
   return std::shared_ptr<SharedMemory>(new SharedMemory(ptr, shm_name, shm_size));
 }
 
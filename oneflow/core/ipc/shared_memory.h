@@ -49,6 +49,9 @@ class SharedMemory final {
 
   static Maybe<SharedMemory> Open(size_t size, bool create);
   static Maybe<SharedMemory> Open(const std::string& name, bool create);
+  // Maps an existing segment without adding its name to SharedMemoryManager, so the segment is
+  // left to be unlinked by the process that created it.
+  static Maybe<SharedMemory> OpenUnmanaged(const std::string& name);
 
   const char* buf() const { return buf_; }
   char* mut_buf() { return buf_; }
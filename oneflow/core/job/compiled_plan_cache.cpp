@@ -0,0 +1,147 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <unistd.h>
+#include "oneflow/core/job/compiled_plan_cache.h"
+#include "oneflow/core/job/compiled_plan_cache.pb.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/graph/task_stream_index_manager.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/job/version.h"
+#include "oneflow/core/memory/chunk_manager.h"
+#include "oneflow/core/persistence/file_system.h"
+
+extern char** environ;
+
+namespace oneflow {
+
+namespace {
+
+constexpr char kPlanCacheDirEnvVar[] = "ONEFLOW_GRAPH_PLAN_CACHE_DIR";
+
+// Maps are serialized in hash order by default, which would make equal keys differ.
+std::string SerializeDeterministically(const PbMessage& msg) {
+  std::string serialized;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&serialized);
+    google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.SetSerializationDeterministic(true);
+    CHECK(msg.SerializeToCodedStream(&coded_stream));
+  }
+  return serialized;
+}
+
+void DumpCompilerGlobalState(CompilerGlobalState* state) {
+  Singleton<IDMgr>::Get()->DumpState(state);
+  Singleton<TaskStreamIndexManager>::Get()->DumpState(state);
+  Singleton<ChunkMgr>::Get()->DumpChunkProtos(state);
+}
+
+}  // namespace
+
+std::string CompiledPlanCache::CacheDir() {
+  return GetStringFromEnv(kPlanCacheDirEnvVar, "");
+}
+
+CompiledPlanCache::CompiledPlanCache(const std::string& cache_dir, const Job& job,
+                                     int64_t job_id,
+                                     const HashSet<std::string>& variable_op_names)
+    : cache_dir_(cache_dir) {
+  CompiledPlanKey key;
+  key.set_version(GetOneFlowGitVersion());
+  key.set_world_size(GlobalProcessCtx::WorldSize());
+  *key.mutable_resource() = Singleton<ResourceDesc, ForSession>::Get()->resource();
+  // ONEFLOW_* environment variables switch compiler passes and memory planning strategies.
+  std::vector<std::string> envs;
+  for (char** env = environ; *env != nullptr; ++env) {
+    const std::string env_var(*env);
+    const std::string name = env_var.substr(0, env_var.find('='));
+    if (name.compare(0, 8, "ONEFLOW_") != 0 || name == kPlanCacheDirEnvVar) { continue; }
+    envs.emplace_back(env_var);
+  }
+  std::sort(envs.begin(), envs.end());
+  for (const auto& env : envs) { key.add_env(env); }
+  key.set_job_id(job_id);
+  *key.mutable_job() = job;
+  std::vector<std::string> sorted_variable_op_names(variable_op_names.begin(),
+                                                    variable_op_names.end());
+  std::sort(sorted_variable_op_names.begin(), sorted_variable_op_names.end());
+  for (const auto& name : sorted_variable_op_names) { key.add_variable_op_name(name); }
+  DumpCompilerGlobalState(key.mutable_global_state());
+  key_ = SerializeDeterministically(key);
+  std::ostringstream file_name;
+  file_name << "plan-" << std::hex << std::hash<std::string>()(key_);
+  path_ = JoinPath(cache_dir_, file_name.str());
+}
+
+bool CompiledPlanCache::TryLoad(Plan* plan) const {
+  fs::FileSystem* fs = LocalFS();
+  if (!fs->FileExists(path_)) { return false; }
+  const uint64_t file_size = fs->GetFileSize(path_);
+  std::string serialized(file_size, '\0');
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(path_, &file);
+  file->Read(0, file_size, &serialized[0]);
+  CompiledPlan compiled_plan;
+  if (!compiled_plan.ParseFromString(serialized)) {
+    LOG(WARNING) << "ignore malformed compiled plan cache " << path_;
+    return false;
+  }
+  // The file name is only a hash of the key.
+  if (compiled_plan.key() != key_) { return false; }
+  // Ids and chunks handed out to the cached plan must not be handed out again.
+  const HashSet<int64_t> exist_chunk_ids = [&]() {
+    CompilerGlobalState state;
+    Singleton<ChunkMgr>::Get()->DumpChunkProtos(&state);
+    HashSet<int64_t> chunk_ids;
+    for (const auto& chunk : state.chunk()) { chunk_ids.insert(chunk.chunk_id()); }
+    return chunk_ids;
+  }();
+  const CompilerGlobalState& state = compiled_plan.global_state();
+  Singleton<IDMgr>::Get()->LoadState(state);
+  Singleton<TaskStreamIndexManager>::Get()->LoadState(state);
+  for (const auto& chunk : state.chunk()) {
+    if (exist_chunk_ids.count(chunk.chunk_id()) == 0) {
+      Singleton<ChunkMgr>::Get()->AddChunkProto(chunk);
+    }
+  }
+  plan->Swap(compiled_plan.mutable_plan());
+  return true;
+}
+
+void CompiledPlanCache::Save(const Plan& plan) const {
+  CompiledPlan compiled_plan;
+  compiled_plan.set_key(key_);
+  *compiled_plan.mutable_plan() = plan;
+  DumpCompilerGlobalState(compiled_plan.mutable_global_state());
+  std::string serialized;
+  CHECK(compiled_plan.SerializeToString(&serialized));
+  fs::FileSystem* fs = LocalFS();
+  fs->RecursivelyCreateDirIfNotExist(cache_dir_);
+  // Written aside and renamed, so that a concurrent reader never sees a partial entry.
+  const std::string tmp_path = path_ + ".tmp." + std::to_string(getpid());
+  std::unique_ptr<fs::WritableFile> file;
+  fs->NewWritableFile(tmp_path, &file);
+  file->Append(serialized.data(), serialized.size());
+  file->Close();
+  fs->RenameFile(tmp_path, path_);
+}
+
+}  // namespace oneflow
@@ -0,0 +1,56 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_COMPILED_PLAN_CACHE_H_
+#define ONEFLOW_CORE_JOB_COMPILED_PLAN_CACHE_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/job/job.pb.h"
+#include "oneflow/core/job/plan.pb.h"
+
+namespace oneflow {
+
+// On-disk cache of the plans compiled on the master, enabled by ONEFLOW_GRAPH_PLAN_CACHE_DIR.
+// An entry is addressed by the job, the resource, the ONEFLOW_* environment, the version and the
+// state of the process wide id generators and chunks the compiler draws from, and loading it
+// moves that state on as the compilation would have. Only the master compiles, so only the
+// master reads and writes the cache.
+//
+// Entries are never evicted: every graph compiled with a new key adds a file holding its whole
+// plan, so the cache dir grows without limit and has to be cleaned up by the user.
+class CompiledPlanCache final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CompiledPlanCache);
+  // Must be created before the job is compiled.
+  CompiledPlanCache(const std::string& cache_dir, const Job& job, int64_t job_id,
+                    const HashSet<std::string>& variable_op_names);
+  ~CompiledPlanCache() = default;
+
+  static bool IsEnabled() { return !CacheDir().empty(); }
+  static std::string CacheDir();
+
+  bool TryLoad(Plan* plan) const;
+  // Must be called right after the job is compiled.
+  void Save(const Plan& plan) const;
+
+ private:
+  std::string cache_dir_;
+  std::string key_;
+  std::string path_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_COMPILED_PLAN_CACHE_H_
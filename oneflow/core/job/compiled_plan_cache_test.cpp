@@ -0,0 +1,241 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include "oneflow/core/common/protobuf.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/graph/task_stream_index_manager.h"
+#include "oneflow/core/job/compiled_plan_cache.h"
+#include "oneflow/core/job/compiled_plan_cache.pb.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/memory/chunk_manager.h"
+#include "oneflow/core/persistence/file_system.h"
+
+namespace oneflow {
+
+namespace {
+
+EnvProto GetEnvProto() {
+  EnvProto ret;
+  auto* machine = ret.add_machine();
+  machine->set_id(0);
+  machine->set_addr("127.0.0.1");
+  ret.set_ctrl_port(9527);
+  return ret;
+}
+
+Resource GetResource() {
+  Resource ret;
+  ret.set_machine_num(1);
+  ret.set_cpu_device_num(1);
+  return ret;
+}
+
+// Sets up the singletons a fresh process compiles with.
+void New() {
+  Singleton<EnvDesc>::New(GetEnvProto());
+  Singleton<ProcessCtx>::New();
+  Singleton<ProcessCtx>::Get()->mutable_ctrl_addr()->Add();
+  Singleton<ProcessCtx>::Get()->set_rank(0);
+  Singleton<ProcessCtx>::Get()->set_node_size(1);
+  Singleton<ResourceDesc, ForSession>::New(GetResource(), GlobalProcessCtx::NumOfProcessPerNode());
+  Singleton<IDMgr>::New();
+  Singleton<TaskStreamIndexManager>::New();
+  Singleton<ChunkMgr>::New();
+}
+
+void Delete() {
+  Singleton<ChunkMgr>::Delete();
+  Singleton<TaskStreamIndexManager>::Delete();
+  Singleton<IDMgr>::Delete();
+  Singleton<ProcessCtx>::Delete();
+  Singleton<ResourceDesc, ForSession>::Delete();
+  Singleton<EnvDesc>::Delete();
+}
+
+std::string CreateTempDirectory() {
+  const char* tmp_env = getenv("TMPDIR");
+  const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
+  std::string tpl = std::string(tmp_dir) + "/test_compiled_plan_cache_XXXXXX";
+  char* path = mkdtemp(const_cast<char*>(tpl.c_str()));
+  PCHECK(path != nullptr);
+  return std::string(path);
+}
+
+Job MakeJob(const std::string& job_name) {
+  Job job;
+  job.mutable_job_conf()->set_job_name(job_name);
+  return job;
+}
+
+// Draws ids, stream indices and a chunk from the process wide state as Compiler::Compile and
+// PlanUtil::GenMemBlockAndChunkWithVariableOpNames4Plan do.
+void Compile(int64_t job_id, Plan* plan) {
+  const DeviceId device_id(0, DeviceType::kCPU, 0);
+  const auto stream_index =
+      Singleton<TaskStreamIndexManager>::Get()->GetNamedTaskStreamIndex(device_id, "compute");
+  const TaskId task_id =
+      Singleton<IDMgr>::Get()->GetTaskIdGenerator()->Generate(StreamId(device_id, stream_index));
+  plan->Clear();
+  plan->mutable_block_chunk_list();
+  plan->mutable_job_confs();
+  plan->mutable_collective_boxing_plan();
+  auto* ctrl_regst_desc_id2producer_task_id =
+      plan->mutable_ctrl_regst_desc_info()->mutable_ctrl_regst_desc_id2producer_task_id();
+  (*ctrl_regst_desc_id2producer_task_id)[Singleton<IDMgr>::Get()->NewRegstDescId()] =
+      EncodeTaskIdToInt64(task_id);
+  ChunkProto* chunk = plan->mutable_block_chunk_list()->add_chunk();
+  chunk->set_chunk_id(Singleton<IDMgr>::Get()->NewChunkId());
+  chunk->add_job_id(job_id);
+  chunk->set_machine_id(0);
+  chunk->mutable_mem_case()->set_device_type(DeviceType::kCPU);
+  chunk->mutable_mem_case()->set_device_id(0);
+  chunk->set_mem_size(1024);
+  MemBlockProto* mem_block = plan->mutable_block_chunk_list()->add_mem_block();
+  mem_block->set_mem_block_id(Singleton<IDMgr>::Get()->NewMemBlockId());
+  mem_block->add_job_id(job_id);
+  mem_block->set_machine_id(0);
+  *mem_block->mutable_mem_case() = chunk->mem_case();
+  mem_block->set_enable_reuse_mem(false);
+  mem_block->set_chunk_id(chunk->chunk_id());
+  mem_block->set_chunk_offset(0);
+  mem_block->set_mem_size(chunk->mem_size());
+  Singleton<ChunkMgr>::Get()->AddChunkProto(*chunk);
+}
+
+// Compiles the job unless the cache holds its plan, as NNGraph::CompileAndInitRuntime does.
+bool CompileWithCache(const std::string& cache_dir, const Job& job, int64_t job_id, Plan* plan) {
+  CompiledPlanCache plan_cache(cache_dir, job, job_id, {"variable"});
+  if (plan_cache.TryLoad(plan)) { return true; }
+  Compile(job_id, plan);
+  plan_cache.Save(*plan);
+  return false;
+}
+
+CompilerGlobalState DumpCompilerGlobalState() {
+  CompilerGlobalState state;
+  Singleton<IDMgr>::Get()->DumpState(&state);
+  Singleton<TaskStreamIndexManager>::Get()->DumpState(&state);
+  Singleton<ChunkMgr>::Get()->DumpChunkProtos(&state);
+  return state;
+}
+
+void CopyFile(fs::FileSystem* fs, const std::string& src, const std::string& dst) {
+  const uint64_t file_size = fs->GetFileSize(src);
+  std::string content(file_size, '\0');
+  std::unique_ptr<fs::RandomAccessFile> src_file;
+  fs->NewRandomAccessFile(src, &src_file);
+  src_file->Read(0, file_size, &content[0]);
+  std::unique_ptr<fs::WritableFile> dst_file;
+  fs->NewWritableFile(dst, &dst_file);
+  dst_file->Append(content.data(), content.size());
+  dst_file->Close();
+}
+
+}  // namespace
+
+TEST(CompiledPlanCache, load_compiled_plan) {
+  const std::string cache_dir = CreateTempDirectory();
+  const Job job = MakeJob("graph_0");
+
+  New();
+  Plan compiled_plan;
+  ASSERT_FALSE(CompileWithCache(cache_dir, job, 0, &compiled_plan));
+  const CompilerGlobalState compiled_state = DumpCompilerGlobalState();
+  Plan next_compiled_plan;
+  Compile(1, &next_compiled_plan);
+  Delete();
+  ASSERT_EQ(LocalFS()->ListDir(cache_dir).size(), 1);
+
+  // The next process loads the plan and ends up in the state the compilation left behind, so a
+  // graph compiled after it gets the same ids and chunks.
+  New();
+  Plan loaded_plan;
+  ASSERT_TRUE(CompileWithCache(cache_dir, job, 0, &loaded_plan));
+  ASSERT_TRUE(PbMd().Equals(loaded_plan, compiled_plan));
+  ASSERT_TRUE(PbMd().Equals(DumpCompilerGlobalState(), compiled_state));
+  Plan next_plan;
+  Compile(1, &next_plan);
+  ASSERT_TRUE(PbMd().Equals(next_plan, next_compiled_plan));
+  Delete();
+  ASSERT_EQ(LocalFS()->ListDir(cache_dir).size(), 1);
+  LocalFS()->RecursivelyDeleteDir(cache_dir);
+}
+
+TEST(CompiledPlanCache, reject_mismatched_key) {
+  fs::FileSystem* fs = LocalFS();
+  const std::string cache_dir = CreateTempDirectory();
+  const Job job = MakeJob("graph_0");
+  const Job other_job = MakeJob("graph_1");
+  New();
+  Plan plan;
+  ASSERT_FALSE(CompileWithCache(cache_dir, job, 0, &plan));
+  Delete();
+  const std::string path = JoinPath(cache_dir, fs->ListDir(cache_dir).front());
+  New();
+  ASSERT_TRUE(CompiledPlanCache(cache_dir, job, 0, {"variable"}).TryLoad(&plan));
+  Delete();
+
+  // Another job, job id, variable set, environment or compiler state misses the entry.
+  New();
+  ASSERT_FALSE(CompiledPlanCache(cache_dir, other_job, 0, {"variable"}).TryLoad(&plan));
+  ASSERT_FALSE(CompiledPlanCache(cache_dir, job, 1, {"variable"}).TryLoad(&plan));
+  ASSERT_FALSE(CompiledPlanCache(cache_dir, job, 0, {}).TryLoad(&plan));
+  setenv("ONEFLOW_TEST_COMPILED_PLAN_CACHE", "1", 1);
+  ASSERT_FALSE(CompiledPlanCache(cache_dir, job, 0, {"variable"}).TryLoad(&plan));
+  unsetenv("ONEFLOW_TEST_COMPILED_PLAN_CACHE");
+  Singleton<IDMgr>::Get()->NewRegstDescId();
+  ASSERT_FALSE(CompiledPlanCache(cache_dir, job, 0, {"variable"}).TryLoad(&plan));
+  Delete();
+
+  // An entry whose file name collides with the key of another job is rejected as well, and
+  // leaves the compiler state untouched.
+  const std::vector<std::string> file_names = fs->ListDir(cache_dir);
+  New();
+  Plan other_plan;
+  ASSERT_FALSE(CompileWithCache(cache_dir, other_job, 0, &other_plan));
+  Delete();
+  std::string other_path;
+  for (const auto& file_name : fs->ListDir(cache_dir)) {
+    if (std::find(file_names.begin(), file_names.end(), file_name) == file_names.end()) {
+      other_path = JoinPath(cache_dir, file_name);
+    }
+  }
+  ASSERT_FALSE(other_path.empty());
+  New();
+  ASSERT_TRUE(CompiledPlanCache(cache_dir, other_job, 0, {"variable"}).TryLoad(&other_plan));
+  Delete();
+  CopyFile(fs, path, other_path);
+  New();
+  const CompilerGlobalState state = DumpCompilerGlobalState();
+  ASSERT_FALSE(CompiledPlanCache(cache_dir, other_job, 0, {"variable"}).TryLoad(&other_plan));
+  ASSERT_TRUE(PbMd().Equals(DumpCompilerGlobalState(), state));
+
+  // So is a malformed entry.
+  {
+    std::unique_ptr<fs::WritableFile> file;
+    fs->NewWritableFile(path, &file);
+    file->Append("plan", 4);
+    file->Close();
+  }
+  ASSERT_FALSE(CompiledPlanCache(cache_dir, job, 0, {"variable"}).TryLoad(&plan));
+  Delete();
+  fs->RecursivelyDeleteDir(cache_dir);
+}
+
+}  // namespace oneflow
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/job/compiled_plan_cache.pb.h"
 
 namespace oneflow {
 
@@ -23,4 +24,26 @@ IDMgr::IDMgr() {
   chunk_id_count_ = 0;
 }
 
+void IDMgr::DumpState(CompilerGlobalState* state) const {
+  state->set_regst_desc_id_count(regst_desc_id_count_);
+  state->set_mem_block_id_count(mem_block_id_count_);
+  state->set_chunk_id_count(chunk_id_count_);
+  auto* stream_id2task_index_count = state->mutable_stream_id2task_index_count();
+  stream_id2task_index_count->clear();
+  for (const auto& pair : task_id_gen_.stream_id2task_index_counter()) {
+    (*stream_id2task_index_count)[EncodeStreamIdToInt64(pair.first)] = pair.second;
+  }
+}
+
+void IDMgr::LoadState(const CompilerGlobalState& state) {
+  regst_desc_id_count_ = state.regst_desc_id_count();
+  mem_block_id_count_ = state.mem_block_id_count();
+  chunk_id_count_ = state.chunk_id_count();
+  auto* stream_id2task_index_counter = task_id_gen_.mut_stream_id2task_index_counter();
+  stream_id2task_index_counter->clear();
+  for (const auto& pair : state.stream_id2task_index_count()) {
+    stream_id2task_index_counter->emplace(DecodeStreamIdFromInt64(pair.first), pair.second);
+  }
+}
+
 }  // namespace oneflow
@@ -24,6 +24,8 @@ limitations under the License.
 
 namespace oneflow {
 
+class CompilerGlobalState;
+
 class IDMgr final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(IDMgr);
@@ -35,6 +37,9 @@ class IDMgr final {
 
   TaskIdGenerator* GetTaskIdGenerator() { return &task_id_gen_; }
 
+  void DumpState(CompilerGlobalState* state) const;
+  void LoadState(const CompilerGlobalState& state);
+
  private:
   friend class Singleton<IDMgr>;
   IDMgr();
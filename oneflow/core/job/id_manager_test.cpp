@@ -16,6 +16,7 @@ limitations under the License.
 #include "gtest/gtest.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/job/compiled_plan_cache.pb.h"
 #include "oneflow/core/job/global_for.h"
 
 namespace oneflow {
@@ -72,4 +73,26 @@ TEST(IDMgr, compile_regst_desc_id) {
   Delete();
 }
 
+TEST(IDMgr, load_dumped_state) {
+  New();
+  const StreamId stream_id(0, DeviceType::kCPU, 0, 0);
+  Singleton<IDMgr>::Get()->NewRegstDescId();
+  Singleton<IDMgr>::Get()->NewMemBlockId();
+  Singleton<IDMgr>::Get()->GetTaskIdGenerator()->Generate(stream_id);
+  CompilerGlobalState state;
+  Singleton<IDMgr>::Get()->DumpState(&state);
+  const int64_t regst_desc_id = Singleton<IDMgr>::Get()->NewRegstDescId();
+  const int64_t mem_block_id = Singleton<IDMgr>::Get()->NewMemBlockId();
+  const int64_t chunk_id = Singleton<IDMgr>::Get()->NewChunkId();
+  const TaskId task_id = Singleton<IDMgr>::Get()->GetTaskIdGenerator()->Generate(stream_id);
+  Delete();
+  New();
+  Singleton<IDMgr>::Get()->LoadState(state);
+  ASSERT_EQ(Singleton<IDMgr>::Get()->NewRegstDescId(), regst_desc_id);
+  ASSERT_EQ(Singleton<IDMgr>::Get()->NewMemBlockId(), mem_block_id);
+  ASSERT_EQ(Singleton<IDMgr>::Get()->NewChunkId(), chunk_id);
+  ASSERT_TRUE(Singleton<IDMgr>::Get()->GetTaskIdGenerator()->Generate(stream_id) == task_id);
+  Delete();
+}
+
 }  // namespace oneflow
@@ -13,11 +13,14 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <iomanip>
 #include "oneflow/core/job/intra_job_mem_sharing_util.h"
 #include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/common/env_var/debug_mode.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/common/shape.h"
 #include "oneflow/core/job/id_manager.h"
+#include "oneflow/core/job/lifetime_packing.h"
 #include "oneflow/core/register/runtime_register_desc.h"
 #include "oneflow/core/thread/thread_pool.h"
 #include "oneflow/core/graph/task_node.h"
@@ -29,6 +32,7 @@ enum MemAllocAlgoType {
   kMemSizeFirstAlgo = 0,
   kMutualExclusionFirstAlgo = 1,
   kTimeLineAlgo = 2,
+  kLifetimePackingAlgo = 3,
 };
 
 }  // namespace oneflow
@@ -53,6 +57,17 @@ struct MemBlockResultInfo {
   HashMap<RegstDescProto*, int64_t> regst_desc2offset;
 };
 
+const char* MemAllocAlgoName(MemAllocAlgoType algo_id) {
+  switch (algo_id) {
+    case kMemSizeFirstAlgo: return "MemSizeFirst";
+    case kMutualExclusionFirstAlgo: return "MutualExclusionFirst";
+    case kTimeLineAlgo: return "TimeLine";
+    case kLifetimePackingAlgo: return "LifetimePacking";
+    default: UNIMPLEMENTED();
+  }
+  return "";
+}
+
 int64_t GenDeviceUniqueId(int64_t machine_id, int64_t device_id) {
   return (machine_id << 32) | device_id;
 }
@@ -703,11 +718,71 @@ void MemReusedAlgorithm_TimeLineAlgo(
   result->mem_block_size = bfc_allocator.buffer_size();
 }
 
+// Lifetimes of the regsts of a mem chain in the order of their alloc index, and then of their regst
+// desc id for the result not to depend on the iteration order of HashSet.
+void GenRegstLifetimes(const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
+                       const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline,
+                       std::vector<RegstDescProto*>* regsts, std::vector<int64_t>* sizes,
+                       std::vector<int64_t>* alloc_indexes, std::vector<int64_t>* free_indexes) {
+  CHECK_EQ(alloc_regsts_timeline.size(), free_regsts_timeline.size());
+  HashMap<RegstDescProto*, int64_t> regst2free_index;
+  for (int64_t i = 0; i < free_regsts_timeline.size(); ++i) {
+    for (RegstDescProto* regst : free_regsts_timeline.at(i)) {
+      CHECK(regst2free_index.emplace(regst, i).second);
+    }
+  }
+  for (int64_t i = 0; i < alloc_regsts_timeline.size(); ++i) {
+    std::vector<RegstDescProto*> alloc_regsts(alloc_regsts_timeline.at(i).begin(),
+                                              alloc_regsts_timeline.at(i).end());
+    std::sort(alloc_regsts.begin(), alloc_regsts.end(),
+              [](RegstDescProto* lhs, RegstDescProto* rhs) {
+                return lhs->regst_desc_id() < rhs->regst_desc_id();
+              });
+    for (RegstDescProto* regst : alloc_regsts) {
+      regsts->emplace_back(regst);
+      sizes->emplace_back(RtRegstDesc(*regst).TotalMainByteSize4AllRegst());
+      alloc_indexes->emplace_back(i);
+      free_indexes->emplace_back(regst2free_index.at(regst));
+    }
+  }
+}
+
+void MemReusedAlgorithm_LifetimePackingAlgo(
+    const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
+    const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline, int64_t time_budget_ms,
+    MemBlockResultInfo* result) {
+  std::vector<RegstDescProto*> regsts;
+  std::vector<int64_t> sizes;
+  std::vector<int64_t> alloc_indexes;
+  std::vector<int64_t> free_indexes;
+  GenRegstLifetimes(alloc_regsts_timeline, free_regsts_timeline, &regsts, &sizes, &alloc_indexes,
+                    &free_indexes);
+  std::vector<int64_t> offsets;
+  result->mem_block_size =
+      LifetimePacking(sizes, alloc_indexes, free_indexes).Solve(time_budget_ms, &offsets);
+  HashMap<RegstDescProto*, int64_t>* regst_desc2offset = &(result->regst_desc2offset);
+  regst_desc2offset->clear();
+  for (int64_t i = 0; i < regsts.size(); ++i) {
+    CHECK(regst_desc2offset->emplace(regsts.at(i), offsets.at(i)).second);
+  }
+}
+
+int64_t LifetimeLowerBound(const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
+                           const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline) {
+  std::vector<RegstDescProto*> regsts;
+  std::vector<int64_t> sizes;
+  std::vector<int64_t> alloc_indexes;
+  std::vector<int64_t> free_indexes;
+  GenRegstLifetimes(alloc_regsts_timeline, free_regsts_timeline, &regsts, &sizes, &alloc_indexes,
+                    &free_indexes);
+  return LifetimePacking(sizes, alloc_indexes, free_indexes).LowerBound();
+}
+
 void SelectAlgorithmGenMemBlockOffset4Regsts(
     MemAllocAlgoType algo_id, const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
     const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline,
     const HashMap<RegstDescProto*, std::vector<RegstDescProto*>>& regst2mutual_exclusion_regsts,
-    MemBlockResultInfo* result) {
+    int64_t time_budget_ms, MemBlockResultInfo* result) {
   CHECK_EQ(result->mem_block_size, 0);
   CHECK(result->regst_desc2offset.empty());
 
@@ -728,6 +803,10 @@ void SelectAlgorithmGenMemBlockOffset4Regsts(
     case kTimeLineAlgo:
       MemReusedAlgorithm_TimeLineAlgo(alloc_regsts_timeline, free_regsts_timeline, result);
       break;
+    case kLifetimePackingAlgo:
+      MemReusedAlgorithm_LifetimePackingAlgo(alloc_regsts_timeline, free_regsts_timeline,
+                                             time_budget_ms, result);
+      break;
     default: UNIMPLEMENTED();
   }
   CHECK_GT(result->mem_block_size, 0);
@@ -741,6 +820,7 @@ int64_t CountMemAllocAlgoNum() {
   if (mem_alloc_algo_conf.use_mem_size_first_algo()) { ++ret; }
   if (mem_alloc_algo_conf.use_mutual_exclusion_first_algo()) { ++ret; }
   if (mem_alloc_algo_conf.use_time_line_algo()) { ++ret; }
+  if (mem_alloc_algo_conf.use_lifetime_packing_algo()) { ++ret; }
   CHECK_GE(ret, 0);
   return ret;
 }
@@ -758,6 +838,9 @@ void InitAlgo2Result(HashMap<MemAllocAlgoType, MemBlockResultInfo>* algo2result)
   if (mem_alloc_algo_conf.use_time_line_algo()) {
     CHECK(algo2result->emplace(kTimeLineAlgo, MemBlockResultInfo()).second);
   }
+  if (mem_alloc_algo_conf.use_lifetime_packing_algo()) {
+    CHECK(algo2result->emplace(kLifetimePackingAlgo, MemBlockResultInfo()).second);
+  }
 }
 
 }  // namespace
@@ -795,6 +878,10 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(
   // step 2: multi-thread run several algorithm for each mem chain
   HashMap<int64_t, HashMap<MemAllocAlgoType, MemBlockResultInfo>> mem_chain2algo2result;
   {
+    const int64_t time_budget_ms = GlobalJobDesc()
+                                       .job_conf()
+                                       .memory_allocation_algorithm_conf()
+                                       .lifetime_packing_time_budget_ms();
     int64_t work_size = mem_chain2mem_reused_regsts.size() * CountMemAllocAlgoNum();
     int64_t thread_pool_size = std::min<int64_t>(work_size, std::thread::hardware_concurrency());
     BlockingCounter counter(work_size);
@@ -806,11 +893,11 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(
         MemBlockResultInfo* result = &pair.second;
         thread_pool.AddWork([algo_id, mem_chain_id, &mem_chain2task2alloc_regsts,
                              &mem_chain2task2free_regsts, &mem_chain2regst2mutual_exclusion_regsts,
-                             result, &counter]() {
+                             time_budget_ms, result, &counter]() {
           SelectAlgorithmGenMemBlockOffset4Regsts(
               algo_id, mem_chain2task2alloc_regsts.at(mem_chain_id),
               mem_chain2task2free_regsts.at(mem_chain_id),
-              mem_chain2regst2mutual_exclusion_regsts.at(mem_chain_id), result);
+              mem_chain2regst2mutual_exclusion_regsts.at(mem_chain_id), time_budget_ms, result);
           counter.Decrease();
         });
       }
@@ -821,12 +908,30 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(
   // step 3: choose best one for each mem chain and set offset for inplace consumer regst
   for (const auto& pair : mem_chain2algo2result) {
     const MemBlockResultInfo* best_result = nullptr;
+    MemAllocAlgoType best_algo_id = kMemSizeFirstAlgo;
     for (const auto& algo_result_pair : pair.second) {
       if (!best_result || algo_result_pair.second.mem_block_size < best_result->mem_block_size) {
         best_result = &algo_result_pair.second;
+        best_algo_id = algo_result_pair.first;
       }
     }
     CHECK(best_result != nullptr);
+    if (IsInDebugMode()) {
+      const int64_t lower_bound = LifetimeLowerBound(mem_chain2task2alloc_regsts.at(pair.first),
+                                                     mem_chain2task2free_regsts.at(pair.first));
+      std::ostringstream report;
+      report << "Mem chain " << pair.first << " of job " << GlobalJobDesc().job_name() << " with "
+             << best_result->regst_desc2offset.size() << " regsts, lower bound " << lower_bound
+             << " bytes";
+      for (const auto& algo_result_pair : pair.second) {
+        const int64_t size = algo_result_pair.second.mem_block_size;
+        report << ", " << MemAllocAlgoName(algo_result_pair.first) << " " << size << " (+"
+               << std::fixed << std::setprecision(2)
+               << (lower_bound > 0 ? 100.0 * (size - lower_bound) / lower_bound : 0.0) << "%)";
+      }
+      report << ", chose " << MemAllocAlgoName(best_algo_id);
+      LOG(INFO) << report.str();
+    }
     int64_t mem_block_id = Singleton<IDMgr>::Get()->NewMemBlockId();
     CHECK_EQ(mem_chain2mem_reused_regsts.at(pair.first).size(),
              (best_result->regst_desc2offset.size()
@@ -0,0 +1,163 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <chrono>
+#include <numeric>
+#include <random>
+#include "oneflow/core/job/lifetime_packing.h"
+
+namespace oneflow {
+
+LifetimePacking::LifetimePacking(const std::vector<int64_t>& sizes,
+                                 const std::vector<int64_t>& alloc_indexes,
+                                 const std::vector<int64_t>& free_indexes)
+    : sizes_(sizes), alloc_indexes_(alloc_indexes), free_indexes_(free_indexes) {
+  CHECK_EQ(sizes_.size(), alloc_indexes_.size());
+  CHECK_EQ(sizes_.size(), free_indexes_.size());
+  for (int64_t i = 0; i < sizes_.size(); ++i) {
+    CHECK_LE(alloc_indexes_.at(i), free_indexes_.at(i));
+    if (i > 0) { CHECK_LE(alloc_indexes_.at(i - 1), alloc_indexes_.at(i)); }
+  }
+  // The regsts are sorted by alloc index, so the lifetimes intersecting regst i and allocated after
+  // it are the ones allocated before it is freed.
+  conflicts_.resize(sizes_.size());
+  for (int64_t i = 0; i < sizes_.size(); ++i) {
+    for (int64_t j = i + 1; j < sizes_.size() && alloc_indexes_.at(j) <= free_indexes_.at(i);
+         ++j) {
+      conflicts_.at(i).emplace_back(j);
+      conflicts_.at(j).emplace_back(i);
+    }
+  }
+}
+
+int64_t LifetimePacking::LowerBound() const {
+  if (alloc_indexes_.empty()) { return 0; }
+  const int64_t time_num = *std::max_element(free_indexes_.begin(), free_indexes_.end()) + 1;
+  std::vector<int64_t> size_delta(time_num + 1, 0);
+  for (int64_t i = 0; i < sizes_.size(); ++i) {
+    size_delta.at(alloc_indexes_.at(i)) += sizes_.at(i);
+    size_delta.at(free_indexes_.at(i) + 1) -= sizes_.at(i);
+  }
+  int64_t alive_size = 0;
+  int64_t lower_bound = 0;
+  for (int64_t t = 0; t < time_num; ++t) {
+    alive_size += size_delta.at(t);
+    lower_bound = std::max(lower_bound, alive_size);
+  }
+  return lower_bound;
+}
+
+int64_t LifetimePacking::Place(const std::vector<int64_t>& order,
+                               std::vector<int64_t>* offsets) const {
+  offsets->assign(sizes_.size(), -1);
+  int64_t mem_block_size = 0;
+  std::vector<std::pair<int64_t, int64_t>> occupied;
+  for (int64_t i : order) {
+    occupied.clear();
+    for (int64_t j : conflicts_.at(i)) {
+      if (offsets->at(j) != -1) {
+        occupied.emplace_back(offsets->at(j), offsets->at(j) + sizes_.at(j));
+      }
+    }
+    std::sort(occupied.begin(), occupied.end());
+    const int64_t size = sizes_.at(i);
+    int64_t best_offset = -1;
+    int64_t best_gap = std::numeric_limits<int64_t>::max();
+    int64_t free_begin = 0;
+    for (const auto& range : occupied) {
+      const int64_t gap = range.first - free_begin;
+      if (gap >= size && gap < best_gap) {
+        best_offset = free_begin;
+        best_gap = gap;
+      }
+      free_begin = std::max(free_begin, range.second);
+    }
+    if (best_offset == -1) { best_offset = free_begin; }
+    offsets->at(i) = best_offset;
+    mem_block_size = std::max(mem_block_size, best_offset + size);
+  }
+  return mem_block_size;
+}
+
+int64_t LifetimePacking::Solve(int64_t time_budget_ms, std::vector<int64_t>* offsets) const {
+  const int64_t regst_num = sizes_.size();
+  std::vector<int64_t> identity(regst_num);
+  std::iota(identity.begin(), identity.end(), 0);
+  auto LifetimeLength = [&](int64_t i) { return free_indexes_.at(i) - alloc_indexes_.at(i) + 1; };
+  std::vector<std::function<bool(int64_t, int64_t)>> greedy_orders{
+      [&](int64_t lhs, int64_t rhs) { return sizes_.at(lhs) > sizes_.at(rhs); },
+      [&](int64_t lhs, int64_t rhs) { return LifetimeLength(lhs) > LifetimeLength(rhs); },
+      [&](int64_t lhs, int64_t rhs) {
+        return sizes_.at(lhs) * LifetimeLength(lhs) > sizes_.at(rhs) * LifetimeLength(rhs);
+      },
+      [&](int64_t lhs, int64_t rhs) {
+        return conflicts_.at(lhs).size() > conflicts_.at(rhs).size();
+      },
+  };
+  std::vector<int64_t> best_order;
+  std::vector<int64_t> best_offsets;
+  int64_t best_size = std::numeric_limits<int64_t>::max();
+  std::vector<int64_t> cur_offsets;
+  for (const auto& Compare : greedy_orders) {
+    std::vector<int64_t> order = identity;
+    std::stable_sort(order.begin(), order.end(), Compare);
+    const int64_t size = Place(order, &cur_offsets);
+    if (size < best_size) {
+      best_size = size;
+      best_order.swap(order);
+      best_offsets.swap(cur_offsets);
+    }
+  }
+
+  const int64_t lower_bound = LowerBound();
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(time_budget_ms);
+  // NOTE: a fixed seed keeps the result reproducible as long as the time budget is not the limit.
+  std::mt19937 gen(regst_num);
+  const int64_t max_stall_num = std::max<int64_t>(1000, regst_num * 10);
+  int64_t stall_num = 0;
+  std::vector<int64_t> top_positions;
+  std::vector<int64_t> order;
+  while (regst_num > 1 && best_size > lower_bound && stall_num < max_stall_num
+         && std::chrono::steady_clock::now() < deadline) {
+    top_positions.clear();
+    for (int64_t pos = 0; pos < regst_num; ++pos) {
+      const int64_t i = best_order.at(pos);
+      if (best_offsets.at(i) + sizes_.at(i) == best_size) { top_positions.emplace_back(pos); }
+    }
+    const int64_t from =
+        top_positions.at(std::uniform_int_distribution<int64_t>(0, top_positions.size() - 1)(gen));
+    order = best_order;
+    if (from == 0) {
+      std::swap(order.at(0),
+                order.at(std::uniform_int_distribution<int64_t>(1, regst_num - 1)(gen)));
+    } else {
+      const int64_t to = std::uniform_int_distribution<int64_t>(0, from - 1)(gen);
+      std::rotate(order.begin() + to, order.begin() + from, order.begin() + from + 1);
+    }
+    const int64_t size = Place(order, &cur_offsets);
+    stall_num = (size < best_size) ? 0 : stall_num + 1;
+    if (size <= best_size) {
+      best_size = size;
+      best_order.swap(order);
+      best_offsets.swap(cur_offsets);
+    }
+  }
+
+  offsets->swap(best_offsets);
+  return best_size;
+}
+
+}  // namespace oneflow
@@ -0,0 +1,53 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_LIFETIME_PACKING_H_
+#define ONEFLOW_CORE_JOB_LIFETIME_PACKING_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Regsts of a mem chain as rectangles on the (time x address) plane: regst i lives from
+// alloc_indexes[i] to free_indexes[i], both inclusive, and two regsts conflict iff their lifetimes
+// intersect. Conflicts of lifetimes form an interval graph, so the largest total size of the regsts
+// alive at one time is a lower bound of the mem block size that any placement reaches.
+class LifetimePacking final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(LifetimePacking);
+  // The regsts must be sorted by alloc index.
+  LifetimePacking(const std::vector<int64_t>& sizes, const std::vector<int64_t>& alloc_indexes,
+                  const std::vector<int64_t>& free_indexes);
+  ~LifetimePacking() = default;
+
+  int64_t LowerBound() const;
+  // Places the regsts in order, each at the best fitting gap left by the regsts conflicting with
+  // it, and returns the mem block size.
+  int64_t Place(const std::vector<int64_t>& order, std::vector<int64_t>* offsets) const;
+  // Starts from the best of a few greedy orders and then keeps moving a regst which reaches the
+  // top of the mem block to an earlier random position of the order, as long as that does not
+  // make the mem block larger, until the time budget is used up or no move has helped for a while.
+  int64_t Solve(int64_t time_budget_ms, std::vector<int64_t>* offsets) const;
+
+ private:
+  std::vector<int64_t> sizes_;
+  std::vector<int64_t> alloc_indexes_;
+  std::vector<int64_t> free_indexes_;
+  std::vector<std::vector<int64_t>> conflicts_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_LIFETIME_PACKING_H_
@@ -0,0 +1,133 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <numeric>
+#include <random>
+#include "gtest/gtest.h"
+#include "oneflow/core/job/lifetime_packing.h"
+
+namespace oneflow {
+
+namespace {
+
+struct Lifetimes {
+  std::vector<int64_t> sizes;
+  std::vector<int64_t> alloc_indexes;
+  std::vector<int64_t> free_indexes;
+};
+
+// Regsts conflicting in time must not overlap in memory, and all of them fit in the mem block.
+void CheckOffsets(const Lifetimes& lifetimes, const std::vector<int64_t>& offsets,
+                  int64_t mem_block_size) {
+  const int64_t regst_num = lifetimes.sizes.size();
+  ASSERT_EQ(offsets.size(), regst_num);
+  for (int64_t i = 0; i < regst_num; ++i) {
+    ASSERT_GE(offsets.at(i), 0);
+    ASSERT_LE(offsets.at(i) + lifetimes.sizes.at(i), mem_block_size);
+    for (int64_t j = i + 1; j < regst_num; ++j) {
+      const bool conflict = lifetimes.alloc_indexes.at(i) <= lifetimes.free_indexes.at(j)
+                            && lifetimes.alloc_indexes.at(j) <= lifetimes.free_indexes.at(i);
+      const bool overlap = offsets.at(i) < offsets.at(j) + lifetimes.sizes.at(j)
+                           && offsets.at(j) < offsets.at(i) + lifetimes.sizes.at(i);
+      ASSERT_FALSE(conflict && overlap) << "regst " << i << " and regst " << j;
+    }
+  }
+}
+
+Lifetimes RandomLifetimes(int64_t regst_num, int64_t time_num, std::mt19937* gen) {
+  Lifetimes lifetimes;
+  std::uniform_int_distribution<int64_t> size_dist(1, 64);
+  std::uniform_int_distribution<int64_t> time_dist(0, time_num - 1);
+  for (int64_t i = 0; i < regst_num; ++i) { lifetimes.alloc_indexes.push_back(time_dist(*gen)); }
+  std::sort(lifetimes.alloc_indexes.begin(), lifetimes.alloc_indexes.end());
+  for (int64_t i = 0; i < regst_num; ++i) {
+    lifetimes.sizes.push_back(size_dist(*gen) * 512);
+    lifetimes.free_indexes.push_back(std::uniform_int_distribution<int64_t>(
+        lifetimes.alloc_indexes.at(i), time_num - 1)(*gen));
+  }
+  return lifetimes;
+}
+
+}  // namespace
+
+TEST(LifetimePacking, lower_bound) {
+  ASSERT_EQ(LifetimePacking({}, {}, {}).LowerBound(), 0);
+  // Alive sizes over time are 4, 7, 5 and 7.
+  ASSERT_EQ(LifetimePacking({4, 3, 2, 5}, {0, 1, 2, 3}, {1, 2, 3, 3}).LowerBound(), 7);
+  // Regsts which never live at the same time need the size of the largest one.
+  ASSERT_EQ(LifetimePacking({4, 9, 2}, {0, 1, 2}, {0, 1, 2}).LowerBound(), 9);
+}
+
+TEST(LifetimePacking, place) {
+  // Regst 2 reuses the memory of regst 0, which is freed before regst 2 is allocated.
+  {
+    const Lifetimes lifetimes{{4, 2, 3}, {0, 0, 2}, {1, 3, 3}};
+    LifetimePacking packing(lifetimes.sizes, lifetimes.alloc_indexes, lifetimes.free_indexes);
+    std::vector<int64_t> offsets;
+    ASSERT_EQ(packing.Place({0, 1, 2}, &offsets), 6);
+    ASSERT_EQ(offsets, (std::vector<int64_t>{0, 4, 0}));
+    CheckOffsets(lifetimes, offsets, 6);
+    ASSERT_EQ(packing.LowerBound(), 6);
+  }
+  // Regst 4 goes to the gap of 3 bytes left by regst 2 rather than the gap of 5 bytes left by
+  // regst 0.
+  {
+    const Lifetimes lifetimes{{5, 1, 3, 1, 3}, {0, 0, 0, 0, 1}, {0, 3, 0, 3, 3}};
+    LifetimePacking packing(lifetimes.sizes, lifetimes.alloc_indexes, lifetimes.free_indexes);
+    std::vector<int64_t> offsets;
+    ASSERT_EQ(packing.Place({0, 1, 2, 3, 4}, &offsets), 10);
+    ASSERT_EQ(offsets, (std::vector<int64_t>{0, 5, 6, 9, 6}));
+    CheckOffsets(lifetimes, offsets, 10);
+    // Another order packs them differently.
+    ASSERT_EQ(packing.Place({1, 3, 0, 2, 4}, &offsets), 10);
+    ASSERT_EQ(offsets, (std::vector<int64_t>{2, 0, 7, 1, 2}));
+    CheckOffsets(lifetimes, offsets, 10);
+  }
+}
+
+TEST(LifetimePacking, local_search) {
+  // Alive sizes over time are 10, 9, 10 and 10, but every greedy order ends up with 11 bytes.
+  const Lifetimes lifetimes{{3, 5, 2, 6, 4}, {0, 0, 0, 1, 2}, {1, 0, 0, 3, 3}};
+  LifetimePacking packing(lifetimes.sizes, lifetimes.alloc_indexes, lifetimes.free_indexes);
+  ASSERT_EQ(packing.LowerBound(), 10);
+  std::vector<int64_t> offsets;
+  // No time is left for the local search.
+  ASSERT_EQ(packing.Solve(0, &offsets), 11);
+  CheckOffsets(lifetimes, offsets, 11);
+  ASSERT_EQ(packing.Solve(1000, &offsets), 10);
+  CheckOffsets(lifetimes, offsets, 10);
+}
+
+TEST(LifetimePacking, solve) {
+  std::mt19937 gen(0);
+  for (int64_t round = 0; round < 50; ++round) {
+    const Lifetimes lifetimes = RandomLifetimes(2 + round, 4 + round / 2, &gen);
+    LifetimePacking packing(lifetimes.sizes, lifetimes.alloc_indexes, lifetimes.free_indexes);
+    std::vector<int64_t> offsets;
+    const int64_t mem_block_size = packing.Solve(100, &offsets);
+    CheckOffsets(lifetimes, offsets, mem_block_size);
+    ASSERT_GE(mem_block_size, packing.LowerBound());
+    // The local search starts from the greedy orders and never ends up worse than them.
+    std::vector<int64_t> order(lifetimes.sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int64_t lhs, int64_t rhs) {
+      return lifetimes.sizes.at(lhs) > lifetimes.sizes.at(rhs);
+    });
+    std::vector<int64_t> greedy_offsets;
+    ASSERT_LE(mem_block_size, packing.Place(order, &greedy_offsets));
+  }
+}
+
+}  // namespace oneflow
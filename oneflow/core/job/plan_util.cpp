@@ -1215,6 +1215,44 @@ void PlanUtil::PopulateOpAttribute(
   }
 }
 
+void PlanUtil::GenPlan4Rank(const Plan& plan, int64_t rank, Plan* rank_plan) {
+  rank_plan->Clear();
+  HashMap<int64_t, HashSet<std::string>> job_id2op_attribute_refs;
+  for (const TaskProto& task : plan.task()) {
+    if (task.machine_id() != rank) { continue; }
+    *rank_plan->add_task() = task;
+    for (const auto& exec_node : task.exec_sequence().exec_node()) {
+      if (exec_node.kernel_conf().has_op_attribute_ref()) {
+        job_id2op_attribute_refs[task.job_id()].insert(exec_node.kernel_conf().op_attribute_ref());
+      }
+    }
+  }
+  MemBlockAndChunkList* block_chunk_list = rank_plan->mutable_block_chunk_list();
+  for (const MemBlockProto& mem_block : plan.block_chunk_list().mem_block()) {
+    if (mem_block.machine_id() != rank) { continue; }
+    *block_chunk_list->add_mem_block() = mem_block;
+  }
+  for (const ChunkProto& chunk : plan.block_chunk_list().chunk()) {
+    if (chunk.machine_id() != rank) { continue; }
+    *block_chunk_list->add_chunk() = chunk;
+  }
+  for (const auto& pair : plan.job_id2op_attribute_ref_table()) {
+    const HashSet<std::string>& refs = job_id2op_attribute_refs[pair.first];
+    auto* op_name2op_attribute =
+        (*rank_plan->mutable_job_id2op_attribute_ref_table())[pair.first]
+            .mutable_op_name2op_attribute();
+    for (const auto& op_name7op_attribute : pair.second.op_name2op_attribute()) {
+      if (refs.count(op_name7op_attribute.first) > 0
+          || op_name7op_attribute.second.op_conf().has_variable_conf()) {
+        op_name2op_attribute->insert(op_name7op_attribute);
+      }
+    }
+  }
+  *rank_plan->mutable_job_confs() = plan.job_confs();
+  *rank_plan->mutable_collective_boxing_plan() = plan.collective_boxing_plan();
+  *rank_plan->mutable_ctrl_regst_desc_info() = plan.ctrl_regst_desc_info();
+}
+
 /*static*/ StreamId PlanUtil::GetStreamId(const TaskProto& task) {
   return DecodeStreamIdFromInt64(task.thrd_id());
 }
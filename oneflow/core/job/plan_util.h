@@ -47,6 +47,10 @@ struct PlanUtil {
   static void PopulateOpAttribute(
       Plan* plan,
       const PbMap<int64_t, ::oneflow::OpAttributeRefTable>& job_id2op_attribute_ref_table);
+  // Keeps only what the runtime of the rank reads: its own tasks, mem blocks and chunks, and the
+  // op attributes they refer to. Variable op attributes are all kept since every rank binds every
+  // variable tensor.
+  static void GenPlan4Rank(const Plan& plan, int64_t rank, Plan* rank_plan);
   static StreamId GetStreamId(const TaskProto& task);
   static int64_t GetDeviceIndex(const TaskProto& task);
 };
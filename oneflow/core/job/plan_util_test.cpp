@@ -0,0 +1,160 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <set>
+#include "gtest/gtest.h"
+#include "oneflow/core/common/protobuf.h"
+#include "oneflow/core/job/plan_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+constexpr int64_t kJobId = 3;
+
+// Task `task_id` on `machine_id`, its kernel refers to the op attribute of `op_name`.
+void AddTask(Plan* plan, int64_t machine_id, int64_t task_id, const std::string& op_name) {
+  TaskProto* task = plan->add_task();
+  task->set_task_type(TaskType::kNormalForward);
+  task->set_machine_id(machine_id);
+  task->set_thrd_id(0);
+  task->set_task_id(task_id);
+  task->set_job_id(kJobId);
+  task->mutable_task_set_info();
+  task->mutable_exec_sequence()->add_exec_node()->mutable_kernel_conf()->set_op_attribute_ref(
+      op_name);
+}
+
+void AddOpAttribute(Plan* plan, const std::string& op_name, bool is_variable) {
+  OpAttribute op_attribute;
+  op_attribute.mutable_op_conf()->set_name(op_name);
+  if (is_variable) { op_attribute.mutable_op_conf()->mutable_variable_conf()->set_out("out"); }
+  (*(*plan->mutable_job_id2op_attribute_ref_table())[kJobId].mutable_op_name2op_attribute())
+      [op_name] = op_attribute;
+}
+
+void AddMemBlockAndChunk(Plan* plan, int64_t machine_id, int64_t id) {
+  ChunkProto* chunk = plan->mutable_block_chunk_list()->add_chunk();
+  chunk->set_chunk_id(id);
+  chunk->add_job_id(kJobId);
+  chunk->set_machine_id(machine_id);
+  chunk->mutable_mem_case()->set_device_type(DeviceType::kCPU);
+  chunk->set_mem_size(1024);
+  MemBlockProto* mem_block = plan->mutable_block_chunk_list()->add_mem_block();
+  mem_block->set_mem_block_id(id);
+  mem_block->add_job_id(kJobId);
+  mem_block->set_machine_id(machine_id);
+  *mem_block->mutable_mem_case() = chunk->mem_case();
+  mem_block->set_enable_reuse_mem(false);
+  mem_block->set_chunk_id(id);
+  mem_block->set_chunk_offset(0);
+  mem_block->set_mem_size(chunk->mem_size());
+}
+
+// Tasks a and c with mem block and chunk 10 on rank 0, task b with 11 and 12 on rank 1. Op
+// attribute d is referred to by no task, v and w are variables.
+Plan MakePlan() {
+  Plan plan;
+  AddTask(&plan, 0, 100, "a");
+  AddTask(&plan, 1, 101, "b");
+  AddTask(&plan, 0, 102, "c");
+  for (const std::string& op_name : {"a", "b", "c", "d"}) {
+    AddOpAttribute(&plan, op_name, false);
+  }
+  AddOpAttribute(&plan, "v", true);
+  AddOpAttribute(&plan, "w", true);
+  AddMemBlockAndChunk(&plan, 0, 10);
+  AddMemBlockAndChunk(&plan, 1, 11);
+  AddMemBlockAndChunk(&plan, 1, 12);
+  (*plan.mutable_job_confs()->mutable_job_id2job_conf())[kJobId].set_job_name("job");
+  (*plan.mutable_collective_boxing_plan()->mutable_job_id2request_set())[kJobId];
+  (*plan.mutable_ctrl_regst_desc_info()->mutable_ctrl_regst_desc_id2producer_task_id())[7] = 101;
+  return plan;
+}
+
+std::vector<int64_t> TaskIds(const Plan& plan) {
+  std::vector<int64_t> task_ids;
+  for (const TaskProto& task : plan.task()) { task_ids.emplace_back(task.task_id()); }
+  return task_ids;
+}
+
+std::vector<int64_t> MemBlockIds(const Plan& plan) {
+  std::vector<int64_t> ids;
+  for (const auto& mem_block : plan.block_chunk_list().mem_block()) {
+    ids.emplace_back(mem_block.mem_block_id());
+  }
+  return ids;
+}
+
+std::vector<int64_t> ChunkIds(const Plan& plan) {
+  std::vector<int64_t> ids;
+  for (const auto& chunk : plan.block_chunk_list().chunk()) { ids.emplace_back(chunk.chunk_id()); }
+  return ids;
+}
+
+std::set<std::string> OpNames(const Plan& plan) {
+  std::set<std::string> op_names;
+  for (const auto& pair : plan.job_id2op_attribute_ref_table().at(kJobId).op_name2op_attribute()) {
+    EXPECT_EQ(pair.first, pair.second.op_conf().name());
+    op_names.insert(pair.first);
+  }
+  return op_names;
+}
+
+}  // namespace
+
+TEST(PlanUtil, GenPlan4Rank) {
+  const Plan plan = MakePlan();
+  Plan rank_plan;
+  // Left over from a previous call.
+  AddTask(&rank_plan, 1, 200, "x");
+
+  PlanUtil::GenPlan4Rank(plan, 0, &rank_plan);
+  ASSERT_EQ(TaskIds(rank_plan), (std::vector<int64_t>{100, 102}));
+  ASSERT_EQ(MemBlockIds(rank_plan), (std::vector<int64_t>{10}));
+  ASSERT_EQ(ChunkIds(rank_plan), (std::vector<int64_t>{10}));
+  ASSERT_EQ(OpNames(rank_plan), (std::set<std::string>{"a", "c", "v", "w"}));
+  ASSERT_TRUE(PbMd().Equals(rank_plan.job_confs(), plan.job_confs()));
+  ASSERT_TRUE(PbMd().Equals(rank_plan.collective_boxing_plan(), plan.collective_boxing_plan()));
+  ASSERT_TRUE(PbMd().Equals(rank_plan.ctrl_regst_desc_info(), plan.ctrl_regst_desc_info()));
+  for (int i = 0; i < rank_plan.task_size(); ++i) {
+    ASSERT_TRUE(PbMd().Equals(rank_plan.task(i), plan.task(i == 0 ? 0 : 2)));
+  }
+
+  PlanUtil::GenPlan4Rank(plan, 1, &rank_plan);
+  ASSERT_EQ(TaskIds(rank_plan), (std::vector<int64_t>{101}));
+  ASSERT_EQ(MemBlockIds(rank_plan), (std::vector<int64_t>{11, 12}));
+  ASSERT_EQ(ChunkIds(rank_plan), (std::vector<int64_t>{11, 12}));
+  ASSERT_EQ(OpNames(rank_plan), (std::set<std::string>{"b", "v", "w"}));
+  ASSERT_TRUE(PbMd().Equals(rank_plan.job_confs(), plan.job_confs()));
+  ASSERT_TRUE(PbMd().Equals(rank_plan.collective_boxing_plan(), plan.collective_boxing_plan()));
+  ASSERT_TRUE(PbMd().Equals(rank_plan.ctrl_regst_desc_info(), plan.ctrl_regst_desc_info()));
+  ASSERT_TRUE(PbMd().Equals(rank_plan.block_chunk_list().mem_block(1),
+                            plan.block_chunk_list().mem_block(2)));
+
+  // A rank without tasks still gets the variables and the job wide parts.
+  PlanUtil::GenPlan4Rank(plan, 2, &rank_plan);
+  ASSERT_EQ(rank_plan.task_size(), 0);
+  ASSERT_EQ(rank_plan.block_chunk_list().mem_block_size(), 0);
+  ASSERT_EQ(rank_plan.block_chunk_list().chunk_size(), 0);
+  ASSERT_EQ(OpNames(rank_plan), (std::set<std::string>{"v", "w"}));
+  ASSERT_TRUE(PbMd().Equals(rank_plan.job_confs(), plan.job_confs()));
+}
+
+}  // namespace test
+
+}  // namespace oneflow
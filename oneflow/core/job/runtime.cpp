@@ -46,7 +46,6 @@ void HandoutTasks(const std::vector<const TaskProto*>& tasks) {
   for (const TaskProto* task : tasks) {
     Singleton<ThreadMgr>::Get()->GetThrd(task->thrd_id())->AddTask(*task);
   }
-  SendCmdMsg(tasks, ActorCmd::kConstructActor);
 }
 
 bool HasNonCtrlConsumedRegstDescId(const TaskProto& task) {
@@ -97,8 +96,12 @@ Runtime::Runtime(
   }
   RuntimeCtx* runtime_ctx = Singleton<RuntimeCtx>::Get();
   runtime_ctx->NewCounter("constructing_actor_cnt", this_machine_task_num);
+  // Threads size the actor slots of a job by its tasks, so all of them are handed out before any
+  // actor is constructed.
   HandoutTasks(source_tasks);
   HandoutTasks(other_tasks);
+  SendCmdMsg(source_tasks, ActorCmd::kConstructActor);
+  SendCmdMsg(other_tasks, ActorCmd::kConstructActor);
   runtime_ctx->WaitUntilCntEqualZero("constructing_actor_cnt");
   VLOG(3) << "Actors on this machine constructed";
   OF_SESSION_BARRIER();
@@ -17,6 +17,7 @@ limitations under the License.
 #include "oneflow/core/memory/memory_allocator.h"
 #include "oneflow/core/memory/memory_case_util.h"
 #include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/job/compiled_plan_cache.pb.h"
 
 namespace oneflow {
 
@@ -46,6 +47,15 @@ void ChunkMgr::AddChunkProto(const ChunkProto& chunk) {
   CHECK(chunk_ids_it->second.insert(chunk.chunk_id()).second);
 }
 
+void ChunkMgr::DumpChunkProtos(CompilerGlobalState* state) const {
+  std::vector<int64_t> chunk_ids;
+  chunk_ids.reserve(chunk_id2chunk_proto_.size());
+  for (const auto& pair : chunk_id2chunk_proto_) { chunk_ids.emplace_back(pair.first); }
+  std::sort(chunk_ids.begin(), chunk_ids.end());
+  state->clear_chunk();
+  for (int64_t chunk_id : chunk_ids) { *state->add_chunk() = *chunk_id2chunk_proto_.at(chunk_id); }
+}
+
 char* ChunkMgr::FindOrCreateChunk(const ChunkProto& chunk) {
   CHECK_EQ(GlobalProcessCtx::Rank(), chunk.machine_id());
   auto it = chunk_id2chunk_.find(chunk.chunk_id());
@@ -24,6 +24,8 @@ limitations under the License.
 
 namespace oneflow {
 
+class CompilerGlobalState;
+
 class ChunkMgr final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ChunkMgr);
@@ -34,6 +36,8 @@ class ChunkMgr final {
   void GetChunkProtosByMemZoneUniqueId(int64_t mem_zone_uid,
                                        std::vector<const ChunkProto*>* chunks) const;
   void AddChunkProto(const ChunkProto& chunk);
+  // in the order of chunk id
+  void DumpChunkProtos(CompilerGlobalState* state) const;
 
   // Runtime
   char* FindOrCreateChunk(const ChunkProto& chunk);
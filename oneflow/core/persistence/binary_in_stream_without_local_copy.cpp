@@ -32,6 +32,9 @@ BinaryInStreamWithoutLocalCopy::BinaryInStreamWithoutLocalCopy(fs::FileSystem* f
     : cur_file_pos_(0) {
   fs->NewRandomAccessFile(file_path, &file_);
   file_size_ = fs->GetFileSize(file_path);
+  static const bool advise_sequential =
+      ParseBooleanFromEnv("ONEFLOW_PERSISTENT_IN_STREAM_FADVISE_SEQUENTIAL", false);
+  if (advise_sequential) { file_->AdviseSequentialRead(); }
 }
 
 }  // namespace oneflow
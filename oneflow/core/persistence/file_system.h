@@ -36,6 +36,10 @@ class RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual void Read(uint64_t offset, size_t n, char* result) const = 0;
 
+  // Hints that the file will be read from the beginning to the end, so that the implementation
+  // may read ahead more aggressively. Does nothing by default.
+  virtual void AdviseSequentialRead() {}
+
  private:
 };
 
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/persistence/binary_in_stream_without_local_copy.h"
 #include "oneflow/core/job/job_set.pb.h"
 #include <cstring>
+#include <chrono>
 #include "oneflow/core/common/constant.h"
 
 namespace oneflow {
@@ -41,6 +42,16 @@ size_t GetBufferSize() {
   return kDefaultBufferSize;
 }
 
+// Number of buffers filled by the read ahead thread while the previous ones are consumed, 0
+// reads synchronously on the calling thread.
+int64_t GetReadAheadDepth() {
+  return ParseIntegerFromEnv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_DEPTH", 0);
+}
+
+double SecondsSince(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 }  // namespace
 
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
@@ -65,10 +76,36 @@ PersistentInStream::PersistentInStream(int64_t session_id, fs::FileSystem* fs,
   } else {
     stream_scanner_.reset(new AcyclicStreamScanner(fs, streams, offset));
   }
-  buffer_.resize(GetBufferSize() + 1);
+  const size_t buffer_size = GetBufferSize();
+  buffer_.resize(buffer_size + 1);
   cur_buf_begin_ = buffer_.data();
   cur_buf_end_ = buffer_.data();
   *cur_buf_end_ = '\0';
+  num_read_bytes_ = 0;
+  read_seconds_ = 0;
+  wait_seconds_ = 0;
+  const int64_t read_ahead_depth = GetReadAheadDepth();
+  read_ahead_ = read_ahead_depth > 0;
+  read_ahead_eof_ = false;
+  if (read_ahead_) {
+    for (int64_t i = 0; i < read_ahead_depth; ++i) {
+      CHECK_EQ(free_buffers_.Send(std::vector<char>(buffer_size + 1)), kChannelStatusSuccess);
+    }
+    read_ahead_thread_ = std::thread(&PersistentInStream::ReadAheadLoop, this);
+  }
+}
+
+PersistentInStream::~PersistentInStream() {
+  if (read_ahead_) {
+    free_buffers_.Close();
+    filled_buffers_.Close();
+    read_ahead_thread_.join();
+  }
+  if (num_read_bytes_ > 0) {
+    VLOG(1) << "PersistentInStream read " << num_read_bytes_ << " bytes in " << read_seconds_
+            << "s (" << num_read_bytes_ / std::max(read_seconds_, 1e-9) / (1024 * 1024)
+            << " MiB/s), readers waited " << wait_seconds_ << "s for data";
+  }
 }
 
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
@@ -126,13 +163,60 @@ int32_t PersistentInStream::ReadFully(char* s, size_t n) {
 
 void PersistentInStream::UpdateBuffer() {
   CHECK_EQ(cur_buf_begin_, cur_buf_end_);
-  uint64_t n = stream_scanner_->UpdateBuffer(&buffer_);
+  uint64_t n = 0;
+  if (read_ahead_) {
+    n = ReceiveReadAheadBuffer();
+  } else {
+    const auto start = std::chrono::steady_clock::now();
+    n = stream_scanner_->UpdateBuffer(&buffer_);
+    const double seconds = SecondsSince(start);
+    num_read_bytes_ += n;
+    read_seconds_ += seconds;
+    wait_seconds_ += seconds;
+  }
   cur_buf_begin_ = buffer_.data();
   cur_buf_end_ = buffer_.data() + n;
   *cur_buf_end_ = '\0';
 }
 
-bool PersistentInStream::IsEof() const {
-  return cur_buf_begin_ == cur_buf_end_ && stream_scanner_->IsEof();
+uint64_t PersistentInStream::ReceiveReadAheadBuffer() {
+  if (read_ahead_eof_) { return 0; }
+  const auto start = std::chrono::steady_clock::now();
+  std::pair<std::vector<char>, uint64_t> filled_buffer;
+  CHECK_EQ(filled_buffers_.Receive(&filled_buffer), kChannelStatusSuccess);
+  wait_seconds_ += SecondsSince(start);
+  if (filled_buffer.second == 0) {
+    read_ahead_eof_ = true;
+    return 0;
+  }
+  std::swap(buffer_, filled_buffer.first);
+  // Fails only if the stream is being destroyed.
+  free_buffers_.Send(std::move(filled_buffer.first));
+  return filled_buffer.second;
+}
+
+void PersistentInStream::ReadAheadLoop() {
+  std::vector<char> buffer;
+  while (free_buffers_.Receive(&buffer) == kChannelStatusSuccess) {
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t n = stream_scanner_->UpdateBuffer(&buffer);
+    read_seconds_ += SecondsSince(start);
+    num_read_bytes_ += n;
+    if (filled_buffers_.Send(std::make_pair(std::move(buffer), n)) != kChannelStatusSuccess) {
+      return;
+    }
+    if (n == 0) { return; }
+  }
+}
+
+bool PersistentInStream::IsEof() {
+  if (cur_buf_begin_ != cur_buf_end_) { return false; }
+  if (read_ahead_) {
+    // Only the read ahead thread knows the position of stream_scanner_, so wait for its next
+    // buffer, which is empty at the end of the data.
+    UpdateBuffer();
+    return cur_buf_begin_ == cur_buf_end_;
+  }
+  return stream_scanner_->IsEof();
 }
 }  // namespace oneflow
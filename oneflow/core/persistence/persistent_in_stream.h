@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_PERSISTENCE_PERSISTENT_IN_STREAM_H_
 #define ONEFLOW_CORE_PERSISTENCE_PERSISTENT_IN_STREAM_H_
 
+#include "oneflow/core/common/channel.h"
 #include "oneflow/core/persistence/file_system.h"
 #include "oneflow/core/persistence/stream_scanner.h"
 
@@ -24,7 +25,7 @@ namespace oneflow {
 class PersistentInStream {
  public:
   OF_DISALLOW_COPY_AND_MOVE(PersistentInStream);
-  virtual ~PersistentInStream() {}
+  virtual ~PersistentInStream();
   PersistentInStream(fs::FileSystem* fs, const std::vector<std::string>& file_paths,
                      uint64_t offset, bool cyclic, bool with_local_copy);
   PersistentInStream(fs::FileSystem* fs, const std::vector<std::string>& file_paths, bool cyclic,
@@ -45,14 +46,29 @@ class PersistentInStream {
   int32_t ReadFully(char* s, size_t n);
 
  private:
-  bool IsEof() const;
+  bool IsEof();
   void UpdateBuffer();
+  uint64_t ReceiveReadAheadBuffer();
+  void ReadAheadLoop();
 
   std::unique_ptr<StreamScanner> stream_scanner_;
 
   std::vector<char> buffer_;
   char* cur_buf_begin_;
   char* cur_buf_end_;
+
+  // With ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_DEPTH > 0, stream_scanner_ is only used by
+  // read_ahead_thread_, which fills the buffers of free_buffers_ and passes them together with
+  // the number of bytes read to filled_buffers_. A buffer of 0 bytes marks the end of the data.
+  bool read_ahead_;
+  bool read_ahead_eof_;
+  Channel<std::vector<char>> free_buffers_;
+  Channel<std::pair<std::vector<char>, uint64_t>> filled_buffers_;
+  std::thread read_ahead_thread_;
+
+  uint64_t num_read_bytes_;
+  double read_seconds_;
+  double wait_seconds_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,98 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/persistence/persistent_in_stream.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+namespace oneflow {
+
+namespace {
+
+std::vector<std::string> WriteTestFiles(fs::FileSystem* file_system,
+                                        std::vector<std::string>* lines) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  std::vector<std::string> file_paths;
+  for (int file_idx = 0; file_idx < 3; ++file_idx) {
+    const std::string file_path =
+        JoinPath(current_dir, "/tmp_persistent_in_stream_test_" + std::to_string(file_idx));
+    std::unique_ptr<fs::WritableFile> file;
+    file_system->NewWritableFile(file_path, &file);
+    for (int line_idx = 0; line_idx < 100 * (file_idx + 1); ++line_idx) {
+      const std::string line = std::to_string(file_idx) + "-" + std::string(line_idx % 17, 'x')
+                               + std::to_string(line_idx);
+      file->Append(line.data(), line.size());
+      file->Append("\n", 1);
+      lines->emplace_back(line);
+    }
+    file->Close();
+    file_paths.emplace_back(file_path);
+  }
+  return file_paths;
+}
+
+void TestReadLines(const std::string& read_ahead_depth) {
+  setenv("ONEFLOW_PERSISTENT_IN_STREAM_BUFFER_SIZE_BYTES", "13", 1);
+  setenv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_DEPTH", read_ahead_depth.c_str(), 1);
+  fs::FileSystem* file_system = LocalFS();
+  std::vector<std::string> lines;
+  const std::vector<std::string> file_paths = WriteTestFiles(file_system, &lines);
+  {
+    PersistentInStream in_stream(file_system, file_paths, /*cyclic=*/false,
+                                 /*with_local_copy=*/false);
+    std::string line;
+    for (const std::string& expected : lines) {
+      ASSERT_EQ(in_stream.ReadLine(&line), 0);
+      ASSERT_EQ(line, expected);
+    }
+    ASSERT_EQ(in_stream.ReadLine(&line), -1);
+  }
+  {
+    PersistentInStream in_stream(file_system, file_paths, /*cyclic=*/true,
+                                 /*with_local_copy=*/false);
+    std::string line;
+    for (int epoch = 0; epoch < 2; ++epoch) {
+      for (const std::string& expected : lines) {
+        ASSERT_EQ(in_stream.ReadLine(&line), 0);
+        ASSERT_EQ(line, expected);
+      }
+    }
+  }
+  {
+    // Destroying a stream whose read ahead thread has not reached the end must not hang.
+    PersistentInStream in_stream(file_system, file_paths, /*cyclic=*/true,
+                                 /*with_local_copy=*/false);
+    std::vector<char> data(lines.front().size() + 1);
+    ASSERT_EQ(in_stream.ReadFully(data.data(), data.size()), 0);
+    ASSERT_EQ(std::string(data.data(), data.size()), lines.front() + "\n");
+  }
+  for (const std::string& file_path : file_paths) { file_system->DelFile(file_path); }
+  unsetenv("ONEFLOW_PERSISTENT_IN_STREAM_BUFFER_SIZE_BYTES");
+  unsetenv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_DEPTH");
+}
+
+}  // namespace
+
+TEST(PersistentInStream, read_lines) { TestReadLines("0"); }
+
+TEST(PersistentInStream, read_lines_with_read_ahead) {
+  TestReadLines("1");
+  TestReadLines("4");
+}
+
+}  // namespace oneflow
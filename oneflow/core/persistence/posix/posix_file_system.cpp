@@ -60,6 +60,13 @@ class PosixRandomAccessFile : public RandomAccessFile {
       }
     }
   }
+
+  void AdviseSequentialRead() override {
+#ifdef __linux__
+    const int err = posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (err != 0) { LOG(WARNING) << "posix_fadvise failed on " << fname_ << ", error " << err; }
+#endif  // __linux__
+  }
 };
 
 class PosixWritableFile : public WritableFile {
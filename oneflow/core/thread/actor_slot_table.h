@@ -0,0 +1,160 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_THREAD_ACTOR_SLOT_TABLE_H_
+#define ONEFLOW_CORE_THREAD_ACTOR_SLOT_TABLE_H_
+
+#include <algorithm>
+#include <vector>
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/graph/task_id.h"
+
+namespace oneflow {
+
+// Slots of the actors of a thread, looked up by actor id for every actor message.
+//
+// Task indices come from a per-stream counter that keeps growing with every job compiled in the
+// process, so the actors of one job on a thread have nearby task indices while jobs compiled
+// later are far apart. Every job therefore gets its own block of slots, indexed by the task index
+// minus the smallest task index of the job on this thread, and the block is dropped when the
+// last actor of the job is destructed. Actors whose task index does not fit in their job's block,
+// e.g. tasks added after the block was created, are kept in a hash map.
+//
+// AddTask and Insert have to be serialized by the caller. Insert, Find and Erase are only called
+// by the thread owning the actors.
+template<typename T>
+class ActorSlotTable final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ActorSlotTable);
+  ActorSlotTable() : size_(0) {}
+  ~ActorSlotTable() = default;
+
+  // Records the task index of a task handed to this thread, before its actor is constructed.
+  void AddTask(int64_t job_id, int64_t actor_id) {
+    const int64_t task_index = TaskIndex(actor_id);
+    auto it = job_id2pending_range_.find(job_id);
+    if (it == job_id2pending_range_.end()) {
+      job_id2pending_range_.emplace(job_id, std::make_pair(task_index, task_index));
+    } else {
+      it->second.first = std::min(it->second.first, task_index);
+      it->second.second = std::max(it->second.second, task_index);
+    }
+  }
+
+  // Returns the empty slot of a new actor.
+  T* Insert(int64_t job_id, int64_t actor_id) {
+    CHECK(Find(actor_id) == nullptr) << "actor " << actor_id << " exists";
+    Block* block = FindOrCreateBlock(job_id);
+    size_ += 1;
+    if (block != nullptr) {
+      const int64_t offset = TaskIndex(actor_id) - block->base;
+      if (offset >= 0 && offset < static_cast<int64_t>(block->slots.size())
+          && block->slots[offset].actor_id == -1) {
+        block->slots[offset].actor_id = actor_id;
+        block->live += 1;
+        return &block->slots[offset].value;
+      }
+    }
+    return &id2fallback_value_[actor_id];
+  }
+
+  T* Find(int64_t actor_id) {
+    const int64_t task_index = TaskIndex(actor_id);
+    for (auto& block : blocks_) {
+      const uint64_t offset = static_cast<uint64_t>(task_index - block.base);
+      if (offset < block.slots.size() && block.slots[offset].actor_id == actor_id) {
+        return &block.slots[offset].value;
+      }
+    }
+    if (likely(id2fallback_value_.empty())) { return nullptr; }
+    auto it = id2fallback_value_.find(actor_id);
+    if (it == id2fallback_value_.end()) { return nullptr; }
+    return &it->second;
+  }
+
+  // Destructs the value of an actor and frees its slot.
+  void Erase(int64_t actor_id) {
+    const int64_t task_index = TaskIndex(actor_id);
+    for (auto block = blocks_.begin(); block != blocks_.end(); ++block) {
+      const uint64_t offset = static_cast<uint64_t>(task_index - block->base);
+      if (offset < block->slots.size() && block->slots[offset].actor_id == actor_id) {
+        block->slots[offset].actor_id = -1;
+        block->slots[offset].value = T();
+        block->live -= 1;
+        if (block->live == 0) { blocks_.erase(block); }
+        size_ -= 1;
+        return;
+      }
+    }
+    CHECK_EQ(id2fallback_value_.erase(actor_id), 1) << "actor " << actor_id << " not found";
+    size_ -= 1;
+  }
+
+  int64_t size() const { return size_; }
+  // Number of slots held, used or not.
+  int64_t capacity() const {
+    int64_t capacity = id2fallback_value_.size();
+    for (const auto& block : blocks_) { capacity += block.slots.size(); }
+    return capacity;
+  }
+
+ private:
+  struct Slot {
+    int64_t actor_id = -1;
+    T value;
+  };
+
+  struct Block {
+    int64_t job_id;
+    int64_t base;
+    int64_t live;
+    std::vector<Slot> slots;
+  };
+
+  static int64_t TaskIndex(int64_t actor_id) {
+    return DecodeTaskIdFromInt64(actor_id).task_index();
+  }
+
+  Block* FindOrCreateBlock(int64_t job_id) {
+    auto range_it = job_id2pending_range_.find(job_id);
+    for (auto& block : blocks_) {
+      if (block.job_id == job_id) {
+        // Tasks of the job added after its block was created go to the hash map.
+        if (range_it != job_id2pending_range_.end()) { job_id2pending_range_.erase(range_it); }
+        return &block;
+      }
+    }
+    if (range_it == job_id2pending_range_.end()) { return nullptr; }
+    blocks_.emplace_back();
+    Block* block = &blocks_.back();
+    block->job_id = job_id;
+    block->base = range_it->second.first;
+    block->live = 0;
+    block->slots.resize(range_it->second.second - range_it->second.first + 1);
+    job_id2pending_range_.erase(range_it);
+    return block;
+  }
+
+  // Only a few jobs are alive at a time, so the blocks are searched linearly.
+  std::vector<Block> blocks_;
+  HashMap<int64_t, T> id2fallback_value_;
+  // Smallest and largest task index of the tasks added for a job that has no block yet.
+  HashMap<int64_t, std::pair<int64_t, int64_t>> job_id2pending_range_;
+  int64_t size_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_THREAD_ACTOR_SLOT_TABLE_H_
@@ -0,0 +1,122 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/thread/actor_slot_table.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+int64_t ActorId(int64_t task_index) {
+  const StreamId stream_id(0, DeviceType::kCPU, 0, 0);
+  return EncodeTaskIdToInt64(TaskId(stream_id, task_index));
+}
+
+struct Value {
+  int64_t actor_id = -1;
+  std::unique_ptr<int64_t> payload;
+};
+
+void ConstructActors(ActorSlotTable<Value>* table, int64_t job_id,
+                     const std::vector<int64_t>& task_indices) {
+  for (int64_t task_index : task_indices) { table->AddTask(job_id, ActorId(task_index)); }
+  for (int64_t task_index : task_indices) {
+    Value* value = table->Insert(job_id, ActorId(task_index));
+    ASSERT_EQ(value->actor_id, -1);
+    ASSERT_FALSE(value->payload);
+    value->actor_id = ActorId(task_index);
+    value->payload.reset(new int64_t(task_index));
+  }
+}
+
+void CheckDispatch(ActorSlotTable<Value>* table, const std::vector<int64_t>& task_indices) {
+  for (int64_t task_index : task_indices) {
+    Value* value = table->Find(ActorId(task_index));
+    ASSERT_TRUE(value != nullptr) << task_index;
+    ASSERT_EQ(value->actor_id, ActorId(task_index));
+    ASSERT_EQ(*value->payload, task_index);
+  }
+}
+
+}  // namespace
+
+TEST(ActorSlotTable, jobs_with_far_apart_task_indices) {
+  ActorSlotTable<Value> table;
+  const std::vector<int64_t> job0_tasks = {3, 4, 5, 7};
+  const int64_t job1_base = TaskId::kMaxTaskIndex - 10;
+  const std::vector<int64_t> job1_tasks = {job1_base, job1_base + 2, job1_base + 1};
+  ConstructActors(&table, 0, job0_tasks);
+  ConstructActors(&table, 1, job1_tasks);
+  ASSERT_EQ(table.size(), 7);
+  // Slots only span the task indices of each job, not the indices between the jobs.
+  ASSERT_EQ(table.capacity(), 5 + 3);
+  CheckDispatch(&table, job0_tasks);
+  CheckDispatch(&table, job1_tasks);
+  ASSERT_TRUE(table.Find(ActorId(6)) == nullptr);
+  ASSERT_TRUE(table.Find(ActorId(job1_base + 3)) == nullptr);
+  ASSERT_TRUE(table.Find(ActorId(job1_base - 1)) == nullptr);
+
+  // Destructing the actors of job 0 drops its slots, job 1 keeps dispatching.
+  for (int64_t task_index : job0_tasks) { table.Erase(ActorId(task_index)); }
+  ASSERT_EQ(table.size(), 3);
+  ASSERT_EQ(table.capacity(), 3);
+  ASSERT_TRUE(table.Find(ActorId(3)) == nullptr);
+  CheckDispatch(&table, job1_tasks);
+
+  // A slot freed while its job is alive is reused by the same actor id.
+  table.Erase(ActorId(job1_base + 2));
+  ASSERT_TRUE(table.Find(ActorId(job1_base + 2)) == nullptr);
+  Value* value = table.Insert(1, ActorId(job1_base + 2));
+  ASSERT_EQ(value->actor_id, -1);
+  ASSERT_FALSE(value->payload);
+  value->actor_id = ActorId(job1_base + 2);
+  value->payload.reset(new int64_t(job1_base + 2));
+  ASSERT_EQ(table.capacity(), 3);
+  CheckDispatch(&table, job1_tasks);
+
+  // A job compiled later gets a block of its own again.
+  const std::vector<int64_t> job2_tasks = {100, 101};
+  ConstructActors(&table, 2, job2_tasks);
+  ASSERT_EQ(table.capacity(), 3 + 2);
+  CheckDispatch(&table, job1_tasks);
+  CheckDispatch(&table, job2_tasks);
+  for (int64_t task_index : job1_tasks) { table.Erase(ActorId(task_index)); }
+  for (int64_t task_index : job2_tasks) { table.Erase(ActorId(task_index)); }
+  ASSERT_EQ(table.size(), 0);
+  ASSERT_EQ(table.capacity(), 0);
+}
+
+TEST(ActorSlotTable, fallback_for_tasks_out_of_the_block) {
+  ActorSlotTable<Value> table;
+  ConstructActors(&table, 0, {10, 11});
+  // Added after the block of job 0 was created, and not in its task index range.
+  ConstructActors(&table, 0, {9, 20});
+  // Never added.
+  Value* value = table.Insert(3, ActorId(50));
+  value->actor_id = ActorId(50);
+  value->payload.reset(new int64_t(50));
+  ASSERT_EQ(table.size(), 5);
+  CheckDispatch(&table, {9, 10, 11, 20, 50});
+  for (int64_t task_index : {9, 10, 11, 20, 50}) { table.Erase(ActorId(task_index)); }
+  ASSERT_EQ(table.size(), 0);
+  ASSERT_EQ(table.capacity(), 0);
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -55,20 +55,31 @@ Thread::~Thread() {
 void Thread::AddTask(const TaskProto& task) {
   std::unique_lock<std::mutex> lck(id2task_mtx_);
   CHECK(id2task_.emplace(task.task_id(), task).second);
+  actor_slots_.AddTask(task.job_id(), task.task_id());
 }
 
 void Thread::PollMsgChannel() {
+  const auto start = std::chrono::steady_clock::now();
+  int64_t msg_cnt = 0;
+  int64_t receive_cnt = 0;
   while (true) {
     if (local_msg_queue_.empty()) {
       CHECK_EQ(msg_channel_.ReceiveMany(&local_msg_queue_), kChannelStatusSuccess);
+      receive_cnt += 1;
     }
     ActorMsg msg = std::move(local_msg_queue_.front());
     local_msg_queue_.pop();
+    msg_cnt += 1;
     if (msg.msg_type() == ActorMsgType::kCmdMsg) {
       if (msg.actor_cmd() == ActorCmd::kStopThread) {
-        CHECK(id2actor_ptr_.empty())
+        CHECK_EQ(actor_slots_.size(), 0)
             << " RuntimeError! Thread: " << thrd_id_
-            << " NOT empty when stop with actor num: " << id2actor_ptr_.size();
+            << " NOT empty when stop with actor num: " << actor_slots_.size();
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        VLOG(1) << "Thread " << thrd_id_ << " handled " << msg_cnt << " actor msgs ("
+                << msg_cnt / std::max(seconds, 1e-9) << " msgs/s) in " << receive_cnt
+                << " channel receives";
         break;
       } else if (msg.actor_cmd() == ActorCmd::kConstructActor) {
         ConstructActor(msg.dst_actor_id());
@@ -78,15 +89,16 @@ void Thread::PollMsgChannel() {
       }
     }
     int64_t actor_id = msg.dst_actor_id();
-    auto actor_it = id2actor_ptr_.find(actor_id);
-    CHECK(actor_it != id2actor_ptr_.end());
-    int process_msg_ret = actor_it->second.second->ProcessMsg(msg);
+    ActorSlot* slot = actor_slots_.Find(actor_id);
+    CHECK(slot != nullptr) << "actor " << actor_id << " not found in thread " << thrd_id_;
+    int process_msg_ret = slot->actor->ProcessMsg(msg);
     if (process_msg_ret == 1) {
       VLOG(3) << "thread " << thrd_id_ << " deconstruct actor " << actor_id;
-      auto job_id_it = id2job_id_.find(actor_id);
-      const int64_t job_id = job_id_it->second;
-      id2job_id_.erase(job_id_it);
-      id2actor_ptr_.erase(actor_it);
+      const int64_t job_id = slot->job_id;
+      // NOTE: the actor may still use its context when destructed.
+      slot->actor.reset();
+      slot->actor_ctx.reset();
+      actor_slots_.Erase(actor_id);
       Singleton<RuntimeCtx>::Get()->DecreaseCounter(GetRunningActorCountKeyByJobId(job_id));
     } else {
       CHECK_EQ(process_msg_ret, 0);
@@ -110,9 +122,10 @@ void Thread::ConstructActor(int64_t actor_id) {
     VLOG(3) << "Thread " << thrd_id_ << " construct LightActor " << TaskType_Name(task.task_type())
             << " " << actor_id;
   }
-  CHECK(id2actor_ptr_.emplace(actor_id, std::make_pair(std::move(actor_ctx), std::move(actor_ptr)))
-            .second);
-  CHECK(id2job_id_.emplace(actor_id, task.job_id()).second);
+  ActorSlot* slot = actor_slots_.Insert(task.job_id(), actor_id);
+  slot->job_id = task.job_id();
+  slot->actor_ctx = std::move(actor_ctx);
+  slot->actor = std::move(actor_ptr);
   id2task_.erase(task_it);
   Singleton<RuntimeCtx>::Get()->DecreaseCounter("constructing_actor_cnt");
 }
@@ -19,6 +19,7 @@ limitations under the License.
 #include "oneflow/core/lazy/actor/actor_message_bus.h"
 #include "oneflow/core/common/channel.h"
 #include "oneflow/core/common/util.h"
+#include "oneflow/core/thread/actor_slot_table.h"
 #include "oneflow/core/job/task.pb.h"
 #include "oneflow/core/lazy/actor/actor.h"
 #include "oneflow/core/lazy/actor/actor_context.h"
@@ -50,7 +51,7 @@ class Thread {
     if (UseLocalMsgQueue()) {
       for (auto it = first; it != last; ++it) { local_msg_queue_.push(*it); }
     } else {
-      for (auto it = first; it != last; ++it) { msg_channel_.Send(*it); }
+      msg_channel_.SendMany(first, last);
     }
   }
 
@@ -58,6 +59,12 @@ class Thread {
   void PollMsgChannel();
 
  private:
+  struct ActorSlot {
+    int64_t job_id = -1;
+    std::unique_ptr<ActorContext> actor_ctx;
+    std::unique_ptr<ActorBase> actor;
+  };
+
   void ConstructActor(int64_t actor_id);
 
   inline bool UseLocalMsgQueue() const {
@@ -65,13 +72,12 @@ class Thread {
   }
 
   HashMap<int64_t, TaskProto> id2task_;
+  // Also guards the tasks added to actor_slots_.
   std::mutex id2task_mtx_;
 
   std::thread actor_thread_;
   Channel<ActorMsg> msg_channel_;
-  HashMap<int64_t, std::pair<std::unique_ptr<ActorContext>, std::unique_ptr<ActorBase>>>
-      id2actor_ptr_;
-  HashMap<int64_t, int64_t> id2job_id_;
+  ActorSlotTable<ActorSlot> actor_slots_;
   std::queue<ActorMsg> local_msg_queue_;
   bool local_msg_queue_enabled_;
   int64_t thrd_id_;
@@ -57,20 +57,17 @@ void MultiThreadLoop(size_t num, const DoEachT& DoEach) {
     SingleThreadLoop(num, DoEach);
     return;
   }
-  size_t thread_num = Singleton<ThreadPool>::Get()->thread_num();
-  thread_num = std::min(num, thread_num);
-  BalancedSplitter bs(num, thread_num);
-  BlockingCounter bc(thread_num);
-  FOR_RANGE(size_t, range_id, 0, thread_num) {
-    Singleton<ThreadPool>::Get()->AddWork([&bc, &bs, range_id, DoEach] {
-      size_t start = bs.At(range_id).begin();
-      size_t end = bs.At(range_id).end();
-      FOR_RANGE(size_t, i, start, end) { DoEach(i); }
-      bc.Decrease();
-    });
-  }
-  // buzy loop wait.
-  bc.WaitForeverUntilCntEqualZero();
+  ThreadPool* thread_pool = Singleton<ThreadPool>::Get();
+  // A few chunks per thread, so that idle workers can steal from the ones with expensive items.
+  const size_t num_chunks =
+      std::max<size_t>(std::min<size_t>(num, thread_pool->thread_num() * 4), 1);
+  const size_t grain_size = (num + num_chunks - 1) / num_chunks;
+  thread_pool->ParallelFor(
+      0, num,
+      [&DoEach](int64_t begin, int64_t end) {
+        FOR_RANGE(size_t, i, begin, end) { DoEach(i); }
+      },
+      grain_size);
 }
 
 }  // namespace oneflow
@@ -18,29 +18,179 @@ limitations under the License.
 
 namespace oneflow {
 
+namespace {
+
+constexpr int64_t kInitialWorkQueueCapacity = 1024;
+constexpr int32_t kMaxSpinsBeforePark = 64;
+
+thread_local const void* current_thread_pool = nullptr;
+thread_local int32_t current_worker_id = -1;
+
+struct ParallelForState {
+  ParallelForState(const std::function<void(int64_t, int64_t)>* func, int64_t begin, int64_t end,
+                   int64_t grain_size, int64_t num_chunks)
+      : func(func),
+        begin(begin),
+        end(end),
+        grain_size(grain_size),
+        num_chunks(num_chunks),
+        next_chunk(0),
+        num_pending_chunks(num_chunks) {}
+
+  // Helpers still queued after the loop is finished find no chunk left and never touch func.
+  void RunChunks() {
+    while (true) {
+      const int64_t chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+      if (chunk >= num_chunks) { break; }
+      const int64_t chunk_begin = begin + chunk * grain_size;
+      (*func)(chunk_begin, std::min(chunk_begin + grain_size, end));
+      if (num_pending_chunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_all();
+      }
+    }
+  }
+
+  void WaitUntilDone() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this]() { return num_pending_chunks.load(std::memory_order_acquire) == 0; });
+  }
+
+  const std::function<void(int64_t, int64_t)>* func;
+  int64_t begin;
+  int64_t end;
+  int64_t grain_size;
+  int64_t num_chunks;
+  std::atomic<int64_t> next_chunk;
+  std::atomic<int64_t> num_pending_chunks;
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+}  // namespace
+
 ThreadPool::ThreadPool(int32_t thread_num)
-    : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+    : injection_queue_size_(0),
+      threads_(thread_num),
+      park_epoch_(0),
+      num_parked_(0),
+      shutdown_(false) {
+  FOR_RANGE(int32_t, i, 0, thread_num) {
+    work_queues_.emplace_back(new WorkStealingQueue<Work>(kInitialWorkQueueCapacity));
+  }
   FOR_RANGE(int32_t, i, 0, thread_num) {
-    Channel<std::function<void()>>* chan = &(work_chans_.at(i));
-    threads_[i] = std::thread([chan]() {
-      SyncVmModeGuard guard(SyncVmMode::kEnable);
-      std::function<void()> work;
-      while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
-    });
+    threads_[i] = std::thread(&ThreadPool::WorkerLoop, this, i);
   }
 }
 
 ThreadPool::~ThreadPool() {
-  FOR_RANGE(int32_t, i, 0, work_chans_.size()) {
-    work_chans_.at(i).Close();
-    threads_.at(i).join();
-  }
+  shutdown_.store(true);
+  WakeUp(true);
+  for (std::thread& thread : threads_) { thread.join(); }
 }
 
 void ThreadPool::AddWork(const std::function<void()>& work) {
-  const size_t cur_chan_idx =
-      work_cnt_.fetch_add(1, std::memory_order_relaxed) % work_chans_.size();
-  work_chans_.at(cur_chan_idx).Send(work);
+  Enqueue(new Work(work));
+  WakeUp(false);
+}
+
+void ThreadPool::ParallelFor(int64_t begin, int64_t end,
+                             const std::function<void(int64_t, int64_t)>& func,
+                             int64_t grain_size) {
+  if (begin >= end) { return; }
+  grain_size = std::max<int64_t>(grain_size, 1);
+  const int64_t num_chunks = (end - begin + grain_size - 1) / grain_size;
+  if (num_chunks == 1 || threads_.empty()) {
+    func(begin, end);
+    return;
+  }
+  auto state = std::make_shared<ParallelForState>(&func, begin, end, grain_size, num_chunks);
+  const int64_t num_helpers = std::min<int64_t>(num_chunks - 1, threads_.size());
+  FOR_RANGE(int64_t, i, 0, num_helpers) {
+    Enqueue(new Work([state]() { state->RunChunks(); }));
+  }
+  WakeUp(true);
+  {
+    SyncVmModeGuard guard(SyncVmMode::kEnable);
+    state->RunChunks();
+  }
+  state->WaitUntilDone();
+}
+
+void ThreadPool::WorkerLoop(int32_t worker_id) {
+  SyncVmModeGuard guard(SyncVmMode::kEnable);
+  current_thread_pool = this;
+  current_worker_id = worker_id;
+  int32_t num_spins = 0;
+  while (true) {
+    Work* work = TryGetWork(worker_id);
+    if (work == nullptr && num_spins < kMaxSpinsBeforePark) {
+      num_spins += 1;
+      std::this_thread::yield();
+      continue;
+    }
+    if (work == nullptr) {
+      // Any work enqueued after the epoch is read either is found by the second try, or bumps the
+      // epoch so that the worker does not sleep.
+      const uint64_t epoch = park_epoch_.load();
+      work = TryGetWork(worker_id);
+      if (work == nullptr) {
+        if (shutdown_.load()) { break; }
+        std::unique_lock<std::mutex> lock(park_mutex_);
+        num_parked_.fetch_add(1);
+        while (park_epoch_.load() == epoch) { park_cond_.wait(lock); }
+        num_parked_.fetch_sub(1);
+        num_spins = 0;
+        continue;
+      }
+    }
+    (*work)();
+    delete work;
+    num_spins = 0;
+  }
+  current_thread_pool = nullptr;
+  current_worker_id = -1;
+}
+
+ThreadPool::Work* ThreadPool::TryGetWork(int32_t worker_id) {
+  Work* work = work_queues_.at(worker_id)->Pop();
+  if (work != nullptr) { return work; }
+  if (injection_queue_size_.load() > 0) {
+    std::lock_guard<std::mutex> lock(injection_mutex_);
+    if (!injection_queue_.empty()) {
+      work = injection_queue_.front();
+      injection_queue_.pop();
+      injection_queue_size_.fetch_sub(1);
+      return work;
+    }
+  }
+  const int32_t num_workers = work_queues_.size();
+  FOR_RANGE(int32_t, i, 1, num_workers) {
+    work = work_queues_.at((worker_id + i) % num_workers)->Steal();
+    if (work != nullptr) { return work; }
+  }
+  return nullptr;
+}
+
+void ThreadPool::Enqueue(Work* work) {
+  if (current_thread_pool == this) {
+    work_queues_.at(current_worker_id)->Push(work);
+  } else {
+    std::lock_guard<std::mutex> lock(injection_mutex_);
+    injection_queue_.push(work);
+    injection_queue_size_.fetch_add(1);
+  }
+}
+
+void ThreadPool::WakeUp(bool all) {
+  park_epoch_.fetch_add(1);
+  if (num_parked_.load() == 0) { return; }
+  std::lock_guard<std::mutex> lock(park_mutex_);
+  if (all) {
+    park_cond_.notify_all();
+  } else {
+    park_cond_.notify_one();
+  }
 }
 
 }  // namespace oneflow
@@ -18,9 +18,13 @@ limitations under the License.
 
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/common/channel.h"
+#include "oneflow/core/thread/work_stealing_queue.h"
 
 namespace oneflow {
 
+// Every worker owns a work stealing deque. Work added by a worker goes to its own deque, work added
+// by other threads goes to a shared injection queue, and idle workers steal from the others before
+// parking, so one long running task does not hold back the work queued after it.
 class ThreadPool final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ThreadPool);
@@ -30,12 +34,31 @@ class ThreadPool final {
 
   int32_t thread_num() const { return threads_.size(); }
   void AddWork(const std::function<void()>& work);
+  // Splits [begin, end) into chunks of grain_size and calls func(chunk_begin, chunk_end) for each
+  // of them. The calling thread works on the chunks too and returns after all of them are done.
+  void ParallelFor(int64_t begin, int64_t end, const std::function<void(int64_t, int64_t)>& func,
+                   int64_t grain_size);
 
  private:
-  std::vector<Channel<std::function<void()>>> work_chans_;
+  using Work = std::function<void()>;
+
+  void WorkerLoop(int32_t worker_id);
+  Work* TryGetWork(int32_t worker_id);
+  void Enqueue(Work* work);
+  void WakeUp(bool all);
+
+  std::vector<std::unique_ptr<WorkStealingQueue<Work>>> work_queues_;
+  std::mutex injection_mutex_;
+  std::queue<Work*> injection_queue_;
+  std::atomic<int64_t> injection_queue_size_;
   std::vector<std::thread> threads_;
 
-  std::atomic<size_t> work_cnt_;
+  // Parked workers wait for park_epoch_ to change, which is bumped after every enqueue.
+  std::mutex park_mutex_;
+  std::condition_variable park_cond_;
+  std::atomic<uint64_t> park_epoch_;
+  std::atomic<int32_t> num_parked_;
+  std::atomic<bool> shutdown_;
 };
 
 }  // namespace oneflow
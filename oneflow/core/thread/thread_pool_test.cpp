@@ -0,0 +1,155 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/common/blocking_counter.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+// The previous pool design: work is assigned round-robin to per-thread channels.
+class RoundRobinThreadPool final {
+ public:
+  explicit RoundRobinThreadPool(int32_t thread_num)
+      : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+    FOR_RANGE(int32_t, i, 0, thread_num) {
+      Channel<std::function<void()>>* chan = &(work_chans_.at(i));
+      threads_[i] = std::thread([chan]() {
+        std::function<void()> work;
+        while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
+      });
+    }
+  }
+  ~RoundRobinThreadPool() {
+    FOR_RANGE(int32_t, i, 0, work_chans_.size()) {
+      work_chans_.at(i).Close();
+      threads_.at(i).join();
+    }
+  }
+
+  void AddWork(const std::function<void()>& work) {
+    work_chans_.at(work_cnt_.fetch_add(1) % work_chans_.size()).Send(work);
+  }
+
+ private:
+  std::vector<Channel<std::function<void()>>> work_chans_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> work_cnt_;
+};
+
+void Spin(int64_t iters, std::atomic<int64_t>* sink) {
+  int64_t acc = 0;
+  for (int64_t i = 0; i < iters; ++i) { acc += i * i; }
+  sink->fetch_add(acc & 1, std::memory_order_relaxed);
+}
+
+// Every 8th task is 64 times as expensive as the others.
+template<typename PoolT>
+double RunSkewedTasks(PoolT* pool, int64_t num_tasks) {
+  std::atomic<int64_t> sink(0);
+  BlockingCounter bc(num_tasks);
+  const auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, i, 0, num_tasks) {
+    const int64_t iters = (i % 8 == 0) ? 64 * 20000 : 20000;
+    pool->AddWork([iters, &sink, &bc]() {
+      Spin(iters, &sink);
+      bc.Decrease();
+    });
+  }
+  bc.WaitForeverUntilCntEqualZero();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+TEST(ThreadPool, add_work) {
+  ThreadPool pool(4);
+  const int64_t num_works = 10000;
+  std::vector<std::atomic<int32_t>> visits(num_works);
+  for (auto& visit : visits) { visit = 0; }
+  BlockingCounter bc(num_works);
+  FOR_RANGE(int64_t, i, 0, num_works) {
+    pool.AddWork([i, &visits, &bc]() {
+      visits.at(i) += 1;
+      bc.Decrease();
+    });
+  }
+  bc.WaitForeverUntilCntEqualZero();
+  for (auto& visit : visits) { ASSERT_EQ(visit.load(), 1); }
+}
+
+TEST(ThreadPool, parallel_for) {
+  ThreadPool pool(4);
+  for (int64_t grain_size : {1, 7, 64, 100000}) {
+    const int64_t begin = 3;
+    const int64_t end = 10003;
+    std::vector<std::atomic<int32_t>> visits(end);
+    for (auto& visit : visits) { visit = 0; }
+    pool.ParallelFor(
+        begin, end,
+        [&](int64_t chunk_begin, int64_t chunk_end) {
+          ASSERT_LE(chunk_end - chunk_begin, grain_size);
+          FOR_RANGE(int64_t, i, chunk_begin, chunk_end) { visits.at(i) += 1; }
+        },
+        grain_size);
+    FOR_RANGE(int64_t, i, 0, end) { ASSERT_EQ(visits.at(i).load(), i < begin ? 0 : 1); }
+  }
+}
+
+TEST(ThreadPool, nested_parallel_for) {
+  ThreadPool pool(3);
+  std::atomic<int64_t> sum(0);
+  pool.ParallelFor(
+      0, 16,
+      [&](int64_t begin, int64_t end) {
+        FOR_RANGE(int64_t, i, begin, end) {
+          pool.ParallelFor(
+              0, 100,
+              [&](int64_t inner_begin, int64_t inner_end) {
+                sum.fetch_add(inner_end - inner_begin);
+              },
+              3);
+        }
+      },
+      1);
+  ASSERT_EQ(sum.load(), 1600);
+}
+
+// Only timings, run it with --gtest_also_run_disabled_tests to compare the pools.
+TEST(ThreadPool, DISABLED_skewed_tasks_benchmark) {
+  const int32_t thread_num = 4;
+  const int64_t num_tasks = 512;
+  double round_robin_ms = 0;
+  double work_stealing_ms = 0;
+  {
+    RoundRobinThreadPool pool(thread_num);
+    round_robin_ms = RunSkewedTasks(&pool, num_tasks);
+  }
+  {
+    ThreadPool pool(thread_num);
+    work_stealing_ms = RunSkewedTasks(&pool, num_tasks);
+  }
+  LOG(INFO) << "skewed tasks, round robin: " << round_robin_ms
+            << " ms, work stealing: " << work_stealing_ms << " ms";
+}
+
+}  // namespace test
+
+}  // namespace oneflow
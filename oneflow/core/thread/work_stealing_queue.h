@@ -0,0 +1,116 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_THREAD_WORK_STEALING_QUEUE_H_
+#define ONEFLOW_CORE_THREAD_WORK_STEALING_QUEUE_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Lock-free Chase-Lev deque ("Correct and Efficient Work-Stealing for Weak Memory Models",
+// Le et al. 2013). Only the owner thread may call Push and Pop, which work on the bottom end,
+// while any thread may call Steal, which takes from the top end.
+// Buffers replaced by Grow are kept until the queue is destroyed, since a concurrent Steal may
+// still read from them.
+template<typename T>
+class WorkStealingQueue final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(WorkStealingQueue);
+  explicit WorkStealingQueue(int64_t capacity) : top_(0), bottom_(0) {
+    CHECK_GT(capacity, 0);
+    CHECK_EQ(capacity & (capacity - 1), 0);
+    buffers_.emplace_back(new Buffer(capacity));
+    buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+  }
+  ~WorkStealingQueue() = default;
+
+  void Push(T* item) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    if (bottom - top > buffer->capacity - 1) { buffer = Grow(buffer, top, bottom); }
+    buffer->Put(bottom, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  T* Pop() {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T* item = buffer->Get(bottom);
+    if (top == bottom) {
+      // Last item, race against thieves for it.
+      if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Returns nullptr only if the queue was observed empty.
+  T* Steal() {
+    while (true) {
+      int64_t top = top_.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const int64_t bottom = bottom_.load(std::memory_order_acquire);
+      if (top >= bottom) { return nullptr; }
+      Buffer* buffer = buffer_.load(std::memory_order_acquire);
+      T* item = buffer->Get(top);
+      if (top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+        return item;
+      }
+    }
+  }
+
+ private:
+  struct Buffer {
+    explicit Buffer(int64_t capacity)
+        : capacity(capacity), mask(capacity - 1), items(new std::atomic<T*>[capacity]) {}
+    T* Get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+    void Put(int64_t i, T* item) { items[i & mask].store(item, std::memory_order_relaxed); }
+
+    int64_t capacity;
+    int64_t mask;
+    std::unique_ptr<std::atomic<T*>[]> items;
+  };
+
+  Buffer* Grow(Buffer* buffer, int64_t top, int64_t bottom) {
+    buffers_.emplace_back(new Buffer(buffer->capacity * 2));
+    Buffer* new_buffer = buffers_.back().get();
+    for (int64_t i = top; i < bottom; ++i) { new_buffer->Put(i, buffer->Get(i)); }
+    buffer_.store(new_buffer, std::memory_order_release);
+    return new_buffer;
+  }
+
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  std::atomic<Buffer*> buffer_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_THREAD_WORK_STEALING_QUEUE_H_
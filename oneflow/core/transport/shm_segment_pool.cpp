@@ -0,0 +1,95 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include "oneflow/core/transport/shm_segment_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+constexpr std::size_t kMinShmSegmentSize = 64 * 1024;
+
+}  // namespace
+
+ShmSegmentPool::~ShmSegmentPool() {
+  // Receivers have mapped the segments already, so unlinking only removes their names.
+  for (auto& pair : dst_machine_id2free_segments_) {
+    for (auto& size7segment : pair.second) { CHECK_JUST(size7segment.second->Unlink()); }
+  }
+}
+
+Maybe<ipc::SharedMemory> ShmSegmentPool::Acquire(int64_t dst_machine_id, std::size_t size) {
+  std::size_t segment_size = kMinShmSegmentSize;
+  while (segment_size < size) { segment_size *= 2; }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& free_segments = dst_machine_id2free_segments_[dst_machine_id];
+    auto it = free_segments.find(segment_size);
+    if (it != free_segments.end()) {
+      std::shared_ptr<ipc::SharedMemory> segment = std::move(it->second);
+      free_segments.erase(it);
+      free_bytes_ -= segment_size;
+      return segment;
+    }
+  }
+  return ipc::SharedMemory::Open(segment_size, /*create=*/true);
+}
+
+void ShmSegmentPool::Release(int64_t dst_machine_id, std::shared_ptr<ipc::SharedMemory> segment) {
+  const std::size_t segment_size = segment->size();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (free_bytes_ + segment_size <= max_bytes_) {
+      dst_machine_id2free_segments_[dst_machine_id].emplace(segment_size, std::move(segment));
+      free_bytes_ += segment_size;
+      return;
+    }
+  }
+  CHECK_JUST(segment->Unlink());
+}
+
+Maybe<ipc::SharedMemory> ShmSegmentPool::Map(const std::string& name) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = name2mapped_segment_.find(name);
+  if (it != name2mapped_segment_.end()) { return it->second; }
+  std::shared_ptr<ipc::SharedMemory> segment = JUST(ipc::SharedMemory::OpenUnmanaged(name));
+  // Callers still copying out of an evicted segment hold it until they are done.
+  while (!mapped_names_.empty() && mapped_bytes_ + segment->size() > max_bytes_) {
+    auto evicted = name2mapped_segment_.find(mapped_names_.front());
+    mapped_bytes_ -= evicted->second->size();
+    name2mapped_segment_.erase(evicted);
+    mapped_names_.pop_front();
+  }
+  name2mapped_segment_.emplace(name, segment);
+  mapped_names_.emplace_back(name);
+  mapped_bytes_ += segment->size();
+  return segment;
+}
+
+std::size_t ShmSegmentPool::free_bytes() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return free_bytes_;
+}
+
+std::size_t ShmSegmentPool::mapped_bytes() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return mapped_bytes_;
+}
+
+}  // namespace oneflow
+
+#endif  // __linux__
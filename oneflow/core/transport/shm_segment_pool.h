@@ -0,0 +1,63 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#ifndef ONEFLOW_CORE_TRANSPORT_SHM_SEGMENT_POOL_H_
+#define ONEFLOW_CORE_TRANSPORT_SHM_SEGMENT_POOL_H_
+
+#include "oneflow/core/ipc/shared_memory.h"
+
+namespace oneflow {
+
+// ShmSegmentPool holds the shared memory segments Transport uses between processes on the same
+// host.
+//
+// The sender acquires a segment per Send and releases it when the Ack msg arrives. Released
+// segments are kept per dst machine and keyed by their power-of-two size until their total size
+// reaches max_bytes; beyond that they are unlinked at once. Only the sender unlinks the segments
+// it created.
+//
+// The receiver maps segments by name and keeps the mappings for reuse. Mappings beyond max_bytes
+// are dropped oldest first, so a segment the sender has unlinked is eventually unmapped.
+class ShmSegmentPool final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShmSegmentPool);
+  explicit ShmSegmentPool(std::size_t max_bytes) : max_bytes_(max_bytes) {}
+  ~ShmSegmentPool();
+
+  Maybe<ipc::SharedMemory> Acquire(int64_t dst_machine_id, std::size_t size);
+  void Release(int64_t dst_machine_id, std::shared_ptr<ipc::SharedMemory> segment);
+  Maybe<ipc::SharedMemory> Map(const std::string& name);
+
+  std::size_t free_bytes() const;
+  std::size_t mapped_bytes() const;
+
+ private:
+  const std::size_t max_bytes_;
+  mutable std::mutex mutex_;
+  HashMap<int64_t, std::multimap<std::size_t, std::shared_ptr<ipc::SharedMemory>>>
+      dst_machine_id2free_segments_;
+  std::size_t free_bytes_ = 0;
+  HashMap<std::string, std::shared_ptr<ipc::SharedMemory>> name2mapped_segment_;
+  std::deque<std::string> mapped_names_;
+  std::size_t mapped_bytes_ = 0;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_TRANSPORT_SHM_SEGMENT_POOL_H_
+
+#endif  // __linux__
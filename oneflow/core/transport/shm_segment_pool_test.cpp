@@ -0,0 +1,124 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "oneflow/core/transport/shm_segment_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+bool ShmExists(const std::string& name) { return access(("/dev/shm/" + name).c_str(), F_OK) == 0; }
+
+}  // namespace
+
+TEST(ShmSegmentPool, map_in_other_process) {
+  std::string name;
+  {
+    ShmSegmentPool sender(1 << 20);
+    std::shared_ptr<ipc::SharedMemory> segment = CHECK_JUST(sender.Acquire(1, 1000));
+    ASSERT_GE(segment->size(), 1000);
+    name = segment->name();
+    for (int i = 0; i < 1000; ++i) { segment->mut_buf()[i] = static_cast<char>(i % 127); }
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      // The forked receiver inherits the names registered by the sender, a real receiver process
+      // does not.
+      CHECK_JUST(ipc::SharedMemoryManager::get().DeleteShmName(name));
+      ShmSegmentPool receiver(1 << 20);
+      std::shared_ptr<ipc::SharedMemory> mapped = CHECK_JUST(receiver.Map(name));
+      for (int i = 0; i < 1000; ++i) {
+        if (mapped->buf()[i] != static_cast<char>(i % 127)) { _exit(1); }
+      }
+      // The receiver must leave unlinking to the sender.
+      if (TRY(ipc::SharedMemoryManager::get().DeleteShmName(name)).IsOk()) { _exit(2); }
+      _exit(0);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    ASSERT_TRUE(ShmExists(name));
+    sender.Release(1, std::move(segment));
+  }
+  ASSERT_FALSE(ShmExists(name));
+}
+
+TEST(ShmSegmentPool, bounded_free_segments) {
+  ShmSegmentPool pool(64 * 1024);
+  std::shared_ptr<ipc::SharedMemory> first = CHECK_JUST(pool.Acquire(1, 64 * 1024));
+  std::shared_ptr<ipc::SharedMemory> second = CHECK_JUST(pool.Acquire(1, 64 * 1024));
+  const std::string first_name = first->name();
+  const std::string second_name = second->name();
+  ASSERT_NE(first_name, second_name);
+
+  pool.Release(1, std::move(first));
+  ASSERT_EQ(pool.free_bytes(), 64 * 1024);
+  pool.Release(1, std::move(second));
+  ASSERT_EQ(pool.free_bytes(), 64 * 1024);
+  ASSERT_TRUE(ShmExists(first_name));
+  ASSERT_FALSE(ShmExists(second_name));
+
+  std::shared_ptr<ipc::SharedMemory> reused = CHECK_JUST(pool.Acquire(1, 100));
+  ASSERT_EQ(reused->name(), first_name);
+  ASSERT_EQ(pool.free_bytes(), 0);
+  pool.Release(1, std::move(reused));
+}
+
+TEST(ShmSegmentPool, bounded_mapped_segments) {
+  ShmSegmentPool sender(1 << 20);
+  ShmSegmentPool receiver(64 * 1024);
+  std::shared_ptr<ipc::SharedMemory> first = CHECK_JUST(sender.Acquire(1, 100));
+  std::shared_ptr<ipc::SharedMemory> second = CHECK_JUST(sender.Acquire(1, 100));
+  std::shared_ptr<ipc::SharedMemory> first_mapped = CHECK_JUST(receiver.Map(first->name()));
+  ASSERT_EQ(CHECK_JUST(receiver.Map(first->name())), first_mapped);
+  ASSERT_EQ(receiver.mapped_bytes(), 64 * 1024);
+  CHECK_JUST(receiver.Map(second->name()));
+  ASSERT_EQ(receiver.mapped_bytes(), 64 * 1024);
+  // The evicted mapping stays valid for its holders and is mapped again on the next Map.
+  ASSERT_NE(CHECK_JUST(receiver.Map(first->name())), first_mapped);
+  sender.Release(1, std::move(first));
+  sender.Release(1, std::move(second));
+}
+
+TEST(ShmSegmentPool, acquire_failure) {
+  ShmSegmentPool pool(1 << 20);
+  ASSERT_FALSE(TRY(pool.Acquire(1, static_cast<std::size_t>(1) << 60)).IsOk());
+  ASSERT_EQ(pool.free_bytes(), 0);
+}
+
+TEST(ShmSegmentPool, map_failure) {
+  ShmSegmentPool sender(1 << 20);
+  ShmSegmentPool receiver(1 << 20);
+  // As seen by a receiver that does not share /dev/shm with the sender.
+  ASSERT_FALSE(TRY(receiver.Map("ofshm_not_on_this_host")).IsOk());
+  // A segment the sender has unlinked already.
+  std::shared_ptr<ipc::SharedMemory> segment = CHECK_JUST(sender.Acquire(1, 100));
+  const std::string name = segment->name();
+  CHECK_JUST(segment->Unlink());
+  ASSERT_FALSE(TRY(receiver.Map(name)).IsOk());
+  ASSERT_EQ(receiver.mapped_bytes(), 0);
+}
+
+}  // namespace oneflow
+
+#endif  // __linux__
@@ -23,6 +23,9 @@ namespace oneflow {
 Transport::Transport() {
   comm_net_ = Singleton<EpollCommNet>::Get();  // NOLINT
   this_machine_id_ = GlobalProcessCtx::Rank();
+  use_shm_ = ParseBooleanFromEnv("ONEFLOW_TRANSPORT_USE_SHM", true);
+  shm_pool_.reset(
+      new ShmSegmentPool(ParseIntegerFromEnv("ONEFLOW_TRANSPORT_SHM_POOL_MB", 256) << 20));
   CHECK(comm_net_ != nullptr);
   // maybe need new read id for each dst machine id, maybe need 2 * machine num read ids
   read_id_ = comm_net_->NewActorReadId();
@@ -56,6 +59,10 @@ void Transport::PollMsgChannel() {
         HandlerAchievedTransportAckMsgFromDstMachine(msg);
         break;
       }
+      case TransportMsgType::kShmNack: {
+        HandlerAchievedTransportShmNackMsgFromDstMachine(msg);
+        break;
+      }
       default: UNIMPLEMENTED(); break;
     }
   }
@@ -112,6 +119,7 @@ void Transport::HandlerAchievedTransportSendMsgFromSrcMachine(const TransportMsg
     CHECK(stat->src_mem_token == nullptr);
     // src_mem_token MUST init in the block protected by lock
     stat->src_mem_token = msg.src_mem_token;
+    stat->shm_name = msg.shm_name;
   }
 
   if (recv_before_send) {
@@ -130,10 +138,12 @@ void Transport::HandlerAchievedTransportAckMsgFromDstMachine(const TransportMsg&
   // this token is all done. So we can call callback function and erase TransportStatus.
   CHECK_EQ(msg.type, TransportMsgType::kAck);
   CHECK(msg.src_mem_token != nullptr);
-  CHECK(msg.dst_mem_token != nullptr);
+  // The receiver does not register memory if the data is in a shared memory segment.
+  CHECK(msg.dst_mem_token != nullptr || msg.shm_name[0] != '\0');
   uint64_t token = msg.token;
   CHECK(token != -1);
   std::function<void()> callback;
+  std::shared_ptr<ipc::SharedMemory> shm_segment;
 
   // get status from map
   {
@@ -150,18 +160,60 @@ void Transport::HandlerAchievedTransportAckMsgFromDstMachine(const TransportMsg&
     CHECK(stat->callback != nullptr);
 
     callback = stat->callback;
+    shm_segment = std::move(stat->shm_segment);
 
     // Recovery status
     token2status_.erase(it);
   }
 
-  // UnRegisterMemory
-  comm_net_->UnRegisterMemory(msg.src_mem_token);
+  if (shm_segment) {
+    shm_pool_->Release(msg.dst_machine_id, std::move(shm_segment));
+  } else {
+    // UnRegisterMemory
+    comm_net_->UnRegisterMemory(msg.src_mem_token);
+  }
 
   // Do Send callback
   callback();
 }
 
+void Transport::HandlerAchievedTransportShmNackMsgFromDstMachine(const TransportMsg& msg) {
+  // This machine is src machine, and the dst machine could not map the shared memory segment of
+  // the Send msg. The data is sent again through CommNet.
+  CHECK_EQ(msg.type, TransportMsgType::kShmNack);
+  CHECK(msg.src_mem_token != nullptr);
+  uint64_t token = msg.token;
+  CHECK(token != -1);
+  TransportStatus* stat = nullptr;
+  std::shared_ptr<ipc::SharedMemory> shm_segment;
+  {
+    std::unique_lock<std::mutex> lock(status_mutex_);
+    auto it = token2status_.find(token);
+    CHECK(it != token2status_.end());
+    stat = &(it->second);
+    CHECK_EQ(stat->src_mem_token, msg.src_mem_token);
+    CHECK_EQ(stat->dst_machine_id, msg.dst_machine_id);
+    CHECK(stat->shm_segment);
+    shm_segment = std::move(stat->shm_segment);
+    // The Ack msg of the resent data finds the memory registered instead of a segment.
+    stat->src_mem_token = comm_net_->RegisterMemory(stat->src_ptr, stat->size);
+  }
+  DisableShm("machine " + std::to_string(msg.dst_machine_id)
+             + " could not map the shared memory segment " + shm_segment->name());
+  shm_pool_->Release(msg.dst_machine_id, std::move(shm_segment));
+
+  TransportMsg send_msg;
+  send_msg.token = token;
+  send_msg.src_machine_id = stat->src_machine_id;
+  send_msg.dst_machine_id = stat->dst_machine_id;
+  send_msg.size = stat->size;
+  send_msg.src_mem_token = stat->src_mem_token;
+  send_msg.dst_mem_token = nullptr;
+  send_msg.type = TransportMsgType::kSend;
+  std::memset(send_msg.shm_name, 0, kTransportShmNameSize);
+  comm_net_->SendTransportMsg(send_msg.dst_machine_id, send_msg);
+}
+
 void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, std::size_t size,
                      std::function<void()> callback) {
   void* mut_ptr = const_cast<void*>(ptr);
@@ -185,8 +237,19 @@ void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, st
   stat->callback = callback;
   stat->is_send_ready = true;
   stat->is_recv_ready = false;
-  stat->src_mem_token = comm_net_->RegisterMemory(mut_ptr, size);
+  if (use_shm_ && IsOnThisHost(dst_machine_id)) {
+    stat->shm_segment = TryAcquireShmSegment(dst_machine_id, size);
+  }
+  const bool use_shm = stat->shm_segment != nullptr;
+  if (use_shm) {
+    // The segment address is only used as the token identifying this Send on the src machine.
+    std::memcpy(stat->shm_segment->mut_buf(), ptr, size);
+    stat->src_mem_token = stat->shm_segment.get();
+  } else {
+    stat->src_mem_token = comm_net_->RegisterMemory(mut_ptr, size);
+  }
   stat->dst_mem_token = nullptr;
+  stat->src_ptr = mut_ptr;
   stat->size = size;
   stat->src_machine_id = this_machine_id_;
   stat->dst_machine_id = dst_machine_id;
@@ -200,6 +263,12 @@ void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, st
   msg.src_mem_token = stat->src_mem_token;
   msg.dst_mem_token = stat->dst_mem_token;
   msg.type = TransportMsgType::kSend;
+  std::memset(msg.shm_name, 0, kTransportShmNameSize);
+  if (use_shm) {
+    const std::string& shm_name = stat->shm_segment->name();
+    CHECK_LT(shm_name.size(), kTransportShmNameSize);
+    std::memcpy(msg.shm_name, shm_name.data(), shm_name.size());
+  }
   comm_net_->SendTransportMsg(msg.dst_machine_id, msg);
 }
 
@@ -262,10 +331,16 @@ void Transport::DoRead(uint64_t token) {
     CHECK(it != token2status_.end());
     stat = &(it->second);
 
-    // dst_mem_token MUST init in the block protected by lock
-    CHECK(stat->dst_mem_token == nullptr);
-    // NOTE(chengcheng): ONLY at this time, the stat->size is the real size assigned by Send
-    stat->dst_mem_token = comm_net_->RegisterMemory(stat->dst_ptr, stat->size);
+    if (stat->shm_name.empty()) {
+      // dst_mem_token MUST init in the block protected by lock
+      CHECK(stat->dst_mem_token == nullptr);
+      // NOTE(chengcheng): ONLY at this time, the stat->size is the real size assigned by Send
+      stat->dst_mem_token = comm_net_->RegisterMemory(stat->dst_ptr, stat->size);
+    }
+  }
+  if (!stat->shm_name.empty()) {
+    DoShmRead(token);
+    return;
   }
   CHECK(stat->is_send_ready && stat->is_recv_ready);
   CHECK(stat->src_mem_token != nullptr);
@@ -285,6 +360,7 @@ void Transport::DoRead(uint64_t token) {
     msg.src_mem_token = stat->src_mem_token;
     msg.dst_mem_token = stat->dst_mem_token;
     msg.type = TransportMsgType::kAck;
+    std::memset(msg.shm_name, 0, kTransportShmNameSize);
     comm_net_->SendTransportMsg(msg.src_machine_id, msg);
 
     // UnRegisterMemory
@@ -303,6 +379,91 @@ void Transport::DoRead(uint64_t token) {
   });
 }
 
+void Transport::DoShmRead(uint64_t token) {
+  TransportStatus* stat = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(status_mutex_);
+    auto it = token2status_.find(token);
+    CHECK(it != token2status_.end());
+    stat = &(it->second);
+  }
+  CHECK(stat->is_send_ready && stat->is_recv_ready);
+  CHECK(stat->callback);
+  auto maybe_segment = TRY(shm_pool_->Map(stat->shm_name));
+  if (!maybe_segment.IsOk()) {
+    // Ask the src machine to send the data again through CommNet, the status waits for the new
+    // Send msg like a Receive() called before it.
+    TransportMsg msg;
+    msg.token = stat->token;
+    msg.src_machine_id = stat->src_machine_id;
+    msg.dst_machine_id = stat->dst_machine_id;
+    msg.size = stat->size;
+    msg.src_mem_token = stat->src_mem_token;
+    msg.dst_mem_token = nullptr;
+    msg.type = TransportMsgType::kShmNack;
+    std::memset(msg.shm_name, 0, kTransportShmNameSize);
+    std::memcpy(msg.shm_name, stat->shm_name.data(), stat->shm_name.size());
+    const std::string shm_name = stat->shm_name;
+    {
+      std::unique_lock<std::mutex> lock(status_mutex_);
+      stat->is_send_ready = false;
+      stat->src_mem_token = nullptr;
+      stat->shm_name.clear();
+    }
+    DisableShm("the shared memory segment " + shm_name
+               + " could not be mapped: " + maybe_segment.GetSerializedError());
+    comm_net_->SendTransportMsg(msg.src_machine_id, msg);
+    return;
+  }
+  std::shared_ptr<ipc::SharedMemory> segment = CHECK_JUST(maybe_segment);
+  CHECK_LE(stat->size, segment->size());
+  std::memcpy(stat->dst_ptr, segment->buf(), stat->size);
+
+  // Send ack message to source machine, which can reuse the segment from now on
+  TransportMsg msg;
+  msg.token = stat->token;
+  msg.src_machine_id = stat->src_machine_id;
+  msg.dst_machine_id = stat->dst_machine_id;
+  msg.size = stat->size;
+  msg.src_mem_token = stat->src_mem_token;
+  msg.dst_mem_token = nullptr;
+  msg.type = TransportMsgType::kAck;
+  std::memset(msg.shm_name, 0, kTransportShmNameSize);
+  std::memcpy(msg.shm_name, stat->shm_name.data(), stat->shm_name.size());
+  comm_net_->SendTransportMsg(msg.src_machine_id, msg);
+
+  // Do Receive callback
+  stat->callback();
+
+  // Recovery status
+  {
+    std::unique_lock<std::mutex> lock(status_mutex_);
+    auto it = token2status_.find(token);
+    CHECK(it != token2status_.end());
+    token2status_.erase(it);
+  }
+}
+
+bool Transport::IsOnThisHost(int64_t machine_id) const {
+  return GlobalProcessCtx::NodeId(machine_id) == GlobalProcessCtx::ThisNodeId();
+}
+
+std::shared_ptr<ipc::SharedMemory> Transport::TryAcquireShmSegment(int64_t dst_machine_id,
+                                                                   std::size_t size) {
+  auto maybe_segment = TRY(shm_pool_->Acquire(dst_machine_id, size));
+  if (maybe_segment.IsOk()) { return CHECK_JUST(maybe_segment); }
+  DisableShm("a shared memory segment of " + std::to_string(size)
+             + " bytes could not be created: " + maybe_segment.GetSerializedError());
+  return nullptr;
+}
+
+void Transport::DisableShm(const std::string& reason) {
+  if (use_shm_.exchange(false)) {
+    LOG(WARNING) << "Transport falls back to CommNet for processes on the same host, because "
+                 << reason;
+  }
+}
+
 void Transport::SendToLocalMachine(uint64_t token, void* ptr, std::size_t size,
                                    std::function<void()> callback) {
   bool need_do_copy = false;
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "oneflow/core/common/channel.h"
 #include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
+#include "oneflow/core/transport/shm_segment_pool.h"
 #include "oneflow/core/transport/transport_message.h"
 
 namespace oneflow {
@@ -45,6 +46,15 @@ namespace oneflow {
 //
 // Transport supports send and receive data on local machine.
 //
+// Between two processes on the same host, the data is not read through CommNet. The sender copies
+// it into a shared memory segment, whose name is part of the Send msg, and the receiver copies it
+// out, see ShmSegmentPool. ONEFLOW_TRANSPORT_SHM_POOL_MB bounds the size of the pooled segments
+// and of the segments mapped by the receiver. If a segment cannot be created, e.g. because
+// /dev/shm is too small, Transport warns once and uses CommNet from then on. If the receiver
+// cannot map a segment, e.g. because the processes do not share /dev/shm, it answers with a
+// ShmNack msg, and the sender sends the data again through CommNet and stops using shared memory
+// as well. Set ONEFLOW_TRANSPORT_USE_SHM=0 to always use CommNet.
+//
 class Transport {
  public:
   OF_DISALLOW_COPY_AND_MOVE(Transport);
@@ -60,7 +70,13 @@ class Transport {
   void PollMsgChannel();
   void HandlerAchievedTransportSendMsgFromSrcMachine(const TransportMsg& msg);
   void HandlerAchievedTransportAckMsgFromDstMachine(const TransportMsg& msg);
+  void HandlerAchievedTransportShmNackMsgFromDstMachine(const TransportMsg& msg);
   void DoRead(uint64_t token);
+  void DoShmRead(uint64_t token);
+  bool IsOnThisHost(int64_t machine_id) const;
+  std::shared_ptr<ipc::SharedMemory> TryAcquireShmSegment(int64_t dst_machine_id,
+                                                          std::size_t size);
+  void DisableShm(const std::string& reason);
   void SendToLocalMachine(uint64_t token, void* ptr, std::size_t size,
                           std::function<void()> callback);
   void RecvFromLocalMachine(uint64_t token, void* ptr, std::size_t max_size,
@@ -87,9 +103,16 @@ class Transport {
     void* dst_mem_token;
     // NOTE(chengcheng): must store dst_ptr in status when Receive max_size > Send size
     void* dst_ptr;
+    // Only for machines on the same host, the data is sent again from src_ptr if the receiver
+    // cannot map the segment.
+    void* src_ptr;
     std::size_t size;
     int64_t src_machine_id;
     int64_t dst_machine_id;
+    // Only for machines on the same host, the segment is held by the sender until the Ack msg
+    // arrives and its name is stored by the receiver.
+    std::shared_ptr<ipc::SharedMemory> shm_segment;
+    std::string shm_name;
     TransportStatus(uint64_t tk)
         : token(tk),
           callback(nullptr),
@@ -97,6 +120,8 @@ class Transport {
           is_recv_ready(false),
           src_mem_token(nullptr),
           dst_mem_token(nullptr),
+          dst_ptr(nullptr),
+          src_ptr(nullptr),
           size(-1),
           src_machine_id(-1),
           dst_machine_id(-1) {}
@@ -129,6 +154,10 @@ class Transport {
   std::mutex local_copy_lock_;
   HashMap<uint64_t, CopyStatusOnLocalMachine> token2local_copy_status_;
 
+  // for shared memory between processes on the same host
+  std::atomic<bool> use_shm_;
+  std::unique_ptr<ShmSegmentPool> shm_pool_;
+
   int64_t this_machine_id_;
   void* read_id_;
   EpollCommNet* comm_net_;
@@ -27,8 +27,13 @@ enum class TransportMsgType {
   kInvalid = 0,
   kSend = 1,  // send msg from local to remote transport
   kAck = 2,   // this token transmission task is down
+  // the shared memory segment of the send msg could not be mapped by the dst machine, the src
+  // machine sends the data again through CommNet
+  kShmNack = 3,
 };
 
+constexpr size_t kTransportShmNameSize = 32;
+
 struct TransportMsg {
   uint64_t token;
   void* src_mem_token;
@@ -37,6 +42,9 @@ struct TransportMsg {
   int64_t src_machine_id;
   int64_t dst_machine_id;
   TransportMsgType type;
+  // Name of the shared memory segment holding the data if src and dst machine are on the same
+  // host, empty otherwise.
+  char shm_name[kTransportShmNameSize];
 };
 
 }  // namespace oneflow
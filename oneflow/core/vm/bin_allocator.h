@@ -24,6 +24,26 @@ limitations under the License.
 namespace oneflow {
 namespace vm {
 
+struct BinAllocatorStats {
+  uint64_t num_allocations = 0;
+  // Allocations served by a thread cache without taking the allocator lock
+  uint64_t num_thread_cache_hits = 0;
+  uint64_t num_deallocations = 0;
+  // Deallocations from threads which never allocated, queued until the next locked operation
+  uint64_t num_deferred_deallocations = 0;
+  // Bytes held from the backend
+  size_t total_memory_bytes = 0;
+  // Bytes handed out and not deallocated yet
+  size_t allocated_bytes = 0;
+  // Bytes of deallocated pieces kept in thread caches
+  size_t thread_cached_bytes = 0;
+  // Bytes of free pieces in bins
+  size_t free_bytes = 0;
+  size_t largest_free_piece_bytes = 0;
+  // 1 - largest_free_piece_bytes / free_bytes, 0 means all free memory is one piece
+  double fragmentation = 0;
+};
+
 template<typename ThreadLock>
 class BinAllocator final : public CachingAllocator {
  public:
@@ -38,12 +58,20 @@ class BinAllocator final : public CachingAllocator {
   }
   void Shrink() override {
     typename ThreadLock::RAIIGuard guard(thread_lock_);
+    DeallocateDeferredPieces();
+    FlushThreadCaches();
     DeallocateFreeBlockForGarbageCollection();
   }
 
+  void GetStats(BinAllocatorStats* stats);
+
  private:
   static constexpr int32_t kInvalidBinNum = -1;
   static constexpr int32_t kBinNumSize = 20;
+  // Pieces of aligned size alignment_ * (size_class + 1) are cached per thread.
+  static constexpr int32_t kInvalidSizeClass = -1;
+  static constexpr int32_t kNumSizeClasses = 64;
+  static constexpr size_t kMaxThreadCacheBytes = 4 << 20;  // 4MiB
 
   // Piece is the basic memory unit of BinAllocator.
   // A Piece is either is free(is_free = true) or in used(is_free = false).
@@ -91,8 +119,46 @@ class BinAllocator final : public CachingAllocator {
     Block(Piece* p) : size(p->size), ptr(p->ptr), start_piece(p) {}
   };
 
+  // ThreadCache keeps small pieces deallocated by a thread which also allocates from this
+  // allocator, so that they are handed out again in O(1) without taking thread_lock_. The pieces
+  // stay in use from the point of view of the bins until the cache is flushed. The mutex is only
+  // contended when Shrink or GetStats inspects the cache from another thread.
+  struct ThreadCache {
+    std::mutex mutex;
+    std::vector<std::vector<char*>> free_lists;
+    size_t cached_bytes = 0;
+  };
+
+  // Deallocations from threads without a ThreadCache are pushed onto a lock free list and done
+  // by the next thread holding thread_lock_.
+  struct DeferredPiece {
+    char* ptr;
+    size_t size;
+    DeferredPiece* next;
+  };
+
   size_t BinSize4BinNum(int32_t bin_num) { return kCudaMemAllocAlignSize << bin_num; }
 
+  int32_t SizeClass4AlignedSize(size_t aligned_size) const {
+    const size_t size_class = aligned_size / alignment_ - 1;
+    return size_class < kNumSizeClasses ? static_cast<int32_t>(size_class) : kInvalidSizeClass;
+  }
+
+  static HashMap<uint64_t, ThreadCache*>* MutThreadLocalId2ThreadCache() {
+    static thread_local HashMap<uint64_t, ThreadCache*> id2thread_cache;
+    return &id2thread_cache;
+  }
+  // Returns the ThreadCache of the calling thread, or nullptr if it never allocated
+  ThreadCache* FindThreadCache();
+  ThreadCache* CreateThreadCache();
+  // Deallocate all pieces kept in thread caches, must be called with thread_lock_ held
+  void FlushThreadCaches();
+  void PushDeferredPiece(char* mem_ptr, std::size_t size);
+  // Must be called with thread_lock_ held
+  void DeallocateDeferredPieces();
+  // Return the piece to its bin, must be called with thread_lock_ held
+  void DeallocatePieceMemory(char* mem_ptr, std::size_t size);
+
   int32_t BinNum4BinSize(size_t size) {
     uint64_t value = std::max(size, kCudaMemAllocAlignSize) >> 9;
     return std::min(kBinNumSize - 1, static_cast<int32_t>(63 ^ __builtin_clzll(value)));
@@ -133,8 +199,23 @@ class BinAllocator final : public CachingAllocator {
   std::vector<std::unique_ptr<Piece>> pieces_;
   HashMap<char*, Piece*> ptr2piece_;
   Piece* recycle_piece_list_;
+
+  // Never reused, so stale thread local entries of a destroyed allocator are never matched.
+  static std::atomic<uint64_t> next_id_;
+  const uint64_t id_;
+  std::vector<std::unique_ptr<ThreadCache>> thread_caches_;
+  std::atomic<DeferredPiece*> deferred_pieces_;
+
+  std::atomic<uint64_t> num_allocations_;
+  std::atomic<uint64_t> num_thread_cache_hits_;
+  std::atomic<uint64_t> num_deallocations_;
+  std::atomic<uint64_t> num_deferred_deallocations_;
+  std::atomic<int64_t> allocated_bytes_;
 };
 
+template<typename ThreadLock>
+std::atomic<uint64_t> BinAllocator<ThreadLock>::next_id_(0);
+
 namespace {
 
 inline size_t MemAlignedBytes(size_t bytes, size_t alignment) { return RoundUp(bytes, alignment); }
@@ -151,7 +232,14 @@ BinAllocator<ThreadLock>::BinAllocator(size_t alignment, std::unique_ptr<Allocat
       alignment_(alignment),
       backend_(std::move(backend)),
       total_memory_bytes_(0),
-      recycle_piece_list_(nullptr) {
+      recycle_piece_list_(nullptr),
+      id_(next_id_.fetch_add(1)),
+      deferred_pieces_(nullptr),
+      num_allocations_(0),
+      num_thread_cache_hits_(0),
+      num_deallocations_(0),
+      num_deferred_deallocations_(0),
+      allocated_bytes_(0) {
   CHECK_GE(alignment, 1);
   CHECK_EQ(1 << static_cast<int>(std::log2(alignment)), alignment);
   bins_.resize(kBinNumSize);
@@ -167,6 +255,12 @@ BinAllocator<ThreadLock>::BinAllocator(size_t alignment, std::unique_ptr<Allocat
 
 template<typename ThreadLock>
 BinAllocator<ThreadLock>::~BinAllocator() {
+  DeferredPiece* deferred_piece = deferred_pieces_.exchange(nullptr);
+  while (deferred_piece != nullptr) {
+    DeferredPiece* next = deferred_piece->next;
+    delete deferred_piece;
+    deferred_piece = next;
+  }
   if (total_memory_bytes_ == 0) {
     CHECK_EQ(mem_ptr2block_.size(), 0);
     return;
@@ -370,21 +464,123 @@ bool BinAllocator<ThreadLock>::DeallocateFreeBlockForGarbageCollection() {
       }
       CHECK_EQ(block.size, piece_size_sum);
 
+      const size_t block_size = block.size;
       mem_ptr2block_.erase(it);
-      backend_->Deallocate(ptr, block.size);
+      backend_->Deallocate(ptr, block_size);
     }
   }
   return total_free_bytes > 0;
 }
 
 template<typename ThreadLock>
-Maybe<void> BinAllocator<ThreadLock>::Allocate(char** mem_ptr, std::size_t size) {
+typename BinAllocator<ThreadLock>::ThreadCache* BinAllocator<ThreadLock>::FindThreadCache() {
+  auto* id2thread_cache = MutThreadLocalId2ThreadCache();
+  auto it = id2thread_cache->find(id_);
+  if (it == id2thread_cache->end()) { return nullptr; }
+  return it->second;
+}
+
+template<typename ThreadLock>
+typename BinAllocator<ThreadLock>::ThreadCache* BinAllocator<ThreadLock>::CreateThreadCache() {
+  thread_caches_.emplace_back(new ThreadCache());
+  ThreadCache* thread_cache = thread_caches_.back().get();
+  thread_cache->free_lists.resize(kNumSizeClasses);
+  CHECK(MutThreadLocalId2ThreadCache()->emplace(id_, thread_cache).second);
+  return thread_cache;
+}
+
+template<typename ThreadLock>
+void BinAllocator<ThreadLock>::FlushThreadCaches() {
+  for (const auto& thread_cache : thread_caches_) {
+    std::lock_guard<std::mutex> lock(thread_cache->mutex);
+    FOR_RANGE(int32_t, size_class, 0, kNumSizeClasses) {
+      const size_t aligned_size = alignment_ * (size_class + 1);
+      for (char* mem_ptr : thread_cache->free_lists.at(size_class)) {
+        DeallocatePieceMemory(mem_ptr, aligned_size);
+      }
+      thread_cache->free_lists.at(size_class).clear();
+    }
+    thread_cache->cached_bytes = 0;
+  }
+}
+
+template<typename ThreadLock>
+void BinAllocator<ThreadLock>::PushDeferredPiece(char* mem_ptr, std::size_t size) {
+  DeferredPiece* deferred_piece = new DeferredPiece{mem_ptr, size, nullptr};
+  deferred_piece->next = deferred_pieces_.load(std::memory_order_relaxed);
+  while (!deferred_pieces_.compare_exchange_weak(deferred_piece->next, deferred_piece,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed)) {}
+  num_deferred_deallocations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename ThreadLock>
+void BinAllocator<ThreadLock>::DeallocateDeferredPieces() {
+  if (deferred_pieces_.load(std::memory_order_relaxed) == nullptr) { return; }
+  DeferredPiece* deferred_piece = deferred_pieces_.exchange(nullptr, std::memory_order_acquire);
+  while (deferred_piece != nullptr) {
+    DeallocatePieceMemory(deferred_piece->ptr, deferred_piece->size);
+    DeferredPiece* next = deferred_piece->next;
+    delete deferred_piece;
+    deferred_piece = next;
+  }
+}
+
+template<typename ThreadLock>
+void BinAllocator<ThreadLock>::GetStats(BinAllocatorStats* stats) {
   typename ThreadLock::RAIIGuard guard(thread_lock_);
+  *stats = BinAllocatorStats();
+  stats->num_allocations = num_allocations_.load(std::memory_order_relaxed);
+  stats->num_thread_cache_hits = num_thread_cache_hits_.load(std::memory_order_relaxed);
+  stats->num_deallocations = num_deallocations_.load(std::memory_order_relaxed);
+  stats->num_deferred_deallocations = num_deferred_deallocations_.load(std::memory_order_relaxed);
+  stats->total_memory_bytes = total_memory_bytes_;
+  stats->allocated_bytes = allocated_bytes_.load(std::memory_order_relaxed);
+  for (const auto& thread_cache : thread_caches_) {
+    std::lock_guard<std::mutex> lock(thread_cache->mutex);
+    stats->thread_cached_bytes += thread_cache->cached_bytes;
+  }
+  for (const Bin& bin : bins_) {
+    for (const Piece* piece : bin.pieces) { stats->free_bytes += piece->size; }
+    if (!bin.pieces.empty()) { stats->largest_free_piece_bytes = (*bin.pieces.rbegin())->size; }
+  }
+  if (stats->free_bytes > 0) {
+    stats->fragmentation =
+        1.0 - static_cast<double>(stats->largest_free_piece_bytes) / stats->free_bytes;
+  }
+}
+
+template<typename ThreadLock>
+Maybe<void> BinAllocator<ThreadLock>::Allocate(char** mem_ptr, std::size_t size) {
   if (size == 0) {
     *mem_ptr = nullptr;
     return Maybe<void>::Ok();
   }
   size_t aligned_size = MemAlignedBytes(size, alignment_);
+  const int32_t size_class = SizeClass4AlignedSize(aligned_size);
+  ThreadCache* thread_cache = nullptr;
+  if (size_class != kInvalidSizeClass) {
+    thread_cache = FindThreadCache();
+    if (thread_cache != nullptr) {
+      std::lock_guard<std::mutex> lock(thread_cache->mutex);
+      std::vector<char*>* free_list = &thread_cache->free_lists.at(size_class);
+      if (!free_list->empty()) {
+        *mem_ptr = free_list->back();
+        free_list->pop_back();
+        thread_cache->cached_bytes -= aligned_size;
+        num_allocations_.fetch_add(1, std::memory_order_relaxed);
+        num_thread_cache_hits_.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes_.fetch_add(aligned_size, std::memory_order_relaxed);
+        return Maybe<void>::Ok();
+      }
+    }
+  }
+
+  typename ThreadLock::RAIIGuard guard(thread_lock_);
+  if (size_class != kInvalidSizeClass && thread_cache == nullptr) {
+    thread_cache = CreateThreadCache();
+  }
+  DeallocateDeferredPieces();
 
   Piece* piece = FindPiece(aligned_size);
 
@@ -392,6 +588,12 @@ Maybe<void> BinAllocator<ThreadLock>::Allocate(char** mem_ptr, std::size_t size)
     if (JUST(AllocateBlockToExtendTotalMem(aligned_size))) { piece = FindPiece(aligned_size); }
   }
 
+  if (piece == nullptr) {
+    // Pieces kept in thread caches may be merged into one large enough.
+    FlushThreadCaches();
+    piece = FindPiece(aligned_size);
+  }
+
   CHECK_NOTNULL_OR_RETURN(piece)
       << Error::OutOfMemoryError() << "Error! : Out of memory when allocate size : " << size
       << ".\n The total_memory_bytes allocated by this BinAllocator is : " << total_memory_bytes_;
@@ -405,14 +607,37 @@ Maybe<void> BinAllocator<ThreadLock>::Allocate(char** mem_ptr, std::size_t size)
   CHECK_NOTNULL_OR_RETURN(piece->ptr) << "invalid piece null ptr";
   CHECK_OR_RETURN(ptr2piece_.find(piece->ptr) != ptr2piece_.end()) << "piece is not found";
   *mem_ptr = piece->ptr;
+  num_allocations_.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes_.fetch_add(aligned_size, std::memory_order_relaxed);
   return Maybe<void>::Ok();
 }
 
 template<typename ThreadLock>
 void BinAllocator<ThreadLock>::Deallocate(char* mem_ptr, std::size_t size) {
   if (mem_ptr == nullptr) { return; }
+  const size_t aligned_size = MemAlignedBytes(size, alignment_);
+  num_deallocations_.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes_.fetch_sub(aligned_size, std::memory_order_relaxed);
+  ThreadCache* thread_cache = FindThreadCache();
+  if (thread_cache == nullptr) {
+    PushDeferredPiece(mem_ptr, size);
+    return;
+  }
+  const int32_t size_class = SizeClass4AlignedSize(aligned_size);
+  if (size_class != kInvalidSizeClass) {
+    std::lock_guard<std::mutex> lock(thread_cache->mutex);
+    if (thread_cache->cached_bytes + aligned_size <= kMaxThreadCacheBytes) {
+      thread_cache->free_lists.at(size_class).emplace_back(mem_ptr);
+      thread_cache->cached_bytes += aligned_size;
+      return;
+    }
+  }
   typename ThreadLock::RAIIGuard guard(thread_lock_);
+  DeallocatePieceMemory(mem_ptr, size);
+}
 
+template<typename ThreadLock>
+void BinAllocator<ThreadLock>::DeallocatePieceMemory(char* mem_ptr, std::size_t size) {
   auto it = ptr2piece_.find(mem_ptr);
   CHECK(it != ptr2piece_.end()) << "Error! : Try deallocate mem_ptr non-existent. mem ptr = "
                                 << mem_ptr << " size = " << size;
@@ -14,15 +14,111 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include <memory>
-#ifdef WITH_CUDA
 #include "gtest/gtest.h"
 #include "oneflow/core/vm/bin_allocator.h"
 #include "oneflow/core/vm/thread_safe_guard.h"
+#ifdef WITH_CUDA
 #include "oneflow/core/device/cuda_util.h"
+#endif  // WITH_CUDA
 
 namespace oneflow {
 namespace vm {
 
+class HostBackendAllocator final : public CachingAllocator {
+ public:
+  HostBackendAllocator() = default;
+  ~HostBackendAllocator() override = default;
+
+  Maybe<void> Allocate(char** mem_ptr, std::size_t size) override {
+    *mem_ptr = static_cast<char*>(aligned_alloc(kCudaMemAllocAlignSize, size));
+    return Maybe<void>::Ok();
+  }
+  void Deallocate(char* mem_ptr, std::size_t size) override { free(mem_ptr); }
+  void DeviceReset() override {}
+  void Shrink() override{};
+};
+
+TEST(HostBinAllocator, thread_cache_and_deferred_deallocation) {
+  BinAllocator<ThreadSafeLock> allocator(kCudaMemAllocAlignSize,
+                                         std::make_unique<HostBackendAllocator>());
+  std::vector<char*> ptrs;
+  for (int i = 0; i < 256; ++i) {
+    char* ptr = nullptr;
+    CHECK_JUST(allocator.Allocate(&ptr, 1000));
+    ASSERT_TRUE(ptr != nullptr);
+    ptrs.emplace_back(ptr);
+  }
+  for (char* ptr : ptrs) { allocator.Deallocate(ptr, 1000); }
+  // Served by the thread cache of this thread.
+  std::vector<char*> reused_ptrs;
+  for (int i = 0; i < 256; ++i) {
+    char* ptr = nullptr;
+    CHECK_JUST(allocator.Allocate(&ptr, 1000));
+    reused_ptrs.emplace_back(ptr);
+  }
+  std::sort(ptrs.begin(), ptrs.end());
+  std::sort(reused_ptrs.begin(), reused_ptrs.end());
+  ASSERT_EQ(ptrs, reused_ptrs);
+  BinAllocatorStats stats;
+  allocator.GetStats(&stats);
+  ASSERT_EQ(stats.num_allocations, 512);
+  ASSERT_EQ(stats.num_thread_cache_hits, 256);
+  ASSERT_EQ(stats.allocated_bytes, 256 * 1024);
+
+  // Deallocations from a thread which never allocated are deferred.
+  std::thread([&]() {
+    for (char* ptr : reused_ptrs) { allocator.Deallocate(ptr, 1000); }
+  }).join();
+  allocator.GetStats(&stats);
+  ASSERT_EQ(stats.num_deferred_deallocations, 256);
+  ASSERT_EQ(stats.allocated_bytes, 0);
+
+  allocator.Shrink();
+  allocator.GetStats(&stats);
+  ASSERT_EQ(stats.total_memory_bytes, 0);
+  ASSERT_EQ(stats.thread_cached_bytes, 0);
+  ASSERT_EQ(stats.free_bytes, 0);
+}
+
+TEST(HostBinAllocator, multi_thread) {
+  BinAllocator<ThreadSafeLock> allocator(kCudaMemAllocAlignSize,
+                                         std::make_unique<HostBackendAllocator>());
+  const int num_threads = 4;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&allocator, t]() {
+      std::vector<std::pair<char*, size_t>> ptrs;
+      for (int i = 0; i < 20000; ++i) {
+        if (ptrs.size() > 64 || (!ptrs.empty() && i % 3 == 0)) {
+          const auto& pair = ptrs.at(i % ptrs.size());
+          // Every piece is owned by exactly one thread, so its content must be intact.
+          ASSERT_EQ(*pair.first, static_cast<char>(t));
+          allocator.Deallocate(pair.first, pair.second);
+          ptrs.at(i % ptrs.size()) = ptrs.back();
+          ptrs.pop_back();
+        } else {
+          const size_t size = (i * 7919) % 70000 + 1;
+          char* ptr = nullptr;
+          CHECK_JUST(allocator.Allocate(&ptr, size));
+          std::memset(ptr, t, size);
+          ptrs.emplace_back(ptr, size);
+        }
+      }
+      for (const auto& pair : ptrs) { allocator.Deallocate(pair.first, pair.second); }
+    });
+  }
+  for (std::thread& thread : threads) { thread.join(); }
+  BinAllocatorStats stats;
+  allocator.GetStats(&stats);
+  ASSERT_EQ(stats.allocated_bytes, 0);
+  ASSERT_EQ(stats.num_allocations, stats.num_deallocations);
+  allocator.Shrink();
+  allocator.GetStats(&stats);
+  ASSERT_EQ(stats.total_memory_bytes, 0);
+}
+
+#ifdef WITH_CUDA
+
 class CudaBackendAllocator final : public CachingAllocator {
  public:
   explicit CudaBackendAllocator(int64_t device_id) : device_id_(device_id) {}
@@ -126,7 +222,7 @@ TEST(CudaBinAllocator, cuda_allocator) {
   a->Deallocate(data_ptr_1, 2048 * sizeof(float));
 }
 
+#endif  // WITH_CUDA
+
 }  // namespace vm
 }  // namespace oneflow
-
-#endif  // WITH_CUDA
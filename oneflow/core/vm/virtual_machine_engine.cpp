@@ -61,8 +61,21 @@ void VirtualMachineEngine::ReleaseInstruction(Instruction* instruction) {
 // Handle pending instructions, and try schedule them to ready list.
 void VirtualMachineEngine::HandleLocalPending() {
   OF_PROFILER_RANGE_GUARD("HandleLocalPending");
+  const int64_t stats_interval = ThreadLocalEnvInteger<ONEFLOW_VM_SCHEDULE_STATS_INTERVAL>();
+  std::chrono::steady_clock::time_point start;
+  const size_t num_local_pending = local_pending_instruction_list().size();
+  if (unlikely(stats_interval > 0)) { start = std::chrono::steady_clock::now(); }
   InstructionList pending_instructions;
   FetchAndTryFusePendingInstructions(&pending_instructions);
+  const size_t num_pending = pending_instructions.size();
+  if (unlikely(stats_interval > 0)) {
+    const auto fuse_end = std::chrono::steady_clock::now();
+    schedule_stats_.fuse_seconds += std::chrono::duration<double>(fuse_end - start).count();
+    // Instructions taken from the local pending list but absorbed into fused ones.
+    schedule_stats_.num_fused_instructions +=
+        num_local_pending - local_pending_instruction_list().size() - num_pending;
+    start = fuse_end;
+  }
   INTRUSIVE_FOR_EACH_PTR(instruction, &pending_instructions) {
     const auto& instruction_policy = instruction->instruction_policy();
     instruction->InitStatus();
@@ -71,11 +84,31 @@ void VirtualMachineEngine::HandleLocalPending() {
       mut_barrier_instruction_list()->PushBack(instruction);
     } else {
       ConsumeDependences(instruction);
+      if (unlikely(stats_interval > 0)) {
+        schedule_stats_.num_in_edges += instruction->in_edges().size();
+      }
       if (likely(Dispatchable(instruction))) {
         mut_ready_instruction_list()->PushBack(instruction);
       }
     }
   }
+  if (unlikely(stats_interval > 0)) {
+    schedule_stats_.dependence_seconds +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    schedule_stats_.num_instructions += num_pending;
+    if (schedule_stats_.num_instructions >= stats_interval) { ReportScheduleStats(); }
+  }
+}
+
+void VirtualMachineEngine::ReportScheduleStats() {
+  const size_t num_instructions = schedule_stats_.num_instructions;
+  LOG(INFO) << "vm handled " << num_instructions << " instructions, "
+            << schedule_stats_.num_fused_instructions << " more were fused into them, "
+            << schedule_stats_.num_in_edges << " in edges. fuse: "
+            << schedule_stats_.fuse_seconds * 1e9 / num_instructions
+            << " ns/instruction, dependence analysis: "
+            << schedule_stats_.dependence_seconds * 1e9 / num_instructions << " ns/instruction";
+  schedule_stats_ = ScheduleStats();
 }
 
 namespace {
@@ -100,6 +100,7 @@ class VirtualMachineEngine final : public intrusive::Base {
 
   void ReleaseFinishedInstructions(const ScheduleCtx& schedule_ctx);
   void HandleLocalPending();
+  void ReportScheduleStats();
   void FetchAndTryFusePendingInstructions(InstructionList* /*out*/ pending_instructions);
   void MakeAndAppendFusedInstruction(InstructionList&& fused_instruction_list,
                                      InstructionList* /*out*/ pending_instructions);
@@ -146,7 +147,8 @@ class VirtualMachineEngine final : public intrusive::Base {
         probe_mutex_(),
         probe_list_(&probe_mutex_),
         local_probe_list_(),
-        barrier_instruction_list_() {}
+        barrier_instruction_list_(),
+        schedule_stats_() {}
   intrusive::Ref intrusive_ref_;
   // lists or maps
   // Do not change the order of the following fields
@@ -169,6 +171,17 @@ class VirtualMachineEngine final : public intrusive::Base {
   BarrierInstructionList barrier_instruction_list_;
   DependenceAccess::object_pool_type access_pool_;
   InstructionEdge::object_pool_type instruction_edge_pool_;
+
+  // Cost of turning pending instructions into DAG nodes, only collected if
+  // ONEFLOW_VM_SCHEDULE_STATS_INTERVAL is positive.
+  struct ScheduleStats {
+    size_t num_instructions = 0;
+    size_t num_fused_instructions = 0;
+    size_t num_in_edges = 0;
+    double fuse_seconds = 0;
+    double dependence_seconds = 0;
+  };
+  ScheduleStats schedule_stats_;
 };
 
 }  // namespace vm
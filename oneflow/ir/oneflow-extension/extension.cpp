@@ -13,6 +13,8 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <fstream>
+#include <unistd.h>
 #include "mlir/Parser/Parser.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
@@ -20,14 +22,20 @@ limitations under the License.
 #include "mlir/ExecutionEngine/MemRefUtils.h"
 #include "mlir/Target/LLVMIR/Dialect/LLVMIR/LLVMToLLVMIRTranslation.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Config/llvm-config.h"
 #include "OneFlow/OneFlowDialect.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/common/switch_func.h"
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/kernel/new_kernel_util.h"
+#include "oneflow/core/job/version.h"
 #include "oneflow/core/persistence/tee_persistent_log_stream.h"
 #include "oneflow/ir/include/OneFlow/Passes.h"
 #include "oneflow/ir/include/OneFlow/Extension.h"
+#ifdef WITH_MLIR_CUDA_CODEGEN
+#include <cuda_runtime_api.h>
+#endif  // WITH_MLIR_CUDA_CODEGEN
 
 namespace oneflow {
 
@@ -103,8 +111,123 @@ llvm::SmallVector<OpaqueMemRefDescriptor> GetMLIRCInterfaceArgs(
   return args;
 }
 
-void WithMlirContext(
+using JitEngine = std::shared_ptr<mlir::ExecutionEngine>;
+
+// Compiled engines of one mlir_jit kernel, keyed by the assembly hash and the shapes and data
+// types of all arguments.
+class MlirJitKernelState final : public user_op::OpKernelState {
+ public:
+  MlirJitKernelState() = default;
+  ~MlirJitKernelState() override = default;
+
+  HashMap<std::string, JitEngine>* mut_engines() { return &engines_; }
+
+ private:
+  HashMap<std::string, JitEngine> engines_;
+};
+
+std::string GetJitEngineKey(user_op::KernelComputeContext* ctx, size_t assembly_hash) {
+  std::ostringstream ss;
+  ss << std::hex << assembly_hash << std::dec;
+  const auto AppendArgs = [&](const std::vector<std::pair<std::string, int32_t>>& args) {
+    for (const auto& pair : args) {
+      const user_op::Tensor* tensor = ctx->Tensor4ArgNameAndIndex(pair.first, pair.second);
+      ss << "," << tensor->data_type() << ":" << tensor->shape_view();
+    }
+  };
+  AppendArgs(ctx->inputs());
+  AppendArgs(ctx->outputs());
+  return ss.str();
+}
+
+// -1 leaves the choice to the JIT.
+int64_t GetJitOptLevel() {
+  const int64_t opt_level = ParseIntegerFromEnv("ONEFLOW_MLIR_JIT_OPT_LEVEL", -1);
+  CHECK_LE(opt_level, 3) << "ONEFLOW_MLIR_JIT_OPT_LEVEL should be in [0, 3]";
+  return opt_level;
+}
+
+// The target the lowering compiles device code for, empty if it cannot be told.
+std::string GetLoweringTarget(const std::string& lowering) {
+#ifdef WITH_MLIR_CUDA_CODEGEN
+  if (lowering == "cuda") {
+    // The cubin embedded in a lowered module is built by SerializeToCubinPass for device 0 with
+    // the CUDA toolkit in use, and is not loadable on other architectures.
+    cudaDeviceProp prop{};
+    int runtime_version = 0;
+    int driver_version = 0;
+    if (cudaGetDeviceProperties(&prop, 0) != cudaSuccess
+        || cudaRuntimeGetVersion(&runtime_version) != cudaSuccess
+        || cudaDriverGetVersion(&driver_version) != cudaSuccess) {
+      return "";
+    }
+    return "sm_" + std::to_string(prop.major) + std::to_string(prop.minor) + " cuda "
+           + std::to_string(runtime_version) + " driver " + std::to_string(driver_version);
+  }
+#endif  // WITH_MLIR_CUDA_CODEGEN
+  return "host";
+}
+
+// Lowered modules are kept in ONEFLOW_MLIR_JIT_CACHE_DIR as LLVM dialect assembly, so that a
+// restarted process skips parsing and lowering and only has to run the LLVM code generation.
+// The file name is only a hash of the key, so the full key is stored in front of the module and
+// compared on load. An empty key disables the cache.
+std::string GetLoweredModuleCacheKey(const std::string& assembly, const std::string& lowering) {
+  const std::string target = GetLoweringTarget(lowering);
+  if (target.empty()) { return ""; }
+  std::ostringstream ss;
+  ss << "oneflow " << GetOneFlowGitVersion() << "\n"
+     << "llvm " << LLVM_VERSION_STRING << "\n"
+     << "lowering " << lowering << "\n"
+     << "target " << target << "\n"
+     << "opt level " << GetJitOptLevel() << "\n"
+     << assembly;
+  return ss.str();
+}
+
+std::string GetLoweredModuleCachePath(const std::string& key, const std::string& lowering) {
+  const std::string cache_dir = GetStringFromEnv("ONEFLOW_MLIR_JIT_CACHE_DIR", "");
+  if (cache_dir.empty() || key.empty()) { return ""; }
+  std::ostringstream ss;
+  ss << std::hex << std::hash<std::string>()(key);
+  return JoinPath(cache_dir, lowering + "-" + ss.str() + ".mlir");
+}
+
+// The file holds the size of the key on the first line, the key and then the module.
+bool LoadLoweredModule(const std::string& path, const std::string& key, std::string* mlir) {
+  std::ifstream in(path);
+  if (!in) { return false; }
+  size_t key_size = 0;
+  if (!(in >> key_size) || in.get() != '\n' || key_size != key.size()) { return false; }
+  std::string stored_key(key_size, '\0');
+  if (!in.read(&stored_key[0], key_size) || stored_key != key) { return false; }
+  std::stringstream lowered;
+  lowered << in.rdbuf();
+  *mlir = lowered.str();
+  return true;
+}
+
+void SaveLoweredModule(mlir::ModuleOp module, const std::string& path, const std::string& key) {
+  std::string mlir;
+  llvm::raw_string_ostream os_mlir(mlir);
+  module.print(os_mlir);
+  os_mlir.flush();
+  // Written aside and renamed, so that a concurrent process never reads a partial module.
+  const std::string tmp_path = path + "." + std::to_string(getpid()) + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::out | std::ios::trunc);
+    if (!out) {
+      LOG(WARNING) << "fail to write MLIR JIT cache " << tmp_path;
+      return;
+    }
+    out << key.size() << "\n" << key << mlir;
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) { std::remove(tmp_path.c_str()); }
+}
+
+JitEngine CompileJitEngine(
     user_op::KernelComputeContext* ctx, const llvm::SmallVector<llvm::StringRef, 4>& ext_libs,
+    const std::string& lowered_module_cache_key, const std::string& lowered_module_cache_path,
     const std::function<mlir::OwningOpRef<mlir::ModuleOp>(mlir::MLIRContext* mlir_ctx)>& parse,
     const std::function<void(mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module)>& lower) {
   mlir::DialectRegistry registry;
@@ -113,12 +236,24 @@ void WithMlirContext(
               mlir::tosa::TosaDialect, mlir::linalg::LinalgDialect>();
   mlir::registerLLVMDialectTranslation(registry);
   mlir::MLIRContext mlir_ctx(registry);
-  mlir::OwningOpRef<mlir::ModuleOp> module = parse(&mlir_ctx);
-  CHECK(!!module) << "fail to parse MLIR, op: " << ctx->op_name();
-  if (ParseBooleanFromEnv("ONEFLOW_MLIR_STDOUT", false)) { module->print(llvm::outs()); }
   llvm::InitializeNativeTarget();
   llvm::InitializeNativeTargetAsmPrinter();
-  lower(&mlir_ctx, *module);
+  mlir::OwningOpRef<mlir::ModuleOp> module;
+  std::string lowered;
+  if (!lowered_module_cache_path.empty()
+      && LoadLoweredModule(lowered_module_cache_path, lowered_module_cache_key, &lowered)) {
+    module = mlir::parseSourceString<mlir::ModuleOp>(lowered, &mlir_ctx);
+    if (!module) { LOG(WARNING) << "ignore broken MLIR JIT cache " << lowered_module_cache_path; }
+  }
+  if (!module) {
+    module = parse(&mlir_ctx);
+    CHECK(!!module) << "fail to parse MLIR, op: " << ctx->op_name();
+    if (ParseBooleanFromEnv("ONEFLOW_MLIR_STDOUT", false)) { module->print(llvm::outs()); }
+    lower(&mlir_ctx, *module);
+    if (!lowered_module_cache_path.empty()) {
+      SaveLoweredModule(*module, lowered_module_cache_path, lowered_module_cache_key);
+    }
+  }
   if (ParseBooleanFromEnv("ONEFLOW_MLIR_STDOUT", false)) { module->print(llvm::outs()); }
   if (ParseBooleanFromEnv("ONEFLOW_MLIR_DUMP_IR", false)) {
     std::string mlir;
@@ -129,13 +264,22 @@ void WithMlirContext(
 
   mlir::ExecutionEngineOptions jitOptions;
   jitOptions.transformer = {};
-  jitOptions.jitCodeGenOptLevel = llvm::None;
+  const int64_t opt_level = GetJitOptLevel();
+  if (opt_level < 0) {
+    jitOptions.jitCodeGenOptLevel = llvm::None;
+  } else {
+    jitOptions.jitCodeGenOptLevel = static_cast<llvm::CodeGenOpt::Level>(opt_level);
+  }
   jitOptions.sharedLibPaths = ext_libs;
 
+  // The engine owns its LLVM module, it does not need mlir_ctx after creation.
   auto jit_or_error = mlir::ExecutionEngine::create(*module, jitOptions);
   CHECK(!!jit_or_error) << "failed to create JIT exe engine, "
                         << llvm::toString(jit_or_error.takeError());
-  auto jit = std::move(jit_or_error.get());
+  return JitEngine(std::move(jit_or_error.get()));
+}
+
+void InvokeJitEngine(user_op::KernelComputeContext* ctx, mlir::ExecutionEngine* jit) {
   llvm::SmallVector<OpaqueMemRefDescriptor> args /* args must outlive JIT invocation */ =
       GetMLIRCInterfaceArgs(ctx);
   llvm::SmallVector<void*> packed_args{};
@@ -144,26 +288,51 @@ void WithMlirContext(
   CHECK(!error) << "fail to invoke jit engine, error: " << llvm::toString(std::move(error));
 }
 
+void ComputeWithCachedJitEngine(
+    user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+    const std::string& lowering,
+    const std::function<void(mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module)>& lower) {
+  auto* engines = CHECK_NOTNULL(dynamic_cast<MlirJitKernelState*>(state))->mut_engines();
+  const std::string& assembly = ctx->Attr<std::string>("mlir_assembly");
+  const size_t assembly_hash = std::hash<std::string>()(assembly);
+  const std::string key = GetJitEngineKey(ctx, assembly_hash);
+  auto it = engines->find(key);
+  if (it == engines->end()) {
+    llvm::SmallVector<llvm::StringRef, 4> ext_libs(
+        {SharedLibPaths()->begin(), SharedLibPaths()->end()});
+    const std::string lowered_module_cache_key = GetLoweredModuleCacheKey(assembly, lowering);
+    JitEngine jit = CompileJitEngine(
+        ctx, ext_libs, lowered_module_cache_key,
+        GetLoweredModuleCachePath(lowered_module_cache_key, lowering),
+        [&assembly](mlir::MLIRContext* mlir_ctx) {
+          return mlir::parseSourceString<mlir::ModuleOp>(assembly, mlir_ctx);
+        },
+        lower);
+    it = engines->emplace(key, std::move(jit)).first;
+  }
+  InvokeJitEngine(ctx, it->second.get());
+}
+
 template<typename T>
 class MlirJitCpuKernel final : public user_op::OpKernel {
  public:
   MlirJitCpuKernel() = default;
   ~MlirJitCpuKernel() = default;
 
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<MlirJitKernelState>();
+  }
+
  private:
-  void Compute(user_op::KernelComputeContext* ctx) const override {
-    llvm::SmallVector<llvm::StringRef, 4> ext_libs(
-        {SharedLibPaths()->begin(), SharedLibPaths()->end()});
-    WithMlirContext(
-        ctx, ext_libs,
-        [&ctx](mlir::MLIRContext* mlir_ctx) {
-          return mlir::parseSourceString<mlir::ModuleOp>(ctx->Attr<std::string>("mlir_assembly"),
-                                                         mlir_ctx);
-        },
-        [](mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module) {
-          CHECK(mlir::succeeded(mlir::oneflow::LowerModuleToLLVM(mlir_ctx, module)))
-              << "fail to lower OneFlow to LLVM";
-        });
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
+    ComputeWithCachedJitEngine(ctx, state, "cpu",
+                               [](mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module) {
+                                 CHECK(mlir::succeeded(
+                                     mlir::oneflow::LowerModuleToLLVM(mlir_ctx, module)))
+                                     << "fail to lower OneFlow to LLVM";
+                               });
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
@@ -193,20 +362,20 @@ class MlirJitGpuKernel final : public user_op::OpKernel {
   MlirJitGpuKernel() = default;
   ~MlirJitGpuKernel() = default;
 
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<MlirJitKernelState>();
+  }
+
  private:
-  void Compute(user_op::KernelComputeContext* ctx) const override {
-    llvm::SmallVector<llvm::StringRef, 4> ext_libs(
-        {SharedLibPaths()->begin(), SharedLibPaths()->end()});
-    WithMlirContext(
-        ctx, ext_libs,
-        [&ctx](mlir::MLIRContext* mlir_ctx) {
-          return mlir::parseSourceString<mlir::ModuleOp>(ctx->Attr<std::string>("mlir_assembly"),
-                                                         mlir_ctx);
-        },
-        [](mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module) {
-          CHECK(mlir::succeeded(mlir::oneflow::LowerModuleToCUDALLVM(mlir_ctx, module)))
-              << "fail to lower OneFlow to CUDA LLVM";
-        });
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
+    ComputeWithCachedJitEngine(ctx, state, "cuda",
+                               [](mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module) {
+                                 CHECK(mlir::succeeded(
+                                     mlir::oneflow::LowerModuleToCUDALLVM(mlir_ctx, module)))
+                                     << "fail to lower OneFlow to CUDA LLVM";
+                               });
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
@@ -0,0 +1,152 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# RUN: python3 %s
+
+import glob
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+import numpy as np
+
+os.environ["ONEFLOW_MLIR_ENABLE_ROUND_TRIP"] = "1"
+os.environ["ONEFLOW_MLIR_ENABLE_CODEGEN_FUSERS"] = "1"
+
+import oneflow as flow
+import oneflow.unittest
+import oneflow.sysconfig
+
+
+class CastModule(flow.nn.Module):
+    def __init__(self):
+        super().__init__()
+
+    def forward(self, x, scale):
+        return x.to(dtype=flow.float32) * scale
+
+
+def run_cast_scale_graph(device, shape):
+    x = flow.tensor(np.random.randint(-8, 8, size=shape), dtype=flow.int64)
+    scale = flow.tensor([7.7], dtype=flow.float32)
+    x = x.to(device)
+    scale = scale.to(device)
+    module_to_run = CastModule()
+
+    class GraphToRun(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+            self.fw = module_to_run
+
+        def build(self, x, scale):
+            return self.fw(x, scale)
+
+    graph_to_run = GraphToRun()
+    # The second run reuses the engine compiled by the first one.
+    for _ in range(2):
+        y_lazy = graph_to_run(x, scale)
+        assert np.array_equal(module_to_run(x, scale).numpy(), y_lazy.numpy())
+        x = flow.tensor(np.random.randint(-8, 8, size=shape), dtype=flow.int64)
+        x = x.to(device)
+
+
+def run_child(device, cache_dir, opt_level=None):
+    env = dict(os.environ)
+    env["ONEFLOW_MLIR_JIT_CACHE_DIR"] = cache_dir
+    env.pop("ONEFLOW_MLIR_JIT_OPT_LEVEL", None)
+    if opt_level is not None:
+        env["ONEFLOW_MLIR_JIT_OPT_LEVEL"] = str(opt_level)
+    subprocess.run(
+        [sys.executable, os.path.abspath(__file__), "--child", device],
+        env=env,
+        check=True,
+    )
+
+
+def cache_files(cache_dir, device):
+    return sorted(glob.glob(os.path.join(cache_dir, device + "-*.mlir")))
+
+
+def split_cache_file(path):
+    with open(path, "rb") as f:
+        content = f.read()
+    key_size, rest = content.split(b"\n", 1)
+    key_size = int(key_size)
+    return rest[:key_size], rest[key_size:]
+
+
+def _test_mlir_jit_cache(test_case, device):
+    with tempfile.TemporaryDirectory() as cache_dir:
+        run_child(device, cache_dir)
+        # One module for each shape.
+        files = cache_files(cache_dir, device)
+        test_case.assertEqual(len(files), 2)
+        path = files[0]
+        key, module = split_cache_file(path)
+        test_case.assertIn(b"lowering " + device.encode(), key)
+        if device == "cuda":
+            test_case.assertIn(b"target sm_", key)
+        stat = os.stat(path)
+
+        # Another process loads the module instead of lowering and writing it again.
+        run_child(device, cache_dir)
+        test_case.assertEqual(cache_files(cache_dir, device), files)
+        test_case.assertEqual(os.stat(path).st_ino, stat.st_ino)
+        test_case.assertEqual(os.stat(path).st_mtime_ns, stat.st_mtime_ns)
+        test_case.assertEqual(split_cache_file(path), (key, module))
+
+        # A corrupted file is lowered again and replaced.
+        with open(path, "wb") as f:
+            f.write(b"not a cache file")
+        run_child(device, cache_dir)
+        test_case.assertEqual(split_cache_file(path), (key, module))
+
+        # So are a module stored for another key and a broken module.
+        foreign_key = key.replace(b"opt level -1", b"opt level -9")
+        test_case.assertNotEqual(foreign_key, key)
+        for stored_key, stored_module in [(foreign_key, module), (key, b"}{")]:
+            with open(path, "wb") as f:
+                f.write(b"%d\n" % len(stored_key) + stored_key + stored_module)
+            run_child(device, cache_dir)
+            test_case.assertEqual(split_cache_file(path), (key, module))
+
+        # The opt level is part of the key.
+        run_child(device, cache_dir, opt_level=2)
+        files_with_opt_level = cache_files(cache_dir, device)
+        test_case.assertEqual(len(files_with_opt_level), 4)
+        for other_path in files_with_opt_level:
+            if other_path not in files:
+                other_key, _ = split_cache_file(other_path)
+                test_case.assertIn(b"opt level 2", other_key)
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestMlirJitCache(oneflow.unittest.TestCase):
+    def test_mlir_jit_cache_cpu(test_case):
+        _test_mlir_jit_cache(test_case, "cpu")
+
+    @unittest.skipUnless(oneflow.sysconfig.with_cuda(), "needs -DBUILD_CUDA=ON")
+    def test_mlir_jit_cache_cuda(test_case):
+        _test_mlir_jit_cache(test_case, "cuda")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) == 3 and sys.argv[1] == "--child":
+        # Engines are compiled per shape, the graphs of both shapes are checked.
+        run_cast_scale_graph(sys.argv[2], (2, 5))
+        run_cast_scale_graph(sys.argv[2], (3, 4))
+        sys.exit(0)
+    unittest.main()
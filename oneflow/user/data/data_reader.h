@@ -25,7 +25,13 @@ namespace oneflow {
 namespace data {
 
 static const int32_t kDataReaderBatchBufferSize = 4;
+static const int32_t kDataReaderMaxBatchBufferSize = 32;
+// number of fetches in a row which found a batch ready before the prefetch depth is lowered
+static const int32_t kDataReaderPrefetchShrinkInterval = 256;
 
+// Batches are prefetched by the load thread. The prefetch depth starts at
+// ONEFLOW_DATA_READER_PREFETCH_DEPTH, grows by one every time Read has to wait for a batch and
+// shrinks back once the loader stays ahead, bounded by ONEFLOW_DATA_READER_MAX_PREFETCH_DEPTH.
 template<typename LoadTarget>
 class DataReader {
  public:
@@ -33,17 +39,38 @@ class DataReader {
   using BatchType = std::vector<SampleType>;
 
   DataReader(user_op::KernelInitContext* ctx)
-      : is_closed_(false), batch_buffer_(kDataReaderBatchBufferSize) {}
+      : is_closed_(false),
+        min_prefetch_depth_(ParseIntegerFromEnv("ONEFLOW_DATA_READER_PREFETCH_DEPTH",
+                                                kDataReaderBatchBufferSize)),
+        max_prefetch_depth_(std::max(
+            min_prefetch_depth_, ParseIntegerFromEnv("ONEFLOW_DATA_READER_MAX_PREFETCH_DEPTH",
+                                                     kDataReaderMaxBatchBufferSize))),
+        prefetch_depth_(min_prefetch_depth_),
+        num_ready_fetches_(0),
+        num_batches_(0),
+        load_seconds_(0),
+        load_wait_seconds_(0),
+        read_wait_seconds_(0),
+        parse_seconds_(0),
+        batch_buffer_(prefetch_depth_) {
+    CHECK_GT(min_prefetch_depth_, 0);
+  }
 
   virtual ~DataReader() {
     Close();
     if (load_thrd_.joinable()) { load_thrd_.join(); }
+    VLOG(1) << "DataReader loaded " << num_batches_ << " batches in " << load_seconds_
+            << "s and parsed them in " << parse_seconds_ << "s, the loader waited "
+            << load_wait_seconds_ << "s for buffer space, readers waited " << read_wait_seconds_
+            << "s for data, final prefetch depth " << prefetch_depth_;
   }
 
   void Read(user_op::KernelComputeContext* ctx) {
     CHECK(load_thrd_.joinable()) << "You should call StartLoadThread before read data";
     auto batch = FetchBatchData();
+    const auto start = std::chrono::steady_clock::now();
     parser_->Parse(batch, ctx);
+    parse_seconds_ += SecondsSince(start);
   }
 
   void Close() {
@@ -65,18 +92,60 @@ class DataReader {
   std::unique_ptr<Parser<LoadTarget>> parser_;
 
  private:
+  static double SecondsSince(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
   BatchType FetchBatchData() {
     BatchType batch;
+    if (batch_buffer_.TryReceive(&batch) == BufferStatus::kBufferStatusSuccess) {
+      num_ready_fetches_ += 1;
+      if (num_ready_fetches_ == kDataReaderPrefetchShrinkInterval) {
+        SetPrefetchDepth(prefetch_depth_ - 1);
+        num_ready_fetches_ = 0;
+      }
+      return batch;
+    }
+    // The loader fell behind, let it run further ahead.
+    SetPrefetchDepth(prefetch_depth_ + 1);
+    num_ready_fetches_ = 0;
+    const auto start = std::chrono::steady_clock::now();
     CHECK_EQ(batch_buffer_.Pull(&batch), BufferStatus::kBufferStatusSuccess);
+    read_wait_seconds_ += SecondsSince(start);
     return batch;
   }
 
+  void SetPrefetchDepth(int64_t depth) {
+    depth = std::min(std::max(depth, min_prefetch_depth_), max_prefetch_depth_);
+    if (depth == prefetch_depth_) { return; }
+    prefetch_depth_ = depth;
+    batch_buffer_.SetMaxLen(depth);
+  }
+
   bool LoadBatch() {
+    auto start = std::chrono::steady_clock::now();
     BatchType batch = loader_->Next();
-    return batch_buffer_.Push(std::move(batch)) == BufferStatus::kBufferStatusSuccess;
+    load_seconds_ += SecondsSince(start);
+    num_batches_ += 1;
+    start = std::chrono::steady_clock::now();
+    const bool is_pushed =
+        batch_buffer_.Push(std::move(batch)) == BufferStatus::kBufferStatusSuccess;
+    load_wait_seconds_ += SecondsSince(start);
+    return is_pushed;
   }
 
   std::atomic<bool> is_closed_;
+  const int64_t min_prefetch_depth_;
+  const int64_t max_prefetch_depth_;
+  // prefetch_depth_, num_ready_fetches_, read_wait_seconds_ and parse_seconds_ are only accessed
+  // by the reading thread, the other counters only by the load thread until it is joined.
+  int64_t prefetch_depth_;
+  int64_t num_ready_fetches_;
+  int64_t num_batches_;
+  double load_seconds_;
+  double load_wait_seconds_;
+  double read_wait_seconds_;
+  double parse_seconds_;
   Buffer<BatchType> batch_buffer_;
   std::thread load_thrd_;
 };
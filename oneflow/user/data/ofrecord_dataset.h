@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_USER_DATA_OFRECORD_DATASET_H_
 
 #include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/buffer.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/framework/op_kernel.h"
 #include "oneflow/core/persistence/persistent_in_stream.h"
@@ -28,6 +29,46 @@ limitations under the License.
 namespace oneflow {
 namespace data {
 
+static const int64_t kOFRecordReaderThreadBufferSize = 64;
+
+inline std::vector<std::string> GetOFRecordDataFilePaths(user_op::KernelInitContext* ctx) {
+  const int32_t data_part_num = ctx->Attr<int32_t>("data_part_num");
+  const std::string& data_dir = ctx->Attr<std::string>("data_dir");
+  const std::string& part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
+  const int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
+  std::vector<std::string> data_file_paths;
+  for (int i = 0; i < data_part_num; ++i) {
+    std::string num = std::to_string(i);
+    int32_t zero_count = std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
+    data_file_paths.emplace_back(
+        JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num));
+  }
+  return data_file_paths;
+}
+
+inline void GetOFRecordParallelIdAndNum(user_op::KernelInitContext* ctx, int32_t* parallel_id,
+                                        int32_t* parallel_num) {
+  bool is_local = false;
+  // NOTE(zwx): OFRecordDataset is used by OFRecordDataReader and
+  // OFRecordImageClassificationDataReader both, the latter has no attr nd_sbp,
+  // so it couldn't work in DDP for now. The If condition here could be removed when
+  // OFRecordImageClassificationDataReader had supported DDP (add attr nd_sbp)
+  // or been deprecated.
+  if (ctx->op_type_name() == "OFRecordReader") {
+    auto nd_sbp_str_vec = ctx->Attr<std::vector<std::string>>("nd_sbp");
+    // NOTE(zwx): OFRecordDataset is not global since attr nd_sbp is empty,
+    // we assume that it works in DDP
+    if (nd_sbp_str_vec.empty()) { is_local = true; }
+  }
+  if (is_local) {
+    *parallel_id = GlobalProcessCtx::Rank();
+    *parallel_num = GlobalProcessCtx::WorldSize();
+  } else {
+    *parallel_id = ctx->parallel_ctx().parallel_id();
+    *parallel_num = ctx->parallel_ctx().parallel_num();
+  }
+}
+
 class OFRecordDataset final : public Dataset<TensorBuffer> {
  public:
   using Base = Dataset<TensorBuffer>;
@@ -37,69 +78,85 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
   OF_DISALLOW_COPY_AND_MOVE(OFRecordDataset);
 
   OFRecordDataset(user_op::KernelInitContext* ctx) {
-    current_epoch_ = 0;
-    shuffle_after_epoch_ = ctx->Attr<bool>("shuffle_after_epoch");
-
-    // in stream
-    data_part_num_ = ctx->Attr<int32_t>("data_part_num");
-    std::string data_dir = ctx->Attr<std::string>("data_dir");
-    std::string part_name_prefix = ctx->Attr<std::string>("part_name_prefix");
-    int32_t part_name_suffix_length = ctx->Attr<int32_t>("part_name_suffix_length");
-
-    for (int i = 0; i < data_part_num_; ++i) {
-      std::string num = std::to_string(i);
-      int32_t zero_count =
-          std::max(part_name_suffix_length - static_cast<int32_t>(num.length()), 0);
-      data_file_paths_.emplace_back(
-          JoinPath(data_dir, part_name_prefix + std::string(zero_count, '0') + num));
-    }
+    int32_t parallel_id = 0;
+    int32_t parallel_num = 0;
+    GetOFRecordParallelIdAndNum(ctx, &parallel_id, &parallel_num);
+    Init(GetOFRecordDataFilePaths(ctx), parallel_id, parallel_num,
+         ctx->Attr<bool>("shuffle_after_epoch"),
+         ParseIntegerFromEnv("ONEFLOW_OFRECORD_READER_NUM_THREADS", 1));
+  }
+  OFRecordDataset(const std::vector<std::string>& data_file_paths, int32_t parallel_id,
+                  int32_t parallel_num, bool shuffle_after_epoch, int64_t num_reader_threads) {
+    Init(data_file_paths, parallel_id, parallel_num, shuffle_after_epoch, num_reader_threads);
+  }
+  ~OFRecordDataset() {
+    for (auto& slot : reader_slots_) { slot->samples.Close(); }
+    for (auto& slot : reader_slots_) { slot->thread.join(); }
+  }
 
-    bool is_local = false;
-    // NOTE(zwx): OFRecordDataset is used by OFRecordDataReader and
-    // OFRecordImageClassificationDataReader both, the latter has no attr nd_sbp,
-    // so it couldn't work in DDP for now. The If condition here could be removed when
-    // OFRecordImageClassificationDataReader had supported DDP (add attr nd_sbp)
-    // or been deprecated.
-    if (ctx->op_type_name() == "OFRecordReader") {
-      auto nd_sbp_str_vec = ctx->Attr<std::vector<std::string>>("nd_sbp");
-      // NOTE(zwx): OFRecordDataset is not global since attr nd_sbp is empty,
-      // we assume that it works in DDP
-      if (nd_sbp_str_vec.empty()) { is_local = true; }
-    }
-    if (is_local) {
-      parallel_id_ = GlobalProcessCtx::Rank();
-      parallel_num_ = GlobalProcessCtx::WorldSize();
+  BatchType Next() override {
+    BatchType batch;
+    if (reader_slots_.empty()) {
+      batch.push_back(TensorBuffer());
+      ReadSample(batch.back());
     } else {
-      parallel_id_ = ctx->parallel_ctx().parallel_id();
-      parallel_num_ = ctx->parallel_ctx().parallel_num();
+      NextInterleaved(&batch);
     }
+    return batch;
+  }
+
+ private:
+  // Every reader thread owns a slot and reads the local parts i with
+  // i % reader_slots_.size() == slot_id one after another.
+  struct ReaderSlot {
+    explicit ReaderSlot(size_t max_len) : samples(max_len), is_epoch_done(false) {}
+    // holds batches of one sample, an empty batch marks the end of an epoch of the slot
+    Buffer<BatchType> samples;
+    // only accessed by the consumer
+    bool is_epoch_done;
+    std::thread thread;
+  };
+
+  void Init(const std::vector<std::string>& data_file_paths, int32_t parallel_id,
+            int32_t parallel_num, bool shuffle_after_epoch, int64_t num_reader_threads) {
+    current_epoch_ = 0;
+    cur_slot_id_ = 0;
+    num_epoch_done_slots_ = 0;
+    shuffle_after_epoch_ = shuffle_after_epoch;
+
+    // in stream
+    data_part_num_ = data_file_paths.size();
+    data_file_paths_ = data_file_paths;
+    parallel_id_ = parallel_id;
+    parallel_num_ = parallel_num;
     CHECK_LE(parallel_num_, data_part_num_);
     BalancedSplitter bs(data_part_num_, parallel_num_);
     range_ = bs.At(parallel_id_);
-    std::vector<std::string> local_file_paths = GetLocalFilePaths();
-    in_stream_.reset(
-        new PersistentInStream(DataFS(), local_file_paths, !shuffle_after_epoch_, false));
+    num_reader_threads = std::min<int64_t>(num_reader_threads, range_.size());
+    if (num_reader_threads > 1) {
+      StartReaderThreads(num_reader_threads);
+    } else {
+      std::vector<std::string> local_file_paths = GetLocalFilePaths();
+      in_stream_.reset(
+          new PersistentInStream(DataFS(), local_file_paths, !shuffle_after_epoch_, false));
+    }
   }
-  ~OFRecordDataset() = default;
 
-  BatchType Next() override {
-    BatchType batch;
-    batch.push_back(TensorBuffer());
-    ReadSample(batch.back());
-    return batch;
+  static bool TryReadSample(PersistentInStream* in_stream, TensorBuffer* tensor) {
+    int64_t OFRecord_size = -1;
+    char* size_ptr = reinterpret_cast<char*>(&OFRecord_size);
+    if (in_stream->ReadFully(size_ptr, sizeof(int64_t)) != 0) { return false; }
+    CHECK_GT(OFRecord_size, 0);
+    tensor->Resize(Shape({OFRecord_size}), DataType::kChar);
+    CHECK_EQ(in_stream->ReadFully(tensor->mut_data<char>(), OFRecord_size), 0);
+    return true;
   }
 
- private:
   void ReadSample(TensorBuffer& tensor) {
-    int64_t OFRecord_size = -1;
-    char* size_ptr = reinterpret_cast<char*>(&OFRecord_size);
-    if (in_stream_->ReadFully(size_ptr, sizeof(int64_t)) != 0) {
+    if (!TryReadSample(in_stream_.get(), &tensor)) {
       ShuffleAfterEpoch();
-      CHECK_EQ(in_stream_->ReadFully(size_ptr, sizeof(int64_t)), 0);
+      CHECK(TryReadSample(in_stream_.get(), &tensor));
     }
-    CHECK_GT(OFRecord_size, 0);
-    tensor.Resize(Shape({OFRecord_size}), DataType::kChar);
-    CHECK_EQ(in_stream_->ReadFully(tensor.mut_data<char>(), OFRecord_size), 0);
   }
 
   void ShuffleAfterEpoch() {
@@ -119,6 +176,63 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
     return ret;
   }
 
+  void StartReaderThreads(int64_t num_reader_threads) {
+    const int64_t max_len = ParseIntegerFromEnv("ONEFLOW_OFRECORD_READER_THREAD_BUFFER_SIZE",
+                                                kOFRecordReaderThreadBufferSize);
+    for (int64_t i = 0; i < num_reader_threads; ++i) {
+      reader_slots_.emplace_back(new ReaderSlot(max_len));
+    }
+    for (int64_t i = 0; i < num_reader_threads; ++i) {
+      reader_slots_.at(i)->thread = std::thread([this, i]() { ReaderLoop(i); });
+    }
+  }
+
+  void ReaderLoop(int64_t slot_id) {
+    ReaderSlot* slot = reader_slots_.at(slot_id).get();
+    // Shuffled exactly as ShuffleAfterEpoch does, so every epoch covers the same parts as the
+    // single stream would.
+    std::vector<std::string> data_file_paths = data_file_paths_;
+    for (int64_t epoch = 0;; ++epoch) {
+      if (shuffle_after_epoch_ && epoch > 0) {
+        std::mt19937 g(kOneflowDatasetSeed + epoch);
+        std::shuffle(data_file_paths.begin(), data_file_paths.end(), g);
+      }
+      std::vector<std::string> slot_file_paths;
+      for (int64_t i = range_.begin() + slot_id; i < range_.end(); i += reader_slots_.size()) {
+        slot_file_paths.emplace_back(data_file_paths.at(i));
+      }
+      PersistentInStream in_stream(DataFS(), slot_file_paths, false, false);
+      while (true) {
+        BatchType batch(1);
+        if (!TryReadSample(&in_stream, &batch.back())) { break; }
+        if (slot->samples.Push(std::move(batch)) != kBufferStatusSuccess) { return; }
+      }
+      if (slot->samples.Push(BatchType()) != kBufferStatusSuccess) { return; }
+    }
+  }
+
+  // Takes one sample from every slot in turn, so the order only depends on the number of reader
+  // threads and not on how fast each of them is. A slot which finished its parts is skipped
+  // until all slots did and the next epoch begins.
+  void NextInterleaved(BatchType* batch) {
+    while (true) {
+      ReaderSlot* slot = reader_slots_.at(cur_slot_id_).get();
+      cur_slot_id_ = (cur_slot_id_ + 1) % reader_slots_.size();
+      if (slot->is_epoch_done) { continue; }
+      CHECK_EQ(slot->samples.Pull(batch), kBufferStatusSuccess);
+      if (!batch->empty()) { return; }
+      slot->is_epoch_done = true;
+      num_epoch_done_slots_ += 1;
+      if (num_epoch_done_slots_ == reader_slots_.size()) {
+        for (auto& s : reader_slots_) { s->is_epoch_done = false; }
+        num_epoch_done_slots_ = 0;
+        // Every epoch is interleaved the same way, starting from the first slot.
+        cur_slot_id_ = 0;
+        current_epoch_++;
+      }
+    }
+  }
+
   int32_t current_epoch_;
   bool shuffle_after_epoch_;
 
@@ -128,6 +242,10 @@ class OFRecordDataset final : public Dataset<TensorBuffer> {
   Range range_;
   std::vector<std::string> data_file_paths_;
   std::unique_ptr<PersistentInStream> in_stream_;
+
+  std::vector<std::unique_ptr<ReaderSlot>> reader_slots_;
+  size_t cur_slot_id_;
+  size_t num_epoch_done_slots_;
 };
 
 }  // namespace data
@@ -0,0 +1,159 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_dataset.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <numeric>
+#include <random>
+#include "oneflow/core/common/str_util.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+std::string CreateTempDirectory() {
+  const char* tmp_env = getenv("TMPDIR");
+  const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
+  std::string tpl = std::string(tmp_dir) + "/test_ofrecord_dataset_XXXXXX";
+  char* path = mkdtemp(const_cast<char*>(tpl.c_str()));
+  PCHECK(path != nullptr);
+  return std::string(path);
+}
+
+// Part i holds the records "i.0", "i.1", ... and its number of records is part_sizes[i].
+std::vector<std::string> WriteParts(fs::FileSystem* fs, const std::string& dir,
+                                    const std::vector<int64_t>& part_sizes) {
+  std::vector<std::string> part_paths;
+  for (size_t i = 0; i < part_sizes.size(); ++i) {
+    part_paths.emplace_back(JoinPath(dir, "part-" + std::to_string(i)));
+    std::unique_ptr<fs::WritableFile> file;
+    fs->NewWritableFile(part_paths.back(), &file);
+    for (int64_t j = 0; j < part_sizes.at(i); ++j) {
+      const std::string record = std::to_string(i) + "." + std::to_string(j);
+      const int64_t record_size = record.size();
+      file->Append(reinterpret_cast<const char*>(&record_size), sizeof(int64_t));
+      file->Append(record.data(), record.size());
+    }
+    file->Close();
+  }
+  return part_paths;
+}
+
+std::vector<std::string> ReadRecords(OFRecordDataset* dataset, size_t n) {
+  std::vector<std::string> records;
+  for (size_t i = 0; i < n; ++i) {
+    OFRecordDataset::BatchType batch = dataset->Next();
+    CHECK_EQ(batch.size(), 1);
+    records.emplace_back(batch.front().data<char>(), batch.front().elem_cnt());
+  }
+  return records;
+}
+
+// The records of one epoch: reader thread t reads the local parts t, t + N, ... in turn, and the
+// threads take turns sample by sample, skipping those that have no samples left.
+std::vector<std::string> ExpectedEpochRecords(const std::vector<int64_t>& part_ids,
+                                              const std::vector<int64_t>& part_sizes,
+                                              int64_t num_reader_threads) {
+  std::vector<std::vector<std::string>> thread_records(num_reader_threads);
+  for (size_t i = 0; i < part_ids.size(); ++i) {
+    const int64_t part_id = part_ids.at(i);
+    for (int64_t j = 0; j < part_sizes.at(part_id); ++j) {
+      thread_records.at(i % num_reader_threads)
+          .emplace_back(std::to_string(part_id) + "." + std::to_string(j));
+    }
+  }
+  std::vector<std::string> records;
+  for (size_t j = 0;; ++j) {
+    bool has_record = false;
+    for (const auto& one_thread_records : thread_records) {
+      if (j < one_thread_records.size()) {
+        records.emplace_back(one_thread_records.at(j));
+        has_record = true;
+      }
+    }
+    if (!has_record) { break; }
+  }
+  return records;
+}
+
+// Parts are shuffled after every epoch as in OFRecordDataset::ShuffleAfterEpoch.
+std::vector<std::vector<std::string>> ExpectedRecords(const std::vector<int64_t>& part_sizes,
+                                                      int32_t parallel_id, int32_t parallel_num,
+                                                      bool shuffle_after_epoch,
+                                                      int64_t num_reader_threads,
+                                                      int64_t num_epochs) {
+  std::vector<int64_t> part_ids(part_sizes.size());
+  std::iota(part_ids.begin(), part_ids.end(), 0);
+  const Range range = BalancedSplitter(part_sizes.size(), parallel_num).At(parallel_id);
+  num_reader_threads = std::min<int64_t>(num_reader_threads, range.size());
+  std::vector<std::vector<std::string>> epochs;
+  for (int64_t epoch = 0; epoch < num_epochs; ++epoch) {
+    if (shuffle_after_epoch && epoch > 0) {
+      std::mt19937 g(kOneflowDatasetSeed + epoch);
+      std::shuffle(part_ids.begin(), part_ids.end(), g);
+    }
+    const std::vector<int64_t> local_part_ids(part_ids.begin() + range.begin(),
+                                              part_ids.begin() + range.end());
+    epochs.emplace_back(ExpectedEpochRecords(local_part_ids, part_sizes, num_reader_threads));
+  }
+  return epochs;
+}
+
+}  // namespace
+
+TEST(OFRecordDataset, InterleavedReadersFollowPartOrder) {
+  fs::FileSystem* fs = DataFS();
+  const std::string dir = CreateTempDirectory();
+  // The reader threads get parts of different sizes, and with 2 or 3 threads some of them get
+  // fewer parts than others.
+  const std::vector<int64_t> part_sizes = {3, 5, 1, 4, 2, 2, 6};
+  const std::vector<std::string> part_paths = WriteParts(fs, dir, part_sizes);
+  for (const bool shuffle_after_epoch : {false, true}) {
+    for (int64_t num_reader_threads = 1; num_reader_threads <= 3; ++num_reader_threads) {
+      for (const auto& parallel : std::vector<std::pair<int32_t, int32_t>>{{0, 1}, {1, 2}}) {
+        const auto expected = ExpectedRecords(part_sizes, parallel.first, parallel.second,
+                                              shuffle_after_epoch, num_reader_threads, 2);
+        OFRecordDataset dataset(part_paths, parallel.first, parallel.second, shuffle_after_epoch,
+                                num_reader_threads);
+        for (size_t epoch = 0; epoch < expected.size(); ++epoch) {
+          ASSERT_EQ(ReadRecords(&dataset, expected.at(epoch).size()), expected.at(epoch))
+              << "shuffle_after_epoch " << shuffle_after_epoch << ", num_reader_threads "
+              << num_reader_threads << ", parallel_id " << parallel.first << ", epoch " << epoch;
+        }
+      }
+    }
+  }
+  // The shuffled epoch differs from the first one.
+  ASSERT_NE(ExpectedRecords(part_sizes, 0, 1, true, 1, 2).back(),
+            ExpectedRecords(part_sizes, 0, 1, false, 1, 2).back());
+  fs->RecursivelyDeleteDir(dir);
+}
+
+TEST(OFRecordDataset, ThreadWithFewerPartsIsSkippedAtEpochEnd) {
+  fs::FileSystem* fs = DataFS();
+  const std::string dir = CreateTempDirectory();
+  // Thread 0 reads part 0 and 2, thread 1 only part 1.
+  const std::vector<std::string> part_paths = WriteParts(fs, dir, {2, 1, 3});
+  OFRecordDataset dataset(part_paths, 0, 1, false, 2);
+  const std::vector<std::string> epoch = {"0.0", "1.0", "0.1", "2.0", "2.1", "2.2"};
+  ASSERT_EQ(ReadRecords(&dataset, epoch.size()), epoch);
+  ASSERT_EQ(ReadRecords(&dataset, epoch.size()), epoch);
+  fs->RecursivelyDeleteDir(dir);
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -0,0 +1,256 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_indexed_dataset.h"
+#include "oneflow/user/data/ofrecord_dataset.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/thread/thread_manager.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+constexpr size_t kIndexScanBufferSize = 4 * 1024 * 1024;
+
+}  // namespace
+
+constexpr char OFRecordIndex::kMagicCode[];
+
+OFRecordIndex::OFRecordIndex(fs::FileSystem* fs, const std::string& part_path)
+    : file_size_(fs->GetFileSize(part_path)), is_built_(false) {
+  if (!TryLoad(fs, part_path)) { Build(fs, part_path); }
+}
+
+bool OFRecordIndex::TryLoad(fs::FileSystem* fs, const std::string& part_path) {
+  const std::string sidecar_path = SidecarPath(part_path);
+  if (!fs->FileExists(sidecar_path)) { return false; }
+  const uint64_t sidecar_size = fs->GetFileSize(sidecar_path);
+  const uint64_t header_size = kMagicCodeLen + sizeof(uint64_t);
+  if (sidecar_size < header_size) {
+    LOG(WARNING) << "ignore truncated OFRecord index " << sidecar_path;
+    return false;
+  }
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(sidecar_path, &file);
+  std::vector<char> header(header_size);
+  file->Read(0, header_size, header.data());
+  uint64_t num_records = 0;
+  std::memcpy(&num_records, header.data() + kMagicCodeLen, sizeof(uint64_t));
+  if (std::memcmp(header.data(), kMagicCode, kMagicCodeLen) != 0
+      || sidecar_size != header_size + num_records * sizeof(int64_t)) {
+    LOG(WARNING) << "ignore malformed OFRecord index " << sidecar_path;
+    return false;
+  }
+  offsets_.resize(num_records);
+  if (num_records > 0) {
+    file->Read(header_size, num_records * sizeof(int64_t),
+               reinterpret_cast<char*>(offsets_.data()));
+  }
+  // An index left over from an older version of the part is rejected rather than trusted.
+  bool is_valid = (num_records == 0) ? (file_size_ == 0) : (offsets_.front() == 0);
+  for (size_t i = 0; is_valid && i < num_records; ++i) {
+    const uint64_t end = (i + 1 == num_records) ? file_size_ : offsets_.at(i + 1);
+    is_valid = offsets_.at(i) >= 0 && end > offsets_.at(i) + sizeof(int64_t);
+  }
+  if (is_valid && num_records > 0) {
+    // Records appended to the part after indexing would be taken for the tail of the last one.
+    std::unique_ptr<fs::RandomAccessFile> part_file;
+    fs->NewRandomAccessFile(part_path, &part_file);
+    int64_t last_record_size = -1;
+    part_file->Read(offsets_.back(), sizeof(int64_t), reinterpret_cast<char*>(&last_record_size));
+    is_valid = last_record_size == record_size(num_records - 1);
+  }
+  if (!is_valid) {
+    LOG(WARNING) << "ignore OFRecord index " << sidecar_path << " not matching " << part_path;
+    offsets_.clear();
+    return false;
+  }
+  return true;
+}
+
+void OFRecordIndex::Build(fs::FileSystem* fs, const std::string& part_path) {
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(part_path, &file);
+  std::vector<char> buffer(kIndexScanBufferSize);
+  uint64_t buffer_begin = 0;
+  uint64_t buffer_end = 0;
+  uint64_t offset = 0;
+  // Only the length prefixes are needed, so the buffer is refilled at the next prefix and the
+  // bodies of large records are never read.
+  while (offset < file_size_) {
+    if (offset + sizeof(int64_t) > buffer_end) {
+      const uint64_t n = std::min<uint64_t>(kIndexScanBufferSize, file_size_ - offset);
+      CHECK_GE(n, sizeof(int64_t)) << "truncated OFRecord part " << part_path;
+      file->Read(offset, n, buffer.data());
+      buffer_begin = offset;
+      buffer_end = offset + n;
+    }
+    int64_t record_size = -1;
+    std::memcpy(&record_size, buffer.data() + (offset - buffer_begin), sizeof(int64_t));
+    CHECK_GT(record_size, 0) << "corrupted OFRecord part " << part_path;
+    offsets_.emplace_back(offset);
+    offset += sizeof(int64_t) + record_size;
+  }
+  CHECK_EQ(offset, file_size_) << "truncated OFRecord part " << part_path;
+  is_built_ = true;
+}
+
+void OFRecordIndex::Save(fs::FileSystem* fs, const std::string& part_path) const {
+  const std::string sidecar_path = SidecarPath(part_path);
+  // Written aside and renamed, so that a concurrent reader never sees a partial index.
+  const std::string tmp_path = sidecar_path + ".tmp";
+  std::unique_ptr<fs::WritableFile> file;
+  fs->NewWritableFile(tmp_path, &file);
+  const uint64_t num_records = offsets_.size();
+  file->Append(kMagicCode, kMagicCodeLen);
+  file->Append(reinterpret_cast<const char*>(&num_records), sizeof(uint64_t));
+  file->Append(reinterpret_cast<const char*>(offsets_.data()), num_records * sizeof(int64_t));
+  file->Close();
+  fs->RenameFile(tmp_path, sidecar_path);
+}
+
+OFRecordIndexedDataset::OFRecordIndexedDataset(user_op::KernelInitContext* ctx)
+    : current_epoch_(0), shard_pos_(0) {
+  shuffle_ = ctx->Attr<bool>("random_shuffle") || ctx->Attr<bool>("shuffle_after_epoch");
+  // All ranks must draw the same permutation, so a per-rank random seed can not be used here.
+  seed_ = ctx->Attr<int64_t>("seed");
+  if (seed_ == -1) { seed_ = kOneflowDatasetSeed; }
+  GetOFRecordParallelIdAndNum(ctx, &parallel_id_, &parallel_num_);
+  Init(DataFS(), GetOFRecordDataFilePaths(ctx));
+}
+
+OFRecordIndexedDataset::OFRecordIndexedDataset(fs::FileSystem* fs,
+                                               const std::vector<std::string>& data_file_paths,
+                                               int32_t parallel_id, int32_t parallel_num,
+                                               bool shuffle, int64_t seed)
+    : shuffle_(shuffle),
+      seed_(seed),
+      current_epoch_(0),
+      parallel_id_(parallel_id),
+      parallel_num_(parallel_num),
+      shard_pos_(0) {
+  Init(fs, data_file_paths);
+}
+
+void OFRecordIndexedDataset::Init(fs::FileSystem* fs,
+                                  const std::vector<std::string>& data_file_paths) {
+  read_group_size_ = ParseIntegerFromEnv("ONEFLOW_OFRECORD_READER_READ_GROUP_SIZE", 256);
+  CHECK_GT(read_group_size_, 0);
+  coalesce_gap_bytes_ =
+      ParseIntegerFromEnv("ONEFLOW_OFRECORD_READER_COALESCE_GAP_BYTES", 64 * 1024);
+  const size_t part_num = data_file_paths.size();
+  const bool save_index = ParseBooleanFromEnv("ONEFLOW_OFRECORD_READER_SAVE_INDEX", false);
+  files_.resize(part_num);
+  indices_.resize(part_num);
+  MultiThreadLoop(part_num, [&](size_t i) {
+    fs->NewRandomAccessFile(data_file_paths.at(i), &files_.at(i));
+    indices_.at(i).reset(new OFRecordIndex(fs, data_file_paths.at(i)));
+    // Every rank builds all missing indices, but each one is only written by a single rank.
+    if (save_index && indices_.at(i)->is_built() && i % parallel_num_ == parallel_id_) {
+      indices_.at(i)->Save(fs, data_file_paths.at(i));
+    }
+  });
+  part_record_id_offsets_.resize(part_num + 1);
+  part_record_id_offsets_.at(0) = 0;
+  for (size_t i = 0; i < part_num; ++i) {
+    part_record_id_offsets_.at(i + 1) =
+        part_record_id_offsets_.at(i) + indices_.at(i)->num_records();
+  }
+  CHECK_GE(part_record_id_offsets_.back(), parallel_num_);
+  StartEpoch();
+}
+
+OFRecordIndexedDataset::BatchType OFRecordIndexedDataset::Next() {
+  if (samples_.empty()) { ReadGroup(); }
+  BatchType batch;
+  batch.push_back(std::move(samples_.front()));
+  samples_.pop_front();
+  return batch;
+}
+
+void OFRecordIndexedDataset::StartEpoch() {
+  const int64_t num_records = part_record_id_offsets_.back();
+  std::vector<int64_t> record_ids(num_records);
+  std::iota(record_ids.begin(), record_ids.end(), 0);
+  if (shuffle_) {
+    std::mt19937 g(seed_ + current_epoch_);
+    std::shuffle(record_ids.begin(), record_ids.end(), g);
+  }
+  BalancedSplitter bs(num_records, parallel_num_);
+  const Range range = bs.At(parallel_id_);
+  shard_record_ids_.assign(record_ids.begin() + range.begin(), record_ids.begin() + range.end());
+  shard_pos_ = 0;
+}
+
+size_t OFRecordIndexedDataset::PartId4RecordId(int64_t record_id) const {
+  auto it = std::upper_bound(part_record_id_offsets_.begin(), part_record_id_offsets_.end(),
+                             record_id);
+  return std::distance(part_record_id_offsets_.begin(), it) - 1;
+}
+
+void OFRecordIndexedDataset::ReadGroup() {
+  if (shard_pos_ == shard_record_ids_.size()) {
+    current_epoch_ += 1;
+    StartEpoch();
+  }
+  const size_t group_size = std::min(read_group_size_, shard_record_ids_.size() - shard_pos_);
+  const int64_t* group_record_ids = shard_record_ids_.data() + shard_pos_;
+  shard_pos_ += group_size;
+  // Global record ids increase with the part and with the position inside the part, so visiting
+  // the group in id order turns it into forward reads over each part.
+  std::vector<size_t> order(group_size);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    return group_record_ids[lhs] < group_record_ids[rhs];
+  });
+  std::vector<TensorBuffer> group(group_size);
+  size_t run_begin = 0;
+  while (run_begin < group_size) {
+    const size_t part_id = PartId4RecordId(group_record_ids[order.at(run_begin)]);
+    const OFRecordIndex& index = *indices_.at(part_id);
+    const int64_t part_record_id_offset = part_record_id_offsets_.at(part_id);
+    const int64_t part_record_id_end = part_record_id_offsets_.at(part_id + 1);
+    auto RecordIdx = [&](size_t i) {
+      return group_record_ids[order.at(i)] - part_record_id_offset;
+    };
+    const uint64_t read_begin = index.record_offset(RecordIdx(run_begin));
+    uint64_t read_end = read_begin + sizeof(int64_t) + index.record_size(RecordIdx(run_begin));
+    size_t run_end = run_begin + 1;
+    while (run_end < group_size && group_record_ids[order.at(run_end)] < part_record_id_end
+           && index.record_offset(RecordIdx(run_end)) - read_end <= coalesce_gap_bytes_) {
+      read_end = index.record_offset(RecordIdx(run_end)) + sizeof(int64_t)
+                 + index.record_size(RecordIdx(run_end));
+      run_end += 1;
+    }
+    if (read_buffer_.size() < read_end - read_begin) { read_buffer_.resize(read_end - read_begin); }
+    files_.at(part_id)->Read(read_begin, read_end - read_begin, read_buffer_.data());
+    for (size_t i = run_begin; i < run_end; ++i) {
+      const char* record = read_buffer_.data() + index.record_offset(RecordIdx(i)) - read_begin;
+      const int64_t record_size = index.record_size(RecordIdx(i));
+      int64_t prefix_size = -1;
+      std::memcpy(&prefix_size, record, sizeof(int64_t));
+      CHECK_EQ(prefix_size, record_size) << "OFRecord index does not match the part";
+      TensorBuffer& tensor = group.at(order.at(i));
+      tensor.Resize(Shape({record_size}), DataType::kChar);
+      std::memcpy(tensor.mut_data<char>(), record + sizeof(int64_t), record_size);
+    }
+    run_begin = run_end;
+  }
+  for (auto& tensor : group) { samples_.push_back(std::move(tensor)); }
+}
+
+}  // namespace data
+}  // namespace oneflow
@@ -0,0 +1,107 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
+#define ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
+
+#include "oneflow/core/framework/op_kernel.h"
+#include "oneflow/core/persistence/file_system.h"
+#include "oneflow/user/data/dataset.h"
+
+namespace oneflow {
+namespace data {
+
+// Byte offsets of the length prefixes of all records in one OFRecord part.
+// The index lives in the sidecar file "<part>.idx": kMagicCode, the uint64 number of records and
+// then one int64 offset per record. If the sidecar is missing, the index is built by walking the
+// length prefixes of the part.
+class OFRecordIndex final {
+ public:
+  OFRecordIndex(fs::FileSystem* fs, const std::string& part_path);
+  ~OFRecordIndex() = default;
+
+  static constexpr char kMagicCode[] = "OFRIDX\x00\x00";
+  static constexpr size_t kMagicCodeLen = sizeof(kMagicCode) - 1;
+
+  static std::string SidecarPath(const std::string& part_path) { return part_path + ".idx"; }
+
+  size_t num_records() const { return offsets_.size(); }
+  uint64_t file_size() const { return file_size_; }
+  // offset of the length prefix of the record
+  uint64_t record_offset(size_t i) const { return offsets_.at(i); }
+  // size of the record excluding its length prefix
+  uint64_t record_size(size_t i) const {
+    const uint64_t end = (i + 1 == offsets_.size()) ? file_size_ : offsets_.at(i + 1);
+    return end - offsets_.at(i) - sizeof(int64_t);
+  }
+  bool is_built() const { return is_built_; }
+
+  void Save(fs::FileSystem* fs, const std::string& part_path) const;
+
+ private:
+  bool TryLoad(fs::FileSystem* fs, const std::string& part_path);
+  void Build(fs::FileSystem* fs, const std::string& part_path);
+
+  uint64_t file_size_;
+  bool is_built_;
+  std::vector<int64_t> offsets_;
+};
+
+// Treats all records of all parts as one sequence and reads them through
+// fs::RandomAccessFile in a per-sample permutation regenerated every epoch. Every rank derives the
+// same permutation from the seed and reads its own contiguous shard of it. Records are fetched
+// in groups, sorted by position and adjacent ones are merged into a single read.
+class OFRecordIndexedDataset final : public Dataset<TensorBuffer> {
+ public:
+  using Base = Dataset<TensorBuffer>;
+  using SampleType = typename Base::SampleType;
+  using BatchType = typename Base::BatchType;
+
+  OF_DISALLOW_COPY_AND_MOVE(OFRecordIndexedDataset);
+  OFRecordIndexedDataset(user_op::KernelInitContext* ctx);
+  OFRecordIndexedDataset(fs::FileSystem* fs, const std::vector<std::string>& data_file_paths,
+                         int32_t parallel_id, int32_t parallel_num, bool shuffle, int64_t seed);
+  ~OFRecordIndexedDataset() = default;
+
+  BatchType Next() override;
+
+ private:
+  void Init(fs::FileSystem* fs, const std::vector<std::string>& data_file_paths);
+  void StartEpoch();
+  void ReadGroup();
+  size_t PartId4RecordId(int64_t record_id) const;
+
+  bool shuffle_;
+  int64_t seed_;
+  int64_t current_epoch_;
+  int32_t parallel_id_;
+  int32_t parallel_num_;
+  size_t read_group_size_;
+  uint64_t coalesce_gap_bytes_;
+
+  std::vector<std::unique_ptr<fs::RandomAccessFile>> files_;
+  std::vector<std::unique_ptr<const OFRecordIndex>> indices_;
+  // first global record id of every part, with the total number of records appended
+  std::vector<int64_t> part_record_id_offsets_;
+  std::vector<int64_t> shard_record_ids_;
+  size_t shard_pos_;
+  std::vector<char> read_buffer_;
+  std::deque<TensorBuffer> samples_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_OFRECORD_INDEXED_DATASET_H_
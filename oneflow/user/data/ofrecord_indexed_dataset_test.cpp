@@ -0,0 +1,224 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/ofrecord_indexed_dataset.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <numeric>
+#include "oneflow/core/common/str_util.h"
+
+namespace oneflow {
+namespace data {
+
+namespace {
+
+std::string CreateTempDirectory() {
+  const char* tmp_env = getenv("TMPDIR");
+  const char* tmp_dir = tmp_env == nullptr ? "/tmp" : tmp_env;
+  std::string tpl = std::string(tmp_dir) + "/test_ofrecord_indexed_dataset_XXXXXX";
+  char* path = mkdtemp(const_cast<char*>(tpl.c_str()));
+  PCHECK(path != nullptr);
+  return std::string(path);
+}
+
+// Records have different sizes and their bytes identify the record id.
+std::string Record4RecordId(int64_t record_id) {
+  std::string record = "record-" + std::to_string(record_id) + ":";
+  const size_t size = record.size() + (record_id * 37) % 300;
+  for (size_t i = record.size(); i < size; ++i) {
+    record.push_back(static_cast<char>((record_id + i) % 251));
+  }
+  return record;
+}
+
+void AppendRecords(fs::FileSystem* fs, const std::string& part_path, int64_t begin_record_id,
+                   int64_t end_record_id) {
+  std::unique_ptr<fs::WritableFile> file;
+  fs->NewAppendableFile(part_path, &file);
+  for (int64_t record_id = begin_record_id; record_id < end_record_id; ++record_id) {
+    const std::string record = Record4RecordId(record_id);
+    const int64_t record_size = record.size();
+    file->Append(reinterpret_cast<const char*>(&record_size), sizeof(int64_t));
+    file->Append(record.data(), record.size());
+  }
+  file->Close();
+}
+
+// Writes the records [part_record_id_offsets[i], part_record_id_offsets[i + 1]) into part i.
+std::vector<std::string> WriteParts(fs::FileSystem* fs, const std::string& dir,
+                                    const std::vector<int64_t>& part_record_id_offsets) {
+  std::vector<std::string> part_paths;
+  for (size_t i = 0; i + 1 < part_record_id_offsets.size(); ++i) {
+    part_paths.emplace_back(JoinPath(dir, "part-" + std::to_string(i)));
+    AppendRecords(fs, part_paths.back(), part_record_id_offsets.at(i),
+                  part_record_id_offsets.at(i + 1));
+  }
+  return part_paths;
+}
+
+std::string Sample2Record(const TensorBuffer& sample) {
+  return std::string(sample.data<char>(), sample.elem_cnt());
+}
+
+int64_t RecordId4Record(const std::string& record) {
+  const size_t begin = record.find('-') + 1;
+  return std::stoll(record.substr(begin, record.find(':') - begin));
+}
+
+void ExpectSameIndex(const OFRecordIndex& lhs, const OFRecordIndex& rhs) {
+  ASSERT_EQ(lhs.num_records(), rhs.num_records());
+  ASSERT_EQ(lhs.file_size(), rhs.file_size());
+  for (size_t i = 0; i < lhs.num_records(); ++i) {
+    ASSERT_EQ(lhs.record_offset(i), rhs.record_offset(i));
+    ASSERT_EQ(lhs.record_size(i), rhs.record_size(i));
+  }
+}
+
+std::vector<std::string> ReadRecords(OFRecordIndexedDataset* dataset, size_t n) {
+  std::vector<std::string> records;
+  for (size_t i = 0; i < n; ++i) {
+    OFRecordIndexedDataset::BatchType batch = dataset->Next();
+    CHECK_EQ(batch.size(), 1);
+    records.emplace_back(Sample2Record(batch.front()));
+  }
+  return records;
+}
+
+}  // namespace
+
+TEST(OFRecordIndex, BuildSaveAndLoad) {
+  fs::FileSystem* fs = LocalFS();
+  const std::string dir = CreateTempDirectory();
+  const std::string part_path = WriteParts(fs, dir, {0, 100}).front();
+  const OFRecordIndex built(fs, part_path);
+  ASSERT_TRUE(built.is_built());
+  ASSERT_EQ(built.num_records(), 100);
+  uint64_t offset = 0;
+  for (size_t i = 0; i < built.num_records(); ++i) {
+    ASSERT_EQ(built.record_offset(i), offset);
+    ASSERT_EQ(built.record_size(i), Record4RecordId(i).size());
+    offset += sizeof(int64_t) + Record4RecordId(i).size();
+  }
+  ASSERT_EQ(built.file_size(), offset);
+
+  built.Save(fs, part_path);
+  ASSERT_TRUE(fs->FileExists(OFRecordIndex::SidecarPath(part_path)));
+  const OFRecordIndex loaded(fs, part_path);
+  ASSERT_FALSE(loaded.is_built());
+  ExpectSameIndex(built, loaded);
+
+  // The sidecar no longer matches a part with appended records.
+  AppendRecords(fs, part_path, 100, 110);
+  const OFRecordIndex rebuilt(fs, part_path);
+  ASSERT_TRUE(rebuilt.is_built());
+  ASSERT_EQ(rebuilt.num_records(), 110);
+  ASSERT_EQ(rebuilt.record_size(109), Record4RecordId(109).size());
+  rebuilt.Save(fs, part_path);
+
+  // A truncated sidecar is rebuilt as well.
+  {
+    std::unique_ptr<fs::WritableFile> file;
+    fs->NewWritableFile(OFRecordIndex::SidecarPath(part_path), &file);
+    file->Append(OFRecordIndex::kMagicCode, OFRecordIndex::kMagicCodeLen);
+    file->Close();
+  }
+  const OFRecordIndex from_truncated(fs, part_path);
+  ASSERT_TRUE(from_truncated.is_built());
+  ExpectSameIndex(rebuilt, from_truncated);
+  fs->RecursivelyDeleteDir(dir);
+}
+
+TEST(OFRecordIndexedDataset, PermutationVisitsEverySampleOncePerEpoch) {
+  fs::FileSystem* fs = LocalFS();
+  const std::string dir = CreateTempDirectory();
+  const std::vector<int64_t> part_record_id_offsets = {0, 37, 38, 100, 161};
+  const int64_t num_records = part_record_id_offsets.back();
+  const std::vector<std::string> part_paths = WriteParts(fs, dir, part_record_id_offsets);
+  setenv("ONEFLOW_OFRECORD_READER_READ_GROUP_SIZE", "16", 1);
+  const int32_t parallel_num = 3;
+  std::vector<std::unique_ptr<OFRecordIndexedDataset>> datasets;
+  for (int32_t parallel_id = 0; parallel_id < parallel_num; ++parallel_id) {
+    datasets.emplace_back(
+        new OFRecordIndexedDataset(fs, part_paths, parallel_id, parallel_num, true, 1234));
+  }
+  unsetenv("ONEFLOW_OFRECORD_READER_READ_GROUP_SIZE");
+  std::vector<int64_t> previous_epoch_record_ids;
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    std::vector<int64_t> epoch_record_ids;
+    for (int32_t parallel_id = 0; parallel_id < parallel_num; ++parallel_id) {
+      // 161 records over 3 ranks are 54, 54 and 53 records per epoch.
+      const size_t shard_size = parallel_id < 2 ? 54 : 53;
+      for (const std::string& record : ReadRecords(datasets.at(parallel_id).get(), shard_size)) {
+        const int64_t record_id = RecordId4Record(record);
+        ASSERT_EQ(record, Record4RecordId(record_id));
+        epoch_record_ids.push_back(record_id);
+      }
+    }
+    std::vector<int64_t> sorted_record_ids = epoch_record_ids;
+    std::sort(sorted_record_ids.begin(), sorted_record_ids.end());
+    std::vector<int64_t> all_record_ids(num_records);
+    std::iota(all_record_ids.begin(), all_record_ids.end(), 0);
+    ASSERT_EQ(sorted_record_ids, all_record_ids) << "epoch " << epoch;
+    // Samples are shuffled, and differently in every epoch.
+    ASSERT_NE(epoch_record_ids, all_record_ids);
+    ASSERT_NE(epoch_record_ids, previous_epoch_record_ids);
+    previous_epoch_record_ids = epoch_record_ids;
+  }
+  fs->RecursivelyDeleteDir(dir);
+}
+
+TEST(OFRecordIndexedDataset, CoalescedReadsMatchSequentialReads) {
+  fs::FileSystem* fs = LocalFS();
+  const std::string dir = CreateTempDirectory();
+  const std::vector<int64_t> part_record_id_offsets = {0, 50, 51, 130};
+  const int64_t num_records = part_record_id_offsets.back();
+  const std::vector<std::string> part_paths = WriteParts(fs, dir, part_record_id_offsets);
+  const auto NewDataset = [&](const char* read_group_size, const char* coalesce_gap_bytes,
+                              bool shuffle) {
+    setenv("ONEFLOW_OFRECORD_READER_READ_GROUP_SIZE", read_group_size, 1);
+    setenv("ONEFLOW_OFRECORD_READER_COALESCE_GAP_BYTES", coalesce_gap_bytes, 1);
+    std::unique_ptr<OFRecordIndexedDataset> dataset(
+        new OFRecordIndexedDataset(fs, part_paths, 0, 1, shuffle, 4321));
+    unsetenv("ONEFLOW_OFRECORD_READER_READ_GROUP_SIZE");
+    unsetenv("ONEFLOW_OFRECORD_READER_COALESCE_GAP_BYTES");
+    return dataset;
+  };
+  std::vector<std::string> expected_records;
+  for (int64_t record_id = 0; record_id < num_records; ++record_id) {
+    expected_records.push_back(Record4RecordId(record_id));
+  }
+  // One record per read, in the order of the parts.
+  std::unique_ptr<OFRecordIndexedDataset> sequential = NewDataset("1", "0", false);
+  ASSERT_EQ(ReadRecords(sequential.get(), num_records), expected_records);
+  // Whole groups are merged into one read per part, across epochs too.
+  std::unique_ptr<OFRecordIndexedDataset> coalesced = NewDataset("64", "1048576", false);
+  ASSERT_EQ(ReadRecords(coalesced.get(), num_records), expected_records);
+  ASSERT_EQ(ReadRecords(coalesced.get(), num_records), expected_records);
+  // Shuffled groups are read in position order with gaps between the records, but the samples
+  // are still returned in the order of the permutation.
+  std::unique_ptr<OFRecordIndexedDataset> shuffled_uncoalesced = NewDataset("1", "0", true);
+  std::unique_ptr<OFRecordIndexedDataset> shuffled_coalesced = NewDataset("64", "1024", true);
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    const std::vector<std::string> records = ReadRecords(shuffled_coalesced.get(), num_records);
+    ASSERT_EQ(records, ReadRecords(shuffled_uncoalesced.get(), num_records));
+    for (const std::string& record : records) {
+      ASSERT_EQ(record, Record4RecordId(RecordId4Record(record)));
+    }
+  }
+  fs->RecursivelyDeleteDir(dir);
+}
+
+}  // namespace data
+}  // namespace oneflow
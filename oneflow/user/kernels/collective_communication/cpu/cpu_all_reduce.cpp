@@ -26,6 +26,224 @@ namespace ccl {
 
 namespace {
 
+// Messages up to this size are reduced by recursive doubling, which takes log2(n) exchanges of
+// the whole buffer instead of the 2 * (n - 1) latency bound steps of the ring.
+size_t RecursiveDoublingMaxBytes() {
+  static const size_t max_bytes =
+      ParseIntegerFromEnv("ONEFLOW_CCL_CPU_ALL_REDUCE_RECURSIVE_DOUBLING_MAX_BYTES", 64 * 1024);
+  return max_bytes;
+}
+
+// Every ring step is split into chunks of this size, so that the reduction of a chunk overlaps
+// the transfer of the following ones.
+size_t RingChunkBytes() {
+  static const size_t chunk_bytes =
+      std::max<int64_t>(ParseIntegerFromEnv("ONEFLOW_CCL_CPU_ALL_REDUCE_CHUNK_BYTES", 256 * 1024),
+                        1);
+  return chunk_bytes;
+}
+
+std::unique_ptr<AsyncTransportCtx> NewAsyncTransportCtx(const TransportToken& transport_token,
+                                                        void* buffer, std::size_t size) {
+  const auto& Prepare = [buffer, size](void** out_buffer, std::size_t* out_size,
+                                       std::function<void()>* Cb) -> Maybe<void> {
+    *out_buffer = buffer;
+    *out_size = size;
+    *Cb = [] {};
+    return Maybe<void>::Ok();
+  };
+  return std::make_unique<NaiveAsyncTransportCtx>(transport_token, Prepare, Prepare);
+}
+
+// Ring all-reduce of 2 * (n - 1) steps: the first n - 1 steps reduce-scatter the parts, the
+// last n - 1 steps all-gather them. At step s, part (parallel_id - s) is sent to the next rank
+// and part (parallel_id - s - 1) is received from the previous one, so the part received at a
+// step is the one sent at the following step. Each part is transferred in chunks, and a chunk
+// is forwarded as soon as it has been received and reduced, without waiting for the whole step.
+template<typename T, ReduceType reduce_type>
+class RingAllReduce final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(RingAllReduce);
+  RingAllReduce(const T* in, T* out, size_t elem_cnt, int64_t parallel_id, int64_t parallel_num,
+                Symbol<RankGroup> rank_group, const TransportToken& transport_token)
+      : in_(in),
+        out_(out),
+        parallel_id_(parallel_id),
+        parallel_num_(parallel_num),
+        num_steps_(2 * (parallel_num - 1)),
+        bs_(elem_cnt, parallel_num),
+        chunk_elem_cnt_(std::max<size_t>(RingChunkBytes() / sizeof(T), 1)),
+        rank_group_(rank_group),
+        transport_token_(transport_token),
+        step2send_ctxs_(num_steps_),
+        step2recv_ctxs_(num_steps_) {
+    // Two buffers, so that the chunks of step s + 1 can be received while step s is reduced.
+    for (auto& recv_buffer : recv_buffers_) {
+      recv_buffer = std::make_unique<T[]>(bs_.At(0).size());
+    }
+  }
+  ~RingAllReduce() = default;
+
+  Maybe<void> Run() {
+    for (int64_t chunk = 0; chunk < NumChunks(SendPartId(0)); ++chunk) { JUST(Send(0, chunk)); }
+    JUST(PostRecvs(0));
+    for (int64_t step = 0; step < num_steps_; ++step) {
+      if (step + 1 < num_steps_) {
+        // All-gather steps receive into out, where the part sent parallel_num - 1 steps earlier
+        // may still be read by the transport.
+        if (step + 1 >= parallel_num_ - 1) { JUST(WaitSends(step + 1 - (parallel_num_ - 1))); }
+        JUST(PostRecvs(step + 1));
+      }
+      const int64_t part_id = RecvPartId(step);
+      for (int64_t chunk = 0; chunk < NumChunks(part_id); ++chunk) {
+        JUST(step2recv_ctxs_.at(step).at(chunk)->WaitDone());
+        if (step < parallel_num_ - 1) {
+          const size_t offset = ChunkOffset(part_id, chunk);
+          ReduceFunctor<T, reduce_type>::Call(ChunkSize(part_id, chunk), out_ + offset,
+                                              in_ + offset, RecvBuffer(step, chunk));
+        }
+        if (step + 1 < num_steps_) { JUST(Send(step + 1, chunk)); }
+      }
+      step2recv_ctxs_.at(step).clear();
+    }
+    for (int64_t step = 0; step < num_steps_; ++step) { JUST(WaitSends(step)); }
+    return Maybe<void>::Ok();
+  }
+
+ private:
+  int64_t SendPartId(int64_t step) const {
+    return ((parallel_id_ - step) % parallel_num_ + parallel_num_) % parallel_num_;
+  }
+  int64_t RecvPartId(int64_t step) const { return SendPartId(step + 1); }
+
+  int64_t NumChunks(int64_t part_id) const {
+    return RoundUp(bs_.At(part_id).size(), chunk_elem_cnt_) / chunk_elem_cnt_;
+  }
+  size_t ChunkOffset(int64_t part_id, int64_t chunk) const {
+    return bs_.At(part_id).begin() + chunk * chunk_elem_cnt_;
+  }
+  size_t ChunkSize(int64_t part_id, int64_t chunk) const {
+    return std::min(chunk_elem_cnt_, bs_.At(part_id).size() - chunk * chunk_elem_cnt_);
+  }
+  T* RecvBuffer(int64_t step, int64_t chunk) const {
+    return recv_buffers_[step % 2].get() + chunk * chunk_elem_cnt_;
+  }
+
+  Maybe<void> Send(int64_t step, int64_t chunk) {
+    const int64_t part_id = SendPartId(step);
+    const T* send_ptr = (step == 0 ? in_ : out_) + ChunkOffset(part_id, chunk);
+    auto ctx = NewAsyncTransportCtx(transport_token_, const_cast<T*>(send_ptr),
+                                    ChunkSize(part_id, chunk) * sizeof(T));
+    JUST(TransportUtil::SendToNextRankInRing(rank_group_, transport_token_, ctx.get()));
+    step2send_ctxs_.at(step).emplace_back(std::move(ctx));
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> PostRecvs(int64_t step) {
+    const int64_t part_id = RecvPartId(step);
+    for (int64_t chunk = 0; chunk < NumChunks(part_id); ++chunk) {
+      T* recv_ptr = nullptr;
+      if (step < parallel_num_ - 1) {
+        recv_ptr = RecvBuffer(step, chunk);
+      } else {
+        recv_ptr = out_ + ChunkOffset(part_id, chunk);
+      }
+      auto ctx =
+          NewAsyncTransportCtx(transport_token_, recv_ptr, ChunkSize(part_id, chunk) * sizeof(T));
+      JUST(TransportUtil::ReceiveFromPrevRankInRing(rank_group_, transport_token_, ctx.get()));
+      step2recv_ctxs_.at(step).emplace_back(std::move(ctx));
+    }
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> WaitSends(int64_t step) {
+    for (const auto& ctx : step2send_ctxs_.at(step)) { JUST(ctx->WaitDone()); }
+    step2send_ctxs_.at(step).clear();
+    return Maybe<void>::Ok();
+  }
+
+  const T* in_;
+  T* out_;
+  int64_t parallel_id_;
+  int64_t parallel_num_;
+  int64_t num_steps_;
+  BalancedSplitter bs_;
+  size_t chunk_elem_cnt_;
+  Symbol<RankGroup> rank_group_;
+  TransportToken transport_token_;
+  std::unique_ptr<T[]> recv_buffers_[2];
+  std::vector<std::vector<std::unique_ptr<AsyncTransportCtx>>> step2send_ctxs_;
+  std::vector<std::vector<std::unique_ptr<AsyncTransportCtx>>> step2recv_ctxs_;
+};
+
+// Recursive doubling: in round i every rank exchanges its whole buffer with the rank whose id
+// differs in bit i and reduces both. If parallel_num is not a power of two, the first
+// 2 * remainder ranks fold pairwise into their even member first, and the odd members receive
+// the result at the end. Both sides of an exchange compute the same commutative op, so all
+// ranks end up with bitwise identical results.
+template<typename T, ReduceType reduce_type>
+Maybe<void> RecursiveDoublingAllReduce(T* out, size_t elem_cnt, int64_t parallel_id,
+                                       int64_t parallel_num, Symbol<ParallelDesc> parallel_desc,
+                                       const TransportToken& transport_token) {
+  const size_t size = elem_cnt * sizeof(T);
+  auto recv_buffer = std::make_unique<T[]>(elem_cnt);
+  int64_t pof2 = 1;
+  while (pof2 * 2 <= parallel_num) { pof2 *= 2; }
+  const int64_t remainder = parallel_num - pof2;
+  const auto& Rank4ParallelId = [&](int64_t id) -> Maybe<int64_t> {
+    return parallel_desc->MachineId4ParallelId(id);
+  };
+  const auto& Exchange = [&](int64_t peer_id, bool send, bool recv, T* recv_ptr) -> Maybe<void> {
+    const int64_t peer_rank = JUST(Rank4ParallelId(peer_id));
+    NaiveAsyncTransportCtx ctx(
+        transport_token,
+        [&](void** buffer, std::size_t* buffer_size, std::function<void()>* Cb) -> Maybe<void> {
+          *buffer = out;
+          *buffer_size = size;
+          *Cb = [] {};
+          return Maybe<void>::Ok();
+        },
+        [&](void** buffer, std::size_t* buffer_size, std::function<void()>* Cb) -> Maybe<void> {
+          *buffer = recv_ptr;
+          *buffer_size = size;
+          *Cb = [] {};
+          return Maybe<void>::Ok();
+        });
+    if (send) { JUST(TransportUtil::SendDataToRank(peer_rank, transport_token, &ctx)); }
+    if (recv) { JUST(TransportUtil::ReceiveDataFromRank(peer_rank, transport_token, &ctx)); }
+    return ctx.WaitDone();
+  };
+
+  int64_t new_id = -1;
+  if (parallel_id < 2 * remainder) {
+    if (parallel_id % 2 == 1) {
+      JUST(Exchange(parallel_id - 1, /*send=*/true, /*recv=*/false, nullptr));
+    } else {
+      JUST(Exchange(parallel_id + 1, /*send=*/false, /*recv=*/true, recv_buffer.get()));
+      ReduceFunctor<T, reduce_type>::Call(elem_cnt, out, out, recv_buffer.get());
+      new_id = parallel_id / 2;
+    }
+  } else {
+    new_id = parallel_id - remainder;
+  }
+  if (new_id >= 0) {
+    for (int64_t mask = 1; mask < pof2; mask *= 2) {
+      const int64_t peer_new_id = new_id ^ mask;
+      const int64_t peer_id = peer_new_id < remainder ? peer_new_id * 2 : peer_new_id + remainder;
+      JUST(Exchange(peer_id, /*send=*/true, /*recv=*/true, recv_buffer.get()));
+      ReduceFunctor<T, reduce_type>::Call(elem_cnt, out, out, recv_buffer.get());
+    }
+  }
+  if (parallel_id < 2 * remainder) {
+    if (parallel_id % 2 == 1) {
+      JUST(Exchange(parallel_id - 1, /*send=*/false, /*recv=*/true, out));
+    } else {
+      JUST(Exchange(parallel_id + 1, /*send=*/true, /*recv=*/false, nullptr));
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
 template<typename T, ReduceType reduce_type>
 struct AllReduceImpl final {
   static Maybe<void> Call(const void* void_in, void* void_out, size_t elem_cnt,
@@ -37,84 +255,22 @@ struct AllReduceImpl final {
     }
     const T* in = reinterpret_cast<const T*>(void_in);
     T* out = reinterpret_cast<T*>(void_out);
-    BalancedSplitter bs(elem_cnt, parallel_num);
-    auto recv_buffer = std::make_unique<T[]>(bs.At(0).size());
     Optional<int64_t> parallel_id;
     JUST(GetTensorDevice4CurrentProcessCtx(parallel_desc, &parallel_id));
-    const auto& rank_group = JUST(RankGroup::New(parallel_desc));
     TransportToken transport_token =
         JUST(TransportToken::NewTransportToken(kTransportTokenTypeData));
-    for (int64_t i = 0, part_id = JUST(parallel_id); i < parallel_num - 1;
-         ++i, part_id = RingDecrease(part_id, parallel_num)) {
-      int64_t send_part_id = part_id;
-      const T* send_ptr = nullptr;
-      if (i == 0) {
-        send_ptr = &in[bs.At(send_part_id).begin()];
-      } else {
-        send_ptr = &out[bs.At(send_part_id).begin()];
-      }
-      size_t send_size = bs.At(send_part_id).size();
-      int64_t recv_part_id = RingDecrease(part_id, parallel_num);
-      T* recv_ptr = recv_buffer.get();
-      size_t recv_size = bs.At(recv_part_id).size();
-      NaiveAsyncTransportCtx ctx(
-          transport_token,
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = const_cast<T*>(send_ptr);
-            *size = send_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          },
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = recv_ptr;
-            *size = recv_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          });
-      if (send_size > 0) {
-        JUST(TransportUtil::SendToNextRankInRing(rank_group, transport_token, &ctx));
-      }
-      if (recv_size > 0) {
-        JUST(TransportUtil::ReceiveFromPrevRankInRing(rank_group, transport_token, &ctx));
-      }
-      JUST(ctx.WaitDone());
-      const T* cur_in = &in[bs.At(recv_part_id).begin()];
-      T* cur_out = &out[bs.At(recv_part_id).begin()];
-      if (recv_size > 0) {
-        ReduceFunctor<T, reduce_type>::Call(recv_size, cur_out, cur_in, recv_ptr);
-      }
-    }
-    for (int64_t i = 0, part_id = RingIncrease(JUST(parallel_id), parallel_num);
-         i < parallel_num - 1; ++i, part_id = RingDecrease(part_id, parallel_num)) {
-      int64_t send_part_id = part_id;
-      const T* send_ptr = &out[bs.At(send_part_id).begin()];
-      size_t send_size = bs.At(send_part_id).size();
-      int64_t recv_part_id = RingDecrease(part_id, parallel_num);
-      T* recv_ptr = &out[bs.At(recv_part_id).begin()];
-      size_t recv_size = bs.At(recv_part_id).size();
-      NaiveAsyncTransportCtx ctx(
-          transport_token,
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = const_cast<T*>(send_ptr);
-            *size = send_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          },
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = recv_ptr;
-            *size = recv_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          });
-      if (send_size > 0) {
-        JUST(TransportUtil::SendToNextRankInRing(rank_group, transport_token, &ctx));
-      }
-      if (recv_size > 0) {
-        JUST(TransportUtil::ReceiveFromPrevRankInRing(rank_group, transport_token, &ctx));
-      }
-      JUST(ctx.WaitDone());
+    // The ring moves 2 * (n - 1) / n of the data per rank whatever n is, but its step count
+    // grows with n, so small messages are latency bound and go through recursive doubling.
+    if (elem_cnt * sizeof(T) <= RecursiveDoublingMaxBytes() || elem_cnt < parallel_num) {
+      if (void_in != void_out) { std::memcpy(void_out, void_in, elem_cnt * sizeof(T)); }
+      return RecursiveDoublingAllReduce<T, reduce_type>(out, elem_cnt, JUST(parallel_id),
+                                                        parallel_num, parallel_desc,
+                                                        transport_token);
     }
-    return Maybe<void>::Ok();
+    const auto& rank_group = JUST(RankGroup::New(parallel_desc));
+    RingAllReduce<T, reduce_type> ring(in, out, elem_cnt, JUST(parallel_id), parallel_num,
+                                       rank_group, transport_token);
+    return ring.Run();
   }
 };
 
@@ -27,32 +27,44 @@ inline int64_t RingDecrease(int64_t n, int64_t size) { return (n - 1 + size) % s
 
 inline int64_t RingIncrease(int64_t n, int64_t size) { return (n + 1 + size) % size; }
 
+// Below this number of elements a reduction runs on the calling thread, since pool threads
+// would cost more than the loop itself. Ring all-reduce reduces chunks of roughly this size.
+constexpr size_t kReduceParallelMinElemCnt = 32 * 1024;
+
+template<typename T, typename BinaryOp>
+void ElementwiseReduce(size_t size, T* out, const T* in0, const T* in1, const BinaryOp& op) {
+  // A plain indexed loop without calls inside, so that the compiler can vectorize it.
+  const auto ReduceRange = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) { out[i] = op(in0[i], in1[i]); }
+  };
+  const size_t max_thread_num =
+      RoundUp(size, kReduceParallelMinElemCnt) / kReduceParallelMinElemCnt;
+  const size_t thread_num =
+      std::min<size_t>(Singleton<ThreadPool>::Get()->thread_num(), max_thread_num);
+  if (thread_num <= 1) {
+    ReduceRange(0, size);
+    return;
+  }
+  BalancedSplitter bs(size, thread_num);
+  MultiThreadLoop(thread_num, [&](size_t thread_idx) {
+    ReduceRange(bs.At(thread_idx).begin(), bs.At(thread_idx).end());
+  });
+}
+
 template<typename T, ReduceType reduce_type>
 struct ReduceFunctor;
 
 template<typename T>
 struct ReduceFunctor<T, kSum> {
   static void Call(size_t size, T* out, const T* in0, const T* in1) {
-    size_t thread_num = Singleton<ThreadPool>::Get()->thread_num();
-    BalancedSplitter bs(size, thread_num);
-    MultiThreadLoop(thread_num, [&](size_t thread_idx) {
-      size_t end = bs.At(thread_idx).end();
-      for (size_t i = bs.At(thread_idx).begin(); i < end; ++i) { out[i] = in0[i] + in1[i]; }
-    });
+    ElementwiseReduce(size, out, in0, in1, [](T x, T y) { return x + y; });
   }
 };
 
 template<typename T>
 struct ReduceFunctor<T, kMax> {
   static void Call(size_t size, T* out, const T* in0, const T* in1) {
-    size_t thread_num = Singleton<ThreadPool>::Get()->thread_num();
-    BalancedSplitter bs(size, thread_num);
-    MultiThreadLoop(thread_num, [&](size_t thread_idx) {
-      size_t end = bs.At(thread_idx).end();
-      for (size_t i = bs.At(thread_idx).begin(); i < end; ++i) {
-        out[i] = std::max(in0[i], in1[i]);
-      }
-    });
+    ElementwiseReduce(size, out, in0, in1, [](T x, T y) { return std::max(x, y); });
   }
 };
 
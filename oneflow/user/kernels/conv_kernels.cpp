@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/kernel/kernel_util.h"
 #include "oneflow/core/ep/include/primitive/add.h"
 #include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
@@ -158,6 +159,14 @@ using Im2ColFunc = void (*)(const T* in_dptr, const ShapeView& in_shape,
                             const int32_t* strides, const int32_t* dilation_rate,
                             const int32_t* padding_before, T* col_buf);
 
+// Writes rows [row_begin, row_end) of the column buffer only, see ConvKernelUtil.
+template<typename T>
+using Im2ColRowsFunc = void (*)(const T* in_dptr, const ShapeView& in_shape,
+                                const ShapeView& weight_shape, const ShapeView& out_shape,
+                                const int32_t* strides, const int32_t* dilation_rate,
+                                const int32_t* padding_before, int64_t row_begin, int64_t row_end,
+                                T* col_buf);
+
 template<typename T>
 using Col2ImFunc = void (*)(const T* col_buf, const ShapeView& in_shape,
                             const ShapeView& weight_shape, const ShapeView& out_shape,
@@ -352,6 +361,46 @@ struct ConvKernelUtil final {
     DoNDWHCFunc(weight_shape, col_buf_util, &col_buf_writer);
   }
 
+  // Every row of the column buffer belongs to one (c, kd, kh, kw) of the filter and holds
+  // od * oh * ow elements, so disjoint row ranges can be written by different threads.
+  static void NCDHWIm2ColRows(const T* in_dptr, const ShapeView& in_shape,
+                              const ShapeView& weight_shape, const ShapeView& out_shape,
+                              const int32_t* strides, const int32_t* dilation_rate,
+                              const int32_t* padding_before, int64_t row_begin, int64_t row_end,
+                              T* col_buf_ptr) {
+    ColBufUtil<T> col_buf_util(in_shape, out_shape, 2, strides, dilation_rate, padding_before);
+    const int64_t row_size = out_shape.Count(2);
+    FOR_RANGE(int64_t, row, row_begin, row_end) {
+      const int64_t kw = row % weight_shape.At(4);
+      const int64_t kh = row / weight_shape.At(4) % weight_shape.At(3);
+      const int64_t kd = row / weight_shape.Count(3) % weight_shape.At(2);
+      const int64_t c = row / weight_shape.Count(2);
+      Im2ColWriter<T> col_buf_writer(in_dptr + c * in_shape.Count(2), col_buf_ptr + row * row_size,
+                                     in_shape.Count(2), in_shape.Count(3), in_shape.Count(4), 1,
+                                     out_shape.Count(3), out_shape.Count(4), 1);
+      col_buf_util(&col_buf_writer, c, kd, kh, kw);
+    }
+  }
+
+  static void NDHWCIm2ColRows(const T* in_dptr, const ShapeView& in_shape,
+                              const ShapeView& weight_shape, const ShapeView& out_shape,
+                              const int32_t* strides, const int32_t* dilation_rate,
+                              const int32_t* padding_before, int64_t row_begin, int64_t row_end,
+                              T* col_buf_ptr) {
+    ColBufUtil<T> col_buf_util(in_shape, out_shape, 1, strides, dilation_rate, padding_before);
+    const int64_t row_size = out_shape.Count(1, 4);
+    FOR_RANGE(int64_t, row, row_begin, row_end) {
+      const int64_t c = row % weight_shape.At(4);
+      const int64_t kw = row / weight_shape.At(4) % weight_shape.At(3);
+      const int64_t kh = row / weight_shape.Count(3) % weight_shape.At(2);
+      const int64_t kd = row / weight_shape.Count(2);
+      Im2ColWriter<T> col_buf_writer(in_dptr, col_buf_ptr + row * row_size, in_shape.Count(2),
+                                     in_shape.Count(2), in_shape.Count(3), in_shape.Count(4),
+                                     out_shape.Count(2, 4), out_shape.Count(3, 4), 1);
+      col_buf_util(&col_buf_writer, c, kd, kh, kw);
+    }
+  }
+
   static void NCDHWCol2Im(const T* col_buf_ptr, const ShapeView& in_shape,
                           const ShapeView& weight_shape, const ShapeView& out_shape,
                           const int32_t* strides, const int32_t* dilation_rate,
@@ -404,6 +453,7 @@ struct ConvKernelUtil final {
 template<typename T>
 struct ConvOpKernelCache final : public user_op::OpKernelCache {
   Im2ColFunc<T> im2col_func_ = nullptr;
+  Im2ColRowsFunc<T> im2col_rows_func_ = nullptr;
   Col2ImFunc<T> col2im_func_ = nullptr;
 
   Shape in_5d_shape_;
@@ -415,6 +465,9 @@ struct ConvOpKernelCache final : public user_op::OpKernelCache {
   std::vector<int32_t> padding_before_3d_;
 
   bool is_out_diff_need_trans_ = false;
+  // 1x1 filter, unit strides and no padding: the column buffer of a channels first image is the
+  // image itself.
+  bool is_col_buf_same_as_in_ = false;
 
   int32_t idx_offset_{};
   bool is_dynamic_{};
@@ -430,11 +483,13 @@ std::shared_ptr<ConvOpKernelCache<T>> CreateConvOpKernelCache(user_op::KernelCac
   std::shared_ptr<ConvOpKernelCache<T>> cache(new ConvOpKernelCache<T>());
   if (data_format == "channels_first") {
     cache->im2col_func_ = ConvKernelUtil<T>::NCDHWIm2Col;
+    cache->im2col_rows_func_ = ConvKernelUtil<T>::NCDHWIm2ColRows;
     cache->col2im_func_ = ConvKernelUtil<T>::NCDHWCol2Im;
     cache->is_out_diff_need_trans_ = false;
     cache->idx_offset_ = 2;
   } else {
     cache->im2col_func_ = ConvKernelUtil<T>::NDHWCIm2Col;
+    cache->im2col_rows_func_ = ConvKernelUtil<T>::NDHWCIm2ColRows;
     cache->col2im_func_ = ConvKernelUtil<T>::NDHWCCol2Im;
     cache->is_out_diff_need_trans_ = true;
     cache->idx_offset_ = 1;
@@ -471,6 +526,15 @@ std::shared_ptr<ConvOpKernelCache<T>> CreateConvOpKernelCache(user_op::KernelCac
       cache->padding_before_3d_.emplace_back(padding_before.at(index));
     }
   }
+  if (data_format == "channels_first") {
+    cache->is_col_buf_same_as_in_ = true;
+    FOR_RANGE(int32_t, dim, 0, 3) {
+      if (cache->weight_5d_shape_.At(cache->idx_offset_ + dim) != 1
+          || cache->strides_3d_.at(dim) != 1 || cache->padding_before_3d_.at(dim) != 0) {
+        cache->is_col_buf_same_as_in_ = false;
+      }
+    }
+  }
 
   return cache;
 }
@@ -480,6 +544,9 @@ void InitBiasMulBuf(T* dptr, int64_t num) {
   for (int64_t i = 0; i < num; ++i) { dptr[i] = 1; }
 }
 
+// Size of the blocks of column buffer rows written by one task when an image is converted.
+constexpr int64_t kIm2ColBlockBytes = 256 * 1024;
+
 template<typename T, size_t NDims>
 class ConvCpuKernel final : public user_op::OpKernel {
  public:
@@ -506,8 +573,6 @@ class ConvCpuKernel final : public user_op::OpKernel {
 
     T* col_buf_dptr = tmp_buffer->mut_dptr<T>();
 
-    bool is_bias_mul_inited = false;
-
     const auto& data_format = ctx->Attr<std::string>("data_format");
     std::unique_ptr<ep::primitive::Matmul> matmul;
     if (data_format == "channels_first") {
@@ -517,36 +582,30 @@ class ConvCpuKernel final : public user_op::OpKernel {
     }
     CHECK(matmul);
 
-    for (int64_t i = 0; i < in->shape_view().At(0); ++i) {
-      conv_cache->im2col_func_(GetImgDptr<T>(in, i), ShapeView(conv_cache->in_5d_shape_),
-                               ShapeView(conv_cache->weight_5d_shape_),
-                               ShapeView(conv_cache->out_5d_shape_), conv_cache->strides_3d_.data(),
-                               conv_cache->dilation_rate_3d_.data(),
-                               conv_cache->padding_before_3d_.data(), col_buf_dptr);
+    int32_t idx_offset = conv_cache->idx_offset_;
+    const int64_t num_of_col_buf =
+        CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+    T* bias_mul_dptr = nullptr;
+    if (bias != nullptr) {
+      int64_t num_of_bias_mul =
+          (tmp_buffer->shape_view().elem_cnt() - num_of_col_buf * sizeof(T)) / sizeof(T);
+      CHECK_GT(num_of_bias_mul, 0);
+      bias_mul_dptr = col_buf_dptr + num_of_col_buf;
+      InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul);
+    }
 
+    auto ComputeImg = [&](int64_t i, const T* img_col_buf_dptr) {
       // channels first: out = weight * col_buf
       // channels last:  out = (weight * col_buf)(T)
-      int32_t idx_offset = conv_cache->idx_offset_;
       matmul->Launch(ctx->stream(),
                      conv_cache->weight_5d_shape_.At(0),                           // filter
                      conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
                      conv_cache->weight_5d_shape_.Count(1),  // ci * kd * kh * kw
-                     static_cast<T>(1), weight->dptr<T>(), col_buf_dptr, static_cast<T>(0),
+                     static_cast<T>(1), weight->dptr<T>(), img_col_buf_dptr, static_cast<T>(0),
                      GetImgMutDptr<T>(out, i));
 
-      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
       if (bias != nullptr) {
-        int64_t num_of_col_buf =
-            CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
-        int64_t num_of_bias_mul =
-            (tmp_buffer->shape_view().elem_cnt() - num_of_col_buf * sizeof(T)) / sizeof(T);
-        CHECK_GT(num_of_bias_mul, 0);
-        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf;
-        if (!is_bias_mul_inited) {
-          InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul);
-          is_bias_mul_inited = true;
-        }
-
         // channels first:  out += bias * bias_mul
         // channels last:   out += (bias * bias_mul)(T)
         matmul->Launch(ctx->stream(),
@@ -556,6 +615,35 @@ class ConvCpuKernel final : public user_op::OpKernel {
                        static_cast<T>(1), bias->dptr<T>(), bias_mul_dptr, static_cast<T>(1),
                        GetImgMutDptr<T>(out, i));
       }
+    };
+
+    // im2col is split into blocks of rows small enough to stay in cache. The GEMMs are launched
+    // from this thread only and left to the threads of the BLAS library, which is not known to be
+    // safe to call from several threads of the stream at once.
+    ep::CpuStream* cpu_stream = ctx->stream()->As<ep::CpuStream>();
+    const int64_t num_rows = conv_cache->weight_5d_shape_.Count(1);
+    const int64_t row_size = num_of_col_buf / num_rows;
+    const int64_t rows_per_block =
+        std::max<int64_t>(kIm2ColBlockBytes / (row_size * sizeof(T)), 1);
+    FOR_RANGE(int64_t, i, 0, in->shape_view().At(0)) {
+      if (conv_cache->is_col_buf_same_as_in_) {
+        ComputeImg(i, GetImgDptr<T>(in, i));
+        continue;
+      }
+      cpu_stream->ParallelFor(
+          0, num_rows,
+          [&](int64_t begin, int64_t end) {
+            for (int64_t row = begin; row < end; row += rows_per_block) {
+              conv_cache->im2col_rows_func_(
+                  GetImgDptr<T>(in, i), ShapeView(conv_cache->in_5d_shape_),
+                  ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+                  conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+                  conv_cache->padding_before_3d_.data(), row, std::min(row + rows_per_block, end),
+                  col_buf_dptr);
+            }
+          },
+          rows_per_block);
+      ComputeImg(i, col_buf_dptr);
     }
   }
 };
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/kernel/kernel_util.h"
 #include "oneflow/core/ep/include/primitive/add.h"
 #include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
@@ -461,6 +462,16 @@ template<typename T>
 void InitBiasMulBuf(T* dptr, int64_t num) {
   for (int64_t i = 0; i < num; ++i) { dptr[i] = 1; }
 }
+
+// Depthwise convs in channels first layout are computed by DepthwiseConvCpuKernel instead.
+auto IsChannelsFirstDepthwiseConv() {
+  return hob::make_custom("IsChannelsFirstDepthwiseConv", [](const user_op::KernelRegContext& ctx) {
+    const int32_t groups = ctx.Attr<int32_t>("groups");
+    return groups > 1 && ctx.Attr<std::string>("data_format") == "channels_first"
+           && ctx.TensorDesc4ArgNameAndIndex("in", 0)->shape().At(1) == groups;
+  });
+}
+
 template<typename T, size_t NDims>
 class ConvCpuKernel final : public user_op::OpKernel {
  public:
@@ -561,6 +572,7 @@ class ConvCpuKernel final : public user_op::OpKernel {
       .SetCreateFn<ConvCpuKernel<dtype, ndims>>()                                           \
       .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                       \
                        && (user_op::HobAttr<int32_t>("groups") > 1)                         \
+                       && !IsChannelsFirstDepthwiseConv()                                   \
                        && (user_op::HobDataType("in", 0) == GetDataType<dtype>::value)      \
                        && ChannelsFirstMatmulPrimitiveExists()                              \
                        && ChannelsLastMatmulPrimitiveExists())                              \
@@ -588,6 +600,106 @@ REGISTER_CONV_KERNEL(conv1d, double, 1);
 REGISTER_CONV_KERNEL(conv2d, double, 2);
 REGISTER_CONV_KERNEL(conv3d, double, 3);
 
+// Number of output elements a single task of the direct depthwise conv should compute at least.
+constexpr int64_t kDepthwiseConvGrainElems = 32768;
+
+// Every output channel of a depthwise conv only reads one input channel, so im2col would copy
+// the input kd * kh * kw times for GEMMs with a reduction size of only kd * kh * kw. The conv is
+// computed directly instead, one output plane per task.
+template<typename T>
+class DepthwiseConvCpuKernel final : public user_op::OpKernel {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(DepthwiseConvCpuKernel);
+  DepthwiseConvCpuKernel() = default;
+  ~DepthwiseConvCpuKernel() = default;
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+
+  std::shared_ptr<user_op::OpKernelCache> InitOpKernelCache(
+      user_op::KernelCacheContext* ctx) const override {
+    return CreateConvOpKernelCache<T>(ctx, "in", "out", "weight");
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState*,
+               const user_op::OpKernelCache* cache) const override {
+    const auto* conv_cache = dynamic_cast<const ConvOpKernelCache<T>*>(cache);
+    CHECK_NOTNULL(conv_cache);
+
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+
+    const ShapeView in_shape(conv_cache->in_5d_shape_);
+    const ShapeView out_shape(conv_cache->out_5d_shape_);
+    const ShapeView weight_shape(conv_cache->weight_5d_shape_);
+    const int32_t* strides = conv_cache->strides_3d_.data();
+    const int32_t* dilation_rate = conv_cache->dilation_rate_3d_.data();
+    const int32_t* padding_before = conv_cache->padding_before_3d_.data();
+    const int64_t num_in_channels = in_shape.At(1);
+    const int64_t num_out_channels = out_shape.At(1);
+    const int64_t channel_multiplier = num_out_channels / num_in_channels;
+
+    const int64_t num_planes = out_shape.At(0) * num_out_channels;
+    const int64_t grain_size = std::max<int64_t>(kDepthwiseConvGrainElems / out_shape.Count(2), 1);
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+        0, num_planes,
+        [&](int64_t begin, int64_t end) {
+          FOR_RANGE(int64_t, plane, begin, end) {
+            const int64_t n = plane / num_out_channels;
+            const int64_t f = plane % num_out_channels;
+            const int64_t c = f / channel_multiplier;
+            const T* in_dptr = in->dptr<T>() + (n * num_in_channels + c) * in_shape.Count(2);
+            const T* weight_dptr = weight->dptr<T>() + f * weight_shape.Count(1);
+            T* out_dptr = out->mut_dptr<T>() + plane * out_shape.Count(2);
+            const T bias_value = bias != nullptr ? bias->dptr<T>()[f] : static_cast<T>(0);
+            FOR_RANGE(int64_t, od, 0, out_shape.At(2)) {
+              FOR_RANGE(int64_t, oh, 0, out_shape.At(3)) {
+                FOR_RANGE(int64_t, ow, 0, out_shape.At(4)) {
+                  T sum = bias_value;
+                  FOR_RANGE(int64_t, kd, 0, weight_shape.At(2)) {
+                    const int64_t id = od * strides[0] - padding_before[0] + kd * dilation_rate[0];
+                    if (id < 0 || id >= in_shape.At(2)) { continue; }
+                    FOR_RANGE(int64_t, kh, 0, weight_shape.At(3)) {
+                      const int64_t ih =
+                          oh * strides[1] - padding_before[1] + kh * dilation_rate[1];
+                      if (ih < 0 || ih >= in_shape.At(3)) { continue; }
+                      const T* in_row = in_dptr + id * in_shape.Count(3) + ih * in_shape.At(4);
+                      const T* weight_row =
+                          weight_dptr + (kd * weight_shape.At(3) + kh) * weight_shape.At(4);
+                      FOR_RANGE(int64_t, kw, 0, weight_shape.At(4)) {
+                        const int64_t iw =
+                            ow * strides[2] - padding_before[2] + kw * dilation_rate[2];
+                        if (iw < 0 || iw >= in_shape.At(4)) { continue; }
+                        sum += in_row[iw] * weight_row[kw];
+                      }
+                    }
+                  }
+                  *(out_dptr++) = sum;
+                }
+              }
+            }
+          }
+        },
+        grain_size);
+  }
+};
+
+#define REGISTER_DEPTHWISE_CONV_KERNEL(op_name, dtype)                                   \
+  REGISTER_USER_KERNEL(#op_name)                                                         \
+      .SetCreateFn<DepthwiseConvCpuKernel<dtype>>()                                      \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                    \
+                       && (user_op::HobDataType("in", 0) == GetDataType<dtype>::value)   \
+                       && IsChannelsFirstDepthwiseConv())
+
+REGISTER_DEPTHWISE_CONV_KERNEL(conv1d, float);
+REGISTER_DEPTHWISE_CONV_KERNEL(conv2d, float);
+REGISTER_DEPTHWISE_CONV_KERNEL(conv3d, float);
+REGISTER_DEPTHWISE_CONV_KERNEL(conv1d, double);
+REGISTER_DEPTHWISE_CONV_KERNEL(conv2d, double);
+REGISTER_DEPTHWISE_CONV_KERNEL(conv3d, double);
+
 template<typename T>
 class ConvDataGradCpuKernel final : public user_op::OpKernel {
  public:
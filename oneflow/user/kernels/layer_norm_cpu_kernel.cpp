@@ -14,9 +14,323 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
 
 namespace oneflow {
 
+namespace {
+
+// Each row is processed in packs of kPackSize columns, every lane of the pack keeps its own
+// partial statistics so that the inner loops have no loop-carried dependence and can be
+// vectorized by the compiler. The lanes are merged once per row.
+constexpr int64_t kPackSize = 8;
+// Number of elements a single task of ParallelFor should process at least.
+constexpr int64_t kParallelGrainElems = 32768;
+// Upper bound of the partial buffers used by the param grad reduction.
+constexpr int64_t kMaxParamGradNumParts = 64;
+
+int64_t GetRowGrainSize(const int64_t norm_size) {
+  return std::max<int64_t>(1, kParallelGrainElems / std::max<int64_t>(norm_size, 1));
+}
+
+int64_t GetParamGradNumParts(const int64_t num_instances, const int64_t norm_size) {
+  const int64_t num_parts_by_elems =
+      std::max<int64_t>(1, num_instances * norm_size / kParallelGrainElems);
+  return std::max<int64_t>(
+      1, std::min(std::min(num_instances, num_parts_by_elems), kMaxParamGradNumParts));
+}
+
+template<typename T>
+inline void WelfordCombine(T b_mean, T b_m2, T b_count, T* mean, T* m2, T* count) {
+  // Chan's parallel variant of Welford's online algorithm, refer to:
+  // https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Parallel_algorithm
+  if (b_count == 0) { return; }
+  const T new_count = *count + b_count;
+  const T nb_over_n = b_count / new_count;
+  const T delta = b_mean - *mean;
+  *mean += delta * nb_over_n;
+  *m2 += b_m2 + delta * delta * (*count) * nb_over_n;
+  *count = new_count;
+}
+
+template<typename T, typename ComputeType>
+void WelfordRowMeanAndInvVariance(const T* x, const int64_t cols, const double epsilon,
+                                  ComputeType* mean, ComputeType* inv_variance) {
+  ComputeType lane_mean[kPackSize];
+  ComputeType lane_m2[kPackSize];
+  for (int64_t i = 0; i < kPackSize; ++i) {
+    lane_mean[i] = 0;
+    lane_m2[i] = 0;
+  }
+  const int64_t num_packs = cols / kPackSize;
+  for (int64_t pack = 0; pack < num_packs; ++pack) {
+    // All lanes share the same count, so the division is hoisted out of the lane loop.
+    const ComputeType inv_count =
+        static_cast<ComputeType>(1) / static_cast<ComputeType>(pack + 1);
+    const T* pack_x = x + pack * kPackSize;
+    for (int64_t i = 0; i < kPackSize; ++i) {
+      const ComputeType x_val = static_cast<ComputeType>(pack_x[i]);
+      const ComputeType delta1 = x_val - lane_mean[i];
+      lane_mean[i] += delta1 * inv_count;
+      lane_m2[i] += delta1 * (x_val - lane_mean[i]);
+    }
+  }
+  ComputeType row_mean = 0;
+  ComputeType row_m2 = 0;
+  ComputeType row_count = 0;
+  if (num_packs > 0) {
+    for (int64_t i = 0; i < kPackSize; ++i) {
+      WelfordCombine<ComputeType>(lane_mean[i], lane_m2[i], static_cast<ComputeType>(num_packs),
+                                  &row_mean, &row_m2, &row_count);
+    }
+  }
+  for (int64_t col = num_packs * kPackSize; col < cols; ++col) {
+    WelfordCombine<ComputeType>(static_cast<ComputeType>(x[col]), 0, 1, &row_mean, &row_m2,
+                                &row_count);
+  }
+  const ComputeType row_variance = std::max(row_m2 / row_count, static_cast<ComputeType>(0));
+  *mean = row_mean;
+  *inv_variance =
+      static_cast<ComputeType>(1) / std::sqrt(row_variance + static_cast<ComputeType>(epsilon));
+}
+
+template<typename T, typename ComputeType, bool do_scale, bool do_center>
+void LayerNormForwardCpu(ep::CpuStream* cpu_stream, const int64_t num_instances,
+                         const int64_t norm_size, const double epsilon, const T* x_ptr,
+                         const T* gamma_ptr, const T* beta_ptr, T* y_ptr, ComputeType* mean_ptr,
+                         ComputeType* inv_variance_ptr) {
+  cpu_stream->ParallelFor(
+      0, num_instances,
+      [=](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const T* row_x = x_ptr + row * norm_size;
+          T* row_y = y_ptr + row * norm_size;
+          ComputeType row_mean;
+          ComputeType row_inv_variance;
+          WelfordRowMeanAndInvVariance<T, ComputeType>(row_x, norm_size, epsilon, &row_mean,
+                                                       &row_inv_variance);
+          mean_ptr[row] = row_mean;
+          inv_variance_ptr[row] = row_inv_variance;
+          for (int64_t col = 0; col < norm_size; ++col) {
+            ComputeType normalized =
+                (static_cast<ComputeType>(row_x[col]) - row_mean) * row_inv_variance;
+            if (do_scale) { normalized *= static_cast<ComputeType>(gamma_ptr[col]); }
+            if (do_center) { normalized += static_cast<ComputeType>(beta_ptr[col]); }
+            row_y[col] = static_cast<T>(normalized);
+          }
+        }
+      },
+      GetRowGrainSize(norm_size));
+}
+
+template<typename T, typename ComputeType>
+void DispatchLayerNormForwardCpu(ep::CpuStream* cpu_stream, const int64_t num_instances,
+                                 const int64_t norm_size, const double epsilon, const T* x_ptr,
+                                 const T* gamma_ptr, const T* beta_ptr, T* y_ptr,
+                                 ComputeType* mean_ptr, ComputeType* inv_variance_ptr) {
+  if (gamma_ptr != nullptr && beta_ptr != nullptr) {
+    LayerNormForwardCpu<T, ComputeType, true, true>(cpu_stream, num_instances, norm_size, epsilon,
+                                                    x_ptr, gamma_ptr, beta_ptr, y_ptr, mean_ptr,
+                                                    inv_variance_ptr);
+  } else if (gamma_ptr != nullptr && beta_ptr == nullptr) {
+    LayerNormForwardCpu<T, ComputeType, true, false>(cpu_stream, num_instances, norm_size,
+                                                     epsilon, x_ptr, gamma_ptr, beta_ptr, y_ptr,
+                                                     mean_ptr, inv_variance_ptr);
+  } else if (gamma_ptr == nullptr && beta_ptr != nullptr) {
+    LayerNormForwardCpu<T, ComputeType, false, true>(cpu_stream, num_instances, norm_size,
+                                                     epsilon, x_ptr, gamma_ptr, beta_ptr, y_ptr,
+                                                     mean_ptr, inv_variance_ptr);
+  } else {
+    LayerNormForwardCpu<T, ComputeType, false, false>(cpu_stream, num_instances, norm_size,
+                                                      epsilon, x_ptr, gamma_ptr, beta_ptr, y_ptr,
+                                                      mean_ptr, inv_variance_ptr);
+  }
+}
+
+template<typename T, typename ComputeType, bool do_scale, bool do_add>
+void LayerNormBackwardCpu(ep::CpuStream* cpu_stream, const int64_t num_instances,
+                          const int64_t norm_size, const T* dy_ptr, const T* x_ptr,
+                          const ComputeType* mean_ptr, const ComputeType* inv_variance_ptr,
+                          const T* gamma_ptr, const T* add_to_output_ptr, T* dx_ptr) {
+  const ComputeType one_over_cols =
+      static_cast<ComputeType>(1) / static_cast<ComputeType>(norm_size);
+  const ComputeType cols = static_cast<ComputeType>(norm_size);
+  cpu_stream->ParallelFor(
+      0, num_instances,
+      [=](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t row_offset = row * norm_size;
+          const T* row_dy = dy_ptr + row_offset;
+          const T* row_x = x_ptr + row_offset;
+          T* row_dx = dx_ptr + row_offset;
+          const ComputeType row_mean = mean_ptr[row];
+          const ComputeType row_inv_variance = inv_variance_ptr[row];
+          const auto ScaledDy = [=](int64_t col) {
+            const ComputeType dy = static_cast<ComputeType>(row_dy[col]);
+            return do_scale ? dy * static_cast<ComputeType>(gamma_ptr[col]) : dy;
+          };
+          const auto Normalized = [=](int64_t col) {
+            return (static_cast<ComputeType>(row_x[col]) - row_mean) * row_inv_variance;
+          };
+          ComputeType lane_sum_stats1[kPackSize];
+          ComputeType lane_sum_stats2[kPackSize];
+          for (int64_t i = 0; i < kPackSize; ++i) {
+            lane_sum_stats1[i] = 0;
+            lane_sum_stats2[i] = 0;
+          }
+          const int64_t num_packed_cols = norm_size / kPackSize * kPackSize;
+          for (int64_t col = 0; col < num_packed_cols; col += kPackSize) {
+            for (int64_t i = 0; i < kPackSize; ++i) {
+              const ComputeType scaled_dy = ScaledDy(col + i);
+              lane_sum_stats1[i] += scaled_dy;
+              lane_sum_stats2[i] += scaled_dy * Normalized(col + i);
+            }
+          }
+          ComputeType sum_stats1 = 0;
+          ComputeType sum_stats2 = 0;
+          for (int64_t i = 0; i < kPackSize; ++i) {
+            sum_stats1 += lane_sum_stats1[i];
+            sum_stats2 += lane_sum_stats2[i];
+          }
+          for (int64_t col = num_packed_cols; col < norm_size; ++col) {
+            const ComputeType scaled_dy = ScaledDy(col);
+            sum_stats1 += scaled_dy;
+            sum_stats2 += scaled_dy * Normalized(col);
+          }
+          const ComputeType inv_variance_over_cols = row_inv_variance * one_over_cols;
+          for (int64_t col = 0; col < norm_size; ++col) {
+            ComputeType dx = (cols * ScaledDy(col) - sum_stats1 - Normalized(col) * sum_stats2)
+                             * inv_variance_over_cols;
+            if (do_add) { dx += static_cast<ComputeType>(add_to_output_ptr[row_offset + col]); }
+            row_dx[col] = static_cast<T>(dx);
+          }
+        }
+      },
+      GetRowGrainSize(norm_size));
+}
+
+template<typename T, typename ComputeType, bool do_scale>
+void DispatchLayerNormBackwardDoAdd(ep::CpuStream* cpu_stream, const int64_t num_instances,
+                                    const int64_t norm_size, const T* dy_ptr, const T* x_ptr,
+                                    const ComputeType* mean_ptr,
+                                    const ComputeType* inv_variance_ptr, const T* gamma_ptr,
+                                    const T* add_to_output_ptr, T* dx_ptr) {
+  if (add_to_output_ptr != nullptr) {
+    LayerNormBackwardCpu<T, ComputeType, do_scale, true>(cpu_stream, num_instances, norm_size,
+                                                         dy_ptr, x_ptr, mean_ptr, inv_variance_ptr,
+                                                         gamma_ptr, add_to_output_ptr, dx_ptr);
+  } else {
+    LayerNormBackwardCpu<T, ComputeType, do_scale, false>(cpu_stream, num_instances, norm_size,
+                                                          dy_ptr, x_ptr, mean_ptr,
+                                                          inv_variance_ptr, gamma_ptr,
+                                                          add_to_output_ptr, dx_ptr);
+  }
+}
+
+template<typename T, typename ComputeType>
+void LaunchLayerNormBackward(ep::CpuStream* cpu_stream, const int64_t num_instances,
+                             const int64_t norm_size, const T* dy_ptr, const T* x_ptr,
+                             const ComputeType* mean_ptr, const ComputeType* inv_variance_ptr,
+                             const T* gamma_ptr, const T* add_to_output_ptr, T* dx_ptr) {
+  if (gamma_ptr != nullptr) {
+    DispatchLayerNormBackwardDoAdd<T, ComputeType, true>(cpu_stream, num_instances, norm_size,
+                                                         dy_ptr, x_ptr, mean_ptr, inv_variance_ptr,
+                                                         gamma_ptr, add_to_output_ptr, dx_ptr);
+  } else {
+    DispatchLayerNormBackwardDoAdd<T, ComputeType, false>(cpu_stream, num_instances, norm_size,
+                                                          dy_ptr, x_ptr, mean_ptr,
+                                                          inv_variance_ptr, gamma_ptr,
+                                                          add_to_output_ptr, dx_ptr);
+  }
+}
+
+template<typename T, typename ComputeType>
+void LayerNormParamGradCpu(ep::CpuStream* cpu_stream, const int64_t num_instances,
+                           const int64_t norm_size, const T* dy_ptr, const T* x_ptr,
+                           const ComputeType* mean_ptr, const ComputeType* inv_variance_ptr,
+                           ComputeType* tmp_buffer_ptr, T* gamma_diff_ptr, T* beta_diff_ptr) {
+  // Every part accumulates a contiguous range of rows into its own partial buffer, then the
+  // partial buffers are summed pairwise level by level until part 0 holds the result.
+  const int64_t num_parts = GetParamGradNumParts(num_instances, norm_size);
+  const int64_t rows_per_part = (num_instances + num_parts - 1) / num_parts;
+  ComputeType* tmp_gamma_diff_ptr = tmp_buffer_ptr;
+  ComputeType* tmp_beta_diff_ptr = tmp_buffer_ptr + num_parts * norm_size;
+  cpu_stream->ParallelFor(
+      0, num_parts,
+      [=](int64_t begin, int64_t end) {
+        for (int64_t part = begin; part < end; ++part) {
+          ComputeType* part_gamma_diff = tmp_gamma_diff_ptr + part * norm_size;
+          ComputeType* part_beta_diff = tmp_beta_diff_ptr + part * norm_size;
+          std::fill(part_gamma_diff, part_gamma_diff + norm_size, static_cast<ComputeType>(0));
+          std::fill(part_beta_diff, part_beta_diff + norm_size, static_cast<ComputeType>(0));
+          const int64_t row_end = std::min(num_instances, (part + 1) * rows_per_part);
+          for (int64_t row = part * rows_per_part; row < row_end; ++row) {
+            const T* row_dy = dy_ptr + row * norm_size;
+            const T* row_x = x_ptr + row * norm_size;
+            const ComputeType row_mean = mean_ptr[row];
+            const ComputeType row_inv_variance = inv_variance_ptr[row];
+            for (int64_t col = 0; col < norm_size; ++col) {
+              const ComputeType dy = static_cast<ComputeType>(row_dy[col]);
+              part_gamma_diff[col] +=
+                  dy * (static_cast<ComputeType>(row_x[col]) - row_mean) * row_inv_variance;
+              part_beta_diff[col] += dy;
+            }
+          }
+        }
+      },
+      1);
+  for (int64_t stride = 1; stride < num_parts; stride *= 2) {
+    const int64_t num_pairs = (num_parts + 2 * stride - 1) / (2 * stride);
+    cpu_stream->ParallelFor(
+        0, num_pairs * norm_size,
+        [=](int64_t begin, int64_t end) {
+          int64_t i = begin;
+          while (i < end) {
+            const int64_t pair = i / norm_size;
+            const int64_t col_begin = i - pair * norm_size;
+            const int64_t col_end = std::min(norm_size, col_begin + (end - i));
+            const int64_t dst_part = pair * 2 * stride;
+            const int64_t src_part = dst_part + stride;
+            if (src_part < num_parts) {
+              ComputeType* dst_gamma_diff = tmp_gamma_diff_ptr + dst_part * norm_size;
+              ComputeType* dst_beta_diff = tmp_beta_diff_ptr + dst_part * norm_size;
+              const ComputeType* src_gamma_diff = tmp_gamma_diff_ptr + src_part * norm_size;
+              const ComputeType* src_beta_diff = tmp_beta_diff_ptr + src_part * norm_size;
+              for (int64_t col = col_begin; col < col_end; ++col) {
+                dst_gamma_diff[col] += src_gamma_diff[col];
+                dst_beta_diff[col] += src_beta_diff[col];
+              }
+            }
+            i += col_end - col_begin;
+          }
+        },
+        kParallelGrainElems);
+  }
+  if (gamma_diff_ptr != nullptr) {
+    std::transform(tmp_gamma_diff_ptr, tmp_gamma_diff_ptr + norm_size, gamma_diff_ptr,
+                   [](ComputeType diff) { return static_cast<T>(diff); });
+  }
+  if (beta_diff_ptr != nullptr) {
+    std::transform(tmp_beta_diff_ptr, tmp_beta_diff_ptr + norm_size, beta_diff_ptr,
+                   [](ComputeType diff) { return static_cast<T>(diff); });
+  }
+}
+
+// float16 is loaded and stored as is, but the statistics and the sums are computed in float, which
+// is also the data type of mean and inv_variance.
+template<typename T>
+struct LayerNormComputeType {
+  using type = T;
+};
+
+template<>
+struct LayerNormComputeType<float16> {
+  using type = float;
+};
+
+}  // namespace
+
 template<typename T>
 class LayerNormCpuKernel final : public user_op::OpKernel {
  public:
@@ -25,7 +339,29 @@ class LayerNormCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    const double epsilon = ctx->Attr<double>("epsilon");
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    if (num_instances == 0) { return; }
+    const int64_t norm_size = x->shape_view().elem_cnt() / num_instances;
+    const T* gamma_ptr = nullptr;
+    const T* beta_ptr = nullptr;
+    if (ctx->has_input("gamma", 0)) {
+      const user_op::Tensor* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+      gamma_ptr = gamma->dptr<T>();
+      CHECK_EQ(gamma->shape_view().elem_cnt(), norm_size);
+    }
+    if (ctx->has_input("beta", 0)) { beta_ptr = ctx->Tensor4ArgNameAndIndex("beta", 0)->dptr<T>(); }
+    using ComputeType = typename LayerNormComputeType<T>::type;
+    DispatchLayerNormForwardCpu<T, ComputeType>(
+        ctx->stream()->As<ep::CpuStream>(), num_instances, norm_size, epsilon, x->dptr<T>(),
+        gamma_ptr, beta_ptr, y->mut_dptr<T>(), mean->mut_dptr<ComputeType>(),
+        inv_variance->mut_dptr<ComputeType>());
+  };
 };
 
 #define REGISTER_LAYER_NORM_CPU_KERNEL(dtype)                         \
@@ -36,6 +372,7 @@ class LayerNormCpuKernel final : public user_op::OpKernel {
 
 REGISTER_LAYER_NORM_CPU_KERNEL(float)
 REGISTER_LAYER_NORM_CPU_KERNEL(double)
+REGISTER_LAYER_NORM_CPU_KERNEL(float16)
 
 template<typename T>
 class LayerNormGradCpuKernel final : public user_op::OpKernel {
@@ -45,17 +382,51 @@ class LayerNormGradCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    if (num_instances == 0) { return; }
+    const int64_t norm_size = x->shape_view().elem_cnt() / num_instances;
+    const T* gamma_ptr = nullptr;
+    if (ctx->has_input("gamma", 0)) {
+      gamma_ptr = ctx->Tensor4ArgNameAndIndex("gamma", 0)->dptr<T>();
+    }
+    const T* add_to_output_ptr = nullptr;
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), dx->data_type());
+      CHECK_EQ(add_to_output->shape_view(), dx->shape_view());
+      add_to_output_ptr = add_to_output->dptr<T>();
+    }
+    using ComputeType = typename LayerNormComputeType<T>::type;
+    LaunchLayerNormBackward<T, ComputeType>(
+        ctx->stream()->As<ep::CpuStream>(), num_instances, norm_size, dy->dptr<T>(), x->dptr<T>(),
+        mean->dptr<ComputeType>(), inv_variance->dptr<ComputeType>(), gamma_ptr, add_to_output_ptr,
+        dx->mut_dptr<T>());
+  };
 };
 
-#define REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(dtype)                    \
-  REGISTER_USER_KERNEL("layer_norm_grad")                             \
-      .SetCreateFn<LayerNormGradCpuKernel<dtype>>()                   \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
-                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value));
+#define REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(dtype)                                         \
+  REGISTER_USER_KERNEL("layer_norm_grad")                                                  \
+      .SetCreateFn<LayerNormGradCpuKernel<dtype>>()                                        \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                      \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value))    \
+      .SetInplaceProposalFn(                                                               \
+          [](const user_op::InferContext& ctx,                                             \
+             const user_op::AddInplaceArgPair& AddInplaceArgPairFn) -> Maybe<void> {       \
+            if (ctx.has_input("_add_to_output", 0)) {                                      \
+              OF_RETURN_IF_ERROR(AddInplaceArgPairFn("dx", 0, "_add_to_output", 0, true)); \
+            }                                                                              \
+            return Maybe<void>::Ok();                                                      \
+          });
 
 REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(float)
 REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(double)
+REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(float16)
 
 template<typename T>
 class LayerNormParamGradCpuKernel final : public user_op::OpKernel {
@@ -65,16 +436,58 @@ class LayerNormParamGradCpuKernel final : public user_op::OpKernel {
 
  private:
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    T* gamma_diff_ptr = nullptr;
+    T* beta_diff_ptr = nullptr;
+    if (ctx->has_output("gamma_diff", 0)) {
+      gamma_diff_ptr = ctx->Tensor4ArgNameAndIndex("gamma_diff", 0)->mut_dptr<T>();
+    }
+    if (ctx->has_output("beta_diff", 0)) {
+      beta_diff_ptr = ctx->Tensor4ArgNameAndIndex("beta_diff", 0)->mut_dptr<T>();
+    }
+    if (num_instances == 0) {
+      const int64_t norm_size = x->shape_view().Count(ctx->Attr<int64_t>("begin_params_axis"));
+      if (gamma_diff_ptr != nullptr) {
+        std::fill(gamma_diff_ptr, gamma_diff_ptr + norm_size, static_cast<T>(0));
+      }
+      if (beta_diff_ptr != nullptr) {
+        std::fill(beta_diff_ptr, beta_diff_ptr + norm_size, static_cast<T>(0));
+      }
+      return;
+    }
+    const int64_t norm_size = x->shape_view().elem_cnt() / num_instances;
+    using ComputeType = typename LayerNormComputeType<T>::type;
+    LayerNormParamGradCpu<T, ComputeType>(
+        ctx->stream()->As<ep::CpuStream>(), num_instances, norm_size, dy->dptr<T>(), x->dptr<T>(),
+        mean->dptr<ComputeType>(), inv_variance->dptr<ComputeType>(),
+        tmp_buffer->mut_dptr<ComputeType>(), gamma_diff_ptr, beta_diff_ptr);
+  };
 };
 
-#define REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(dtype)              \
-  REGISTER_USER_KERNEL("layer_norm_param_grad")                       \
-      .SetCreateFn<LayerNormParamGradCpuKernel<dtype>>()              \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
-                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value));
+#define REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(dtype)                                       \
+  REGISTER_USER_KERNEL("layer_norm_param_grad")                                                \
+      .SetCreateFn<LayerNormParamGradCpuKernel<dtype>>()                                       \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                          \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value))        \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) {                                      \
+        const int64_t begin_params_axis = ctx->Attr<int64_t>("begin_params_axis");             \
+        const auto& dy = ctx->InputTensorDesc("dy", 0);                                        \
+        const int64_t num_instances = dy.shape().Count(0, begin_params_axis);                  \
+        const int64_t norm_size = dy.shape().Count(begin_params_axis);                         \
+        const int64_t num_parts = GetParamGradNumParts(num_instances, norm_size);              \
+        size_t tmp_buffer_size =                                                               \
+            2 * num_parts * norm_size * sizeof(LayerNormComputeType<dtype>::type);             \
+        return tmp_buffer_size;                                                                \
+      });
 
 REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(float)
 REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(double)
+REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(float16)
 
 }  // namespace oneflow
@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/user/kernels/model_update_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
@@ -55,15 +56,17 @@ void SGDUpdateKernelUtil<DeviceType::kCPU, T, G, C>::Update(
   if (skip_if != nullptr && *skip_if != 0) { return; }
   if (learning_rate != nullptr) { learning_rate_val = *learning_rate; }
   if (scale_by_ptr != nullptr) { scale *= *scale_by_ptr; }
-  for (int64_t i = 0; i != n; ++i) {
-    if (model_copy != nullptr) {
-      FusedSGDUpdateFunctor<T, G, C>()(model_diff + i, model + i, model_copy + i, scale, l1, l2,
-                                       weight_decay, learning_rate_val);
-    } else {
-      SGDUpdateFunctor<T, G>()(model_diff + i, model + i, scale, l1, l2, weight_decay,
-                               learning_rate_val);
+  stream->As<ep::CpuStream>()->ParallelFor(0, n, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i != end; ++i) {
+      if (model_copy != nullptr) {
+        FusedSGDUpdateFunctor<T, G, C>()(model_diff + i, model + i, model_copy + i, scale, l1, l2,
+                                         weight_decay, learning_rate_val);
+      } else {
+        SGDUpdateFunctor<T, G>()(model_diff + i, model + i, scale, l1, l2, weight_decay,
+                                 learning_rate_val);
+      }
     }
-  }
+  });
 }
 
 template struct SGDUpdateKernelUtil<DeviceType::kCPU, float, float, float16>;
@@ -122,10 +125,12 @@ void MomentumUpdateKernelUtil<DeviceType::kCPU, T, G>::Update(
   if (skip_if != nullptr && *skip_if != 0) { return; }
   if (learning_rate != nullptr) { learning_rate_val = *learning_rate; }
   if (scale_by_ptr != nullptr) { scale *= *scale_by_ptr; }
-  for (int64_t i = 0; i != n; ++i) {
-    MomentumUpdateFunctor<T, G>()(model_diff + i, model + i, momentum + i, scale, l1, l2, beta,
-                                  dampening, nesterov, maximize, weight_decay, learning_rate_val);
-  }
+  stream->As<ep::CpuStream>()->ParallelFor(0, n, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i != end; ++i) {
+      MomentumUpdateFunctor<T, G>()(model_diff + i, model + i, momentum + i, scale, l1, l2, beta,
+                                    dampening, nesterov, maximize, weight_decay, learning_rate_val);
+    }
+  });
 }
 
 template struct MomentumUpdateKernelUtil<DeviceType::kCPU, float, float>;
@@ -194,18 +199,20 @@ void AdamUpdateKernelUtil<DeviceType::kCPU, T, G, C>::Update(
   if (bias_correction1_ptr != nullptr) { bias_correction1_val = *bias_correction1_ptr; }
   if (bias_correction2_ptr != nullptr) { bias_correction2_val = *bias_correction2_ptr; }
 
-  FOR_RANGE(int64_t, i, 0, n) {
-    if (model_copy != nullptr) {
-      FusedAdamUpdateFunctor<T, G, C>()(model_diff + i, model + i, model_copy + i, m + i, v + i,
-                                        max_v + i, scale, l1, l2, beta1, beta2, epsilon,
-                                        weight_decay, amsgrad, bias_correction1_val,
-                                        bias_correction2_val, learning_rate_val);
-    } else {
-      AdamUpdateFunctor<T, G>()(model_diff + i, model + i, m + i, v + i, max_v + i, scale, l1, l2,
-                                beta1, beta2, epsilon, weight_decay, amsgrad, bias_correction1_val,
-                                bias_correction2_val, learning_rate_val);
+  stream->As<ep::CpuStream>()->ParallelFor(0, n, [&](int64_t begin, int64_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      if (model_copy != nullptr) {
+        FusedAdamUpdateFunctor<T, G, C>()(model_diff + i, model + i, model_copy + i, m + i, v + i,
+                                          max_v + i, scale, l1, l2, beta1, beta2, epsilon,
+                                          weight_decay, amsgrad, bias_correction1_val,
+                                          bias_correction2_val, learning_rate_val);
+      } else {
+        AdamUpdateFunctor<T, G>()(model_diff + i, model + i, m + i, v + i, max_v + i, scale, l1,
+                                  l2, beta1, beta2, epsilon, weight_decay, amsgrad,
+                                  bias_correction1_val, bias_correction2_val, learning_rate_val);
+      }
     }
-  }
+  });
 }
 
 template struct AdamUpdateKernelUtil<DeviceType::kCPU, float, float, float16>;
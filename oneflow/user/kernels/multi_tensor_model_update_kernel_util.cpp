@@ -0,0 +1,236 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/model_update_kernel_util.h"
+#include "oneflow/user/kernels/multi_tensor_model_update_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+namespace oneflow {
+
+namespace {
+
+// Calls UpdateRange(tensor_idx, begin, end) for every piece of the tensors, which are split as
+// one element space, so that the parallelism does not depend on the size of each tensor and
+// small tensors are updated together instead of in separate parallel loops.
+template<int N, typename F>
+void ForEachTensorRange(ep::Stream* stream, int64_t n_tensor,
+                        const TensorTupleParams<N>& tensor_tuple_params, const F& UpdateRange) {
+  int64_t offsets[kMaxTuples + 1];
+  offsets[0] = 0;
+  for (int64_t i = 0; i < n_tensor; ++i) {
+    offsets[i + 1] = offsets[i] + tensor_tuple_params.sizes[i];
+  }
+  stream->As<ep::CpuStream>()->ParallelFor(0, offsets[n_tensor], [&](int64_t begin, int64_t end) {
+    int64_t tensor_idx = std::upper_bound(offsets, offsets + n_tensor + 1, begin) - offsets - 1;
+    while (begin < end) {
+      const int64_t tensor_end = std::min(end, offsets[tensor_idx + 1]);
+      if (tensor_end > begin) {
+        UpdateRange(tensor_idx, begin - offsets[tensor_idx], tensor_end - offsets[tensor_idx]);
+      }
+      begin = tensor_end;
+      tensor_idx += 1;
+    }
+  });
+}
+
+// Updates the elements [begin, end) of tensor tensor_idx. The tuples of the WithCast kernels hold
+// a float16 model copy after the other tensors, so the update is specialized on the tuple size.
+template<typename T, typename G, int N>
+struct SGDUpdateRange;
+
+template<typename T, typename G>
+struct SGDUpdateRange<T, G, 2> {
+  static void Update(const TensorTupleParams<2>& tensor_tuple_params, int64_t tensor_idx,
+                     int64_t begin, int64_t end, T scale, float l1, float l2, float weight_decay,
+                     float learning_rate_val) {
+    T* model = static_cast<T*>(tensor_tuple_params.ptr[0][tensor_idx]);
+    const G* model_diff = static_cast<const G*>(tensor_tuple_params.ptr[1][tensor_idx]);
+    for (int64_t i = begin; i < end; ++i) {
+      SGDUpdateFunctor<T, G>()(model_diff + i, model + i, scale, l1, l2, weight_decay,
+                               learning_rate_val);
+    }
+  }
+};
+
+template<typename T, typename G>
+struct SGDUpdateRange<T, G, 3> {
+  static void Update(const TensorTupleParams<3>& tensor_tuple_params, int64_t tensor_idx,
+                     int64_t begin, int64_t end, T scale, float l1, float l2, float weight_decay,
+                     float learning_rate_val) {
+    T* model = static_cast<T*>(tensor_tuple_params.ptr[0][tensor_idx]);
+    const G* model_diff = static_cast<const G*>(tensor_tuple_params.ptr[1][tensor_idx]);
+    float16* model_copy = static_cast<float16*>(tensor_tuple_params.ptr[2][tensor_idx]);
+    for (int64_t i = begin; i < end; ++i) {
+      FusedSGDUpdateFunctor<T, G, float16>()(model_diff + i, model + i, model_copy + i, scale, l1,
+                                             l2, weight_decay, learning_rate_val);
+    }
+  }
+};
+
+// Multi tensor adam does not support amsgrad, so max_v is never accessed.
+template<typename T, typename G, int N>
+struct AdamUpdateRange;
+
+template<typename T, typename G>
+struct AdamUpdateRange<T, G, 4> {
+  static void Update(const TensorTupleParams<4>& tensor_tuple_params, int64_t tensor_idx,
+                     int64_t begin, int64_t end, T scale, float l1, float l2, float beta1,
+                     float beta2, float epsilon, float weight_decay, float bias_correction1_val,
+                     float bias_correction2_val, float learning_rate_val) {
+    T* model = static_cast<T*>(tensor_tuple_params.ptr[0][tensor_idx]);
+    const G* model_diff = static_cast<const G*>(tensor_tuple_params.ptr[1][tensor_idx]);
+    T* m = static_cast<T*>(tensor_tuple_params.ptr[2][tensor_idx]);
+    T* v = static_cast<T*>(tensor_tuple_params.ptr[3][tensor_idx]);
+    for (int64_t i = begin; i < end; ++i) {
+      AdamUpdateFunctor<T, G>()(model_diff + i, model + i, m + i, v + i, nullptr, scale, l1, l2,
+                                beta1, beta2, epsilon, weight_decay, /*amsgrad=*/false,
+                                bias_correction1_val, bias_correction2_val, learning_rate_val);
+    }
+  }
+};
+
+template<typename T, typename G>
+struct AdamUpdateRange<T, G, 5> {
+  static void Update(const TensorTupleParams<5>& tensor_tuple_params, int64_t tensor_idx,
+                     int64_t begin, int64_t end, T scale, float l1, float l2, float beta1,
+                     float beta2, float epsilon, float weight_decay, float bias_correction1_val,
+                     float bias_correction2_val, float learning_rate_val) {
+    T* model = static_cast<T*>(tensor_tuple_params.ptr[0][tensor_idx]);
+    const G* model_diff = static_cast<const G*>(tensor_tuple_params.ptr[1][tensor_idx]);
+    T* m = static_cast<T*>(tensor_tuple_params.ptr[2][tensor_idx]);
+    T* v = static_cast<T*>(tensor_tuple_params.ptr[3][tensor_idx]);
+    float16* model_copy = static_cast<float16*>(tensor_tuple_params.ptr[4][tensor_idx]);
+    for (int64_t i = begin; i < end; ++i) {
+      FusedAdamUpdateFunctor<T, G, float16>()(
+          model_diff + i, model + i, model_copy + i, m + i, v + i, nullptr, scale, l1, l2, beta1,
+          beta2, epsilon, weight_decay, /*amsgrad=*/false, bias_correction1_val,
+          bias_correction2_val, learning_rate_val);
+    }
+  }
+};
+
+template<typename T, typename G, int N>
+void MultiTensorSGDUpdateCpu(ep::Stream* stream, int64_t n_tensor, T scale, float l1, float l2,
+                             float weight_decay, float learning_rate_val,
+                             const float* learning_rate, const T* scale_by_ptr,
+                             const int64_t* skip_if,
+                             const TensorTupleParams<N>& tensor_tuple_params) {
+  if (skip_if != nullptr && *skip_if != 0) { return; }
+  if (learning_rate != nullptr) { learning_rate_val = *learning_rate; }
+  if (scale_by_ptr != nullptr) { scale *= *scale_by_ptr; }
+  ForEachTensorRange(stream, n_tensor, tensor_tuple_params,
+                     [&](int64_t tensor_idx, int64_t begin, int64_t end) {
+                       SGDUpdateRange<T, G, N>::Update(tensor_tuple_params, tensor_idx, begin, end,
+                                                       scale, l1, l2, weight_decay,
+                                                       learning_rate_val);
+                     });
+}
+
+template<typename T, typename G, int N>
+void MultiTensorAdamUpdateCpu(ep::Stream* stream, int64_t n_tensor, T scale, float l1, float l2,
+                              float beta1, float beta2, float epsilon, float weight_decay,
+                              float learning_rate_val, float bias_correction1_val,
+                              float bias_correction2_val, const float* learning_rate,
+                              const T* scale_by_ptr, const int64_t* skip_if,
+                              const float* bias_correction1_ptr, const float* bias_correction2_ptr,
+                              const TensorTupleParams<N>& tensor_tuple_params) {
+  if (skip_if != nullptr && *skip_if != 0) { return; }
+  if (learning_rate != nullptr) { learning_rate_val = *learning_rate; }
+  if (scale_by_ptr != nullptr) { scale *= *scale_by_ptr; }
+  if (bias_correction1_ptr != nullptr) { bias_correction1_val = *bias_correction1_ptr; }
+  if (bias_correction2_ptr != nullptr) { bias_correction2_val = *bias_correction2_ptr; }
+  ForEachTensorRange(stream, n_tensor, tensor_tuple_params,
+                     [&](int64_t tensor_idx, int64_t begin, int64_t end) {
+                       AdamUpdateRange<T, G, N>::Update(
+                           tensor_tuple_params, tensor_idx, begin, end, scale, l1, l2, beta1,
+                           beta2, epsilon, weight_decay, bias_correction1_val,
+                           bias_correction2_val, learning_rate_val);
+                     });
+}
+
+}  // namespace
+
+template<typename T, typename G>
+struct MultiTensorSGDUpdateKernelUtil<DeviceType::kCPU, T, G> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float weight_decay, float learning_rate_val,
+                     const float* learning_rate, const T* scale_by_ptr, const int64_t* skip_if,
+                     TensorTupleParams<2> tensor_tuple_params) {
+    MultiTensorSGDUpdateCpu<T, G, 2>(stream, n_tensor, scale, l1, l2, weight_decay,
+                                     learning_rate_val, learning_rate, scale_by_ptr, skip_if,
+                                     tensor_tuple_params);
+  }
+};
+
+template struct MultiTensorSGDUpdateKernelUtil<DeviceType::kCPU, float, float>;
+template struct MultiTensorSGDUpdateKernelUtil<DeviceType::kCPU, double, double>;
+
+template<typename T, typename G>
+struct MultiTensorAdamUpdateKernelUtil<DeviceType::kCPU, T, G> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float beta1, float beta2, float epsilon,
+                     float weight_decay, bool amsgrad, bool do_bias_correction,
+                     float learning_rate_val, float bias_correction1_val,
+                     float bias_correction2_val, const float* learning_rate, const T* scale_by_ptr,
+                     const int64_t* skip_if, const float* bias_correction1,
+                     const float* bias_correction2, TensorTupleParams<4> tensor_tuple_params) {
+    CHECK(!amsgrad);
+    MultiTensorAdamUpdateCpu<T, G, 4>(stream, n_tensor, scale, l1, l2, beta1, beta2, epsilon,
+                                      weight_decay, learning_rate_val, bias_correction1_val,
+                                      bias_correction2_val, learning_rate, scale_by_ptr, skip_if,
+                                      bias_correction1, bias_correction2, tensor_tuple_params);
+  }
+};
+
+template struct MultiTensorAdamUpdateKernelUtil<DeviceType::kCPU, float, float>;
+template struct MultiTensorAdamUpdateKernelUtil<DeviceType::kCPU, double, double>;
+
+template<typename T, typename G>
+struct MultiTensorSGDUpdateWithCastKernelUtil<DeviceType::kCPU, T, G> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float weight_decay, float learning_rate_val,
+                     const float* learning_rate, const T* scale_by_ptr, const int64_t* skip_if,
+                     TensorTupleParams<3> tensor_tuple_params) {
+    MultiTensorSGDUpdateCpu<T, G, 3>(stream, n_tensor, scale, l1, l2, weight_decay,
+                                     learning_rate_val, learning_rate, scale_by_ptr, skip_if,
+                                     tensor_tuple_params);
+  }
+};
+
+template struct MultiTensorSGDUpdateWithCastKernelUtil<DeviceType::kCPU, float, float>;
+template struct MultiTensorSGDUpdateWithCastKernelUtil<DeviceType::kCPU, double, double>;
+
+template<typename T, typename G>
+struct MultiTensorAdamUpdateWithCastKernelUtil<DeviceType::kCPU, T, G> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float beta1, float beta2, float epsilon,
+                     float weight_decay, bool amsgrad, bool do_bias_correction,
+                     float learning_rate_val, float bias_correction1_val,
+                     float bias_correction2_val, const float* learning_rate, const T* scale_by_ptr,
+                     const int64_t* skip_if, const float* bias_correction1,
+                     const float* bias_correction2, TensorTupleParams<5> tensor_tuple_params) {
+    CHECK(!amsgrad);
+    MultiTensorAdamUpdateCpu<T, G, 5>(stream, n_tensor, scale, l1, l2, beta1, beta2, epsilon,
+                                      weight_decay, learning_rate_val, bias_correction1_val,
+                                      bias_correction2_val, learning_rate, scale_by_ptr, skip_if,
+                                      bias_correction1, bias_correction2, tensor_tuple_params);
+  }
+};
+
+template struct MultiTensorAdamUpdateWithCastKernelUtil<DeviceType::kCPU, float, float>;
+template struct MultiTensorAdamUpdateWithCastKernelUtil<DeviceType::kCPU, double, double>;
+
+}  // namespace oneflow
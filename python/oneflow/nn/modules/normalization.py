@@ -149,7 +149,8 @@ def layer_norm(input, normalized_shape, weight=None, bias=None, eps=1e-05):
                 f"Given normalized_shape={normalized_shape}, expected input with shape [*, {str(normalized_shape)[1:-1]}], but got input of size {input.shape}"
             )
 
-    if not input.is_cuda:
+    if not input.is_cuda and input.dtype == flow.bfloat16:
+        # There are no bfloat16 CPU layer_norm kernels, compose it of mean and var.
         reduce_axis = []
         for dim in range(len(input.shape)):
             if dim >= begin_norm_axis:
@@ -177,24 +178,24 @@ def layer_norm(input, normalized_shape, weight=None, bias=None, eps=1e-05):
         if elementwise_affine:
             normalized = normalized * weight + bias
         return normalized
+
+    if elementwise_affine:
+        res = flow._C.layer_norm_affine(
+            input,
+            weight,
+            bias,
+            begin_norm_axis=begin_norm_axis,
+            begin_params_axis=begin_params_axis,
+            epsilon=eps,
+        )
     else:
-        if elementwise_affine:
-            res = flow._C.layer_norm_affine(
-                input,
-                weight,
-                bias,
-                begin_norm_axis=begin_norm_axis,
-                begin_params_axis=begin_params_axis,
-                epsilon=eps,
-            )
-        else:
-            res = flow._C.layer_norm(
-                input,
-                begin_norm_axis=begin_norm_axis,
-                begin_params_axis=begin_params_axis,
-                epsilon=eps,
-            )
-        return res
+        res = flow._C.layer_norm(
+            input,
+            begin_norm_axis=begin_norm_axis,
+            begin_params_axis=begin_params_axis,
+            epsilon=eps,
+        )
+    return res
 
 
 class LayerNorm(Module):
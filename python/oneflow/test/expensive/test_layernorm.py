@@ -126,6 +126,126 @@ def _test_layernorm_backward(test_case, device):
     )
 
 
+def _layernorm_np(x, gamma, beta, begin_norm_axis, eps):
+    axes = tuple(range(begin_norm_axis, x.ndim))
+    mean = x.mean(axis=axes, keepdims=True)
+    rstd = 1.0 / np.sqrt(x.var(axis=axes, keepdims=True) + eps)
+    normalized = (x - mean) * rstd
+    return normalized * gamma + beta, normalized, rstd
+
+
+def _layernorm_grad_np(dy, x, gamma, begin_norm_axis, eps):
+    axes = tuple(range(begin_norm_axis, x.ndim))
+    row_axes = tuple(range(begin_norm_axis))
+    _, normalized, rstd = _layernorm_np(x, gamma, 0, begin_norm_axis, eps)
+    dnormalized = dy * gamma
+    dx = rstd * (
+        dnormalized
+        - dnormalized.mean(axis=axes, keepdims=True)
+        - normalized * (dnormalized * normalized).mean(axis=axes, keepdims=True)
+    )
+    dgamma = (dy * normalized).sum(axis=row_axes)
+    dbeta = dy.sum(axis=row_axes)
+    return dx, dgamma, dbeta
+
+
+def _test_layernorm_with_numpy(
+    test_case, device, dtype, shape, begin_norm_axis, elementwise_affine
+):
+    eps = 1e-05
+    np_dtype = {flow.float64: np.float64, flow.float16: np.float16}.get(
+        dtype, np.float32
+    )
+    tol = {flow.float64: 1e-10, flow.float16: 1e-02}.get(dtype, 1e-04)
+    # float16 is normalized in float, so is the reference.
+    ref_dtype = np.float64 if dtype == flow.float64 else np.float32
+    normalized_shape = shape[begin_norm_axis:]
+    np_x = np.random.randn(*shape).astype(np_dtype)
+    np_dy = np.random.randn(*shape).astype(np_dtype)
+    x = flow.tensor(np_x, dtype=dtype, device=flow.device(device), requires_grad=True)
+    m = flow.nn.LayerNorm(
+        normalized_shape, eps=eps, elementwise_affine=elementwise_affine
+    )
+    if elementwise_affine:
+        np_gamma = np.random.randn(*normalized_shape).astype(np_dtype)
+        np_beta = np.random.randn(*normalized_shape).astype(np_dtype)
+        m.weight = flow.nn.Parameter(flow.tensor(np_gamma, dtype=dtype))
+        m.bias = flow.nn.Parameter(flow.tensor(np_beta, dtype=dtype))
+    else:
+        np_gamma = np.ones(normalized_shape, dtype=np_dtype)
+        np_beta = np.zeros(normalized_shape, dtype=np_dtype)
+    m.to(flow.device(device))
+    y = m(x)
+    y.backward(flow.tensor(np_dy, dtype=dtype, device=flow.device(device)))
+    np_x, np_dy, np_gamma, np_beta = [
+        arr.astype(ref_dtype) for arr in [np_x, np_dy, np_gamma, np_beta]
+    ]
+    np_y, _, _ = _layernorm_np(np_x, np_gamma, np_beta, begin_norm_axis, eps)
+    np_dx, np_dgamma, np_dbeta = _layernorm_grad_np(
+        np_dy, np_x, np_gamma, begin_norm_axis, eps
+    )
+    test_case.assertTrue(np.allclose(y.numpy(), np_y, tol, tol))
+    test_case.assertTrue(np.allclose(x.grad.numpy(), np_dx, tol, tol))
+    if elementwise_affine:
+        test_case.assertTrue(np.allclose(m.weight.grad.numpy(), np_dgamma, tol, tol))
+        test_case.assertTrue(np.allclose(m.bias.grad.numpy(), np_dbeta, tol, tol))
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestLayerNormCpu(flow.unittest.TestCase):
+    def test_layernorm_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["test_fun"] = [
+            _test_layernorm,
+            _test_layernorm_v2,
+            _test_layernorm_v3,
+            _test_layernorm_backward,
+        ]
+        arg_dict["device"] = ["cpu"]
+        for arg in GenArgList(arg_dict):
+            arg[0](test_case, *arg[1:])
+
+    def test_layernorm_cpu_with_numpy(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["device"] = ["cpu"]
+        arg_dict["dtype"] = [flow.float32, flow.float64]
+        # Rows narrower and wider than the vectorized lanes, and a single huge row.
+        arg_dict["shape"] = [(4, 3, 5), (2, 8, 1023), (1, 2, 70000)]
+        arg_dict["begin_norm_axis"] = [1, 2]
+        arg_dict["elementwise_affine"] = [True, False]
+        for arg in GenArgList(arg_dict):
+            _test_layernorm_with_numpy(test_case, *arg)
+
+    def test_layernorm_cpu_half_with_numpy(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["device"] = ["cpu"]
+        arg_dict["dtype"] = [flow.float16]
+        arg_dict["shape"] = [(4, 3, 5), (2, 8, 1023)]
+        arg_dict["begin_norm_axis"] = [1, 2]
+        arg_dict["elementwise_affine"] = [True, False]
+        for arg in GenArgList(arg_dict):
+            _test_layernorm_with_numpy(test_case, *arg)
+
+    @autotest(n=10, auto_backward=True, rtol=1e-3, atol=1e-3)
+    def test_layernorm_cpu_with_random_data(test_case):
+        device = cpu_device()
+        channel = random(1, 32).to(int)
+        height = random(1, 4).to(int)
+        width = random(1, 2048).to(int)
+
+        def get_random_norm_shape():
+            begin_axis = random(1, 3).to(int).value()
+            return tuple((channel.value(), height.value(), width.value())[begin_axis:])
+
+        m = torch.nn.LayerNorm(
+            normalized_shape=get_random_norm_shape(),
+            elementwise_affine=random().to(bool),
+        ).to(device)
+        x = random_tensor(ndim=4, dim1=channel, dim2=height, dim3=width).to(device)
+        y = m(x)
+        return y
+
+
 @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
 @flow.unittest.skip_unless_1n1d()
 class TestLayerNorm(flow.unittest.TestCase):
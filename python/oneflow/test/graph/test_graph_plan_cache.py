@@ -0,0 +1,110 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+# Trains a linear layer with nn.Graph in a fresh process and saves the losses and the weight.
+_TRAIN_SCRIPT = """
+import sys
+import numpy as np
+import oneflow as flow
+
+linear = flow.nn.Linear(3, 8)
+flow.nn.init.constant_(linear.weight, 2.068758)
+flow.nn.init.constant_(linear.bias, 0.23)
+sgd = flow.optim.SGD(linear.parameters(), lr=0.001, momentum=0.9)
+x = flow.tensor(np.arange(24, dtype=np.float32).reshape(8, 3) / 10)
+
+
+class LinearTrainGraph(flow.nn.Graph):
+    def __init__(self):
+        super().__init__()
+        self.linear = linear
+        self.add_optimizer(sgd)
+
+    def build(self, x):
+        out = self.linear(x).sum()
+        out.backward()
+        return out
+
+
+class LinearEvalGraph(flow.nn.Graph):
+    def __init__(self):
+        super().__init__()
+        self.linear = linear
+
+    def build(self, x):
+        return self.linear(x)
+
+
+train_graph = LinearTrainGraph()
+eval_graph = LinearEvalGraph()
+losses = [train_graph(x).numpy() for _ in range(3)]
+np.savez(
+    sys.argv[1],
+    losses=np.array(losses),
+    weight=linear.weight.numpy(),
+    out=eval_graph(x).numpy(),
+)
+"""
+
+
+def _train_in_subprocess(cache_dir, out_path):
+    env = dict(os.environ)
+    env["ONEFLOW_GRAPH_PLAN_CACHE_DIR"] = cache_dir
+    subprocess.run([sys.executable, "-c", _TRAIN_SCRIPT, out_path], env=env, check=True)
+    return np.load(out_path)
+
+
+def _stat_cache_entries(cache_dir):
+    entries = {}
+    for name in os.listdir(cache_dir):
+        stat = os.stat(os.path.join(cache_dir, name))
+        entries[name] = (stat.st_ino, stat.st_mtime_ns)
+    return entries
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestGraphPlanCache(oneflow.unittest.TestCase):
+    def test_recompile_from_plan_cache(test_case):
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            cache_dir = os.path.join(tmp_dir, "plan_cache")
+            compiled = _train_in_subprocess(
+                cache_dir, os.path.join(tmp_dir, "compiled.npz")
+            )
+            # One entry per graph.
+            entries = _stat_cache_entries(cache_dir)
+            test_case.assertEqual(len(entries), 2)
+            test_case.assertTrue(all(name.startswith("plan-") for name in entries))
+
+            loaded = _train_in_subprocess(
+                cache_dir, os.path.join(tmp_dir, "loaded.npz")
+            )
+            # Both plans are loaded from the cache, so no entry is written again.
+            test_case.assertEqual(_stat_cache_entries(cache_dir), entries)
+            for name in ["losses", "weight", "out"]:
+                test_case.assertTrue(np.array_equal(loaded[name], compiled[name]))
+
+
+if __name__ == "__main__":
+    unittest.main()
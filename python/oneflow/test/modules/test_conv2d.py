@@ -1871,6 +1871,42 @@ class TestConv2d(flow.unittest.TestCase):
         y = m(x)
         return y
 
+    @autotest(n=5)
+    def test_conv2d_1x1_cpu_with_random_data(test_case):
+        channels = random(1, 16)
+        m = torch.nn.Conv2d(
+            in_channels=channels,
+            out_channels=random(1, 16),
+            kernel_size=1,
+            dilation=random(1, 3) | nothing(),
+        )
+        m.train(random())
+        device = cpu_device()
+        m.to(device)
+        x = random_tensor(ndim=4, dim0=random(1, 4), dim1=channels).to(device)
+        y = m(x)
+        return y
+
+    @autotest(n=5)
+    def test_conv2d_depthwise_cpu_with_random_data(test_case):
+        channels = random(2, 8)
+        m = torch.nn.Conv2d(
+            in_channels=channels,
+            out_channels=channels * random(1, 3).to(int),
+            kernel_size=random(1, 4),
+            stride=random() | nothing(),
+            padding=random(1, 3).to(int) | nothing(),
+            dilation=random(1, 3) | nothing(),
+            groups=channels,
+            padding_mode=constant("zeros") | nothing(),
+        )
+        m.train(random())
+        device = cpu_device()
+        m.to(device)
+        x = random_tensor(ndim=4, dim0=random(1, 4), dim1=channels).to(device)
+        y = m(x)
+        return y
+
     @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
     @autotest(n=5, check_allclose=False)
     def test_conv2d_group_with_random_data(test_case):
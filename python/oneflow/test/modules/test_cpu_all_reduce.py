@@ -0,0 +1,90 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import unittest
+from collections import OrderedDict
+
+import numpy as np
+
+# Every ring step of a large tensor is split into many chunks.
+os.environ["ONEFLOW_CCL_CPU_ALL_REDUCE_CHUNK_BYTES"] = "4096"
+
+import oneflow as flow
+import oneflow.unittest
+from oneflow.test_utils.test_util import GenArgList
+
+# Tensors up to 64KiB go through recursive doubling, larger ones through the ring.
+_shapes = [
+    # fewer elements than ranks
+    (2,),
+    (3, 5),
+    # 64KiB of float32, the largest recursive doubling message
+    (16384,),
+    (16385,),
+    # not divisible by 2, 3 or 4
+    (257, 389),
+]
+
+
+def _rank_array(rank, shape, dtype):
+    rng = np.random.RandomState(rank + 1)
+    if dtype == np.bool_:
+        return rng.randint(0, 4, size=shape) == 0
+    # Integral values, so that the sum is exact in any order.
+    return rng.randint(-100, 100, size=shape).astype(dtype)
+
+
+def _test_cpu_all_reduce(test_case, shape, dtype, inplace):
+    rank = flow.env.get_rank()
+    arrays = [_rank_array(i, shape, dtype) for i in range(flow.env.get_world_size())]
+    if dtype == np.bool_:
+        expected = np.logical_or.reduce(arrays)
+    else:
+        expected = np.sum(arrays, axis=0).astype(dtype)
+    x = flow.tensor(arrays[rank], device="cpu")
+    y = flow._C.local_all_reduce(x, inplace=inplace)
+    test_case.assertTrue(np.array_equal(y.numpy(), expected))
+    if inplace:
+        test_case.assertTrue(np.array_equal(x.numpy(), expected))
+    else:
+        test_case.assertTrue(np.array_equal(x.numpy(), arrays[rank]))
+
+
+def _test_cpu_all_reduce_cases(test_case):
+    arg_dict = OrderedDict()
+    arg_dict["shape"] = _shapes
+    arg_dict["dtype"] = [np.float32, np.float64, np.int64, np.bool_]
+    arg_dict["inplace"] = [False, True]
+    for arg in GenArgList(arg_dict):
+        _test_cpu_all_reduce(test_case, *arg)
+
+
+class TestCpuAllReduce(flow.unittest.TestCase):
+    @flow.unittest.skip_unless_1n2d()
+    def test_cpu_all_reduce_1n2d(test_case):
+        _test_cpu_all_reduce_cases(test_case)
+
+    @flow.unittest.skip_unless_1n3d()
+    def test_cpu_all_reduce_1n3d(test_case):
+        _test_cpu_all_reduce_cases(test_case)
+
+    @flow.unittest.skip_unless_1n4d()
+    def test_cpu_all_reduce_1n4d(test_case):
+        _test_cpu_all_reduce_cases(test_case)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -151,14 +151,15 @@ def compare_with_numpy_adam(
             )
 
 
-@unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
 @flow.unittest.skip_unless_1n1d()
 class TestOptimizers(flow.unittest.TestCase):
     def test_multi_tensor_adam_update(test_case):
         arg_dict = OrderedDict()
-        arg_dict["device"] = ["cuda"]
-        arg_dict["x_shape"] = [(4,)]
-        arg_dict["tensor_num"] = [4]
+        arg_dict["device"] = ["cpu"]
+        if not os.getenv("ONEFLOW_TEST_CPU_ONLY"):
+            arg_dict["device"].append("cuda")
+        arg_dict["x_shape"] = [(4,), (300, 200)]
+        arg_dict["tensor_num"] = [4, 40]
         arg_dict["betas"] = [(0.9, 0.999)]
         arg_dict["do_bias_correction"] = [True, False]
         arg_dict["learning_rate"] = [1.0, 1e-3]
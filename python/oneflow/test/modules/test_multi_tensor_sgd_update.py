@@ -96,14 +96,15 @@ def compare_with_numpy_sgd(
         )
 
 
-@unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
 @flow.unittest.skip_unless_1n1d()
 class TestOptimizers(flow.unittest.TestCase):
     def test_multi_tensor_sgd_update(test_case):
         arg_dict = OrderedDict()
-        arg_dict["device"] = ["cuda"]
-        arg_dict["x_shape"] = [(2,)]
-        arg_dict["tensor_num"] = [4]
+        arg_dict["device"] = ["cpu"]
+        if not os.getenv("ONEFLOW_TEST_CPU_ONLY"):
+            arg_dict["device"].append("cuda")
+        arg_dict["x_shape"] = [(2,), (300, 200)]
+        arg_dict["tensor_num"] = [4, 40]
         arg_dict["weight_decay"] = [0.0, 0.5]
         arg_dict["learning_rate"] = [1.0, 1e-3]
         arg_dict["train_iters"] = [10]